@@ -202,9 +202,16 @@ var opts = {
 		type: 'size',
 		map: 'loopTileSize'
 	},
+	'method-autotune': {
+		type: 'string',
+		map: 'gfAutotuneCache'
+	},
 	'hash-method': {
 		type: 'string'
 	},
+	'hash-threads': {
+		type: 'int'
+	},
 	'md5-method': {
 		type: 'string'
 	},
@@ -236,10 +243,23 @@ var opts = {
 	'opencl-minchunk': {
 		type: 'size0'
 	},
+	'opencl-auto-balance': {
+		type: 'bool',
+		map: 'openclAutoBalance',
+		default: true
+	},
+	'opencl-split': {
+		type: 'enum',
+		enum: ['slice','output'],
+		map: 'openclSplit'
+	},
 	'opencl-list': {
 		type: 'string',
 		ifSetDefault: 'gpu'
 	},
+	'repair': {
+		type: 'string'
+	},
 	'cpu-minchunk': {
 		type: 'size0',
 		map: 'cpuMinChunkSize'
@@ -372,6 +392,72 @@ if(argv['opencl-list']) {
 	process.exit(0);
 }
 
+if(argv.repair) {
+	var repairStart = Date.now();
+	var repairer;
+	try {
+		repairer = new ParPar.PAR2Repair(argv.repair, {
+			memoryLimit: 'memory' in argv ? argv.memory : null,
+			numThreads: argv.threads,
+			readBuffers: argv['read-buffers'] || 8
+		});
+	} catch(x) {
+		error(x.message);
+	}
+	var invertPercent = -1;
+	repairer.run(function(event, arg1, arg2) {
+		if(argv.quiet) return;
+		if(event == 'invert_progress') {
+			// only report whole percentage changes
+			var percent = Math.floor(arg1 * 100 / arg2);
+			if(percent == invertPercent) return;
+			invertPercent = percent;
+		}
+		if(argv.json) {
+			if(event == 'verified_file' || event == 'repaired_file')
+				print_json(event, {file_name: arg1.name, good_slices: arg1.goodSlices, total_slices: arg1.numSlices, needs_repair: arg1.needsRepair});
+			else if(event == 'repair_info')
+				print_json(event, arg1);
+			else if(event == 'pass_complete')
+				print_json(event, {pass: arg1, passes: arg2});
+			else if(event == 'invert_progress')
+				print_json(event, {progress_percent: invertPercent});
+			else if(event == 'found_displaced')
+				print_json(event, {slices: arg1});
+			return;
+		}
+		if(event == 'verified_file') {
+			var status = arg1.needsRepair ? (arg1.exists ? 'damaged' : 'missing') : 'ok';
+			process.stderr.write('Verified "' + arg1.name + '": ' + status + ' (' + arg1.goodSlices + '/' + arg1.numSlices + ' slices intact)\n');
+		}
+		else if(event == 'invert_progress') {
+			// overwritten by the following line
+			if(process.stderr.isTTY)
+				process.stderr.write('Inverting recovery matrix: ' + invertPercent + '%\r');
+		}
+		else if(event == 'found_displaced')
+			process.stderr.write('Found ' + cliFormat('1', arg1) + ' displaced slice(s), which will be moved into place\n');
+		else if(event == 'repair_info')
+			process.stderr.write('Rebuilding ' + cliFormat('1', arg1.missing_slices) + ' slice(s) from ' + cliFormat('1', arg1.recovery_slices) + ' recovery slice(s), in ' + arg1.passes + ' pass(es)\n');
+		else if(event == 'repaired_file')
+			process.stderr.write('Repaired "' + arg1.name + '"\n');
+	}, function(err) {
+		if(err) {
+			console.error(err.message || err);
+			process.exit(1);
+		}
+		if(!argv.quiet) {
+			var timeTaken = (Date.now() - repairStart)/1000;
+			if(argv.json)
+				print_json('process_complete', {duration_seconds: timeTaken, repaired: repairer.needsRepair()});
+			else
+				process.stderr.write((repairer.needsRepair() ? 'Repair complete' : 'All files are intact') + '; time taken: ' + cliFormat('1', timeTaken + ' s') + '\n');
+		}
+		process.exit(0);
+	});
+	return;
+}
+
 if(!argv.out || !argv['input-slices']) {
 	error('Values for `out` and `input-slices` are required');
 }
@@ -409,6 +495,11 @@ if(argv['hash-method']) {
 if(argv['md5-method']) {
 	require('../lib/par2.js').set_outhash_method(argv['md5-method']);
 }
+if('hash-threads' in argv) {
+	if(argv['hash-threads'] < 0)
+		error('Invalid value for `--hash-threads`');
+	require('../lib/par2.js').set_inhash_threads(argv['hash-threads']);
+}
 
 if(argv['recovery-exponents']) {
 	['recovery-slices', 'min-recovery-slices', 'max-recovery-slices', 'recovery-offset', 'slice-dist', 'slices-per-file', 'slices-first-file', 'recovery-files'].forEach(function(conflictOpt) {
@@ -913,6 +1004,8 @@ var inputFiles = argv._;
 					print_json('writing_data', {file_name: arg1.name});
 				if(event == 'closing_files')
 					print_json('closing_files', {});
+				if(event == 'rebalance')
+					print_json('rebalance', {backends: arg1});
 			}
 		}, function(err) {
 			if(err) throw err;
@@ -59,17 +59,17 @@
       }],
     ],
     "cflags_c": ["-std=c99", "-D_DARWIN_C_SOURCE", "-D_GNU_SOURCE", "-D_DEFAULT_SOURCE"],
-    "defines": ["PARPAR_ENABLE_HASHER_MULTIMD5", "PARPAR_OPENCL_SUPPORT"],
+    "defines": ["PARPAR_ENABLE_HASHER_MD5CRC", "PARPAR_ENABLE_HASHER_MULTIMD5", "PARPAR_OPENCL_SUPPORT", "PARPAR_INVERT_SUPPORT"],
     "msvs_settings": {"VCCLCompilerTool": {"Optimization": "MaxSpeed"}}
   },
   "targets": [
     {
       "target_name": "parpar_gf",
       "dependencies": [
-        "parpar_gf_c", "gf16", "gf16_generic", "gf16_sse2", "gf16_ssse3", "gf16_avx", "gf16_avx2", "gf16_avx512", "gf16_vbmi", "gf16_gfni", "gf16_gfni_avx2", "gf16_gfni_avx512", "gf16_gfni_avx10", "gf16_neon", "gf16_sha3", "gf16_sve", "gf16_sve2", "gf16_rvv", "gf16_rvv_zvbc",
+        "parpar_gf_c", "gf16", "gf16_generic", "gf16_sse2", "gf16_ssse3", "gf16_avx", "gf16_avx2", "gf16_avx512", "gf16_vbmi", "gf16_gfni", "gf16_gfni_avx2", "gf16_gfni_avx512", "gf16_gfni_avx10", "gf16_pmul_sse", "gf16_pmul_avx2", "gf16_pmul_vpclmul", "gf16_pmul_vpclgfni", "gf16_neon", "gf16_sha3", "gf16_sve", "gf16_sve2", "gf16_rvv", "gf16_rvv_zvbc",
         "hasher", "hasher_sse2", "hasher_clmul", "hasher_xop", "hasher_bmi1", "hasher_avx2", "hasher_avx512", "hasher_avx512vl", "hasher_armcrc", "hasher_neon", "hasher_neoncrc", "hasher_sve2", "hasher_rvzbc"
       ],
-      "sources": ["src/gf.cc", "gf16/controller.cpp", "gf16/controller_cpu.cpp", "gf16/controller_ocl.cpp", "gf16/controller_ocl_init.cpp"],
+      "sources": ["src/gf.cc", "gf16/controller.cpp", "gf16/controller_cpu.cpp", "gf16/controller_cpu_tune.cpp", "gf16/controller_ocl.cpp", "gf16/controller_ocl_init.cpp", "gf16/controller_repair.cpp", "gf16/gfmat_inv.cpp", "gf16/cpu_topology.cpp"],
       "include_dirs": ["gf16", "gf16/opencl-include"],
       "cflags!": ["-fno-exceptions"],
       "cxxflags!": ["-fno-exceptions"],
@@ -125,7 +125,7 @@
       "target_name": "hasher",
       "type": "static_library",
       "defines": ["NDEBUG"],
-      "sources": ["hasher/hasher.cpp", "hasher/hasher_input.cpp", "hasher/hasher_md5mb.cpp", "hasher/hasher_scalar.cpp", "hasher/tables.cpp"],
+      "sources": ["hasher/hasher.cpp", "hasher/hasher_blockscan.cpp", "hasher/hasher_input.cpp", "hasher/hasher_input_pool.cpp", "hasher/hasher_md5crc.cpp", "hasher/hasher_md5mb.cpp", "hasher/hasher_scalar.cpp", "hasher/tables.cpp"],
       "dependencies": ["hasher_c"],
       "cxxflags": ["-std=c++11"],
       "cflags!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"],
@@ -535,7 +535,8 @@
       "type": "static_library",
       "defines": ["NDEBUG"],
       "sources": [
-        "gf16/gf16mul.cpp"
+        "gf16/gf16mul.cpp",
+        "gf16/gf16pmul.cpp"
       ],
       "xcode_settings": {
         "OTHER_CFLAGS!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"],
@@ -909,6 +910,135 @@
         }]
       ]
     },
+    {
+      "target_name": "gf16_pmul_sse",
+      "type": "static_library",
+      "defines": ["NDEBUG"],
+      "sources": [
+        "gf16/gf16pmul_sse.c"
+      ],
+      "cflags": ["-Wno-unused-function", "-std=gnu99"],
+      "xcode_settings": {
+        "OTHER_CFLAGS": ["-Wno-unused-function"],
+        "OTHER_CFLAGS!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"]
+      },
+      "cflags!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"],
+      "msvs_settings": {"VCCLCompilerTool": {"BufferSecurityCheck": "false"}},
+      "conditions": [
+        ['target_arch in "ia32 x64" and OS!="win"', {
+          "variables": {"supports_pmul_sse%": "<!(<!(echo ${CC_target:-${CC:-cc}}) -MM -E gf16/gf16pmul_sse.c -msse4.1 -mpclmul 2>/dev/null || true)"},
+          "conditions": [
+            ['supports_pmul_sse!=""', {
+              "cflags": ["-msse4.1", "-mpclmul"],
+              "cxxflags": ["-msse4.1", "-mpclmul"],
+              "xcode_settings": {
+                "OTHER_CFLAGS": ["-msse4.1", "-mpclmul"],
+                "OTHER_CXXFLAGS": ["-msse4.1", "-mpclmul"],
+              }
+            }]
+          ]
+        }]
+      ]
+    },
+    {
+      "target_name": "gf16_pmul_avx2",
+      "type": "static_library",
+      "defines": ["NDEBUG"],
+      "sources": [
+        "gf16/gf16pmul_avx2.c"
+      ],
+      "cflags": ["-Wno-unused-function", "-std=gnu99"],
+      "xcode_settings": {
+        "OTHER_CFLAGS": ["-Wno-unused-function"],
+        "OTHER_CFLAGS!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"]
+      },
+      "cflags!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"],
+      "msvs_settings": {"VCCLCompilerTool": {"BufferSecurityCheck": "false"}},
+      "conditions": [
+        ['target_arch in "ia32 x64" and OS!="win"', {
+          "variables": {"supports_pmul_avx2%": "<!(<!(echo ${CC_target:-${CC:-cc}}) -MM -E gf16/gf16pmul_avx2.c -mavx2 -mpclmul 2>/dev/null || true)"},
+          "conditions": [
+            ['supports_pmul_avx2!=""', {
+              "cflags": ["-mavx2", "-mpclmul"],
+              "cxxflags": ["-mavx2", "-mpclmul"],
+              "xcode_settings": {
+                "OTHER_CFLAGS": ["-mavx2", "-mpclmul"],
+                "OTHER_CXXFLAGS": ["-mavx2", "-mpclmul"],
+              }
+            }]
+          ]
+        }],
+        ['target_arch in "ia32 x64" and OS=="win"', {
+          "msvs_settings": {"VCCLCompilerTool": {"EnableEnhancedInstructionSet": "3"}}
+        }]
+      ]
+    },
+    {
+      "target_name": "gf16_pmul_vpclmul",
+      "type": "static_library",
+      "defines": ["NDEBUG"],
+      "sources": [
+        "gf16/gf16pmul_vpclmul.c"
+      ],
+      "cflags": ["-Wno-unused-function", "-std=gnu99"],
+      "xcode_settings": {
+        "OTHER_CFLAGS": ["-Wno-unused-function"],
+        "OTHER_CFLAGS!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"]
+      },
+      "cflags!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"],
+      "msvs_settings": {"VCCLCompilerTool": {"BufferSecurityCheck": "false"}},
+      "conditions": [
+        ['target_arch in "ia32 x64" and OS!="win"', {
+          "variables": {"supports_pmul_vpclmul%": "<!(<!(echo ${CC_target:-${CC:-cc}}) -MM -E gf16/gf16pmul_vpclmul.c -mavx2 -mvpclmulqdq 2>/dev/null || true)"},
+          "conditions": [
+            ['supports_pmul_vpclmul!=""', {
+              "cflags": ["-mavx2", "-mvpclmulqdq"],
+              "cxxflags": ["-mavx2", "-mvpclmulqdq"],
+              "xcode_settings": {
+                "OTHER_CFLAGS": ["-mavx2", "-mvpclmulqdq"],
+                "OTHER_CXXFLAGS": ["-mavx2", "-mvpclmulqdq"],
+              }
+            }]
+          ]
+        }],
+        ['target_arch in "ia32 x64" and OS=="win"', {
+          "msvs_settings": {"VCCLCompilerTool": {"EnableEnhancedInstructionSet": "3"}}
+        }]
+      ]
+    },
+    {
+      "target_name": "gf16_pmul_vpclgfni",
+      "type": "static_library",
+      "defines": ["NDEBUG"],
+      "sources": [
+        "gf16/gf16pmul_vpclgfni.c"
+      ],
+      "cflags": ["-Wno-unused-function", "-std=gnu99"],
+      "xcode_settings": {
+        "OTHER_CFLAGS": ["-Wno-unused-function"],
+        "OTHER_CFLAGS!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"]
+      },
+      "cflags!": ["-fno-omit-frame-pointer", "-fno-tree-vrp", "-fno-strict-aliasing"],
+      "msvs_settings": {"VCCLCompilerTool": {"BufferSecurityCheck": "false"}},
+      "conditions": [
+        ['target_arch in "ia32 x64" and OS!="win"', {
+          "variables": {"supports_pmul_vpclgfni%": "<!(<!(echo ${CC_target:-${CC:-cc}}) -MM -E gf16/gf16pmul_vpclgfni.c -mavx2 -mvpclmulqdq -mgfni 2>/dev/null || true)"},
+          "conditions": [
+            ['supports_pmul_vpclgfni!=""', {
+              "cflags": ["-mavx2", "-mvpclmulqdq", "-mgfni"],
+              "cxxflags": ["-mavx2", "-mvpclmulqdq", "-mgfni"],
+              "xcode_settings": {
+                "OTHER_CFLAGS": ["-mavx2", "-mvpclmulqdq", "-mgfni"],
+                "OTHER_CXXFLAGS": ["-mavx2", "-mvpclmulqdq", "-mgfni"],
+              }
+            }]
+          ]
+        }],
+        ['target_arch in "ia32 x64" and OS=="win"', {
+          "msvs_settings": {"VCCLCompilerTool": {"EnableEnhancedInstructionSet": "3"}}
+        }]
+      ]
+    },
     {
       "target_name": "gf16_neon",
       "type": "static_library",
@@ -916,6 +1046,7 @@
       "sources": [
         "gf16/gf16_shuffle_neon.c",
         "gf16/gf16_clmul_neon.c",
+        "gf16/gf16pmul_neon.c",
         "gf16/gf_add_neon.c",
         "gf16/gf16_cksum_neon.c"
       ],
@@ -1020,6 +1151,7 @@
         "gf16/gf16_shuffle2x128_sve2.c",
         "gf16/gf16_shuffle512_sve2.c",
         "gf16/gf16_clmul_sve2.c",
+        "gf16/gf16pmul_sve2.c",
         "gf16/gf_add_sve2.c"
       ],
       "cflags": ["-Wno-unused-function", "-std=c99"],
@@ -1107,7 +1239,8 @@
       "type": "static_library",
       "defines": ["NDEBUG"],
       "sources": [
-        "gf16/gf16_clmul_rvv.c"
+        "gf16/gf16_clmul_rvv.c",
+        "gf16/gf16pmul_rvv.c"
       ],
       "cflags": ["-Wno-unused-function", "-std=c99"],
       "xcode_settings": {
@@ -1,11 +1,17 @@
 #include "controller.h"
 #include "../src/platform.h"
 #include "gfmat_coeff.h"
+#include "../hasher/hasher_input_impl.h"
 #include <cassert>
 #include <algorithm>
+#include <memory>
+#ifndef USE_LIBUV
+# include <thread>
+# include <chrono>
+#endif
 
 
-PAR2Proc::PAR2Proc() IF_LIBUV(: endSignalled(false)) {
+PAR2Proc::PAR2Proc() : autoBalance(false), passActive(false) IF_LIBUV(, endSignalled(false)) {
 	gfmat_init();
 }
 
@@ -14,10 +20,14 @@ bool PAR2Proc::init(size_t sliceSize, const std::vector<struct PAR2ProcBackendAl
 #ifdef USE_LIBUV
 	progressCb = _progressCb;
 	finishCb = nullptr;
+	coeffInputRef = 0;
 #endif
 	hasAdded = false;
 	
 	currentSliceSize = sliceSize;
+	numRecoverySlices = 0;
+	passActive = false;
+	balance.clear();
 	
 	// TODO: better distribution
 	backends.resize(_backends.size());
@@ -26,61 +36,83 @@ bool PAR2Proc::init(size_t sliceSize, const std::vector<struct PAR2ProcBackendAl
 		auto& backend = backends[i];
 		backend.currentSliceSize = size;
 		backend.allocSliceSize = size;
+		backend.maxSliceSize = (std::max)(size, _backends[i].maxSize);
 		backend.currentOffset = _backends[i].offset;
+		backend.outputFirst = _backends[i].outputFirst;
+		backend.outputCount = _backends[i].outputCount;
 		backend.be = _backends[i].be;
 		backend.be->setSliceSize(size);
+		backend.passInputs = 0;
 		
 #ifdef USE_LIBUV
-		backend.be->setProgressCb([this](int numInputs) {
-			this->onBackendProcess(numInputs);
+		backend.be->setProgressCb([this, i](int numInputs) {
+			this->onBackendProcess(i, numInputs);
 		});
+#else
+		backend.be->setAddNotify(&addNotify);
 #endif
 	}
 	return checkBackendAllocation();
 }
 
 bool PAR2Proc::checkBackendAllocation() {
-	// check ranges of backends (could maybe make this more optimal with a heap, but I expect few devices, so good enough for now)
-	// determine if we're covering the full slice, and whether there are overlaps (overlap = dynamic scheduling)
-	size_t start = backends[0].currentOffset, end = backends[0].currentOffset+backends[0].currentSliceSize;
-	bool hasOverlap = false;
-	std::vector<bool> beChecked(backends.size());
-	int beUnchecked = backends.size()-1;
-	beChecked[0] = true;
-	while(beUnchecked) {
-		bool beFound = false;
-		for(unsigned i=1; i<backends.size(); i++) {
-			if(beChecked[i]) continue;
-			const auto& backend = backends[i];
-			size_t currentEnd = backend.currentOffset + backend.currentSliceSize;
-			if(backend.currentOffset <= start && currentEnd >= start) {
-				if(currentEnd > start) hasOverlap = true;
-				start = backend.currentOffset;
-				if(currentEnd > end) end = currentEnd;
-			}
-			else if(currentEnd >= end && backend.currentOffset <= end) {
-				if(backend.currentOffset < end) hasOverlap = true;
-				end = currentEnd;
-				if(backend.currentOffset < start) start = backend.currentOffset; // this shouldn't be possible I think
-			}
-			else if(backend.currentOffset > start && currentEnd < end) {
-				hasOverlap = true;
-			}
-			else continue;
-			
-			// found a connecting backend
-			beChecked[i] = true;
-			beUnchecked--;
-			beFound = true;
-			
-			// ensure alignment to 16-bit words
-			if(backend.currentOffset & 1) return false;
-			if((backend.currentSliceSize & 1) && backend.currentOffset+backend.currentSliceSize != currentSliceSize) return false;
-		}
-		if(!beFound) return false;
+	// group backends with identical ranges into pools; pools with the same range but different recovery slices form a region; other overlaps aren't supported
+	pools.clear();
+	for(unsigned i=0; i<backends.size(); i++) {
+		const auto& backend = backends[i];
+		// ensure alignment to 16-bit words
+		if(backend.currentOffset & 1) return false;
+		if((backend.currentSliceSize & 1) && backend.currentOffset+backend.currentSliceSize != currentSliceSize) return false;
+		
+		// unused backends aren't pooled with each other, as they may later be given different parts of the slice
+		auto pool = backend.currentSliceSize == 0 ? pools.end() : std::find_if(pools.begin(), pools.end(), [&](const PAR2ProcPool& p) {
+			return p.offset == backend.currentOffset && p.size == backend.currentSliceSize && p.outputFirst == backend.outputFirst && p.outputCount == backend.outputCount;
+		});
+		if(pool == pools.end())
+			pools.push_back({backend.currentOffset, backend.currentSliceSize, backend.outputFirst, backend.outputCount, {i}, 0, 0});
+		else
+			pool->members.push_back(i);
 	}
-	if(hasOverlap) return false; // TODO: eventually support overlapping
-	return (start == 0 && end == currentSliceSize); // fail if backends don't cover the entire slice
+	std::sort(pools.begin(), pools.end(), [](const PAR2ProcPool& a, const PAR2ProcPool& b) {
+		if(a.offset != b.offset) return a.offset < b.offset;
+		if(a.size != b.size) return a.size < b.size;
+		return a.outputFirst < b.outputFirst;
+	});
+	
+	// pools with the same range form a region if they don't overlap in recovery slices (only the last can be open-ended)
+	for(size_t i=1; i<pools.size(); i++) {
+		const auto& prev = pools[i-1];
+		bool sameRange = pools[i].offset == prev.offset && pools[i].size == prev.size;
+		bool disjoint = prev.outputCount != 0 && prev.outputFirst + prev.outputCount <= pools[i].outputFirst;
+		if(sameRange && !disjoint && pools[i].size) return false;
+		pools[i].region = prev.region + (sameRange && disjoint ? 0 : 1);
+	}
+	
+	// regions must cover the entire slice, without overlapping each other
+	size_t end = 0;
+	for(size_t i=0; i<pools.size(); i=regionEnd(i)) {
+		if(pools[i].size == 0) continue; // covers nothing
+		if(pools[i].offset != end) return false;
+		end += pools[i].size;
+	}
+	return end == currentSliceSize;
+}
+
+// index of the pool following the region starting at the specified pool
+size_t PAR2Proc::regionEnd(size_t pool) const {
+	size_t end = pool+1;
+	while(end < pools.size() && pools[end].region == pools[pool].region)
+		end++;
+	return end;
+}
+
+// the largest size the region starting at the specified pool can be resized to
+size_t PAR2Proc::regionAlloc(size_t pool) const {
+	size_t alloc = backends[pools[pool].members[0]].allocSliceSize;
+	for(size_t i=pool; i<regionEnd(pool); i++)
+		for(unsigned idx : pools[i].members)
+			alloc = (std::min)(alloc, backends[idx].allocSliceSize);
+	return alloc;
 }
 
 // this just reduces the size without resizing backends; TODO: this should be removed
@@ -91,25 +123,43 @@ bool PAR2Proc::setCurrentSliceSize(size_t newSliceSize) {
 		backends[0].currentSliceSize = currentSliceSize;
 		backends[0].allocSliceSize = (std::max)(currentSliceSize, backends[0].allocSliceSize);
 		assert(backends[0].currentOffset == 0);
+		checkBackendAllocation(); // update the pool
 		return backends[0].be->setCurrentSliceSize(currentSliceSize);
 	}
 	
+	std::vector<std::pair<size_t, size_t>> sizeAlloc;
+	if(autoBalance && balanceSlice(newSliceSize, sizeAlloc))
+		return setCurrentSliceSize(newSliceSize, sizeAlloc);
+	
 	if(newSliceSize > currentSliceSize) {
 		// check if requested amount exceeds initial allocation
 		size_t totalAlloc = 0;
-		for(const auto& backend : backends)
-			totalAlloc += backend.allocSliceSize;
+		for(size_t i=0; i<pools.size(); i=regionEnd(i))
+			totalAlloc += regionAlloc(i);
 		if(newSliceSize > totalAlloc) return false; // backends support upsizing, but we don't know how to reallocate the split, so don't allow it for now
 	}
 	currentSliceSize = newSliceSize;
 	
+	// regions are laid out in order, each shrunk to fit what's left of the slice
 	bool success = true;
 	size_t pos = 0;
-	for(auto& backend : backends) {
-		backend.currentSliceSize = (std::min)(currentSliceSize-pos, backend.allocSliceSize);
-		backend.currentOffset = pos;
-		success = success && backend.be->setCurrentSliceSize(backend.currentSliceSize);
-		pos += backend.currentSliceSize;
+	for(size_t i=0; i<pools.size(); ) {
+		size_t end = regionEnd(i);
+		size_t alloc = (std::min)(currentSliceSize-pos, regionAlloc(i));
+		for(; i<end; i++) {
+			auto& pool = pools[i];
+			pool.offset = pos;
+			pool.size = alloc;
+			for(unsigned idx : pool.members) {
+				auto& backend = backends[idx];
+				backend.currentSliceSize = alloc;
+				backend.currentOffset = pos;
+				// resize all backends, even if one fails, so that they stay consistent with the pools
+				if(!backend.be->setCurrentSliceSize(alloc))
+					success = false;
+			}
+		}
+		pos += alloc;
 	}
 	return success;
 }
@@ -123,20 +173,143 @@ bool PAR2Proc::setCurrentSliceSize(size_t newSliceSize, const std::vector<std::p
 	for(auto& backend : backends) {
 		backend.currentSliceSize = alloc->second;
 		backend.currentOffset = alloc->first;
-		success = success && backend.be->setCurrentSliceSize(backend.currentSliceSize);
+		if(backend.be->setCurrentSliceSize(backend.currentSliceSize))
+			backend.allocSliceSize = (std::max)(backend.currentSliceSize, backend.allocSliceSize);
+		else
+			success = false;
 		alloc++;
 	}
-	return checkBackendAllocation();
+	// always update the pools, as the backends' ranges have changed
+	bool valid = checkBackendAllocation();
+	return success && valid;
+}
+
+void PAR2Proc::startPass() {
+	passActive = true;
+	passStart = std::chrono::steady_clock::now();
+	for(auto& backend : backends) {
+		backend.passInputs = 0;
+		backend.passEnd = passStart;
+	}
+}
+
+// split the slice across regions in proportion to the throughput each achieved in the last pass; returns false if there's nothing to balance, or the last pass wasn't measured
+bool PAR2Proc::balanceSlice(size_t newSliceSize, std::vector<std::pair<size_t, size_t>>& sizeAlloc) {
+	balance.clear();
+	if(passActive) return false;
+	
+	// a region's throughput is limited by the last of its members to finish; regions which were allocated nothing weren't measured, so are left unused
+	std::vector<size_t> regions, sizes, caps;
+	std::vector<double> speeds;
+	double totalSpeed = 0;
+	for(size_t i=0; i<pools.size(); i=regionEnd(i)) {
+		if(pools[i].size == 0) continue;
+		double time = 0;
+		for(size_t j=i; j<regionEnd(i); j++)
+			for(unsigned idx : pools[j].members) {
+				const auto& backend = backends[idx];
+				if(backend.passInputs == 0) return false;
+				time = (std::max)(time, std::chrono::duration<double>(backend.passEnd - passStart).count());
+			}
+		if(time <= 0) return false;
+		size_t cap = newSliceSize;
+		for(size_t j=i; j<regionEnd(i); j++)
+			for(unsigned idx : pools[j].members)
+				cap = (std::min)(cap, backends[idx].maxSliceSize);
+		regions.push_back(i);
+		speeds.push_back(pools[i].size / time);
+		caps.push_back(cap);
+		totalSpeed += speeds.back();
+	}
+	if(regions.size() < 2) return false;
+	
+	// all but the last region must be a multiple of 2 bytes; every region retains at least 2 bytes, so that it continues to be measured
+	size_t total = 0;
+	for(size_t r=0; r<regions.size(); r++) {
+		size_t size = (size_t)(newSliceSize * speeds[r] / totalSpeed) & ~(size_t)1;
+		size = (std::max)(size, (size_t)2);
+		size = (std::min)(size, caps[r] & ~(size_t)1);
+		sizes.push_back(size);
+		total += size;
+	}
+	// give any remainder (from rounding or capping) to regions with spare capacity, or take back any excess
+	for(size_t r=0; r<regions.size() && total != newSliceSize; r++) {
+		bool last = r == regions.size()-1;
+		size_t amount;
+		if(total < newSliceSize) {
+			amount = (std::min)(caps[r] - sizes[r], newSliceSize - total);
+			if(!last) amount &= ~(size_t)1;
+			sizes[r] += amount;
+			total += amount;
+		} else if(sizes[r] > 2) {
+			amount = (std::min)(sizes[r] - 2, total - newSliceSize);
+			if(!last) amount &= ~(size_t)1;
+			sizes[r] -= amount;
+			total -= amount;
+		}
+	}
+	if(total != newSliceSize) return false;
+	
+	sizeAlloc.resize(backends.size());
+	balance.resize(backends.size());
+	for(unsigned idx=0; idx<backends.size(); idx++) {
+		sizeAlloc[idx] = {backends[idx].currentOffset, 0}; // unused backends remain unused
+		balance[idx] = {0, backends[idx].currentOffset, 0};
+	}
+	size_t pos = 0;
+	for(size_t r=0; r<regions.size(); r++) {
+		for(size_t j=regions[r]; j<regionEnd(regions[r]); j++) {
+			const auto& pool = pools[j];
+			unsigned numOutputs = pool.outputCount ? pool.outputCount : numRecoverySlices - pool.outputFirst;
+			for(unsigned idx : pool.members) {
+				const auto& backend = backends[idx];
+				double time = std::chrono::duration<double>(backend.passEnd - passStart).count();
+				sizeAlloc[idx] = {pos, sizes[r]};
+				balance[idx] = {time > 0 ? (double)backend.currentSliceSize * backend.passInputs * numOutputs / time : 0, pos, sizes[r]};
+			}
+		}
+		pos += sizes[r];
+	}
+	// the measurements have been used; don't rebalance again until the next pass has been measured
+	for(auto& backend : backends)
+		backend.passInputs = 0;
+	return true;
 }
 
 bool PAR2Proc::setRecoverySlices(unsigned numSlices, const uint16_t* exponents) {
 	// TODO: consider throwing if numSlices > previously set, or some mechanism to resize buffer
 	
-	// TODO: may eventually consider splitting by recovery, but for now, just pass through
-	// - though we may still need a way to allocate different recovery to different backends (don't want to split slices to finely)
+	// the pools of each region must exactly cover the recovery slices (unless the region can never be used)
+	for(size_t i=0; i<pools.size(); i=regionEnd(i)) {
+		if(regionAlloc(i) == 0) continue;
+		unsigned next = 0;
+		for(size_t j=i; j<regionEnd(i); j++) {
+			if(pools[j].outputFirst != next) return false;
+			next = pools[j].outputCount ? next + pools[j].outputCount : numSlices;
+		}
+		if(next != numSlices) return false;
+	}
+	numRecoverySlices = numSlices;
+	
 	bool success = true;
-	for(auto& backend : backends)
-		success = success && backend.be->setRecoverySlices(numSlices, exponents);
+	for(auto& backend : backends) {
+		if(backend.outputFirst >= numSlices) continue; // can only occur on an unused backend
+		unsigned count = backend.outputCount ? backend.outputCount : numSlices - backend.outputFirst;
+		success = success && backend.be->setRecoverySlices(count, exponents ? exponents + backend.outputFirst : nullptr);
+	}
+	return success;
+}
+
+bool PAR2Proc::addRecoverySlices(unsigned numSlices, const uint16_t* exponents) {
+	for(const auto& pool : pools)
+		if(pool.outputFirst || pool.outputCount) return false;
+	
+	bool success = true;
+	for(auto& backend : backends) {
+		if(backend.allocSliceSize == 0) continue; // can never be used
+		success = success && backend.be->addRecoverySlices(numSlices, exponents);
+	}
+	if(success) numRecoverySlices += numSlices;
 	return success;
 }
 
@@ -160,18 +333,79 @@ PAR2ProcBackendAddResult PAR2Proc::canAdd() const {
 	return PROC_ADD_OK_BUSY;
 }
 
+FUTURE_RETURN_T IPAR2ProcBackend::addInputHashed(const void* buffer, size_t size, uint16_t inputNum, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad IF_LIBUV(, const PAR2ProcPlainCb& cb)) {
+	hasher->update(buffer, size);
+	hasher->getBlock(md5crc, zeroPad);
+	IF_NOT_LIBUV(return) addInput(buffer, size, inputNum, flush IF_LIBUV(, cb));
+}
+FUTURE_RETURN_T IPAR2ProcBackend::addInputHashed(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad IF_LIBUV(, const PAR2ProcPlainCb& cb)) {
+	hasher->update(buffer, size);
+	hasher->getBlock(md5crc, zeroPad);
+	IF_NOT_LIBUV(return) addInput(buffer, size, coeffs, flush IF_LIBUV(, cb));
+}
+
+// backends assigned a subset of recovery slices only receive the coefficients for those slices
+static inline uint16_t backend_coeffs(uint16_t inputNum, unsigned) {
+	return inputNum;
+}
+static inline const uint16_t* backend_coeffs(const uint16_t* coeffs, unsigned outputFirst) {
+	return coeffs + outputFirst;
+}
+
+// the backend which receives the whole of an input (if any), and hence can hash it; -1 if the input is split across backends
+// if the input goes to a pool shared by multiple backends, which one receives it isn't known in advance, so it isn't hashed by a backend either
+int PAR2Proc::hashingBackend(size_t size) const {
+	for(const auto& pool : pools) {
+		if(pool.offset == 0 && pool.size >= size && pool.members.size() == 1)
+			return pool.members[0];
+	}
+	return -1;
+}
+
+// pick the member of a pool to send the next input to: one with free space is preferred over one which is busy, and one which is full is only chosen if all are
+unsigned PAR2Proc::claimBackend(struct PAR2ProcPool& pool) {
+	if(pool.members.size() == 1) return pool.members[0];
+	unsigned best = 0;
+	int bestRank = -1;
+	for(unsigned i=0; i<pool.members.size(); i++) {
+		unsigned member = (pool.nextMember + i) % pool.members.size();
+		auto state = backends[pool.members[member]].be->canAdd();
+		int rank = state == PROC_ADD_OK ? 2 : (state == PROC_ADD_OK_BUSY ? 1 : 0);
+		if(rank > bestRank) {
+			bestRank = rank;
+			best = member;
+		}
+	}
+	pool.nextMember = (best + 1) % pool.members.size();
+	return pool.members[best];
+}
+
 #ifndef USE_LIBUV
 void PAR2Proc::waitForAdd() {
-	for(auto& backend : backends)
-		backend.be->waitForAdd();
+	for(const auto& pool : pools) {
+		if(pool.size == 0) continue;
+		if(pool.members.size() == 1) {
+			backends[pool.members[0]].be->waitForAdd();
+			continue;
+		}
+		// wait for any member to have space; each backend signals addNotify when it frees up a staging area
+		std::unique_lock<std::mutex> lk(addNotify.mutex);
+		addNotify.cond.wait(lk, [&]() {
+			return std::any_of(pool.members.begin(), pool.members.end(), [this](unsigned idx) {
+				return backends[idx].be->canAdd() != PROC_ADD_FULL;
+			});
+		});
+	}
 }
 #endif
 
 #ifdef USE_LIBUV
 template<typename T>
-bool PAR2Proc::_addInput(const void* buffer, size_t size, uint16_t inputRef, T inputNumOrCoeffs, bool flush, const PAR2ProcPlainCb& cb) {
+bool PAR2Proc::_addInput(const void* buffer, size_t size, int inputRef, T inputNumOrCoeffs, bool flush, IHasherInput* hasher, void* md5crc, const PAR2ProcPlainCb& cb) {
 	IF_LIBUV(assert(!endSignalled));
+	if(!passActive) startPass();
 	
+	int hashBackend = hasher ? hashingBackend(size) : -1;
 	auto cbRef = addCbRefs.find(inputRef);
 	if(cbRef != addCbRefs.end()) {
 		cbRef->second.cb = cb;
@@ -188,26 +422,42 @@ bool PAR2Proc::_addInput(const void* buffer, size_t size, uint16_t inputRef, T i
 				}
 			}
 		})).first;
-		for(auto& backend : backends) {
-			size_t amount = (std::min)(size-backend.currentOffset, backend.currentSliceSize);
-			if(backend.currentOffset >= size || amount == 0)
-				cbRef->second.backendsActive--;
+		// only one backend per pool receives the input
+		cbRef->second.backendsActive = 0;
+		for(const auto& pool : pools) {
+			if(pool.offset < size && pool.size > 0)
+				cbRef->second.backendsActive++;
+		}
+		// if no backend can hash the input, do it now (only on the first attempt, as failed adds are resent)
+		if(hasher && hashBackend < 0) {
+			hasher->update(buffer, size);
+			hasher->getBlock(md5crc, currentSliceSize - size);
 		}
 	}
 	
 	// if the last add was unsuccessful, we assume that failed add is now being resent
 	// TODO: consider some better system - e.g. it may be worthwhile allowing accepting backends to continue to get new buffers? or perhaps use this as an opportunity to size up the size?
 	bool success = true;
-	for(auto& backend : backends) {
-		if(backend.currentOffset >= size) continue;
-		size_t amount = (std::min)(size-backend.currentOffset, backend.currentSliceSize);
+	for(auto& pool : pools) {
+		if(pool.offset >= size) continue;
+		size_t amount = (std::min)(size-pool.offset, pool.size);
 		if(amount == 0) continue;
-		if(backend.added.find(inputRef) == backend.added.end()) {
+		bool added = false;
+		for(unsigned idx : pool.members)
+			if(backends[idx].added.find(inputRef) != backends[idx].added.end()) added = true;
+		if(!added) {
+			unsigned i = claimBackend(pool);
+			auto& backend = backends[i];
 			bool canAdd = backend.be->canAdd() != PROC_ADD_FULL;
-			if(canAdd)
-				backend.be->addInput(static_cast<const char*>(buffer) + backend.currentOffset, amount, inputNumOrCoeffs, flush, cbRef->second.backendCb);
+			if(canAdd && (int)i == hashBackend)
+				backend.be->addInputHashed(buffer, size, backend_coeffs(inputNumOrCoeffs, backend.outputFirst), flush, hasher, md5crc, currentSliceSize - size, cbRef->second.backendCb);
+			else if(canAdd)
+				backend.be->addInput(static_cast<const char*>(buffer) + backend.currentOffset, amount, backend_coeffs(inputNumOrCoeffs, backend.outputFirst), flush, cbRef->second.backendCb);
 			success = success && canAdd;
-			if(canAdd) backend.added.insert(inputRef);
+			if(canAdd) {
+				backend.added.insert(inputRef);
+				backend.passInputs++;
+			}
 		}
 	}
 	if(success) {
@@ -220,18 +470,37 @@ bool PAR2Proc::_addInput(const void* buffer, size_t size, uint16_t inputRef, T i
 }
 
 bool PAR2Proc::addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush, const PAR2ProcPlainCb& cb) {
-	return _addInput(buffer, size, inputNum, inputNum, flush, cb);
+	return _addInput(buffer, size, inputNum, inputNum, flush, nullptr, nullptr, cb);
 }
 bool PAR2Proc::addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, const PAR2ProcPlainCb& cb) {
-	// use first coefficient as reference
-	return _addInput(buffer, size, coeffs[0], coeffs, flush, cb);
+	// the reference only moves on once the add succeeds, as a failed add will be resent
+	bool added = _addInput(buffer, size, 65536 + coeffInputRef, coeffs, flush, nullptr, nullptr, cb);
+	if(added) coeffInputRef++;
+	return added;
+}
+bool PAR2Proc::addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush, IHasherInput* hasher, void* md5crc, const PAR2ProcPlainCb& cb) {
+	return _addInput(buffer, size, inputNum, inputNum, flush, hasher, md5crc, cb);
+}
+bool PAR2Proc::addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, IHasherInput* hasher, void* md5crc, const PAR2ProcPlainCb& cb) {
+	bool added = _addInput(buffer, size, 65536 + coeffInputRef, coeffs, flush, hasher, md5crc, cb);
+	if(added) coeffInputRef++;
+	return added;
 }
 #else
+// unlike std::async, the returned future doesn't block on destruction, so callers can discard it whilst backends hold onto an input (e.g. CPU in-place input, which is only released once processed)
 static std::future<void> combine_futures(std::vector<std::future<void>>&& futures) {
-	return std::async(std::launch::async, [](std::vector<std::future<void>>&& futures) {
-		for(auto& f : futures)
-			f.get();
-	}, std::move(futures));
+	auto prom = std::make_shared<std::promise<void>>();
+	auto result = prom->get_future();
+	std::thread([prom](std::vector<std::future<void>>&& futures) {
+		try {
+			for(auto& f : futures)
+				f.get();
+			prom->set_value();
+		} catch(...) {
+			prom->set_exception(std::current_exception());
+		}
+	}, std::move(futures)).detach();
+	return result;
 }
 static std::future<bool> combine_futures_and(std::vector<std::future<bool>>&& futures) {
 	return std::async(std::launch::async, [](std::vector<std::future<bool>>&& futures) -> bool {
@@ -243,40 +512,68 @@ static std::future<bool> combine_futures_and(std::vector<std::future<bool>>&& fu
 }
 
 template<typename T>
-std::future<void> PAR2Proc::_addInput(const void* buffer, size_t size, T inputNumOfCoeffs, bool flush) {
+std::future<void> PAR2Proc::_addInput(const void* buffer, size_t size, T inputNumOfCoeffs, bool flush, IHasherInput* hasher, void* md5crc) {
 	std::vector<std::future<void>> addFutures;
-	addFutures.reserve(backends.size());
+	addFutures.reserve(pools.size());
+	if(!passActive) startPass();
 	
-	for(auto& backend : backends) {
-		if(backend.currentOffset >= size) continue;
-		size_t amount = (std::min)(size-backend.currentOffset, backend.currentSliceSize);
+	int hashBackend = hasher ? hashingBackend(size) : -1;
+	if(hasher && hashBackend < 0) {
+		hasher->update(buffer, size);
+		hasher->getBlock(md5crc, currentSliceSize - size);
+	}
+	
+	for(auto& pool : pools) {
+		if(pool.offset >= size) continue;
+		size_t amount = (std::min)(size-pool.offset, pool.size);
 		if(amount == 0) continue;
-		addFutures.push_back(backend.be->addInput(static_cast<const char*>(buffer) + backend.currentOffset, amount, inputNumOfCoeffs, flush));
+		unsigned i = claimBackend(pool);
+		auto& backend = backends[i];
+		backend.passInputs++;
+		if((int)i == hashBackend)
+			addFutures.push_back(backend.be->addInputHashed(buffer, size, backend_coeffs(inputNumOfCoeffs, backend.outputFirst), flush, hasher, md5crc, currentSliceSize - size));
+		else
+			addFutures.push_back(backend.be->addInput(static_cast<const char*>(buffer) + backend.currentOffset, amount, backend_coeffs(inputNumOfCoeffs, backend.outputFirst), flush));
 	}
 	hasAdded = true;
+	if(addFutures.size() == 1) return std::move(addFutures[0]);
 	return combine_futures(std::move(addFutures));
 }
 
 FUTURE_RETURN_T PAR2Proc::addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush) {
-	return _addInput(buffer, size, inputNum, flush);
+	return _addInput(buffer, size, inputNum, flush, nullptr, nullptr);
 }
 FUTURE_RETURN_T PAR2Proc::addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush) {
-	return _addInput(buffer, size, coeffs, flush);
+	return _addInput(buffer, size, coeffs, flush, nullptr, nullptr);
+}
+FUTURE_RETURN_T PAR2Proc::addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush, IHasherInput* hasher, void* md5crc) {
+	return _addInput(buffer, size, inputNum, flush, hasher, md5crc);
+}
+FUTURE_RETURN_T PAR2Proc::addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, IHasherInput* hasher, void* md5crc) {
+	return _addInput(buffer, size, coeffs, flush, hasher, md5crc);
 }
 #endif
 
 bool PAR2Proc::dummyInput(size_t size, uint16_t inputNum, bool flush) {
 	IF_LIBUV(assert(!endSignalled));
+	if(!passActive) startPass();
 	
 	bool success = true;
-	for(auto& backend : backends) {
-		if(backend.currentOffset >= size || backend.currentSliceSize == 0) continue;
-		if(backend.added.find(inputNum) == backend.added.end()) {
+	for(auto& pool : pools) {
+		if(pool.offset >= size || pool.size == 0) continue;
+		bool added = false;
+		for(unsigned idx : pool.members)
+			if(backends[idx].added.find(inputNum) != backends[idx].added.end()) added = true;
+		if(!added) {
+			auto& backend = backends[claimBackend(pool)];
 			bool canAdd = backend.be->canAdd() != PROC_ADD_FULL;
 			if(canAdd)
 				backend.be->dummyInput(inputNum, flush);
 			success = success && canAdd;
-			if(canAdd) backend.added.insert(inputNum);
+			if(canAdd) {
+				backend.added.insert(inputNum);
+				backend.passInputs++;
+			}
 		}
 	}
 	if(success) {
@@ -313,6 +610,7 @@ FUTURE_RETURN_T PAR2Proc::endInput(IF_LIBUV(const PAR2ProcPlainCb& _finishCb)) {
 #ifdef USE_LIBUV
 	assert(!endSignalled);
 	flush();
+	passActive = false;
 	finishCb = _finishCb;
 	bool allIsEmpty = true;
 	for(auto& backend : backends) {
@@ -325,83 +623,137 @@ FUTURE_RETURN_T PAR2Proc::endInput(IF_LIBUV(const PAR2ProcPlainCb& _finishCb)) {
 		processing_finished();
 #else
 	flush();
+	passActive = false;
 	std::vector<std::future<void>> futures;
-	for(auto& backend : backends) {
+	for(unsigned i=0; i<backends.size(); i++) {
+		auto& backend = backends[i];
 		if(backend.currentSliceSize == 0) continue;
-		futures.push_back(backend.be->endInput()); // this will also call processing_finished when appropriate
+		if(autoBalance) {
+			// note when each backend finishes, to measure its throughput
+			futures.push_back(std::async(std::launch::async, [this, i](std::future<void>&& f) {
+				f.get();
+				backends[i].passEnd = std::chrono::steady_clock::now();
+			}, backend.be->endInput()));
+		} else
+			futures.push_back(backend.be->endInput()); // this will also call processing_finished when appropriate
 	}
 	return combine_futures(std::move(futures));
 #endif
 }
 
+// XOR src into dst, a few words at a time (which compilers can vectorise)
+static void xor_buffer(void* dst, const void* src, size_t len) {
+	uint8_t* d = static_cast<uint8_t*>(dst);
+	const uint8_t* s = static_cast<const uint8_t*>(src);
+	const size_t BLOCK = sizeof(uintptr_t)*4;
+	size_t i = 0;
+	for(; i+BLOCK <= len; i += BLOCK) {
+		uintptr_t dw[4], sw[4];
+		memcpy(dw, d+i, BLOCK);
+		memcpy(sw, s+i, BLOCK);
+		for(int w=0; w<4; w++)
+			dw[w] ^= sw[w];
+		memcpy(d+i, dw, BLOCK);
+	}
+	for(; i<len; i++)
+		d[i] ^= s[i];
+}
+
+struct PAR2ProcOutputFetch {
+	IPAR2ProcBackend* be;
+	unsigned index; // index of the recovery slice, relative to the backend's first
+	void* output;
+};
+// a pool member's partial output, to be XOR'd into the final output once fetched
+struct PAR2ProcOutputMerge {
+	void* output;
+	std::unique_ptr<uint8_t[]> partial;
+	size_t len;
+};
+
 FUTURE_RETURN_BOOL_T PAR2Proc::getOutput(unsigned index, void* output  IF_LIBUV(, const PAR2ProcOutputCb& cb)) const {
-#ifdef USE_LIBUV
 	if(!hasAdded) {
 		// no recovery was computed -> zero fill result
 		memset(output, 0, currentSliceSize);
+#ifdef USE_LIBUV
 		cb(true);
 		return;
+#else
+		std::promise<bool> prom;
+		prom.set_value(true);
+		return prom.get_future();
+#endif
 	}
 	
-	auto* cbRef = new int(backends.size());
-	for(const auto& backend : backends) {
-		if(backend.currentSliceSize == 0)
-			(*cbRef)--;
+	// in each region, the output comes from the pool holding the recovery slice
+	// the first member of the pool which computed anything writes directly to the output; any others write to a temporary buffer, which is merged in afterwards
+	std::vector<PAR2ProcOutputFetch> fetches;
+	auto merges = std::make_shared<std::vector<PAR2ProcOutputMerge>>();
+	for(size_t i=0; i<pools.size(); i=regionEnd(i)) {
+		if(pools[i].size == 0) continue;
+		auto outputPtr = static_cast<char*>(output) + pools[i].offset;
+		bool hasOutput = false;
+		for(size_t j=i; j<regionEnd(i); j++) {
+			const auto& pool = pools[j];
+			if(index < pool.outputFirst || (pool.outputCount && index >= pool.outputFirst + pool.outputCount)) continue;
+			for(unsigned idx : pool.members) {
+				auto* be = backends[idx].be;
+				if(!be->_hasAdded()) continue;
+				if(!hasOutput) {
+					fetches.push_back({be, index - pool.outputFirst, outputPtr});
+					hasOutput = true;
+				} else {
+					merges->push_back({outputPtr, std::unique_ptr<uint8_t[]>(new uint8_t[pool.size]), pool.size});
+					fetches.push_back({be, index - pool.outputFirst, merges->back().partial.get()});
+				}
+			}
+		}
+		// no computation done on region -> zero fill part
+		if(!hasOutput)
+			memset(outputPtr, 0, pools[i].size);
+	}
+
+#ifdef USE_LIBUV
+	if(fetches.empty()) {
+		cb(true);
+		return;
 	}
+	auto* cbRef = new int(fetches.size());
 	auto* allValid = new bool(true);
-	for(auto& backend : backends) {
-		if(backend.currentSliceSize == 0) continue;
-		auto outputPtr = static_cast<char*>(output) + backend.currentOffset;
-		if(!backend.be->_hasAdded()) {
-			// no computation done on backend -> zero fill part
-			memset(outputPtr, 0, backend.currentSliceSize);
+	for(const auto& fetch : fetches) {
+		fetch.be->getOutput(fetch.index, fetch.output, [cbRef, allValid, merges, cb](bool valid) {
+			*allValid = *allValid && valid;
 			if(--(*cbRef) == 0) {
+				for(const auto& merge : *merges)
+					xor_buffer(merge.output, merge.partial.get(), merge.len);
 				delete cbRef;
 				cb(*allValid);
 				delete allValid;
 			}
-		} else {
-			// TODO: for overlapping regions, need to do a xor-merge pass
-			backend.be->getOutput(index, outputPtr, [cbRef, allValid, cb](bool valid) {
-				*allValid = *allValid && valid;
-				if(--(*cbRef) == 0) {
-					delete cbRef;
-					cb(*allValid);
-					delete allValid;
-				}
-			});
-		}
+		});
 	}
-	
 #else
-	
-	if(!hasAdded) {
-		// no recovery was computed -> zero fill result
-		memset(output, 0, currentSliceSize);
-		std::promise<bool> prom;
-		prom.set_value(true);
-		return prom.get_future();
-	}
-	
 	std::vector<std::future<bool>> outFutures;
-	outFutures.reserve(backends.size());
-	
-	for(auto& backend : backends) {
-		if(backend.currentSliceSize == 0) continue;
-		auto outputPtr = static_cast<char*>(output) + backend.currentOffset;
-		if(!backend.be->_hasAdded()) {
-			// no computation done on backend -> zero fill part
-			memset(outputPtr, 0, backend.currentSliceSize);
-		} else {
-			outFutures.push_back(backend.be->getOutput(index, outputPtr));
-		}
-	}
-	return combine_futures_and(std::move(outFutures));
+	outFutures.reserve(fetches.size());
+	for(const auto& fetch : fetches)
+		outFutures.push_back(fetch.be->getOutput(fetch.index, fetch.output));
+	if(merges->empty())
+		return combine_futures_and(std::move(outFutures));
+	return std::async(std::launch::async, [merges](std::vector<std::future<bool>>&& futures) -> bool {
+		bool result = true;
+		for(auto& f : futures)
+			result = result && f.get();
+		for(const auto& merge : *merges)
+			xor_buffer(merge.output, merge.partial.get(), merge.len);
+		return result;
+	}, std::move(outFutures));
 #endif
 }
 
 #ifdef USE_LIBUV
-void PAR2Proc::onBackendProcess(int numInputs) {
+void PAR2Proc::onBackendProcess(unsigned backend, int numInputs) {
+	backends[backend].passEnd = std::chrono::steady_clock::now();
+	
 	// since we need to invoke the callback for each backend which completes (for adds to continue), this means this isn't exactly 'progress' any more
 	// TODO: consider renaming
 	if(progressCb) progressCb(numInputs);
@@ -424,8 +776,10 @@ void PAR2Proc::processing_finished() {
 		if(backend.currentSliceSize > 0)
 			backend.be->processing_finished();
 	
-	if(finishCb) finishCb();
+	// the callback may start another pass, so clear it first
+	auto cb = finishCb;
 	finishCb = nullptr;
+	if(cb) cb();
 }
 
 void PAR2Proc::deinit(PAR2ProcPlainCb cb) {
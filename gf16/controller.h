@@ -5,10 +5,13 @@
 #include <vector>
 #include <cstring>
 #include <functional>
+#include <chrono>
 #include <unordered_map>
 #include <unordered_set>
 #include "threadqueue.h"
 
+class IHasherInput;
+
 
 #ifdef USE_LIBUV
 // callback types
@@ -74,6 +77,19 @@ public:
 	}
 };
 
+#ifndef USE_LIBUV
+// signalled whenever a backend releases a staging area, so that a controller can wait for any of several backends to accept input
+struct PAR2ProcAddNotify {
+	std::mutex mutex;
+	std::condition_variable cond;
+	inline void signal() {
+		// taking the lock ensures that a waiter is either yet to check the backends, or is already waiting
+		{ std::lock_guard<std::mutex> lk(mutex); }
+		cond.notify_all();
+	}
+};
+#endif
+
 class IPAR2ProcBackend {
 protected:
 #ifdef USE_LIBUV
@@ -112,6 +128,10 @@ protected:
 	}
 #else
 	std::atomic<unsigned> stagingActiveCount;
+	PAR2ProcAddNotify* addNotify;
+	inline void _areaReleased() {
+		if(addNotify) addNotify->signal();
+	}
 	static inline void _waitForAdd(IPAR2ProcStaging& area) {
 		area.promFuture.get();
 	}
@@ -151,7 +171,7 @@ public:
 	, _queueRecv(_loop, this, &IPAR2ProcBackend::_notifyRecv)
 	, _queueProc(_loop, this, &IPAR2ProcBackend::_notifyProc)
 #else
-	IPAR2ProcBackend() : stagingActiveCount(0)
+	IPAR2ProcBackend() : stagingActiveCount(0), addNotify(nullptr)
 #endif
 	{}
 	int getNumRecoverySlices() const {
@@ -165,9 +185,19 @@ public:
 #endif
 	virtual bool setCurrentSliceSize(size_t size) = 0;
 	virtual bool setRecoverySlices(unsigned numSlices, const uint16_t* exponents = nullptr) = 0;
+	// append recovery slices, retaining what's been computed for existing ones; backends which don't support this return false
+	virtual bool addRecoverySlices(unsigned numSlices, const uint16_t* exponents = nullptr) {
+		(void)numSlices; (void)exponents;
+		return false;
+	}
 	virtual PAR2ProcBackendAddResult canAdd() const = 0;
 	virtual FUTURE_RETURN_T addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush IF_LIBUV(, const PAR2ProcPlainCb& cb)) = 0;
 	virtual FUTURE_RETURN_T addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush IF_LIBUV(, const PAR2ProcPlainCb& cb)) = 0;
+	// as above, but also feeds the input through `hasher`, then writes the block hash (MD5 + CRC32, as per IHasherInput::getBlock) to `md5crc`, with the block treated as zero padded by `zeroPad` bytes
+	// the hash is available, and `hasher` can be used again, once the add is signalled
+	// by default, hashing is performed on the calling thread, before the input is added; backends can override this to fuse it with their prepare
+	virtual FUTURE_RETURN_T addInputHashed(const void* buffer, size_t size, uint16_t inputNum, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad IF_LIBUV(, const PAR2ProcPlainCb& cb));
+	virtual FUTURE_RETURN_T addInputHashed(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad IF_LIBUV(, const PAR2ProcPlainCb& cb));
 	virtual void dummyInput(uint16_t inputNum, bool flush = false) = 0;
 	virtual bool fillInput(const void* buffer) = 0;
 	virtual void flush() = 0;
@@ -192,6 +222,9 @@ public:
 	virtual void processing_finished() {};
 #ifndef USE_LIBUV
 	virtual void waitForAdd() = 0;
+	inline void setAddNotify(PAR2ProcAddNotify* notify) {
+		addNotify = notify;
+	}
 #endif
 	
 #ifdef USE_LIBUV
@@ -229,7 +262,11 @@ struct Backend {
 	size_t currentOffset;
 	size_t currentSliceSize;
 	size_t allocSliceSize;
+	size_t maxSliceSize; // most of the slice the backend can be given when rebalancing
+	unsigned outputFirst, outputCount; // as per PAR2ProcBackendAlloc
 	std::unordered_set<int> added;
+	unsigned passInputs; // inputs sent to the backend in the last pass
+	std::chrono::steady_clock::time_point passEnd; // when the backend last finished processing
 };
 
 #ifdef USE_LIBUV
@@ -243,6 +280,31 @@ struct PAR2ProcAddCbRef {
 struct PAR2ProcBackendAlloc {
 	IPAR2ProcBackend* be;
 	size_t offset, size;
+	// backends can also be allocated a range of recovery slices, allowing recovery to be split between backends which each receive the full input (e.g. if a device can't hold all recovery data for the slice); outputCount = 0 means all slices from outputFirst onwards
+	unsigned outputFirst, outputCount;
+	// when auto-balancing, the backend can be grown to this size (e.g. as far as its memory allows); 0 means it can't grow beyond size
+	size_t maxSize;
+	
+	PAR2ProcBackendAlloc(IPAR2ProcBackend* _be, size_t _offset, size_t _size, unsigned _outputFirst = 0, unsigned _outputCount = 0, size_t _maxSize = 0)
+	: be(_be), offset(_offset), size(_size), outputFirst(_outputFirst), outputCount(_outputCount), maxSize(_maxSize) {}
+};
+
+// throughput of a backend over the last pass, and the part of the slice allocated to it for the next
+struct PAR2ProcBackendBalance {
+	double rate; // multiplied bytes/sec
+	size_t offset, size;
+};
+
+// backends allocated the same range form a pool; each input is only sent to one member of each pool (whichever is most ready to accept it), so each member computes a partial sum of the recovery data, which are XOR'd together when fetching outputs
+// this allows devices of unknown relative speed to share part of the slice, with each processing what it can keep up with
+// pools with the same range, but different recovery slices, form a region, which all receive the same inputs
+// backends allocated nothing are kept in pools of their own, so that they can be given part of the slice when it's resized
+struct PAR2ProcPool {
+	size_t offset, size;
+	unsigned outputFirst, outputCount;
+	std::vector<unsigned> members; // indices into backends
+	unsigned nextMember; // where to start looking for a member, so that equally ready members take turns
+	unsigned region; // pools in the same region are adjacent
 };
 
 class PAR2Proc {
@@ -250,22 +312,39 @@ private:
 	bool hasAdded;
 #ifdef USE_LIBUV
 	std::unordered_map<int, struct PAR2ProcAddCbRef> addCbRefs;
-	template<typename T> bool _addInput(const void* buffer, size_t size, uint16_t inputRef, T inputNumOfCoeffs, bool flush, const PAR2ProcPlainCb& cb);
+	uint16_t coeffInputRef; // inputs added by coefficients have no input number, so are referenced by a counter instead (offset by 65536 to avoid clashing with input numbers)
+	template<typename T> bool _addInput(const void* buffer, size_t size, int inputRef, T inputNumOfCoeffs, bool flush, IHasherInput* hasher, void* md5crc, const PAR2ProcPlainCb& cb);
 #else
-	template<typename T> std::future<void> _addInput(const void* buffer, size_t size, T inputNumOfCoeffs, bool flush);
+	template<typename T> std::future<void> _addInput(const void* buffer, size_t size, T inputNumOfCoeffs, bool flush, IHasherInput* hasher, void* md5crc);
 #endif
+	int hashingBackend(size_t size) const;
 	std::vector<struct Backend> backends;
+	std::vector<struct PAR2ProcPool> pools; // sorted by offset, then outputFirst
+	unsigned claimBackend(struct PAR2ProcPool& pool);
+	size_t regionEnd(size_t pool) const;
+	size_t regionAlloc(size_t pool) const;
+	unsigned numRecoverySlices;
 	
 	bool checkBackendAllocation();
 	
 	size_t currentSliceSize; // current slice chunk size (<=sliceSize)
 	
+	// throughput measurement, for balancing the slice across backends
+	bool autoBalance;
+	std::vector<struct PAR2ProcBackendBalance> balance;
+	bool passActive;
+	std::chrono::steady_clock::time_point passStart;
+	void startPass();
+	bool balanceSlice(size_t newSliceSize, std::vector<std::pair<size_t, size_t>>& sizeAlloc);
+
 #ifdef USE_LIBUV
 	bool endSignalled;
 	void processing_finished();
 	PAR2ProcPlainCb finishCb;
 	PAR2ProcCompleteCb progressCb;
-	void onBackendProcess(int numInputs);
+	void onBackendProcess(unsigned backend, int numInputs);
+#else
+	PAR2ProcAddNotify addNotify;
 #endif
 	
 	// disable copy constructor
@@ -281,24 +360,44 @@ public:
 	inline size_t getCurrentSliceSize() const {
 		return currentSliceSize;
 	}
+	// when enabled, the single argument setCurrentSliceSize splits the slice across backends in proportion to the throughput each achieved in the last pass, so that they finish together
+	// this only applies to backends allocated different parts of the slice; getBalance returns the measured rates and the chosen split if the last resize rebalanced the slice
+	inline void setAutoBalance(bool enable) {
+		autoBalance = enable;
+	}
+	inline bool getAutoBalance() const {
+		return autoBalance;
+	}
+	inline const std::vector<struct PAR2ProcBackendBalance>& getBalance() const {
+		return balance;
+	}
 	
 	bool setRecoverySlices(unsigned numSlices, const uint16_t* exponents = nullptr);
 	inline bool setRecoverySlices(const std::vector<uint16_t>& exponents) {
 		return setRecoverySlices(exponents.size(), exponents.data());
 	}
 	inline int getNumRecoverySlices() const {
-		// TODO: need proper number if splitting recovery blocks; for now, just use the first backend as all are the same
-		return backends[0].be->getNumRecoverySlices();
+		return numRecoverySlices;
 	}
+	// append recovery slices, retaining the recovery data computed so far; the new slices start zeroed, so for them to be complete, inputs already processed need to be added again, with zero coefficients for the existing slices
+	// can only be used between passes (i.e. once endInput completes), and if all backends support it; recovery slices can't be split across backends
+	bool addRecoverySlices(unsigned numSlices, const uint16_t* exponents = nullptr);
 	
 	PAR2ProcBackendAddResult canAdd() const;
 #ifndef USE_LIBUV
 	void waitForAdd();
 	FUTURE_RETURN_T addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush = false);
 	FUTURE_RETURN_T addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush = false);
+	// add an input whilst computing its block hash (MD5 + CRC32) into `md5crc`, with the block zero padded to the current slice size; where possible, this is done as part of the backend's prepare, to avoid reading the input twice
+	// `hasher` must not be used elsewhere until the add completes, and inputs using the same hasher are hashed in the order they're added
+	FUTURE_RETURN_T addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush, IHasherInput* hasher, void* md5crc);
+	FUTURE_RETURN_T addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, IHasherInput* hasher, void* md5crc);
 #else
 	bool addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush, const PAR2ProcPlainCb& cb);
 	bool addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, const PAR2ProcPlainCb& cb);
+	// hashing variants, as above
+	bool addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush, IHasherInput* hasher, void* md5crc, const PAR2ProcPlainCb& cb);
+	bool addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, IHasherInput* hasher, void* md5crc, const PAR2ProcPlainCb& cb);
 #endif
 	// dummyInput/fillInput is only used for benchmarking; pretends to add an input without transferring anything to the backend
 	bool dummyInput(size_t size, uint16_t inputNum, bool flush = false);
@@ -1,13 +1,43 @@
 #include "controller_cpu.h"
+#include "controller_cpu_common.h"
 #include "../src/platform.h"
 #include "gfmat_coeff.h"
+#include "../hasher/hasher_input_impl.h"
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+# include "../hasher/hasher_md5mb.h"
+#endif
 #include <cassert>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cmath>
 
-#ifndef MIN
-# define MIN(a, b) ((a)<(b) ? (a) : (b))
+#if defined(__linux) || defined(__linux__)
+# include <sys/mman.h>
+# include <stdio.h>
+# if defined(MAP_ANONYMOUS) && defined(MADV_DONTNEED)
+#  define PROC_MMAP_SUPPORT 1
+#  ifdef MADV_HUGEPAGE
+#   define PROC_HUGEPAGE_SUPPORT 1
+#  endif
+# endif
 #endif
-#define CEIL_DIV(a, b) (((a) + (b)-1) / (b))
-#define ROUND_DIV(a, b) (((a) + ((b)>>1)) / (b))
+
+// when work stealing, the number of tiles each worker's share of full chunks is split into
+static const size_t TILES_PER_WORKER = 4;
+// with 2D tiling, don't split outputs into ranges smaller than this, unless needed to give every worker a tile
+static const unsigned OUTPUT_TILE_MIN = 8;
+// maximum number of staging areas that can be in use, if a staging memory limit is set
+static const unsigned STAGING_AREA_SLOTS = 16;
+// when hashing inputs (or outputs), prepare (or finish) is done in pieces of this size, each being hashed whilst it's still in cache, so that the data is only read from memory once
+static const size_t HASH_PIECE_SIZE = 32768;
+// smallest per-core L2 size which the default chunk sizes are assumed to have been tuned for
+static const size_t CHUNK_REF_L2 = 256*1024;
+// in hybrid mode, core class weights are updated once each class has accumulated this much worker time (in ns), and only if a weight changes by more than the tolerance
+static const uint64_t CLASS_WEIGHT_MIN_TIME = 50000000;
+static const double CLASS_WEIGHT_TOLERANCE = 0.1;
+// default target size of each recovery memory segment; smaller on 32-bit, where address space fragmentation is more of a concern
+static const size_t SEGMENT_TARGET_SIZE = sizeof(void*) >= 8 ? 256*1048576 : 32*1048576;
 
 PAR2ProcCPUStaging::~PAR2ProcCPUStaging() {
 	if(src) ALIGN_FREE(src);
@@ -15,11 +45,14 @@ PAR2ProcCPUStaging::~PAR2ProcCPUStaging() {
 
 /** initialization **/
 PAR2ProcCPU::PAR2ProcCPU(IF_LIBUV(uv_loop_t* _loop,) int stagingAreas)
-: IPAR2ProcBackend(IF_LIBUV(_loop)), sliceSize(0), numThreads(0), gf(NULL), staging(stagingAreas), memProcessing(NULL), transferThread(PAR2ProcCPU::transfer_slice) {
+: IPAR2ProcBackend(IF_LIBUV(_loop)), sliceSize(0), numThreads(0), gf(NULL), staging(MAX(stagingAreas, (int)STAGING_AREA_SLOTS)), stagingAreasUsed(stagingAreas), minStagingAreas(stagingAreas), stagingAreasCap(0), stagingMemLimit(0), pageMode(PROC_PAGES_DEFAULT), segmentSize(SEGMENT_TARGET_SIZE), segmentChunks(0), zeroedMem(false), memIsZero(false), nextTransferThread(0), batchSeq(0), tilingMode(PROC_TILING_AUTO), outputTiled(false), workStealing(true), lookaheadPrefetch(true), inPlaceInput(false), statSteals(0), statLookaheads(0), statIdleTime(0) {
 	
 	// default number of threads = number of CPUs available
 	setNumThreads(-1);
-	transferThread.name = "gf_transfer";
+	setTransferThreads(1);
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	outputHashGroup = 0;
+#endif
 #ifdef DEBUG_STAT_THREAD_EMPTY
 	endSignalled = false;
 	statWorkerIdleEvents = 0;
@@ -72,10 +105,28 @@ void PAR2ProcCPU::setNumThreads(int threads) {
 		thWorkers[i].name = "gf_worker";
 		thWorkers[i].setCallback(PAR2ProcCPU::compute_worker);
 	}
+	if(!numaNodes.empty()) assign_numa_workers();
+	if(!coreClasses.empty()) assign_class_workers();
 	
 	if(alignedCurrentSliceSize) calcChunkSize();
 }
 
+void PAR2ProcCPU::setTransferThreads(int threads) {
+	if(threads < 1) {
+		// one transfer thread per 8 compute threads
+		threads = CEIL_DIV(numThreads, 8);
+		if(threads < 1) threads = 1;
+	}
+	
+	int oldThreads = transferThreads.size();
+	transferThreads.resize(threads); // removed threads are ended + joined once their queue is drained
+	for(int i=oldThreads; i<threads; i++) {
+		transferThreads[i].reset(new MessageThread(PAR2ProcCPU::transfer_slice));
+		transferThreads[i]->name = "gf_transfer";
+	}
+	nextTransferThread = 0;
+}
+
 bool PAR2ProcCPU::init(Galois16Methods method, unsigned _inputGrouping, size_t _chunkLen) {
 	freeGf();
 	bool ret = true;
@@ -83,7 +134,8 @@ bool PAR2ProcCPU::init(Galois16Methods method, unsigned _inputGrouping, size_t _
 	// TODO: accept & pass on hint info
 	gf = new Galois16Mul(method);
 	const Galois16MethodInfo& info = gf->info();
-	chunkLen = _chunkLen ? _chunkLen : info.idealChunkSize;
+	if(!gf->hasNaturalInput()) inPlaceInput = false;
+	targetChunkLen = chunkLen = _chunkLen ? _chunkLen : defaultChunkLen(info);
 	alignment = info.alignment;
 	stride = info.stride;
 	inputBatchSize = _inputGrouping;
@@ -116,24 +168,97 @@ bool PAR2ProcCPU::init(Galois16Methods method, unsigned _inputGrouping, size_t _
 
 bool PAR2ProcCPU::reallocMemInput() {
 	bool ret = true;
-	for(auto& area : staging) {
+	for(unsigned i=0; i<staging.size(); i++) {
+		auto& area = staging[i];
 		if(area.src) ALIGN_FREE(area.src);
+		area.src = nullptr;
+		area.inPlace.resize(inputBatchSize);
+		if(i >= stagingAreasUsed) continue;
 		ALIGN_ALLOC(area.src, inputBatchSize * alignedSliceSize, alignment);
 		if(!area.src) ret = false;
+		else if(!numaNodes.empty() && !tiles.empty()) bind_numa_staging(area);
 	}
 	return ret;
 }
 
-void PAR2ProcCPU::calcChunkSize() {
+unsigned PAR2ProcCPU::maxStagingAreas() const {
+	if(!stagingMemLimit || !alignedSliceSize) return minStagingAreas;
+	size_t areas = stagingMemLimit / (inputBatchSize * alignedSliceSize);
+	if(areas > staging.size()) areas = staging.size();
+	if(stagingAreasCap && areas > stagingAreasCap) areas = stagingAreasCap;
+	return MAX(minStagingAreas, (unsigned)areas);
+}
+
+// ensure that the current staging area can be added to, adjusting the number of areas in use if a memory limit is set
+// returns false if all areas are busy, and another couldn't be allocated
+bool PAR2ProcCPU::acquire_staging() {
+	if(currentStagingInputs) return true; // current area is partially filled
+	
+	if(stagingAreasUsed > minStagingAreas && stagingActiveCount_get() == 0) {
+		// processing has caught up with input, so release the extra areas
+		for(unsigned i=minStagingAreas; i<stagingAreasUsed; i++) {
+			if(staging[i].src) ALIGN_FREE(staging[i].src);
+			staging[i].src = nullptr;
+		}
+		stagingAreasUsed = minStagingAreas;
+		stagingAreasCap = 0; // memory has been freed, so allow retrying
+		if(currentStagingArea >= stagingAreasUsed) currentStagingArea = 0;
+	}
+	
+	if(!staging[currentStagingArea].getIsActive()) return true;
+	// areas may complete out of order, so look for any idle one
+	for(unsigned i=1; i<stagingAreasUsed; i++) {
+		unsigned idx = (currentStagingArea + i) % stagingAreasUsed;
+		if(!staging[idx].getIsActive()) {
+			currentStagingArea = idx;
+			return true;
+		}
+	}
+	
+	// all areas are busy - bring another into use
+	if(stagingAreasUsed >= maxStagingAreas()) return false;
+	auto& area = staging[stagingAreasUsed];
+	ALIGN_ALLOC(area.src, inputBatchSize * alignedSliceSize, alignment);
+	if(!area.src) {
+		// out of memory: don't go beyond the areas we have, so that canAdd reports being full until one is free
+		stagingAreasCap = stagingAreasUsed;
+		return false;
+	}
+	area.procCoeffs.resize(outputExponents.size() * inputBatchSize);
+	if(!numaNodes.empty() && !tiles.empty()) bind_numa_staging(area);
+	currentStagingArea = stagingAreasUsed++;
+	return true;
+}
+// after submitting a batch, if the next area is busy, bring in another now, so that a failed allocation is reflected by canAdd before the next add
+void PAR2ProcCPU::next_staging() {
+	if(++currentStagingArea == stagingAreasUsed)
+		currentStagingArea = 0;
+	if(stagingMemLimit && staging[currentStagingArea].getIsActive())
+		acquire_staging();
+}
+
+size_t PAR2ProcCPU::defaultChunkLen(const Galois16MethodInfo& info) {
+	// the method defaults were tuned on CPUs with at least 256KB of L2 per core; reduce them if the core's share of L2 is smaller
+	// larger caches don't seem to benefit from larger tiles (e.g. on a 2MB L2, doubling the tile size helps Affine, but is significantly slower for Shuffle), so the defaults are never increased
+	size_t l2 = cputopo_cache_info().l2PerCore();
+	size_t chunk = info.idealChunkSize;
+	if(l2) {
+		for(size_t ref = CHUNK_REF_L2; l2 < ref && chunk > info.idealChunkSize/4; ref /= 2)
+			chunk /= 2;
+	}
+	return chunk;
+}
+
+bool PAR2ProcCPU::calcChunkSize() {
 	// split the slice evenly across threads
 	size_t targetThreadChunk = CEIL_DIV(alignedCurrentSliceSize, numThreads);
 	
 	// if the per-thread size is much smaller than our target, scale it up and split by output as well
-	if(targetThreadChunk <= chunkLen/2) {
-		numChunks = ROUND_DIV(alignedCurrentSliceSize, chunkLen);
+	if(targetThreadChunk <= targetChunkLen/2) {
+		numChunks = ROUND_DIV(alignedCurrentSliceSize, targetChunkLen);
 		if(numChunks < 1) numChunks = 1;
 	} else {
-		numChunks = ROUND_DIV(targetThreadChunk, chunkLen);
+		numChunks = ROUND_DIV(targetThreadChunk, targetChunkLen);
 		if(numChunks < 1) numChunks = 1;
 		numChunks *= numThreads;
 	}
@@ -142,6 +267,11 @@ void PAR2ProcCPU::calcChunkSize() {
 	
 	// fix up numChunks with actual number (since it may have changed from aligning/rounding)
 	numChunks = CEIL_DIV(alignedCurrentSliceSize, chunkLen);
+	tiles.clear();
+	
+	// chunk regions depend on the chunk size
+	if(outputExponents.empty()) return true;
+	return reallocProcessingMem();
 }
 
 bool PAR2ProcCPU::setCurrentSliceSize(size_t newSliceSize) {
@@ -154,47 +284,295 @@ bool PAR2ProcCPU::setCurrentSliceSize(size_t newSliceSize) {
 		sliceSize = currentSliceSize;
 		alignedSliceSize = alignedCurrentSliceSize;
 		ret = reallocMemInput();
-		if(memProcessing) {
-			freeProcessingMem();
-			if(!outputExponents.empty()) {
-				ALIGN_ALLOC(memProcessing, outputExponents.size() * alignedSliceSize, alignment);
-				if(!memProcessing) ret = false;
-			}
-		}
 	}
-	calcChunkSize();
+	if(!calcChunkSize()) ret = false;
 	
 	return ret;
 }
 
 bool PAR2ProcCPU::setRecoverySlices(unsigned numSlices, const uint16_t* exponents) {
-	// TODO: consider throwing if numSlices > previously set, or some mechanism to resize buffer
-	
+	// existing recovery memory is re-used where large enough (see reallocProcessingMem), so changing the number of slices between passes doesn't need to reallocate everything
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	std::vector<uint16_t> oldExponents;
+	if(outputHashGroup) oldExponents.swap(outputExponents);
+#endif
 	outputExponents.clear();
 	if(!numSlices) return true;
 	
-	outputExponents.resize(numSlices, 1); // default to 1 to bypass output==0 add shortcut (if we're going with custom coeffs)
+	outputExponents.resize(numSlices, 1); // only informational with custom coeffs; the kernel classifies each batch's coefficients itself
 	if(exponents)
 		memcpy(outputExponents.data(), exponents, numSlices * sizeof(uint16_t));
 	
-	for(auto& area : staging)
-		area.procCoeffs.resize(numSlices * inputBatchSize);
+	for(unsigned i=0; i<stagingAreasUsed; i++) // additional areas are sized when brought into use
+		staging[i].procCoeffs.resize(numSlices * inputBatchSize);
+	tiles.clear();
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	// the same slices are re-set when the slice size changes between chunks, which mustn't lose what's been hashed so far
+	if(outputHashGroup && oldExponents != outputExponents) {
+		freeOutputHashers();
+		createOutputHashers();
+	}
+#endif
 	
-	if(!memProcessing) {
-		// allocate processing area
-		// TODO: see if we can get an aligned calloc and set processingAdd = true
-		// (investigate mmap or just use calloc and align ourself)
-		// (will need to be careful with discard_output)
-		ALIGN_ALLOC(memProcessing, numSlices * alignedSliceSize, alignment);
+	// allocate processing area
+	// if it's freshly mapped, it'll be zeroed, so the first batch can skip clearing it (see run_kernel)
+	return reallocProcessingMem();
+}
+
+bool PAR2ProcCPU::addRecoverySlices(unsigned numSlices, const uint16_t* exponents) {
+	if(!numSlices) return true;
+	// the recovery data can't be moved whilst a batch may be using it, and the pending batch's coefficients are for the existing slices
+	if(!isEmpty() || currentStagingInputs) return false;
+	for(unsigned i=0; i<stagingAreasUsed; i++)
+		if(staging[i].getIsActive()) return false;
+	
+	// if anything has been computed, it's moved to the new layout; otherwise there's nothing to retain
+	unsigned oldOutputs = outputExponents.size();
+	bool retain = oldOutputs && processingAdd && !chunkMem.empty();
+	if(retain && !growProcessingMem(oldOutputs, oldOutputs + numSlices)) return false;
+	
+	outputExponents.resize(oldOutputs + numSlices, 1);
+	if(exponents)
+		memcpy(outputExponents.data() + oldOutputs, exponents, numSlices * sizeof(uint16_t));
+	
+	for(unsigned i=0; i<stagingAreasUsed; i++)
+		staging[i].procCoeffs.resize(outputExponents.size() * inputBatchSize);
+	tiles.clear();
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	if(outputHashGroup) {
+		freeOutputHashers();
+		createOutputHashers();
 	}
-	return memProcessing != nullptr;
+#endif
+
+	if(retain) return true;
+	return reallocProcessingMem();
 }
 
-void PAR2ProcCPU::freeProcessingMem() {
-	if(memProcessing) {
-		ALIGN_FREE(memProcessing);
-		memProcessing = NULL;
+#ifdef PROC_HUGEPAGE_SUPPORT
+// read a size from a line starting with `key` in a /proc or /sys file; returns 0 if not found
+static size_t read_sys_size(const char* file, const char* key, size_t unit) {
+	size_t result = 0;
+	FILE* fp = fopen(file, "r");
+	if(!fp) return 0;
+	char line[256];
+	size_t keyLen = strlen(key);
+	while(fgets(line, sizeof(line), fp)) {
+		if(strncmp(line, key, keyLen)) continue;
+		unsigned long long value;
+		if(sscanf(line + keyLen, " %llu", &value) == 1)
+			result = (size_t)value * unit;
+		break;
+	}
+	fclose(fp);
+	return result;
+}
+// explicit huge pages (MAP_HUGETLB) use the default huge page size, whilst THP uses PMD sized pages; these usually match, but the former can be configured (e.g. to 1GB)
+static size_t hugetlb_page_size() {
+	static const size_t size = read_sys_size("/proc/meminfo", "Hugepagesize:", 1024);
+	return size ? size : 2*1048576;
+}
+static size_t thp_page_size() {
+	static const size_t size = read_sys_size("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "", 1);
+	return size ? size : hugetlb_page_size();
+}
+#endif
+static bool alloc_segment(PAR2ProcCPUSegment& seg, size_t size, size_t align, PAR2ProcCPUPageMode mode, bool zeroed) {
+	seg.size = size;
+	seg.mapped = false;
+	seg.huge = false;
+#ifdef PROC_HUGEPAGE_SUPPORT
+	if(mode != PROC_PAGES_DEFAULT) {
+# ifdef MAP_HUGETLB
+		if(mode == PROC_PAGES_HUGETLB) {
+			size_t hugeSize = hugetlb_page_size();
+			size_t mapSize = (size + hugeSize-1) & ~(hugeSize-1);
+			void* mem = mmap(NULL, mapSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+			if(mem != MAP_FAILED) {
+				seg.mem = mem;
+				seg.size = mapSize;
+				seg.mapped = seg.huge = true;
+				return true;
+			}
+			// no huge pages reserved, fall back to THP
+		}
+# endif
+		// over-allocate, so that the mapping can be aligned to a huge page boundary, which THP requires
+		size_t hugeSize = thp_page_size();
+		size_t mapSize = (size + hugeSize-1) & ~(hugeSize-1);
+		char* mem = (char*)mmap(NULL, mapSize + hugeSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if(mem != MAP_FAILED) {
+			char* alignedMem = (char*)(((uintptr_t)mem + hugeSize-1) & ~(uintptr_t)(hugeSize-1));
+			if(alignedMem > mem) munmap(mem, alignedMem - mem);
+			munmap(alignedMem + mapSize, mem + hugeSize - alignedMem);
+			seg.mem = alignedMem;
+			seg.size = mapSize;
+			seg.mapped = true;
+			seg.huge = madvise(alignedMem, mapSize, MADV_HUGEPAGE) == 0;
+			return true;
+		}
+		// fall back to regular allocation
+	}
+#else
+	(void)mode;
+#endif
+#ifdef PROC_MMAP_SUPPORT
+	if(zeroed) {
+		// anonymous mappings are page aligned and zero filled
+		void* mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if(mem != MAP_FAILED) {
+			seg.mem = mem;
+			seg.mapped = true;
+			return true;
+		}
+	}
+#else
+	(void)zeroed;
+#endif
+	ALIGN_ALLOC(seg.mem, size, align);
+	return seg.mem != nullptr;
+}
+static void free_segment(PAR2ProcCPUSegment& seg) {
+	if(!seg.mem) return;
+#ifdef PROC_MMAP_SUPPORT
+	if(seg.mapped)
+		munmap(seg.mem, seg.size);
+	else
+#endif
+		ALIGN_FREE(seg.mem);
+	seg.mem = nullptr;
+}
+
+bool PAR2ProcCPU::reallocProcessingMem() {
+	const size_t numOutputs = outputExponents.size();
+	if(!numOutputs) return true;
+	const size_t regionSize = chunkLen * numOutputs;
+	segmentChunks = segmentSize / regionSize;
+	if(segmentChunks < 1) segmentChunks = 1;
+	unsigned numSegments = (unsigned)CEIL_DIV(numChunks, segmentChunks);
+	// the last chunk is usually shorter, so size each segment to what's actually used
+	auto segmentLen = [=](unsigned seg) -> size_t {
+		size_t start = seg * segmentChunks * chunkLen;
+		size_t end = MIN((seg+1) * segmentChunks * chunkLen, alignedCurrentSliceSize);
+		return (end - start) * numOutputs;
+	};
+	
+	// re-use existing segments which are large enough, only replacing those which aren't; any surplus segments are kept for later passes
+	bool anyReused = false, anyFresh = false, freshZero = true;
+	if(memSegments.size() < numSegments) {
+		size_t oldSegments = memSegments.size();
+		memSegments.resize(numSegments);
+		for(size_t seg = oldSegments; seg < numSegments; seg++) {
+			memSegments[seg].mem = nullptr;
+			memSegments[seg].size = 0;
+		}
+	}
+	for(unsigned seg = 0; seg < numSegments; seg++) {
+		auto& segment = memSegments[seg];
+		if(segment.mem && segment.size >= segmentLen(seg)) {
+			anyReused = true;
+			continue;
+		}
+		free_segment(segment);
+		if(!alloc_segment(segment, segmentLen(seg), alignment, pageMode, zeroedMem)) {
+			freeProcessingMem();
+			return false;
+		}
+		anyFresh = true;
+		freshZero = freshZero && segment.mapped;
+	}
+	if(anyFresh) // fresh mappings are zeroed, but re-used segments retain their contents
+		memIsZero = freshZero && (memIsZero || !anyReused);
+	
+	chunkMem.resize(numChunks);
+	for(size_t chunk = 0; chunk < numChunks; chunk++)
+		chunkMem[chunk] = static_cast<char*>(memSegments[chunk / segmentChunks].mem) + (chunk % segmentChunks) * regionSize;
+	tiles.clear(); // NUMA placement needs to be redone
+	return true;
+}
+
+// extend each chunk's region with zeroed recovery data for additional outputs, retaining the existing data
+// chunks stay in the same segment, so only segments which are too small need to be replaced; replacements are allocated up front, so nothing changes if allocation fails
+bool PAR2ProcCPU::growProcessingMem(unsigned oldOutputs, unsigned numOutputs) {
+	const size_t numSegments = CEIL_DIV(numChunks, segmentChunks);
+	std::vector<PAR2ProcCPUSegment> newSegments(memSegments.begin(), memSegments.begin() + numSegments);
+	for(size_t seg = 0; seg < numSegments; seg++) {
+		size_t start = seg * segmentChunks * chunkLen;
+		size_t end = MIN((seg+1) * segmentChunks * chunkLen, alignedCurrentSliceSize);
+		size_t len = (end - start) * numOutputs;
+		if(newSegments[seg].size >= len) continue;
+		if(!alloc_segment(newSegments[seg], len, alignment, pageMode, zeroedMem)) {
+			for(size_t i = 0; i < seg; i++)
+				if(newSegments[i].mem != memSegments[i].mem) free_segment(newSegments[i]);
+			return false;
+		}
+	}
+	
+	for(size_t seg = 0; seg < numSegments; seg++) {
+		size_t firstChunk = seg * segmentChunks;
+		size_t endChunk = MIN(firstChunk + segmentChunks, numChunks);
+		// regions only move to higher addresses, so go from last to first to avoid overwriting any not yet moved
+		for(size_t chunk = endChunk; chunk-- > firstChunk; ) {
+			size_t procSize = MIN(chunkLen, alignedCurrentSliceSize - chunk*chunkLen);
+			char* dst = static_cast<char*>(newSegments[seg].mem) + (chunk - firstChunk) * chunkLen * numOutputs;
+			memmove(dst, chunkMem[chunk], procSize * oldOutputs);
+			memset(dst + procSize * oldOutputs, 0, procSize * (numOutputs - oldOutputs));
+		}
+		if(newSegments[seg].mem != memSegments[seg].mem) {
+			free_segment(memSegments[seg]);
+			memSegments[seg] = newSegments[seg];
+		}
+	}
+	
+	for(size_t chunk = 0; chunk < numChunks; chunk++)
+		chunkMem[chunk] = static_cast<char*>(memSegments[chunk / segmentChunks].mem) + (chunk % segmentChunks) * chunkLen * numOutputs;
+	memIsZero = false;
+	tiles.clear(); // NUMA placement needs to be redone
+	return true;
+}
+
+// zero recovery memory by dropping its pages; the OS supplies zero pages on next access
+bool PAR2ProcCPU::discardProcessingMem() {
+	if(memIsZero) return true;
+#ifdef PROC_MMAP_SUPPORT
+	for(const auto& seg : memSegments) {
+		if(!seg.mapped) return false;
+		if(madvise(seg.mem, seg.size, MADV_DONTNEED) != 0) return false; // e.g. explicit huge pages on older kernels
 	}
+	memIsZero = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void PAR2ProcCPU::freeProcessingMem() {
+	for(auto& seg : memSegments)
+		free_segment(seg);
+	memSegments.clear();
+	chunkMem.clear();
+}
+
+bool PAR2ProcCPU::setPageMode(PAR2ProcCPUPageMode mode) {
+	if(mode == pageMode) return true;
+	pageMode = mode;
+	if(memSegments.empty()) return true;
+	freeProcessingMem();
+	return reallocProcessingMem();
+}
+bool PAR2ProcCPU::setSegmentSize(size_t size) {
+	if(size == segmentSize) return true;
+	segmentSize = size;
+	if(memSegments.empty()) return true;
+	freeProcessingMem();
+	return reallocProcessingMem();
+}
+bool PAR2ProcCPU::setZeroedMemory(bool enable) {
+	if(enable == zeroedMem) return true;
+	zeroedMem = enable;
+	if(memSegments.empty()) return true;
+	freeProcessingMem();
+	return reallocProcessingMem();
 }
 void PAR2ProcCPU::_deinit() {
 	for(auto& worker : thWorkers)
@@ -206,10 +584,12 @@ void PAR2ProcCPU::_deinit() {
 
 PAR2ProcCPU::~PAR2ProcCPU() {
 	deinit();
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	freeOutputHashers();
+#endif
 }
 
 /** prepare **/
-// TODO: future idea: multiple prepare threads? Not sure if there's a case where it's particularly beneficial...
 struct transfer_data {
 	bool finish; // false = prepare, true = finish
 	
@@ -226,32 +606,177 @@ struct transfer_data {
 	size_t dstLen;
 	unsigned submitInBufs;
 	unsigned inBufId;
+	bool inPlace; // only compute the checksum; the source is read during processing
+	IHasherInput* hasher; // if set, feed the source through this, then write the block hash to md5crc
+	void* md5crc;
+	uint64_t zeroPad;
 	NOTIFY_DECL(cbPrep, promPrep);
 	
 	// finish specific
+	void* const* chunkMem; // if src is NULL, recovery data is split across segments, with each chunk's region here
+	size_t procLen;
 	NOTIFY_BOOL_DECL(cbOut, promOut);
 	int cksumSuccess;
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	MD5Multi* outHasher; // if set, finish numOutputs outputs, starting at index, into outputs, and add them to this
+	void* const* outputs;
+	unsigned numOutputs;
+#endif
 };
 
+// a request is created for every input and output, so they're recycled rather than allocated each time
+static ThreadObjectPool<struct transfer_data> transferPool;
+static struct transfer_data* new_transfer(bool finish) {
+	struct transfer_data* data = transferPool.get();
+	data->finish = finish;
+#ifndef USE_LIBUV
+	// a recycled request's promise will have already been fulfilled
+	if(finish)
+		data->promOut = std::promise<bool>();
+	else
+		data->promPrep = std::promise<void>();
+#endif
+	return data;
+}
+
+// finish part of an output; if recovery data is split across segments, the part must not cross a chunk boundary
+static int finish_output_part(const struct transfer_data* data, void* dst, unsigned index, size_t pos, size_t len) {
+	if(data->src)
+		return data->gf->finish_partial_packsum(dst, const_cast<void*>(data->src), data->size, data->numBufs, index, data->chunkLen, pos, len, NULL);
+	
+	// address the chunk as if all chunks were contiguous, so that only this chunk's region is read
+	size_t chunk = pos / data->chunkLen;
+	size_t chunkStride = data->chunkLen * data->numBufs;
+	char* src = static_cast<char*>(data->chunkMem[chunk]) - chunk*chunkStride;
+	// the checksum sits at the end of the output's piece of the last chunk
+	size_t lastChunk = CEIL_DIV(data->procLen, data->chunkLen) - 1;
+	size_t lastProcSize = data->procLen - lastChunk*data->chunkLen;
+	size_t stride = data->gf->info().stride;
+	void* checksum = static_cast<char*>(data->chunkMem[lastChunk]) + (index+1)*lastProcSize - stride;
+	return data->gf->finish_partial_packsum(dst, src, data->size, data->numBufs, index, data->chunkLen, pos, len, checksum);
+}
+
+// finish a single output; if recovery data is split across segments, each chunk's piece is finished directly from its segment
+static int finish_output(const struct transfer_data* data, void* dst, unsigned index) {
+	if(data->src)
+		return data->gf->finish_packed_cksum(dst, data->src, data->size, data->numBufs, index, data->chunkLen);
+	
+	// partial finishing accumulates the checksum in recovery memory, which is fine as each output is only fetched once per pass
+	int success = 1;
+	for(size_t pos = 0; pos < data->size; pos += data->chunkLen) {
+		size_t len = MIN(data->chunkLen, data->size - pos);
+		int result = finish_output_part(data, static_cast<char*>(dst) + pos, index, pos, len);
+		if(pos + len == data->size) // checksum result is only available on the last part
+			success = result;
+	}
+	return success;
+}
+
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+// finish a group of outputs, and feed them into the group's MD5s
+static int finish_output_group(const struct transfer_data* data) {
+	int success = 1;
+	if(!data->src && !data->chunkMem) {
+		// nothing was computed, so the outputs are all zero
+		for(unsigned out = 0; out < data->numOutputs; out++)
+			memset(data->outputs[out], 0, data->size);
+		data->outHasher->update(data->outputs, data->size);
+		return success;
+	}
+	
+	// finish a stripe across all outputs, then hash it whilst it's still in cache
+	// partial finishing accumulates the checksum in recovery memory, which is fine as each output is only fetched once per pass
+	std::vector<const void*> stripe(data->numOutputs);
+	size_t pieceLen = HASH_PIECE_SIZE - HASH_PIECE_SIZE % data->gf->info().stride;
+	for(size_t pos = 0, len; pos < data->size; pos += len) {
+		len = MIN(pieceLen, data->size - pos);
+		if(!data->src) // stripes can't cross a chunk boundary, as the chunks may be in different segments
+			len = MIN(len, data->chunkLen - pos % data->chunkLen);
+		for(unsigned out = 0; out < data->numOutputs; out++) {
+			void* dst = static_cast<char*>(data->outputs[out]) + pos;
+			int result = finish_output_part(data, dst, data->index + out, pos, len);
+			if(pos + len == data->size) // checksum result is only available on the last part
+				success &= result;
+			stripe[out] = dst;
+		}
+		data->outHasher->update(stripe.data(), len);
+	}
+	return success;
+}
+#endif
+
 // prepare thread process function
 void PAR2ProcCPU::transfer_slice(ThreadMessageQueue<void*>& q) {
 	struct transfer_data* data;
 	while((data = static_cast<struct transfer_data*>(q.pop())) != NULL) {
 		if(data->finish) {
-			data->cksumSuccess = data->gf->finish_packed_cksum(data->dst, data->src, data->size, data->numBufs, data->index, data->chunkLen);
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+			if(data->outHasher)
+				data->cksumSuccess = finish_output_group(data);
+			else
+#endif
+			data->cksumSuccess = finish_output(data, data->dst, data->index);
 			NOTIFY_DONE(data, _queueRecv, data->promOut, data->cksumSuccess);
+		} else if(data->inPlace) {
+			if(data->hasher) {
+				data->hasher->update(data->src, data->size);
+				data->hasher->getBlock(data->md5crc, data->zeroPad);
+			}
+			data->gf->prepare_natural_cksum(data->dst, data->src, data->size, data->dstLen);
+			// the source is still needed, so hold the request until the batch is processed (see release_inplace)
+			// once released, the batch may start, after which this request can be signalled and deleted at any time
+			data->parent->staging[data->inBufId].inPlace[data->index].prepReq = data;
+			data->parent->release_prepare(data->inBufId, data->submitInBufs ? 2 : 1);
+			continue;
 		} else {
-			if(data->src)
+			if(data->hasher) {
+				// hash a piece, then prepare it whilst it's still in cache
+				size_t pieceLen = HASH_PIECE_SIZE - HASH_PIECE_SIZE % data->gf->info().stride;
+				for(size_t pos = 0; pos < data->size; pos += pieceLen) {
+					size_t len = MIN(pieceLen, data->size - pos);
+					data->hasher->update(static_cast<const char*>(data->src) + pos, len);
+					data->gf->prepare_partial_packsum(data->dst, static_cast<const char*>(data->src) + pos, data->size, data->dstLen, data->numBufs, data->index, data->chunkLen, pos, len);
+				}
+				data->hasher->getBlock(data->md5crc, data->zeroPad);
+			} else if(data->src)
 				data->gf->prepare_packed_cksum(data->dst, data->src, data->size, data->dstLen, data->numBufs, data->index, data->chunkLen);
-			if(data->submitInBufs) {
-				// queue async compute
-				data->parent->run_kernel(data->inBufId, data->submitInBufs);
-			}
+			// if this submits the batch, also release the submission hold, so that compute is queued once all prepares for the batch are done
+			data->parent->release_prepare(data->inBufId, data->submitInBufs ? 2 : 1);
 			
 			// signal main thread that prepare has completed
 			NOTIFY_DONE(data, _queueSent, data->promPrep);
 		}
-		IF_NOT_LIBUV(delete data);
+		IF_NOT_LIBUV(transferPool.put(data));
+	}
+}
+
+void PAR2ProcCPU::send_transfer(void* data) {
+	transferThreads[nextTransferThread]->send(data);
+	if(++nextTransferThread == transferThreads.size())
+		nextTransferThread = 0;
+}
+// send to a thread determined by `affinity`, so that transfers sharing it are processed in order
+void PAR2ProcCPU::send_transfer(void* data, const void* affinity) {
+	transferThreads[(reinterpret_cast<uintptr_t>(affinity) / 64) % transferThreads.size()]->send(data);
+}
+
+void PAR2ProcCPU::release_prepare(unsigned inBuf, unsigned count) {
+	auto& area = staging[inBuf];
+	if(area.prepPending.fetch_sub(count, std::memory_order_acq_rel) == count) {
+		// all prepares done - reset the hold for the next time this area is used, and queue async compute
+		area.prepPending.store(1, std::memory_order_relaxed);
+		run_kernel(inBuf, area.submitInputs);
+	}
+}
+
+void PAR2ProcCPU::release_inplace(PAR2ProcCPUStaging& area, unsigned numInputs) {
+	for(unsigned i=0; i<numInputs; i++) {
+		auto data = static_cast<struct transfer_data*>(area.inPlace[i].prepReq);
+		if(!data) continue; // dummy or pre-filled input
+		area.inPlace[i].prepReq = nullptr;
+		// signal main thread that the caller's buffer is no longer needed
+		NOTIFY_DONE(data, _queueSent, data->promPrep);
+		IF_NOT_LIBUV(transferPool.put(data));
 	}
 }
 
@@ -260,7 +785,8 @@ void PAR2ProcCPU::_notifySent(void* _req) {
 	auto data = static_cast<struct transfer_data*>(_req);
 	pendingInCallbacks--;
 	if(data->cbPrep && data->src) data->cbPrep();
-	delete data;
+	data->cbPrep = nullptr;
+	transferPool.put(data);
 	
 	// handle possibility of _notifySent being called after the last _notifyProc
 	if(endSignalled && isEmpty() && progressCb) progressCb(0);
@@ -269,34 +795,51 @@ void PAR2ProcCPU::_notifySent(void* _req) {
 
 PAR2ProcBackendAddResult PAR2ProcCPU::canAdd() const {
 	// NOTE: if add fails due to being full, client resubmitting may be vulnerable to race conditions if it adds an event listener after completion event gets fired
-	if(staging[currentStagingArea].getIsActive()) return PROC_ADD_FULL;
-	return staging[(currentStagingArea == 0 ? staging.size() : currentStagingArea)-1].getIsActive()
+	if(staging[currentStagingArea].getIsActive()) {
+		// we're only full if all areas are busy, and the memory limit doesn't allow any more
+		if(stagingAreasUsed < maxStagingAreas()) return PROC_ADD_OK_BUSY;
+		for(unsigned i=0; i<stagingAreasUsed; i++)
+			if(!staging[i].getIsActive()) return PROC_ADD_OK_BUSY;
+		return PROC_ADD_FULL;
+	}
+	return staging[(currentStagingArea == 0 ? stagingAreasUsed : currentStagingArea)-1].getIsActive()
 		? PROC_ADD_OK_BUSY
 		: PROC_ADD_OK;
 }
 #ifndef USE_LIBUV
 void PAR2ProcCPU::waitForAdd() {
+	if(canAdd() != PROC_ADD_FULL) return;
 	IPAR2ProcBackend::_waitForAdd(staging[currentStagingArea]);
 }
 #endif
 
 FUTURE_RETURN_T PAR2ProcCPU::addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush  IF_LIBUV(, const PAR2ProcPlainCb& cb)) {
-	IF_NOT_LIBUV(return) _addInput(buffer, size, inputNum, flush IF_LIBUV(, cb));
+	IF_NOT_LIBUV(return) _addInput(buffer, size, inputNum, flush, nullptr, nullptr, 0 IF_LIBUV(, cb));
 }
 FUTURE_RETURN_T PAR2ProcCPU::addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush  IF_LIBUV(, const PAR2ProcPlainCb& cb)) {
-	IF_NOT_LIBUV(return) _addInput(buffer, size, coeffs, flush IF_LIBUV(, cb));
+	IF_NOT_LIBUV(return) _addInput(buffer, size, coeffs, flush, nullptr, nullptr, 0 IF_LIBUV(, cb));
+}
+FUTURE_RETURN_T PAR2ProcCPU::addInputHashed(const void* buffer, size_t size, uint16_t inputNum, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad  IF_LIBUV(, const PAR2ProcPlainCb& cb)) {
+	IF_NOT_LIBUV(return) _addInput(buffer, size, inputNum, flush, hasher, md5crc, zeroPad IF_LIBUV(, cb));
+}
+FUTURE_RETURN_T PAR2ProcCPU::addInputHashed(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad  IF_LIBUV(, const PAR2ProcPlainCb& cb)) {
+	IF_NOT_LIBUV(return) _addInput(buffer, size, coeffs, flush, hasher, md5crc, zeroPad IF_LIBUV(, cb));
 }
 
 template<typename T>
-FUTURE_RETURN_T PAR2ProcCPU::_addInput(const void* buffer, size_t size, T inputNumOrCoeffs, bool flush  IF_LIBUV(, const PAR2ProcPlainCb& cb)) {
+FUTURE_RETURN_T PAR2ProcCPU::_addInput(const void* buffer, size_t size, T inputNumOrCoeffs, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad  IF_LIBUV(, const PAR2ProcPlainCb& cb)) {
 	IF_LIBUV(assert(!endSignalled));
+	if(!staging[0].src) reallocMemInput();
+	if(!acquire_staging()) {
+		// caller added whilst full
+		IF_NOT_LIBUV(IPAR2ProcBackend::_waitForAdd(staging[currentStagingArea]));
+		IF_LIBUV(assert(0));
+	}
 	auto& area = staging[currentStagingArea];
 	assert(!area.getIsActive());
-	if(!staging[0].src) reallocMemInput();
 	
 	set_coeffs(area, currentStagingInputs, inputNumOrCoeffs);
-	struct transfer_data* data = new struct transfer_data;
-	data->finish = false;
+	struct transfer_data* data = new_transfer(false);
 	data->src = buffer;
 	data->size = size;
 	data->parent = this;
@@ -306,51 +849,71 @@ FUTURE_RETURN_T PAR2ProcCPU::_addInput(const void* buffer, size_t size, T inputN
 	data->index = currentStagingInputs++;
 	data->chunkLen = chunkLen;
 	data->gf = gf;
+	data->inPlace = inPlaceInput;
+	data->hasher = hasher;
+	data->md5crc = md5crc;
+	data->zeroPad = zeroPad;
+	if(inPlaceInput) {
+		// each input gets its own slot, with an unpacked layout, holding the end of the input + checksum
+		data->dst = static_cast<char*>(area.src) + data->index*alignedCurrentSliceSize;
+		area.inPlace[data->index] = {buffer, size - size%stride, nullptr};
+	}
 	IF_LIBUV(data->cbPrep = cb);
 	
 	data->submitInBufs = (flush || currentStagingInputs == inputBatchSize || (
 		// allow submitting early if there's no active processing
-		stagingActiveCount_get() == 0 && staging.size() > 1 && currentStagingInputs >= minInBatchSize
+		stagingActiveCount_get() == 0 && maxStagingAreas() > 1 && currentStagingInputs >= minInBatchSize
 	)) ? currentStagingInputs : 0;
 	data->inBufId = currentStagingArea;
 	
 	if(data->submitInBufs) {
 		stagingActiveCount_inc();
 		area.setIsActive(true); // lock this buffer until processing is complete
+		area.submitInputs = currentStagingInputs;
 		statBatchesStarted++;
 		currentStagingInputs = 0;
-		if(++currentStagingArea == staging.size())
-			currentStagingArea = 0;
+		next_staging();
 	}
 	
+	area.prepPending.fetch_add(1, std::memory_order_relaxed);
 	IF_LIBUV(pendingInCallbacks++);
 	IF_NOT_LIBUV(auto future = data->promPrep.get_future());
-	transferThread.send(data);
+	// a hasher must receive its inputs in order, so always send these to the same thread
+	if(hasher)
+		send_transfer(data, hasher);
+	else
+		send_transfer(data);
 	
 	IF_NOT_LIBUV(return future);
 }
 
 void PAR2ProcCPU::dummyInput(uint16_t inputNum, bool flush) {
 	IF_LIBUV(assert(!endSignalled));
+	if(!staging[0].src) reallocMemInput();
+	if(!acquire_staging()) {
+		IF_NOT_LIBUV(IPAR2ProcBackend::_waitForAdd(staging[currentStagingArea]));
+		IF_LIBUV(assert(0));
+	}
 	auto& area = staging[currentStagingArea];
 	assert(!area.getIsActive());
-	if(!staging[0].src) reallocMemInput();
 	
 	set_coeffs(area, currentStagingInputs, inputNum);
+	if(inPlaceInput) area.inPlace[currentStagingInputs] = {nullptr, 0, nullptr};
 	currentStagingInputs++;
 	
 	if(flush || currentStagingInputs == inputBatchSize || (
-		stagingActiveCount_get() == 0 && staging.size() > 1 && currentStagingInputs >= minInBatchSize
+		stagingActiveCount_get() == 0 && maxStagingAreas() > 1 && currentStagingInputs >= minInBatchSize
 	)) {
 		stagingActiveCount_inc();
 		area.setIsActive(true); // lock this buffer until processing is complete
+		area.submitInputs = currentStagingInputs;
 		statBatchesStarted++;
 		
-		run_kernel(currentStagingArea, currentStagingInputs);
+		// process once any prepares queued for this area are done
+		release_prepare(currentStagingArea, 1);
 		
 		currentStagingInputs = 0;
-		if(++currentStagingArea == staging.size())
-			currentStagingArea = 0;
+		next_staging();
 	}
 }
 
@@ -358,10 +921,16 @@ bool PAR2ProcCPU::fillInput(const void* buffer) {
 	IF_LIBUV(assert(!endSignalled));
 	if(!staging[0].src) reallocMemInput();
 	
-	gf->prepare_packed_cksum(staging[currentStagingArea].src, buffer, currentSliceSize, alignedCurrentSliceSize - stride, inputBatchSize, currentStagingInputs, chunkLen);
+	if(inPlaceInput) {
+		// there's no caller buffer to read from, so copy the whole input into its slot
+		char* slot = static_cast<char*>(staging[currentStagingArea].src) + currentStagingInputs*alignedCurrentSliceSize;
+		gf->prepare_natural_cksum(slot, buffer, currentSliceSize, alignedCurrentSliceSize - stride);
+		memcpy(slot, buffer, currentSliceSize - currentSliceSize%stride);
+	} else
+		gf->prepare_packed_cksum(staging[currentStagingArea].src, buffer, currentSliceSize, alignedCurrentSliceSize - stride, inputBatchSize, currentStagingInputs, chunkLen);
 	if(++currentStagingInputs == inputBatchSize) {
 		currentStagingInputs = 0;
-		if(++currentStagingArea == staging.size()) {
+		if(++currentStagingArea == stagingAreasUsed) {
 			currentStagingArea = 0;
 			return true; // all filled
 		}
@@ -384,27 +953,47 @@ void PAR2ProcCPU::set_coeffs(PAR2ProcCPUStaging& area, unsigned idx, const uint1
 	}
 }
 
+void PAR2ProcCPU::classify_coeffs(PAR2ProcCPUStaging& area, unsigned numInputs) {
+	const unsigned numOutputs = outputExponents.size();
+	area.coeffClass.resize(numOutputs);
+	for(unsigned out=0; out<numOutputs; out++) {
+		const uint16_t* coeffs = area.procCoeffs.data() + out*inputBatchSize;
+		uint16_t first = coeffs[0];
+		auto cls = PAR2PROC_CPU_COEFF_GENERAL;
+		if(first <= 1) {
+			unsigned in = 1;
+			while(in < numInputs && coeffs[in] == first) in++;
+			if(in == numInputs)
+				cls = first ? PAR2PROC_CPU_COEFF_ONES : PAR2PROC_CPU_COEFF_ZERO;
+		}
+		area.coeffClass[out] = cls;
+	}
+}
+
 void PAR2ProcCPU::flush() {
 	if(!currentStagingInputs) return; // no inputs to flush
 	
 	// send a flush signal by queueing up a prepare, but with a NULL buffer
-	struct transfer_data* data = new struct transfer_data;
-	data->finish = false;
+	struct transfer_data* data = new_transfer(false);
 	data->src = NULL;
 	data->parent = this;
 	data->submitInBufs = currentStagingInputs;
 	data->inBufId = currentStagingArea;
 	data->gf = gf;
+	data->inPlace = false;
+	data->hasher = nullptr;
 	
+	auto& area = staging[currentStagingArea];
 	stagingActiveCount_inc();
-	staging[currentStagingArea].setIsActive(true); // lock this buffer until processing is complete
+	area.setIsActive(true); // lock this buffer until processing is complete
+	area.submitInputs = currentStagingInputs;
+	area.prepPending.fetch_add(1, std::memory_order_relaxed);
 	statBatchesStarted++;
 	currentStagingInputs = 0;
-	if(++currentStagingArea == staging.size())
-		currentStagingArea = 0;
+	next_staging();
 	
 	IF_LIBUV(pendingInCallbacks++);
-	transferThread.send(data);
+	send_transfer(data);
 }
 
 /** finish **/
@@ -414,107 +1003,358 @@ void PAR2ProcCPU::_notifyRecv(void* _req) {
 	pendingOutCallbacks--;
 	// signal output ready
 	data->cbOut(data->cksumSuccess);
-	delete data;
+	data->cbOut = nullptr;
+	transferPool.put(data);
 	
 	if(pendingOutCallbacks < 1 && deinitCallback) deinit(deinitCallback);
 }
 #endif
 
 FUTURE_RETURN_BOOL_T PAR2ProcCPU::getOutput(unsigned index, void* output  IF_LIBUV(, const PAR2ProcOutputCb& cb)) {
-	struct transfer_data* data = new struct transfer_data;
-	data->finish = true;
+	struct transfer_data* data = new_transfer(true);
 	data->parent = this;
-	data->src = memProcessing;
+	// if recovery data is in a single segment, it has the usual packed layout and can be finished directly; surplus segments kept from earlier passes aren't in use
+	data->src = numChunks <= segmentChunks ? memSegments[0].mem : NULL;
+	data->chunkMem = chunkMem.data();
+	data->procLen = alignedCurrentSliceSize;
 	data->size = currentSliceSize;
 	data->gf = gf;
 	data->dst = output;
 	data->numBufs = outputExponents.size();
 	data->index = index;
 	data->chunkLen = chunkLen;
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	data->outHasher = NULL;
+#endif
 #ifdef USE_LIBUV
 	data->cbOut = cb;
 	pendingOutCallbacks++;
 #else
 	auto future = data->promOut.get_future();
 #endif
-	transferThread.send(data);
+	send_transfer(data);
 	
 	IF_NOT_LIBUV(return future);
 }
 
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+void PAR2ProcCPU::setOutputHashing(unsigned groupSize, const void* setId) {
+	freeOutputHashers();
+	outputHashGroup = setId ? groupSize : 0;
+	if(!outputHashGroup) return;
+	memcpy(outputHashSetId, setId, sizeof(outputHashSetId));
+	createOutputHashers();
+}
+
+void PAR2ProcCPU::createOutputHashers() {
+	unsigned numOutputs = outputExponents.size();
+	for(unsigned first = 0; first < numOutputs; first += outputHashGroup) {
+		outputHashers.push_back(new MD5Multi(MIN(outputHashGroup, numOutputs - first)));
+		resetOutputHasher(outputHashers.size()-1);
+	}
+}
+
+void PAR2ProcCPU::freeOutputHashers() {
+	for(auto hasher : outputHashers)
+		delete hasher;
+	outputHashers.clear();
+}
+
+void PAR2ProcCPU::resetOutputHasher(unsigned group) {
+	// the packet MD5 covers everything from the set ID onwards; this is the same for all recovery packets, except for the exponent
+	const unsigned HEADER_LEN = 36;
+	unsigned first = group * outputHashGroup;
+	unsigned count = MIN(outputHashGroup, (unsigned)outputExponents.size() - first);
+	std::vector<uint8_t> headers(count * HEADER_LEN);
+	std::vector<const void*> headerPtrs(count);
+	for(unsigned i=0; i<count; i++) {
+		uint8_t* header = headers.data() + i*HEADER_LEN;
+		memcpy(header, outputHashSetId, 16);
+		memcpy(header + 16, "PAR 2.0\0RecvSlic", 16);
+		uint16_t exponent = outputExponents[first+i];
+		header[32] = exponent & 0xff;
+		header[33] = exponent >> 8;
+		header[34] = header[35] = 0;
+		headerPtrs[i] = header;
+	}
+	outputHashers[group]->reset();
+	outputHashers[group]->update(headerPtrs.data(), HEADER_LEN);
+}
+
+FUTURE_RETURN_BOOL_T PAR2ProcCPU::getOutputGroup(unsigned group, void* const* outputs  IF_LIBUV(, const PAR2ProcOutputCb& cb)) {
+	struct transfer_data* data = new_transfer(true);
+	data->parent = this;
+	if(processingAdd) {
+		data->src = numChunks <= segmentChunks ? memSegments[0].mem : NULL;
+		data->chunkMem = chunkMem.data();
+	} else { // no input was added, which finish_output_group handles by hashing zeroes
+		data->src = NULL;
+		data->chunkMem = NULL;
+	}
+	data->procLen = alignedCurrentSliceSize;
+	data->size = currentSliceSize;
+	data->gf = gf;
+	data->dst = NULL;
+	data->numBufs = outputExponents.size();
+	data->index = group * outputHashGroup;
+	data->chunkLen = chunkLen;
+	data->outHasher = outputHashers[group];
+	data->outputs = outputs;
+	data->numOutputs = MIN(outputHashGroup, data->numBufs - data->index);
+#ifdef USE_LIBUV
+	data->cbOut = cb;
+	pendingOutCallbacks++;
+#else
+	auto future = data->promOut.get_future();
+#endif
+	// keep a group on the same thread, so that passes are hashed in order
+	send_transfer(data, data->outHasher);
+	
+	IF_NOT_LIBUV(return future);
+}
+
+void PAR2ProcCPU::getOutputGroupMD5(unsigned group, void* md5s) {
+	outputHashers[group]->end();
+	outputHashers[group]->get(md5s);
+	resetOutputHasher(group);
+}
+#endif
+
 
 /** main processing **/
 typedef struct __compute_req : PAR2ProcBackendBaseComputeReq<PAR2ProcCPU> {
 	unsigned inputGrouping;
 	uint16_t numOutputs;
-	const uint16_t *outNonZero;
+	const PAR2ProcCPUCoeffClass* coeffClass;
 	const uint16_t* coeffs;
-	size_t len, chunkSize, numChunks;
+	size_t len, chunkSize;
 	const void* input;
-	void* output;
+	void* const* chunkMem;
 	bool add;
+	bool inPlace; // inputs are read from area->inPlace, rather than the packed staging area
 	
+	unsigned worker, numDispatched;
+	bool steal;
+	bool lookahead; // prefetch from the next queued request
+	unsigned stealFirst, stealWorkers; // range of workers which can be stolen from
+	uint32_t batchSeq;
+	const PAR2ProcCPUTile* tiles;
+	std::atomic<uint32_t>* tileBatch;
 	void* mutScratch;
+	std::atomic<uint64_t> *statBytes, *statTime; // NUMA node stats, if tracked
 	
 	const Galois16Mul* gf;
-	std::atomic<int>* procRefs;
+	PAR2ProcCPUStaging* area;
 } compute_req;
+static ThreadObjectPool<compute_req> computeReqPool; // one request is sent to each worker, for every batch
+
+static inline uint64_t tile_range_pack(uint32_t start, uint32_t end) {
+	return (uint64_t)start | ((uint64_t)end << 32);
+}
+// take a tile from the front of a worker's range; used by the owning worker
+static bool tile_take_front(std::atomic<uint64_t>& range, unsigned& tile) {
+	uint64_t cur = range.load(std::memory_order_relaxed);
+	while(1) {
+		uint32_t start = (uint32_t)cur, end = (uint32_t)(cur >> 32);
+		if(start >= end) return false;
+		if(range.compare_exchange_weak(cur, tile_range_pack(start+1, end), std::memory_order_relaxed)) {
+			tile = start;
+			return true;
+		}
+	}
+}
+// take a tile from the back of a worker's range; used by other workers, so that the owner retains locality of the front
+// tiles which the previous batch hasn't yet finished with are left for the owner
+static bool tile_take_back(std::atomic<uint64_t>& range, unsigned& tile, const std::atomic<uint32_t>* tileBatch, uint32_t prevBatch) {
+	uint64_t cur = range.load(std::memory_order_relaxed);
+	while(1) {
+		uint32_t start = (uint32_t)cur, end = (uint32_t)(cur >> 32);
+		if(start >= end) return false;
+		if(tileBatch[end-1].load(std::memory_order_acquire) != prevBatch) return false;
+		if(range.compare_exchange_weak(cur, tile_range_pack(start, end-1), std::memory_order_relaxed)) {
+			tile = end-1;
+			return true;
+		}
+	}
+}
+
+static inline bool tile_range_empty(const std::atomic<uint64_t>& range) {
+	uint64_t cur = range.load(std::memory_order_relaxed);
+	return (uint32_t)cur >= (uint32_t)(cur >> 32);
+}
+
+static inline uint64_t worker_timestamp() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// returns the number of multiply-add bytes processed
+// if nextInput/nextOutput are set, they're prefetched during the final round, in place of the next round's input/output
+static uint64_t compute_tile(const compute_req* req, const PAR2ProcCPUTile& tile, const char* nextInput, const char* nextOutput) {
+	const Galois16MethodInfo& gfInfo = req->gf->info();
+	const unsigned numOutputs = tile.numOutputs;
+	// compute how many inputs regions get prefetched in a muladd_multi call
+	// TODO: should this be done across all threads?
+	unsigned inputsPrefetchedPerInvok = (req->numInputs / gfInfo.idealInputMultiple);
+	unsigned inputPrefetchOutOffset = numOutputs-1;
+	const unsigned MAX_PF_FACTOR = 3;
+	{
+		const unsigned pfFactor = gfInfo.prefetchDownscale;
+		if(inputsPrefetchedPerInvok > (1U<<pfFactor)) { // will inputs ever be prefetched? if all prefetch rounds are spent on outputs, inputs will never prefetch
+			inputsPrefetchedPerInvok -= (1U<<pfFactor); // exclude output fetching rounds
+			inputsPrefetchedPerInvok <<= MAX_PF_FACTOR - pfFactor; // scale appropriately
+			// compute number of input prefetch passes needed
+			inputPrefetchOutOffset = CEIL_DIV(req->numInputs << MAX_PF_FACTOR, inputsPrefetchedPerInvok);
+			assert(inputPrefetchOutOffset > 0); // at least one pass needed
+			if(numOutputs >= inputPrefetchOutOffset)
+				inputPrefetchOutOffset = numOutputs - inputPrefetchOutOffset;
+			else
+				inputPrefetchOutOffset = 0;
+		}
+	}
+	
+	const PAR2ProcCPUCoeffClass* coeffClass = req->coeffClass + tile.output;
+	const uint16_t* coeffs = req->coeffs + tile.output*req->inputGrouping;
+	uint64_t procBytes = 0;
+	for(size_t round = 0; round < tile.numChunks; round++) {
+		size_t sliceOffset = (tile.chunk+round)*req->chunkSize;
+		size_t procSize = MIN(req->len-sliceOffset, req->chunkSize);
+		procBytes += procSize;
+		const char* srcPtr = static_cast<const char*>(req->input) + sliceOffset*req->inputGrouping;
+		char* dstBase = static_cast<char*>(req->chunkMem[tile.chunk+round]) + tile.output*procSize;
+		for(unsigned out = 0; out < numOutputs; out++) {
+			const uint16_t* vals = coeffs + out*req->inputGrouping;
+			
+			char* dstPtr = dstBase + out*procSize;
+			if(!req->add) memset(dstPtr, 0, procSize);
+			if(coeffClass[out] == PAR2PROC_CPU_COEFF_ZERO) continue;
+			const char* pfInput = NULL;
+			const char* pfOutput = dstPtr+procSize;
+			if(round == tile.numChunks-1) {
+				if(nextInput && out >= inputPrefetchOutOffset)
+					pfInput = nextInput + ((inputsPrefetchedPerInvok*(out-inputPrefetchOutOffset)*procSize)>>MAX_PF_FACTOR);
+				if(out+1 == numOutputs) {
+					if(nextOutput)
+						pfOutput = nextOutput;
+					else if(coeffClass[out] == PAR2PROC_CPU_COEFF_GENERAL) {
+						req->gf->mul_add_multi_packed(req->inputGrouping, req->numInputs, dstPtr, srcPtr, procSize, vals, req->mutScratch);
+						continue;
+					} else // there's no non-prefetching add variant, so point the prefetch at the (already cached) destination
+						pfOutput = dstPtr;
+				}
+			} else {
+				pfInput = out >= inputPrefetchOutOffset ? srcPtr + req->chunkSize*req->inputGrouping + ((inputsPrefetchedPerInvok*(out-inputPrefetchOutOffset)*procSize)>>MAX_PF_FACTOR) : NULL;
+				// procSize input prefetch may be wrong for final round, but it's the closest we've got; TODO: perhaps consider skipping out of prefetching, if the final round has a different region size
+			}
+			
+			if(coeffClass[out] == PAR2PROC_CPU_COEFF_ONES)
+				req->gf->add_multi_packpf(req->inputGrouping, req->numInputs, dstPtr, srcPtr, procSize, pfInput, pfOutput);
+			else
+				req->gf->mul_add_multi_packpf(req->inputGrouping, req->numInputs, dstPtr, srcPtr, procSize, vals, req->mutScratch, pfInput, pfOutput);
+		}
+	}
+	return procBytes * req->numInputs * numOutputs;
+}
+
+// in-place variant of the above: each input is read from the caller's buffer, up to where the buffer ends, then from the input's slot in the staging area
+static uint64_t compute_tile_inplace(const compute_req* req, const PAR2ProcCPUTile& tile, std::vector<const void*>& srcList) {
+	const auto& inPlace = req->area->inPlace;
+	const auto& splits = req->area->inPlaceSplits;
+	const unsigned numOutputs = tile.numOutputs;
+	const uint16_t* coeffs = req->coeffs + tile.output*req->inputGrouping;
+	srcList.resize(req->numInputs);
+	uint64_t procBytes = 0;
+	for(size_t round = 0; round < tile.numChunks; round++) {
+		size_t sliceOffset = (tile.chunk+round)*req->chunkSize;
+		size_t procSize = MIN(req->len-sliceOffset, req->chunkSize);
+		size_t chunkEnd = sliceOffset + procSize;
+		procBytes += procSize;
+		char* dstBase = static_cast<char*>(req->chunkMem[tile.chunk+round]) + tile.output*procSize;
+		if(!req->add) memset(dstBase, 0, procSize*numOutputs);
+		
+		// split the chunk into parts where no input switches source
+		size_t pos = sliceOffset;
+		auto split = std::upper_bound(splits.begin(), splits.end(), pos);
+		while(pos < chunkEnd) {
+			size_t partEnd = chunkEnd;
+			if(split != splits.end() && *split < chunkEnd)
+				partEnd = *split++;
+			for(unsigned in = 0; in < req->numInputs; in++) {
+				const char* base = pos < inPlace[in].len
+					? static_cast<const char*>(inPlace[in].src)
+					: static_cast<const char*>(req->input) + in*req->len;
+				srcList[in] = base + sliceOffset;
+			}
+			for(unsigned out = 0; out < numOutputs; out++)
+				if(req->coeffClass[tile.output+out] != PAR2PROC_CPU_COEFF_ZERO)
+					req->gf->mul_add_multi_natural(req->numInputs, pos-sliceOffset, dstBase + out*procSize, srcList.data(), partEnd-pos, coeffs + out*req->inputGrouping, req->mutScratch);
+			pos = partEnd;
+		}
+	}
+	return procBytes * req->numInputs * numOutputs;
+}
+
+// if the worker's request for the next batch has already been queued, find where its first tile starts, so that it can be prefetched at the end of the current batch
+static bool lookahead_next(const ThreadMessageQueue<void*>& q, const char*& nextInput, const char*& nextOutput) {
+	void* item;
+	if(!q.trypeek(&item) || !item) return false; // NULL signals the worker to exit
+	// the request isn't modified after being queued, and can't be recycled until we've processed it
+	const compute_req* next = static_cast<const compute_req*>(item);
+	if(next->inPlace) return false; // inputs aren't packed, so aren't worth predicting
+	const auto& range = next->area->tileRanges[next->worker];
+	if(tile_range_empty(range)) return false;
+	const PAR2ProcCPUTile& tile = next->tiles[(uint32_t)range.load(std::memory_order_relaxed)];
+	size_t sliceOffset = tile.chunk*next->chunkSize;
+	size_t procSize = MIN(next->len-sliceOffset, next->chunkSize);
+	nextInput = static_cast<const char*>(next->input) + sliceOffset*next->inputGrouping;
+	nextOutput = static_cast<const char*>(next->chunkMem[tile.chunk]) + tile.output*procSize;
+	return true;
+}
 
 void PAR2ProcCPU::compute_worker(ThreadMessageQueue<void*>& q) {
 	compute_req* req;
+	std::vector<const void*> srcList;
 	while((req = static_cast<compute_req*>(q.pop())) != NULL) {
+		auto* area = req->area;
+		const uint32_t prevBatch = req->batchSeq-1;
+		unsigned tile;
+		uint64_t procBytes = 0;
+		uint64_t startTime = req->statTime ? worker_timestamp() : 0;
 		
-		const Galois16MethodInfo& gfInfo = req->gf->info();
-		// compute how many inputs regions get prefetched in a muladd_multi call
-		// TODO: should this be done across all threads?
-		unsigned inputsPrefetchedPerInvok = (req->numInputs / gfInfo.idealInputMultiple);
-		unsigned inputPrefetchOutOffset = req->numOutputs-1;
-		const unsigned MAX_PF_FACTOR = 3;
-		{
-			const unsigned pfFactor = gfInfo.prefetchDownscale;
-			if(inputsPrefetchedPerInvok > (1U<<pfFactor)) { // will inputs ever be prefetched? if all prefetch rounds are spent on outputs, inputs will never prefetch
-				inputsPrefetchedPerInvok -= (1U<<pfFactor); // exclude output fetching rounds
-				inputsPrefetchedPerInvok <<= MAX_PF_FACTOR - pfFactor; // scale appropriately
-				// compute number of input prefetch passes needed
-				inputPrefetchOutOffset = CEIL_DIV(req->numInputs << MAX_PF_FACTOR, inputsPrefetchedPerInvok);
-				assert(inputPrefetchOutOffset > 0); // at least one pass needed
-				if(req->numOutputs >= inputPrefetchOutOffset)
-					inputPrefetchOutOffset = req->numOutputs - inputPrefetchOutOffset;
-				else
-					inputPrefetchOutOffset = 0;
+		// process our own tiles first
+		while(tile_take_front(area->tileRanges[req->worker], tile)) {
+			// the previous batch's tile is either done by us, or is being processed by a worker which stole it, in which case, wait for it to finish
+			while(req->tileBatch[tile].load(std::memory_order_acquire) != prevBatch)
+				std::this_thread::yield();
+			const char* nextInput = nullptr;
+			const char* nextOutput = nullptr;
+			if(req->lookahead && !req->inPlace && tile_range_empty(area->tileRanges[req->worker])) {
+				// this is our last tile; try to hide the cold start of the next batch
+				if(lookahead_next(q, nextInput, nextOutput))
+					req->parent->statLookaheads.fetch_add(1, std::memory_order_relaxed);
 			}
+			procBytes += req->inPlace ? compute_tile_inplace(req, req->tiles[tile], srcList) : compute_tile(req, req->tiles[tile], nextInput, nextOutput);
+			req->tileBatch[tile].store(req->batchSeq, std::memory_order_release);
 		}
 		
-		for(size_t round = 0; round < req->numChunks; round++) {
-			size_t procSize = MIN(req->len-round*req->chunkSize, req->chunkSize);
-			const char* srcPtr = static_cast<const char*>(req->input) + round*req->chunkSize*req->inputGrouping;
-			for(unsigned out = 0; out < req->numOutputs; out++) {
-				const uint16_t* vals = req->coeffs + out*req->inputGrouping;
-				
-				char* dstPtr = static_cast<char*>(req->output) + out*procSize + round*req->numOutputs*req->chunkSize;
-				if(!req->add) memset(dstPtr, 0, procSize);
-				if(round == req->numChunks-1) {
-					if(out+1 < req->numOutputs) {
-						if(req->outNonZero[out])
-							req->gf->mul_add_multi_packpf(req->inputGrouping, req->numInputs, dstPtr, srcPtr, procSize, vals, req->mutScratch, NULL, dstPtr+procSize);
-						else
-							req->gf->add_multi_packpf(req->inputGrouping, req->numInputs, dstPtr, srcPtr, procSize, NULL, dstPtr+procSize);
-					} else
-						// TODO: this could also be a 0 output, so consider add_multi optimisation?
-						req->gf->mul_add_multi_packed(req->inputGrouping, req->numInputs, dstPtr, srcPtr, procSize, vals, req->mutScratch);
-				} else {
-					const char* pfInput = out >= inputPrefetchOutOffset ? static_cast<const char*>(req->input) + (round+1)*req->chunkSize*req->inputGrouping + ((inputsPrefetchedPerInvok*(out-inputPrefetchOutOffset)*procSize)>>MAX_PF_FACTOR) : NULL;
-					// procSize input prefetch may be wrong for final round, but it's the closest we've got; TODO: perhaps consider skipping out of prefetching, if the final round has a different region size
-					
-					if(req->outNonZero[out])
-						req->gf->mul_add_multi_packpf(req->inputGrouping, req->numInputs, dstPtr, srcPtr, procSize, vals, req->mutScratch, pfInput, dstPtr+procSize);
-					else
-						req->gf->add_multi_packpf(req->inputGrouping, req->numInputs, dstPtr, srcPtr, procSize, pfInput, dstPtr+procSize);
+		// then steal from other workers; since ranges only ever shrink, a single pass over all workers is sufficient
+		if(req->steal) {
+			unsigned steals = 0;
+			for(unsigned i = 1; i < req->stealWorkers; i++) {
+				auto& victim = area->tileRanges[req->stealFirst + (req->worker - req->stealFirst + i) % req->stealWorkers];
+				while(tile_take_back(victim, tile, req->tileBatch, prevBatch)) {
+					procBytes += req->inPlace ? compute_tile_inplace(req, req->tiles[tile], srcList) : compute_tile(req, req->tiles[tile], nullptr, nullptr);
+					req->tileBatch[tile].store(req->batchSeq, std::memory_order_release);
+					steals++;
 				}
 			}
+			if(steals)
+				req->parent->statSteals.fetch_add(steals, std::memory_order_relaxed);
 		}
 		
-		// TODO: allow worker to peek into next queue entry for prefetching?
+		if(req->statTime) {
+			req->statBytes->fetch_add(procBytes, std::memory_order_relaxed);
+			req->statTime->fetch_add(worker_timestamp() - startTime, std::memory_order_relaxed);
+		}
 		
 #ifdef DEBUG_STAT_THREAD_EMPTY
 		if(q.empty() && !(req->parent->endSignalled IF_NOT_LIBUV(.load(std::memory_order_relaxed))))
@@ -522,105 +1362,447 @@ void PAR2ProcCPU::compute_worker(ThreadMessageQueue<void*>& q) {
 #endif
 		
 		// mark that we've done processing this request
-		if(req->procRefs->fetch_sub(1, std::memory_order_acq_rel) <= 1) { // ensure all prior memory operations to be complete at this point; even though a cross-thread signal requires stricter ordering, it's only guaranteed on the sending thread
+		uint64_t finishTime = worker_timestamp();
+		area->finishTimeSum.fetch_add(finishTime, std::memory_order_relaxed);
+		if(area->procRefs.fetch_sub(1, std::memory_order_acq_rel) <= 1) { // ensure all prior memory operations to be complete at this point; even though a cross-thread signal requires stricter ordering, it's only guaranteed on the sending thread
+			// all other workers finished earlier, and have been idle since
+			uint64_t othersFinishSum = area->finishTimeSum.load(std::memory_order_relaxed) - finishTime;
+			req->parent->statIdleTime.fetch_add((req->numDispatched-1) * finishTime - othersFinishSum, std::memory_order_relaxed);
+			
+			if(req->inPlace) req->parent->release_inplace(*area, req->numInputs);
+			
 			// signal this input group is done with
 #ifdef USE_LIBUV
 			req->parent->_queueProc.notify(req);
 #else
 			req->parent->stagingActiveCount_dec();
 			req->parent->_setAreaActive(req->procIdx, false);
-			delete req;
+			computeReqPool.put(req);
 #endif
 		} else
-			delete req;
+			computeReqPool.put(req);
 	}
 }
 
-void PAR2ProcCPU::run_kernel(unsigned inBuf, unsigned numInputs) {
-	if(outputExponents.empty()) return;
+void PAR2ProcCPU::calcTiles() {
+	tiles.clear();
+	outputTiled = false;
+	tileOwnerEnd.assign(numThreads, 0);
+	if(numaNodes.empty())
+		plan_tiles(0, numChunks, 0, numThreads);
+	else {
+		// give each node a share of the slice, proportional to its number of workers
+		for(auto& node : numaNodes) {
+			node.chunkStart = ROUND_DIV(numChunks * node.firstWorker, (size_t)numThreads);
+			node.chunkEnd = ROUND_DIV(numChunks * node.endWorker, (size_t)numThreads);
+			plan_tiles(node.chunkStart, node.chunkEnd - node.chunkStart, node.firstWorker, node.endWorker - node.firstWorker);
+		}
+		bind_numa_memory();
+	}
 	
+	// as the plan is only changed whilst nothing is processing, all tiles are up-to-date
+	tileBatch = std::vector<std::atomic<uint32_t>>(tiles.size());
+	for(auto& tb : tileBatch)
+		tb.store(batchSeq, std::memory_order_relaxed);
+	
+	// until class weights are known, keep the plan's assignment
+	bool uniform = true;
+	for(const auto& cls : coreClasses)
+		if(cls.weight != 1.0) uniform = false;
+	if(!uniform) weight_tile_owners();
+}
+
+void PAR2ProcCPU::plan_tiles(size_t chunkStart, size_t chunks, unsigned firstWorker, unsigned workers) {
+	// the initial assignment matches a static distribution: chunks are distributed evenly across threads, and for remaining chunks, outputs are distributed evenly across threads, but a thread won't handle more than one remaining chunk
+	// with work stealing enabled, each worker's chunks are further split into several tiles, so that idle workers can take some of the load off slower workers
+	if(!chunks || !workers) {
+		for(unsigned thread = 0; thread < workers; thread++)
+			tileOwnerEnd[firstWorker + thread] = tiles.size();
+		return;
+	}
+	const unsigned numOutputs = outputExponents.size();
+	const size_t tilesTarget = (size_t)workers * (workStealing ? TILES_PER_WORKER : 1);
+	if(tilingMode == PROC_TILING_2D || (tilingMode == PROC_TILING_AUTO && workers > 1 && numOutputs > 1 && chunks < tilesTarget)) {
+		plan_tiles_2d(chunkStart, chunks, firstWorker, workers);
+		return;
+	}
+	size_t fullChunksPerThread = chunks / workers;
+	unsigned leftoverChunks = chunks % workers;
+	unsigned threadsPerChunk = 0;
+	float outputsPerThread = 0;
+	if(leftoverChunks) {
+		// send each chunk to this many threads
+		threadsPerChunk = MIN(workers / leftoverChunks, numOutputs);
+		assert(threadsPerChunk >= 1);
+		// number of outputs to send to a thread (this will be rounded appropriately as it's processed)
+		outputsPerThread = (float)numOutputs / threadsPerChunk;
+		assert(outputsPerThread >= 1);
+		assert(threadsPerChunk * leftoverChunks <= workers);
+	}
+	size_t tilesPerThread = workStealing ? MIN(fullChunksPerThread, TILES_PER_WORKER) : MIN(fullChunksPerThread, (size_t)1);
+	
+	for(unsigned thread = 0; thread < workers; thread++) {
+		if(thread < threadsPerChunk * leftoverChunks) {
+			// split a remaining chunk across threads
+			unsigned tc = thread % threadsPerChunk;
+			unsigned outputIdx = (unsigned)(outputsPerThread*tc + 0.5);
+			tiles.push_back({
+				chunkStart + thread / threadsPerChunk, 1,
+				outputIdx, (unsigned)(outputsPerThread*(tc+1) + 0.5) - outputIdx
+			});
+			assert(tiles.back().numOutputs >= 1);
+			if(tc == threadsPerChunk-1) assert(outputIdx + tiles.back().numOutputs == numOutputs);
+		}
+		if(fullChunksPerThread) {
+			size_t chunk = chunkStart + leftoverChunks + thread*fullChunksPerThread;
+			for(size_t t = 0; t < tilesPerThread; t++) {
+				size_t tileEnd = chunkStart + leftoverChunks + thread*fullChunksPerThread + (fullChunksPerThread * (t+1)) / tilesPerThread;
+				tiles.push_back({chunk, tileEnd-chunk, 0, numOutputs});
+				chunk = tileEnd;
+			}
+		}
+		// threads without tiles get an empty range, and won't be sent any work
+		tileOwnerEnd[firstWorker + thread] = tiles.size();
+	}
+}
+
+void PAR2ProcCPU::plan_tiles_2d(size_t chunkStart, size_t chunks, unsigned firstWorker, unsigned workers) {
+	// split outputs into enough ranges for each worker to get its share of tiles, but keep ranges large enough to amortise the cost of loading a chunk's inputs
+	const unsigned numOutputs = outputExponents.size();
+	const size_t tilesTarget = (size_t)workers * (workStealing ? TILES_PER_WORKER : 1);
+	size_t groups = CEIL_DIV(tilesTarget, chunks);
+	size_t maxGroups = MAX(numOutputs / OUTPUT_TILE_MIN, CEIL_DIV(workers, chunks));
+	groups = MIN(groups, MIN(maxGroups, (size_t)numOutputs));
+	if(groups < 1) groups = 1;
+	
+	// tiles are ordered by chunk, so that consecutive tiles (which will mostly be processed by the same worker) share inputs
+	size_t firstTile = tiles.size();
+	for(size_t chunk = chunkStart; chunk < chunkStart+chunks; chunk++) {
+		for(size_t group = 0; group < groups; group++) {
+			unsigned outputIdx = (unsigned)(numOutputs * group / groups);
+			unsigned outputEnd = (unsigned)(numOutputs * (group+1) / groups);
+			tiles.push_back({chunk, 1, outputIdx, outputEnd - outputIdx});
+		}
+	}
+	size_t numTiles = tiles.size() - firstTile;
+	outputTiled = true;
+	for(unsigned thread = 0; thread < workers; thread++)
+		tileOwnerEnd[firstWorker + thread] = firstTile + numTiles * (thread+1) / workers;
+}
+
+void PAR2ProcCPU::run_kernel(unsigned inBuf, unsigned numInputs) {
 	auto& area = staging[inBuf];
+	if(outputExponents.empty()) {
+		if(inPlaceInput) release_inplace(area, numInputs);
+		return;
+	}
+	
+	std::lock_guard<std::mutex> lk(kernelMutex);
 	
-	// currently do static distribution; TODO: consider dynamic scheduling?
 	bool oldProcessingAdd = processingAdd;
+	// if recovery memory is already zero, the first batch can add to it instead of clearing it
+	if(!oldProcessingAdd)
+		oldProcessingAdd = zeroedMem ? discardProcessingMem() : memIsZero;
+	memIsZero = false;
 	processingAdd = true;
 	
-	auto makeReq = [&, this](unsigned thread, size_t sliceOffset) -> compute_req* {
-		compute_req* req = new compute_req;
+	if(tiles.empty()) calcTiles();
+	else if(!coreClasses.empty() && update_class_weights()) weight_tile_owners();
+	classify_coeffs(area, numInputs);
+	unsigned usedThreads = 0;
+	area.batchSeq = ++batchSeq;
+	if(area.tileRanges.size() != (unsigned)numThreads)
+		area.tileRanges = std::vector<std::atomic<uint64_t>>(numThreads);
+	uint32_t tileStart = 0;
+	for(unsigned thread = 0; thread < (unsigned)numThreads; thread++) {
+		uint32_t tileEnd = tileOwnerEnd[thread];
+		area.tileRanges[thread].store(tile_range_pack(tileStart, tileEnd), std::memory_order_relaxed);
+		if(tileEnd > tileStart) usedThreads++;
+		tileStart = tileEnd;
+	}
+	
+	if(inPlaceInput) {
+		area.inPlaceSplits.clear();
+		for(unsigned i=0; i<numInputs; i++) {
+			size_t len = area.inPlace[i].len;
+			if(len > 0 && len < alignedCurrentSliceSize)
+				area.inPlaceSplits.push_back(len);
+		}
+		std::sort(area.inPlaceSplits.begin(), area.inPlaceSplits.end());
+		area.inPlaceSplits.erase(std::unique(area.inPlaceSplits.begin(), area.inPlaceSplits.end()), area.inPlaceSplits.end());
+	}
+	
+	area.procRefs.store(usedThreads, std::memory_order_relaxed);
+	area.finishTimeSum.store(0, std::memory_order_relaxed);
+	// the ordering of the above stores are guaranteed by the queue (release/acquire on the ring) used to send requests to workers
+	unsigned numaNode = 0, coreClass = 0;
+	for(unsigned thread = 0; thread < (unsigned)numThreads; thread++) {
+		if(tileOwnerEnd[thread] == (thread ? tileOwnerEnd[thread-1] : 0)) continue; // no work for this thread
+		compute_req* req = computeReqPool.get();
 		req->numInputs = numInputs;
 		req->inputGrouping = inputBatchSize;
+		req->numOutputs = outputExponents.size();
+		req->coeffClass = area.coeffClass.data();
+		req->coeffs = area.procCoeffs.data();
+		req->len = alignedCurrentSliceSize;
 		req->chunkSize = chunkLen;
-		req->input = static_cast<const char*>(area.src) + sliceOffset*inputBatchSize;
+		req->input = area.src;
+		req->chunkMem = chunkMem.data();
 		req->add = oldProcessingAdd;
+		req->inPlace = inPlaceInput;
+		req->worker = thread;
+		req->numDispatched = usedThreads;
+		req->steal = workStealing;
+		req->lookahead = lookaheadPrefetch;
+		if(numaNodes.empty()) {
+			req->stealFirst = 0;
+			req->stealWorkers = numThreads;
+			req->statBytes = req->statTime = nullptr;
+			if(!coreClasses.empty()) {
+				while(thread >= coreClasses[coreClass].endWorker) coreClass++;
+				req->statBytes = &classStatBytes[coreClass];
+				req->statTime = &classStatTime[coreClass];
+			}
+		} else {
+			// only steal from workers on the same node
+			while(thread >= numaNodes[numaNode].endWorker) numaNode++;
+			req->stealFirst = numaNodes[numaNode].firstWorker;
+			req->stealWorkers = numaNodes[numaNode].endWorker - req->stealFirst;
+			req->statBytes = &numaStatBytes[numaNode];
+			req->statTime = &numaStatTime[numaNode];
+		}
+		req->batchSeq = area.batchSeq;
+		req->tiles = tiles.data();
+		req->tileBatch = tileBatch.data();
 		req->mutScratch = gfScratch[thread]; // TODO: should this be assigned to the thread instead?
 		req->gf = gf;
 		req->parent = this;
-		req->procRefs = &(area.procRefs);
+		req->area = &area;
 		req->procIdx = inBuf;
-		return req;
-	};
+		thWorkers[thread].send(req);
+	}
+}
+
+bool PAR2ProcCPU::setInPlaceInput(bool enable) {
+	inPlaceInput = enable && gf && gf->hasNaturalInput();
+	return inPlaceInput == enable;
+}
+
+bool PAR2ProcCPU::setNumaMode(bool enable, unsigned fakeNodes) {
+	std::vector<CpuNumaNode> nodes;
+	if(enable)
+		nodes = fakeNodes ? cputopo_fake_numa_nodes(fakeNodes) : cputopo_numa_nodes();
+	if(nodes.size() < 2) nodes.clear();
+	if(!nodes.empty() && !coreClasses.empty()) {
+		coreClasses.clear();
+		assign_class_workers(); // unpin
+	}
 	
-	// distribute chunks evenly across threads. For remaining chunks, try to distribute the outputs evenly across threads, but don't allow a thread to handle more than one remaining chunk
-	size_t fullChunksPerThread = numChunks / numThreads;
-	unsigned leftoverChunks = numChunks % numThreads;
-	size_t chunk = 0;
-	// start off with remaining chunks
-	if(leftoverChunks) {
-		// send each chunk to this many threads
-		unsigned threadsPerChunk = MIN(numThreads / leftoverChunks, outputExponents.size());
-		assert(threadsPerChunk >= 1);
-		// number of outputs to send to a thread (this will be rounded appropriately as it's processed)
-		float outputsPerThread = (float)outputExponents.size() / threadsPerChunk;
-		assert(outputsPerThread >= 1);
-		// number of threads that we'll send remaining chunks to
-		unsigned usedThreads = threadsPerChunk * leftoverChunks;
-		assert((int)usedThreads <= numThreads);
-		area.procRefs.store((fullChunksPerThread ? numThreads : 0) + usedThreads, std::memory_order_relaxed);
-		
-		unsigned thread = 0;
-		for(; chunk < leftoverChunks; chunk++) {
-			size_t sliceOffset = chunk*chunkLen;
-			size_t reqLen = MIN(alignedCurrentSliceSize-sliceOffset, chunkLen);
-			char* outputBase = static_cast<char*>(memProcessing) + sliceOffset*outputExponents.size();
-			// split this chunk across threads
-			unsigned outputIdx = 0;
-			for(unsigned tc = 0; tc < threadsPerChunk; tc++) {
-				assert(thread < usedThreads);
-				auto req = makeReq(thread, sliceOffset);
-				req->numOutputs = (unsigned)(outputsPerThread*(tc+1) + 0.5) - outputIdx;
-				assert(req->numOutputs >= 1);
-				req->outNonZero = outputExponents.data() + outputIdx;
-				req->coeffs = area.procCoeffs.data() + outputIdx * inputBatchSize;
-				req->len = reqLen;
-				req->numChunks = 1;
-				req->output = outputBase + outputIdx*req->len;
-				
-				outputIdx += req->numOutputs;
-				if(tc == threadsPerChunk-1) assert(outputIdx == outputExponents.size());
-				thWorkers[thread].send(req);
-				thread++;
+	numaNodes.clear();
+	for(const auto& node : nodes)
+		numaNodes.push_back({node.id, node.cpus, 0, 0, 0, 0});
+	numaStatBytes = std::vector<std::atomic<uint64_t>>(numaNodes.size());
+	numaStatTime = std::vector<std::atomic<uint64_t>>(numaNodes.size());
+	for(unsigned i=0; i<numaNodes.size(); i++) {
+		numaStatBytes[i].store(0, std::memory_order_relaxed);
+		numaStatTime[i].store(0, std::memory_order_relaxed);
+	}
+	
+	assign_numa_workers();
+	return !numaNodes.empty() || !enable;
+}
+
+void PAR2ProcCPU::assign_numa_workers() {
+	// distribute workers across nodes, proportional to the number of CPUs in each
+	size_t totalCpus = 0, cpusBefore = 0;
+	for(const auto& node : numaNodes)
+		totalCpus += node.cpus.size();
+	for(auto& node : numaNodes) {
+		node.firstWorker = (unsigned)ROUND_DIV(numThreads * cpusBefore, totalCpus);
+		cpusBefore += node.cpus.size();
+		node.endWorker = (unsigned)ROUND_DIV(numThreads * cpusBefore, totalCpus);
+	}
+	
+	// pinning is applied when the thread (re)starts
+	const std::vector<int> noAffinity;
+	unsigned node = 0;
+	for(unsigned i=0; i<thWorkers.size(); i++) {
+		while(node < numaNodes.size() && i >= numaNodes[node].endWorker) node++;
+		const auto& cpus = node < numaNodes.size() ? numaNodes[node].cpus : noAffinity;
+		if(thWorkers[i].cpuAffinity != cpus) {
+			thWorkers[i].cpuAffinity = cpus;
+			thWorkers[i].end();
+		}
+	}
+	tiles.clear();
+}
+
+void PAR2ProcCPU::bind_numa_memory() {
+	if(!chunkMem.empty()) {
+		const size_t numOutputs = outputExponents.size();
+		for(const auto& node : numaNodes) {
+			// bind each run of chunks which are contiguous in memory
+			size_t chunk = node.chunkStart;
+			while(chunk < node.chunkEnd) {
+				char* start = static_cast<char*>(chunkMem[chunk]);
+				char* end = start;
+				for(; chunk < node.chunkEnd && chunkMem[chunk] == end; chunk++)
+					end += MIN(alignedCurrentSliceSize - chunk*chunkLen, chunkLen) * numOutputs;
+				cputopo_bind_memory(start, end-start, node.id);
 			}
 		}
-	} else
-		area.procRefs.store(numThreads, std::memory_order_relaxed);
-	
-	// distribute chunks evenly across threads
-	if(fullChunksPerThread) {
-		for(int thread=0; thread<numThreads; thread++) {
-			size_t sliceOffset = chunk*chunkLen;
-			auto req = makeReq(thread, sliceOffset);
-			req->numOutputs = outputExponents.size();
-			req->outNonZero = outputExponents.data();
-			req->coeffs = area.procCoeffs.data();
-			req->len = MIN(alignedCurrentSliceSize-sliceOffset, chunkLen*fullChunksPerThread);
-			req->numChunks = fullChunksPerThread;
-			req->output = static_cast<char*>(memProcessing) + sliceOffset*outputExponents.size();
-			
-			thWorkers[thread].send(req);
-			chunk += fullChunksPerThread;
+	}
+	for(auto& area : staging)
+		if(area.src) bind_numa_staging(area);
+}
+void PAR2ProcCPU::bind_numa_staging(PAR2ProcCPUStaging& area) {
+	for(const auto& node : numaNodes) {
+		if(node.chunkEnd <= node.chunkStart) continue;
+		size_t start = node.chunkStart * chunkLen;
+		size_t end = MIN(node.chunkEnd * chunkLen, alignedCurrentSliceSize);
+		cputopo_bind_memory(static_cast<char*>(area.src) + start*inputBatchSize, (end-start)*inputBatchSize, node.id);
+	}
+}
+
+std::vector<PAR2ProcCPUNumaStat> PAR2ProcCPU::getNumaStats() const {
+	std::vector<PAR2ProcCPUNumaStat> stats;
+	for(unsigned i=0; i<numaNodes.size(); i++) {
+		const auto& node = numaNodes[i];
+		unsigned threads = node.endWorker - node.firstWorker;
+		uint64_t time = numaStatTime[i].load(std::memory_order_relaxed);
+		double throughput = 0;
+		if(time) // time is summed across workers, so scale by the number of workers to get the node's throughput
+			throughput = (double)numaStatBytes[i].load(std::memory_order_relaxed) * threads / ((double)time / 1000000000.0);
+		stats.push_back({node.id, threads, throughput});
+	}
+	return stats;
+}
+
+bool PAR2ProcCPU::setHybridMode(bool enable, unsigned fakeClasses) {
+	std::vector<CpuCoreClass> classes;
+	if(enable)
+		classes = fakeClasses ? cputopo_fake_core_classes(fakeClasses) : cputopo_core_classes();
+	if(classes.size() < 2) classes.clear();
+	if(!classes.empty() && !numaNodes.empty())
+		setNumaMode(false);
+	
+	coreClasses.clear();
+	for(const auto& cls : classes)
+		coreClasses.push_back({cls.name, cls.cpus, 0, 0, 1.0});
+	classStatBytes = std::vector<std::atomic<uint64_t>>(coreClasses.size());
+	classStatTime = std::vector<std::atomic<uint64_t>>(coreClasses.size());
+	for(unsigned i=0; i<coreClasses.size(); i++) {
+		classStatBytes[i].store(0, std::memory_order_relaxed);
+		classStatTime[i].store(0, std::memory_order_relaxed);
+	}
+	
+	assign_class_workers();
+	return !coreClasses.empty() || !enable;
+}
+
+void PAR2ProcCPU::assign_class_workers() {
+	// if there's enough workers to cover all CPUs, distribute them proportional to the number of CPUs in each class (as with NUMA nodes), otherwise fill the fastest classes first
+	size_t totalCpus = 0, cpusBefore = 0;
+	for(const auto& cls : coreClasses)
+		totalCpus += cls.cpus.size();
+	unsigned worker = 0;
+	for(auto& cls : coreClasses) {
+		cls.firstWorker = worker;
+		if((size_t)numThreads >= totalCpus) {
+			cpusBefore += cls.cpus.size();
+			worker = (unsigned)ROUND_DIV(numThreads * cpusBefore, totalCpus);
+		} else
+			worker = MIN(worker + (unsigned)cls.cpus.size(), (unsigned)numThreads);
+		cls.endWorker = worker;
+	}
+	
+	// pinning is applied when the thread (re)starts
+	const std::vector<int> noAffinity;
+	unsigned cls = 0;
+	for(unsigned i=0; i<thWorkers.size(); i++) {
+		while(cls < coreClasses.size() && i >= coreClasses[cls].endWorker) cls++;
+		const auto& cpus = cls < coreClasses.size() ? coreClasses[cls].cpus : noAffinity;
+		if(thWorkers[i].cpuAffinity != cpus) {
+			thWorkers[i].cpuAffinity = cpus;
+			thWorkers[i].end();
+		}
+	}
+	tiles.clear();
+}
+
+void PAR2ProcCPU::setCoreClassWeights(const std::vector<double>& weights) {
+	std::lock_guard<std::mutex> lk(kernelMutex);
+	for(unsigned i=0; i<coreClasses.size() && i<weights.size(); i++)
+		if(weights[i] > 0) coreClasses[i].weight = weights[i];
+	weight_tile_owners();
+}
+
+bool PAR2ProcCPU::update_class_weights() {
+	// wait until every class has a reasonable amount of processing measured
+	// classes without workers keep their weight
+	std::vector<double> throughput(coreClasses.size(), 0);
+	for(unsigned i=0; i<coreClasses.size(); i++) {
+		if(coreClasses[i].endWorker == coreClasses[i].firstWorker) continue;
+		uint64_t time = classStatTime[i].load(std::memory_order_relaxed);
+		uint64_t bytes = classStatBytes[i].load(std::memory_order_relaxed);
+		if(time < CLASS_WEIGHT_MIN_TIME || !bytes) return false;
+		throughput[i] = (double)bytes / (double)time;
+	}
+	if(throughput[0] <= 0) return false;
+	
+	// only replan if a weight has changed significantly
+	bool changed = false;
+	for(unsigned i=0; i<coreClasses.size(); i++) {
+		if(throughput[i] <= 0) continue;
+		double weight = throughput[i] / throughput[0];
+		if(fabs(weight - coreClasses[i].weight) > coreClasses[i].weight * CLASS_WEIGHT_TOLERANCE) {
+			coreClasses[i].weight = weight;
+			changed = true;
 		}
 	}
-	assert(chunk == numChunks);
+	return changed;
+}
+
+void PAR2ProcCPU::weight_tile_owners() {
+	// the tiles stay the same, but each worker is given a contiguous run of them, proportional to its class' weight
+	// this only changes ownership, so can be done whilst other batches are processing: a worker waits for the previous batch's processing of a tile to finish before taking it
+	if(tiles.empty()) return;
+	
+	double totalCost = 0, totalWeight = 0;
+	for(const auto& tile : tiles)
+		totalCost += (double)tile.numChunks * tile.numOutputs;
+	for(const auto& cls : coreClasses)
+		totalWeight += (cls.endWorker - cls.firstWorker) * cls.weight;
+	
+	double target = 0, assigned = 0;
+	uint32_t tile = 0;
+	for(const auto& cls : coreClasses) {
+		for(unsigned worker = cls.firstWorker; worker < cls.endWorker; worker++) {
+			target += totalCost * cls.weight / totalWeight;
+			while(tile < tiles.size()) {
+				double cost = (double)tiles[tile].numChunks * tiles[tile].numOutputs;
+				if(assigned + cost/2 > target) break;
+				assigned += cost;
+				tile++;
+			}
+			tileOwnerEnd[worker] = tile;
+		}
+	}
+	tileOwnerEnd[numThreads-1] = tiles.size();
+}
+
+std::vector<PAR2ProcCPUCoreClassStat> PAR2ProcCPU::getCoreClassStats() const {
+	std::vector<PAR2ProcCPUCoreClassStat> stats;
+	for(unsigned i=0; i<coreClasses.size(); i++) {
+		const auto& cls = coreClasses[i];
+		unsigned threads = cls.endWorker - cls.firstWorker;
+		uint64_t time = classStatTime[i].load(std::memory_order_relaxed);
+		double throughput = 0;
+		if(time)
+			throughput = (double)classStatBytes[i].load(std::memory_order_relaxed) * threads / ((double)time / 1000000000.0);
+		stats.push_back({cls.name, threads, throughput, cls.weight});
+	}
+	return stats;
 }
 
 #ifdef USE_LIBUV
@@ -635,13 +1817,12 @@ void PAR2ProcCPU::_notifyProc(void* _req) {
 	/*
 	// TODO: implement for non-libuv if we go ahead with this
 	// this is currently pointless while minInBatchSize == inputBatchSize
-	if(currentStagingInputs && stagingActiveCount_get() == 0 && staging.size() > 1 && currentStagingInputs >= minInBatchSize) {
+	if(currentStagingInputs && stagingActiveCount_get() == 0 && maxStagingAreas() > 1 && currentStagingInputs >= minInBatchSize) {
 		// TODO: consider firing off next batch of inputs
 	}
 	*/
-	// TODO: also consider idea of dynamically scaling areas - this removes the notion of a 'full' state, and allows caller to manage maximum outstanding regions
 	
-	delete req;
+	computeReqPool.put(req);
 }
 #endif
 
@@ -655,5 +1836,8 @@ void PAR2ProcCPU::processing_finished() {
 		if(area.src) ALIGN_FREE(area.src);
 		area.src = nullptr;
 	}
+	stagingAreasUsed = minStagingAreas;
+	stagingAreasCap = 0;
+	if(currentStagingArea >= stagingAreasUsed) currentStagingArea = 0;
 }
 
@@ -3,17 +3,110 @@
 
 #include "controller.h"
 #include <atomic>
+#include <memory>
+#include <mutex>
 #include "threadqueue.h"
 
 #include "gf16mul.h"
+#include "cpu_topology.h"
 
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+class MD5Multi;
+#endif
+
+// a unit of work handed to compute workers: a run of consecutive chunks, for a range of outputs
+struct PAR2ProcCPUTile {
+	size_t chunk, numChunks;
+	unsigned output, numOutputs;
+};
+
+enum PAR2ProcCPUPageMode {
+	PROC_PAGES_DEFAULT, // regular allocation
+	PROC_PAGES_THP, // request transparent huge pages
+	PROC_PAGES_HUGETLB // explicit huge pages, falling back to transparent huge pages if unavailable
+};
+
+enum PAR2ProcCPUTiling {
+	PROC_TILING_AUTO, // use 2D tiling if the 1D plan can't give each worker enough tiles
+	PROC_TILING_1D, // tiles span all outputs, except where chunks are left over after an even split across workers
+	PROC_TILING_2D // every chunk is split by output as well
+};
+
+// a block of recovery memory, holding the regions for a run of chunks
+struct PAR2ProcCPUSegment {
+	void* mem;
+	size_t size; // allocated size
+	bool mapped; // allocated via mmap, rather than ALIGN_ALLOC
+	bool huge; // backed by huge pages (or at least, they've been requested via madvise)
+};
+
+// parameters selected by PAR2ProcCPU::autotune
+struct PAR2ProcCPUTuning {
+	Galois16Methods method;
+	unsigned inputGrouping; // 0 = use default
+	size_t chunkLen; // 0 = use default
+};
+
+// in NUMA mode, each node gets its own share of the slice, processed by workers pinned to the node
+struct PAR2ProcCPUNumaNode {
+	int id; // -1 if not a real node
+	std::vector<int> cpus;
+	unsigned firstWorker, endWorker;
+	size_t chunkStart, chunkEnd;
+};
+struct PAR2ProcCPUNumaStat {
+	int node;
+	unsigned threads;
+	double throughput; // multiply-add bytes per second (input bytes multiplied, summed across outputs)
+};
+
+// in hybrid mode, workers are pinned to a core class, and each worker's share of tiles is weighted by its class' measured throughput
+struct PAR2ProcCPUCoreClass {
+	std::string name;
+	std::vector<int> cpus;
+	unsigned firstWorker, endWorker;
+	double weight; // per-worker throughput, relative to the first class
+};
+struct PAR2ProcCPUCoreClassStat {
+	std::string name;
+	unsigned threads;
+	double throughput; // as with PAR2ProcCPUNumaStat
+	double weight;
+};
+
+// in in-place mode, an input's full strides are read directly from the caller's buffer, which is held until the batch is processed
+struct PAR2ProcCPUInPlaceInput {
+	const void* src;
+	size_t len; // amount read from src; the remainder of the slice (and checksum) comes from the staging area
+	void* prepReq; // completed prepare request, signalled once the batch is processed
+};
+
+// what each output's coefficients (across a batch's inputs) allow the multiply to be reduced to
+enum PAR2ProcCPUCoeffClass : uint8_t {
+	PAR2PROC_CPU_COEFF_GENERAL,
+	PAR2PROC_CPU_COEFF_ONES, // all coefficients are 1, so the inputs only need to be added
+	PAR2PROC_CPU_COEFF_ZERO // all coefficients are 0, so the output is unaffected by the batch
+};
 
 class PAR2ProcCPUStaging : public IPAR2ProcStaging {
 public:
 	void* src;
 	std::atomic<int> procRefs;
+	std::vector<PAR2ProcCPUCoeffClass> coeffClass; // per output, for the current batch
+	
+	std::vector<PAR2ProcCPUInPlaceInput> inPlace; // per input
+	std::vector<size_t> inPlaceSplits; // offsets at which some inputs switch from the caller's buffer to the staging area, sorted
+	
+	// work stealing scheduler state; each worker owns a contiguous range of tiles, which is consumed from the front by the owner, and from the back by other workers
+	std::vector<std::atomic<uint64_t>> tileRanges; // per worker: low 32 bits = next tile, high 32 bits = end tile
+	uint32_t batchSeq;
+	std::atomic<uint64_t> finishTimeSum; // sum of timestamps of workers which finished before the last one (for idle time tracking)
 	
-	PAR2ProcCPUStaging() : IPAR2ProcStaging(), src(nullptr) {}
+	// prepares may complete out of order across transfer threads; this counts outstanding prepares, plus one until the batch is submitted, and whichever thread brings it to zero starts processing
+	std::atomic<unsigned> prepPending;
+	unsigned submitInputs;
+	
+	PAR2ProcCPUStaging() : IPAR2ProcStaging(), src(nullptr), batchSeq(0), finishTimeSum(0), prepPending(1), submitInputs(0) {}
 	~PAR2ProcCPUStaging();
 };
 
@@ -30,25 +123,49 @@ private:
 	
 	Galois16Mul* gf;
 	size_t chunkLen; // loop tiling size
+	size_t targetChunkLen; // desired tiling size; chunkLen is derived from this, to evenly divide the slice
 	size_t numChunks;
 	unsigned alignment;
 	unsigned stride;
 	void freeGf();
 	
 	// staging area from which processing is performed
+	// only the first stagingAreasUsed are in use; if a memory limit is set, more are brought into use when all are busy, and released once processing catches up
 	std::vector<PAR2ProcCPUStaging> staging;
+	unsigned stagingAreasUsed, minStagingAreas;
+	unsigned stagingAreasCap; // if non-zero, an allocation failed, so the number of areas is held at this
+	size_t stagingMemLimit; // 0 = fixed number of areas
+	unsigned maxStagingAreas() const;
+	bool acquire_staging();
+	void next_staging();
 	bool reallocMemInput();
-	void* memProcessing; // TODO: break this into chunks, to avoid massive single allocation
+	// recovery data is split into segments, each holding the regions (of chunkLen*numOutputs bytes) for a run of chunks, to avoid a massive single allocation
+	std::vector<PAR2ProcCPUSegment> memSegments;
+	std::vector<void*> chunkMem; // start of each chunk's region
+	PAR2ProcCPUPageMode pageMode;
+	size_t segmentSize; // target segment size
+	size_t segmentChunks; // number of chunks held by each segment
+	bool zeroedMem; // allocate recovery memory from anonymous mappings, which are zero filled, and re-zero them by discarding their pages, rather than clearing on the first batch
+	bool memIsZero; // recovery memory is known to be all zeroes
+	bool reallocProcessingMem();
+	bool growProcessingMem(unsigned oldOutputs, unsigned numOutputs);
+	bool discardProcessingMem();
 	
-	void calcChunkSize();
+	bool calcChunkSize();
 	
-	MessageThread transferThread;
+	// prepare/finish threads; each transfer is handed to the next thread in turn
+	std::vector<std::unique_ptr<MessageThread>> transferThreads;
+	unsigned nextTransferThread;
+	void send_transfer(void* data);
+	void send_transfer(void* data, const void* affinity);
+	void release_prepare(unsigned inBuf, unsigned count);
 	
 	void set_coeffs(PAR2ProcCPUStaging& area, unsigned idx, uint16_t inputNum);
 	void set_coeffs(PAR2ProcCPUStaging& area, unsigned idx, const uint16_t* inputCoeffs);
+	void classify_coeffs(PAR2ProcCPUStaging& area, unsigned numInputs);
 	void run_kernel(unsigned inBuf, unsigned numInputs) override;
 	
-	template<typename T> FUTURE_RETURN_T _addInput(const void* buffer, size_t size, T inputNumOrCoeffs, bool flush  IF_LIBUV(, const PAR2ProcPlainCb& cb));
+	template<typename T> FUTURE_RETURN_T _addInput(const void* buffer, size_t size, T inputNumOrCoeffs, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad  IF_LIBUV(, const PAR2ProcPlainCb& cb));
 	
 #ifdef USE_LIBUV
 	void _notifySent(void* _req) override;
@@ -59,6 +176,50 @@ private:
 	static void transfer_slice(ThreadMessageQueue<void*>& q);
 	static void compute_worker(ThreadMessageQueue<void*>& q);
 	
+	// tile plan, shared across all staging areas; rebuilt on the next batch if cleared
+	std::vector<PAR2ProcCPUTile> tiles;
+	std::vector<uint32_t> tileOwnerEnd; // end of each worker's range of tiles
+	// sequence number of the last batch which completed each tile; as batches accumulate into the same memory, a tile can only be processed once the previous batch has finished with it
+	std::vector<std::atomic<uint32_t>> tileBatch;
+	uint32_t batchSeq;
+	std::mutex kernelMutex; // batches may be started from any transfer thread; this keeps them (and the first batch of a pass) in order
+	void calcTiles();
+	void plan_tiles(size_t chunkStart, size_t chunks, unsigned firstWorker, unsigned workers);
+	void plan_tiles_2d(size_t chunkStart, size_t chunks, unsigned firstWorker, unsigned workers);
+	PAR2ProcCPUTiling tilingMode;
+	bool outputTiled; // the current plan uses 2D tiling
+	
+	std::vector<PAR2ProcCPUNumaNode> numaNodes; // empty if NUMA mode is disabled
+	std::vector<std::atomic<uint64_t>> numaStatBytes, numaStatTime; // per node; time is the sum of worker busy time in nanoseconds
+	void assign_numa_workers();
+	void bind_numa_memory();
+	void bind_numa_staging(PAR2ProcCPUStaging& area);
+	
+	std::vector<PAR2ProcCPUCoreClass> coreClasses; // empty if hybrid mode is disabled
+	std::vector<std::atomic<uint64_t>> classStatBytes, classStatTime; // as with numaStatBytes/Time
+	void assign_class_workers();
+	bool update_class_weights();
+	void weight_tile_owners();
+	
+	bool workStealing;
+	bool lookaheadPrefetch;
+	bool inPlaceInput;
+	void release_inplace(PAR2ProcCPUStaging& area, unsigned numInputs);
+	std::atomic<unsigned> statSteals;
+	std::atomic<unsigned> statLookaheads;
+	std::atomic<uint64_t> statIdleTime; // in nanoseconds
+	
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	// recovery packet MD5 contexts, one per group of outputs; empty if output hashing is disabled
+	// each context persists across passes, and is primed with the packet header, so only the recovery data needs to be fed in
+	std::vector<MD5Multi*> outputHashers;
+	unsigned outputHashGroup; // number of outputs in each group
+	uint8_t outputHashSetId[16];
+	void freeOutputHashers();
+	void createOutputHashers();
+	void resetOutputHasher(unsigned group);
+#endif
+	
 #ifdef DEBUG_STAT_THREAD_EMPTY
 	std::atomic<bool> endSignalled;
 	std::atomic<unsigned> statWorkerIdleEvents;
@@ -78,24 +239,46 @@ public:
 	bool setCurrentSliceSize(size_t newSliceSize) override;
 	
 	bool setRecoverySlices(unsigned numSlices, const uint16_t* exponents = NULL) override;
+	// append recovery slices to those already set, retaining the recovery data computed so far; the new slices start zeroed, so inputs already processed need to be added again (with zero coefficients for the existing slices) to complete them
+	// can only be used whilst no inputs are pending or being processed; returns false if this isn't the case, or memory can't be allocated
+	bool addRecoverySlices(unsigned numSlices, const uint16_t* exponents = NULL) override;
 	void freeProcessingMem() override;
 	
 	inline void _setAreaActive(int area, bool active) {
 		staging[area].setIsActive(active);
+		IF_NOT_LIBUV(if(!active) _areaReleased());
 	}
 	
 	void setNumThreads(int threads);
 	inline int getNumThreads() const {
 		return numThreads;
 	}
+	// number of threads used for preparing inputs and finishing outputs; 1 = single transfer thread, <1 = automatic
+	void setTransferThreads(int threads);
+	inline int getTransferThreads() const {
+		return transferThreads.size();
+	}
 	inline const char* getMethodName() const {
 		return gf->info().name;
 	}
 	inline size_t getChunkLen() const {
 		return chunkLen;
 	}
+	// default tiling size for a method, reduced if the detected L2 cache is small
+	static size_t defaultChunkLen(const Galois16MethodInfo& info);
 	inline unsigned getStagingAreas() const {
-		return staging.size();
+		return stagingAreasUsed;
+	}
+	// limit on the memory used by staging areas; if set, additional areas (beyond the number specified at construction) are used whilst processing is behind, allowing bursts of input to be absorbed
+	inline void setStagingMemoryLimit(size_t bytes) {
+		stagingMemLimit = bytes;
+		stagingAreasCap = 0;
+	}
+	inline size_t getStagingMemoryLimit() const {
+		return stagingMemLimit;
+	}
+	inline unsigned getMaxStagingAreas() const {
+		return maxStagingAreas();
 	}
 	inline unsigned getAlignment() const {
 		return alignment;
@@ -103,17 +286,135 @@ public:
 	inline unsigned getStride() const {
 		return stride;
 	}
+	
+	// if disabled, each worker only processes the tiles initially assigned to it (i.e. static distribution)
+	inline void setWorkStealing(bool enable) {
+		workStealing = enable;
+		tiles.clear();
+	}
+	inline bool getWorkStealing() const {
+		return workStealing;
+	}
+	// when a worker reaches its last tile of a batch, and its request for the next batch is already queued, prefetch the start of its next tile during the final round
+	inline void setLookaheadPrefetch(bool enable) {
+		lookaheadPrefetch = enable;
+	}
+	inline bool getLookaheadPrefetch() const {
+		return lookaheadPrefetch;
+	}
+	// 2D tiling splits the slice by outputs as well as chunks, so that small slices with many outputs can be spread across workers without shrinking chunks; each worker gets a run of output ranges over the same chunk, keeping that chunk's inputs cached
+	inline void setTilingMode(PAR2ProcCPUTiling mode) {
+		tilingMode = mode;
+		tiles.clear();
+	}
+	inline PAR2ProcCPUTiling getTilingMode() const {
+		return tilingMode;
+	}
+	// whether the current plan uses 2D tiling; only valid once processing has started
+	inline bool isOutputTiled() const {
+		return outputTiled;
+	}
+	// read inputs directly from the buffers passed to addInput, instead of copying them into the staging area; only the checksum is computed during prepare
+	// as the buffer is read during processing, an add isn't signalled as complete until its batch has been processed, so callers need enough buffers to fill a batch
+	// returns false if the method doesn't support it; must not be changed whilst inputs are pending
+	bool setInPlaceInput(bool enable);
+	inline bool getInPlaceInput() const {
+		return inPlaceInput;
+	}
+	// number of tiles taken from another worker's queue
+	inline unsigned getStealCount() const {
+		return statSteals.load(std::memory_order_relaxed);
+	}
+	// number of times a worker prefetched from its next batch
+	inline unsigned getLookaheadCount() const {
+		return statLookaheads.load(std::memory_order_relaxed);
+	}
+	// total time (in seconds) workers spent waiting for other workers to finish a batch
+	inline double getWorkerIdleTime() const {
+		return (double)statIdleTime.load(std::memory_order_relaxed) / 1000000000.0;
+	}
+	inline void resetStats() {
+		statSteals.store(0, std::memory_order_relaxed);
+		statLookaheads.store(0, std::memory_order_relaxed);
+		statIdleTime.store(0, std::memory_order_relaxed);
+		for(auto& stat : numaStatBytes) stat.store(0, std::memory_order_relaxed);
+		for(auto& stat : numaStatTime) stat.store(0, std::memory_order_relaxed);
+		for(auto& stat : classStatBytes) stat.store(0, std::memory_order_relaxed);
+		for(auto& stat : classStatTime) stat.store(0, std::memory_order_relaxed);
+	}
+	
+	// NUMA mode splits the slice across nodes, placing each node's recovery + staging memory on that node, and pins workers to their node
+	// if fakeNodes > 0, available CPUs are split into that many nodes instead of using the detected topology (no memory binding is performed)
+	// returns false if only a single node exists, in which case NUMA mode is disabled
+	bool setNumaMode(bool enable, unsigned fakeNodes = 0);
+	inline bool getNumaMode() const {
+		return !numaNodes.empty();
+	}
+	std::vector<PAR2ProcCPUNumaStat> getNumaStats() const;
+	
+	// hybrid mode pins workers to core classes (e.g. P/E-cores), and gives each worker a share of the slice proportional to its class' measured throughput; NUMA mode and hybrid mode are mutually exclusive
+	// if fakeClasses > 0, available CPUs are split into that many classes instead of using the detected topology
+	// returns false if the CPU isn't hybrid, in which case hybrid mode is disabled
+	bool setHybridMode(bool enable, unsigned fakeClasses = 0);
+	inline bool getHybridMode() const {
+		return !coreClasses.empty();
+	}
+	// override the relative throughput of each class; this will be replaced by measured throughput once enough has been processed
+	void setCoreClassWeights(const std::vector<double>& weights);
+	std::vector<PAR2ProcCPUCoreClassStat> getCoreClassStats() const;
 	inline size_t getAllocSliceSize() const {
 		return alignedSliceSize;
 	}
 	
+	// page size used for recovery memory; returns false if reallocating existing memory fails
+	bool setPageMode(PAR2ProcCPUPageMode mode);
+	inline PAR2ProcCPUPageMode getPageMode() const {
+		return pageMode;
+	}
+	// target size of each recovery memory segment; a segment holds at least one chunk's region
+	bool setSegmentSize(size_t size);
+	// if enabled, recovery memory comes zeroed from the OS (where supported), so the first batch of each pass doesn't need to clear it
+	bool setZeroedMemory(bool enable);
+	inline bool getZeroedMemory() const {
+		return zeroedMem;
+	}
+	inline unsigned getRecoverySegments() const {
+		return memSegments.size();
+	}
+	// true if any recovery memory is backed by huge pages
+	inline bool getUsingHugePages() const {
+		for(const auto& seg : memSegments)
+			if(seg.huge) return true;
+		return false;
+	}
+	
 	PAR2ProcBackendAddResult canAdd() const override;
 	FUTURE_RETURN_T addInput(const void* buffer, size_t size, uint16_t inputNum, bool flush  IF_LIBUV(, const PAR2ProcPlainCb& cb)) override;
 	FUTURE_RETURN_T addInput(const void* buffer, size_t size, const uint16_t* coeffs, bool flush  IF_LIBUV(, const PAR2ProcPlainCb& cb)) override;
+	// hashing is done by the prepare thread, interleaved with the prepare, so that the input only needs to be read from memory once
+	FUTURE_RETURN_T addInputHashed(const void* buffer, size_t size, uint16_t inputNum, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad  IF_LIBUV(, const PAR2ProcPlainCb& cb)) override;
+	FUTURE_RETURN_T addInputHashed(const void* buffer, size_t size, const uint16_t* coeffs, bool flush, IHasherInput* hasher, void* md5crc, uint64_t zeroPad  IF_LIBUV(, const PAR2ProcPlainCb& cb)) override;
 	void dummyInput(uint16_t inputNum, bool flush = false) override;
 	bool fillInput(const void* buffer) override;
 	void flush() override;
 	FUTURE_RETURN_BOOL_T getOutput(unsigned index, void* output  IF_LIBUV(, const PAR2ProcOutputCb& cb)) override;
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	// compute the MD5 of each recovery packet whilst finishing outputs, so that outputs don't need to be read again to hash them
+	// outputs are split into groups of groupSize (the last group may be smaller), which must be fetched with getOutputGroup instead of getOutput; 0 disables hashing
+	// setId is the 16 byte recovery set ID, used to build each packet's header
+	void setOutputHashing(unsigned groupSize, const void* setId);
+	inline unsigned getOutputHashing() const {
+		return outputHashGroup;
+	}
+	inline unsigned numOutputGroups() const {
+		return outputHashers.size();
+	}
+	// fetch all outputs in a group, adding them to the group's packet MD5s; outputs[i] receives output number group*groupSize+i
+	// a group must be fetched exactly once per pass, in pass order, as fetching consumes the checksum held in recovery memory
+	FUTURE_RETURN_BOOL_T getOutputGroup(unsigned group, void* const* outputs  IF_LIBUV(, const PAR2ProcOutputCb& cb));
+	// once all passes have been fetched, write the packet MD5 (16 bytes each) of each output in the group to md5s; this resets the group's MD5s for the next recovery set
+	void getOutputGroupMD5(unsigned group, void* md5s);
+#endif
 	
 	void processing_finished() override;
 #ifndef USE_LIBUV
@@ -136,6 +437,9 @@ public:
 	static inline std::vector<Galois16Methods> availableMethods() {
 		return Galois16Mul::availableMethods(true);
 	}
+	// micro-benchmark the available methods, with a few input grouping/chunk length pairs, against the specified workload, returning the fastest combination
+	// if cacheFile is specified, a previous result for this CPU model and (approximate) workload is returned from it if present, otherwise the result is appended to it
+	static PAR2ProcCPUTuning autotune(size_t sliceSize, unsigned numInputs, unsigned numOutputs, const char* cacheFile = nullptr);
 	
 #ifdef DEBUG_STAT_THREAD_EMPTY
 	inline unsigned getWorkerIdleCount() const {
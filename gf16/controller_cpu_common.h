@@ -0,0 +1,15 @@
+#ifndef __GF16_CONTROLLER_CPU_COMMON
+#define __GF16_CONTROLLER_CPU_COMMON
+
+// helpers shared by the CPU controller's translation units
+
+#ifndef MIN
+# define MIN(a, b) ((a)<(b) ? (a) : (b))
+#endif
+#ifndef MAX
+# define MAX(a, b) ((a)>(b) ? (a) : (b))
+#endif
+#define CEIL_DIV(a, b) (((a) + (b)-1) / (b))
+#define ROUND_DIV(a, b) (((a) + ((b)>>1)) / (b))
+
+#endif // defined(__GF16_CONTROLLER_CPU_COMMON)
@@ -0,0 +1,246 @@
+#include "controller_cpu.h"
+#include "controller_cpu_common.h"
+#include "gfmat_coeff.h"
+#include "../src/platform.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <functional>
+
+#if defined(_WINDOWS) || defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# define WIN32_LEAN_AND_MEAN
+# include <Windows.h>
+#endif
+
+// the benchmark workload is limited to this, so that tuning stays quick regardless of the actual workload; this is enough to exercise tiling, and beyond a handful of outputs, the input preparation cost is negligible
+static const size_t TUNE_MAX_SLICE = 512*1024;
+static const unsigned TUNE_MAX_OUTPUTS = 8;
+static const unsigned TUNE_MAX_INPUTS = 64;
+// minimum duration of each trial, in seconds
+static const double TUNE_MIN_TIME = 0.02;
+// the fastest few methods (at their default parameters) are then tried with other input grouping/chunk length pairs
+static const unsigned TUNE_REFINE_METHODS = 3;
+
+// round up to a power of 2; workloads are bucketed this way when caching results
+static size_t tune_bucket(size_t v) {
+	size_t b = 1;
+	while(b < v) b <<= 1;
+	return b;
+}
+
+// run the computation the same way the compute workers do (on a single thread), returning the throughput in multiplied bytes/sec
+static double tune_trial(const Galois16Mul& gf, size_t sliceSize, unsigned inputGrouping, size_t chunkLen, unsigned numOutputs) {
+	const Galois16MethodInfo& info = gf.info();
+	size_t alignedSliceSize = gf.alignToStride(sliceSize) + info.stride; // extra stride for checksum
+	// split the slice evenly, as PAR2ProcCPU does
+	size_t numChunks = ROUND_DIV(alignedSliceSize, chunkLen);
+	if(numChunks < 1) numChunks = 1;
+	chunkLen = gf.alignToStride(CEIL_DIV(alignedSliceSize, numChunks));
+	numChunks = CEIL_DIV(alignedSliceSize, chunkLen);
+	
+	uint8_t* src;
+	void *packed, *dst;
+	ALIGN_ALLOC(src, sliceSize, info.alignment);
+	ALIGN_ALLOC(packed, inputGrouping * alignedSliceSize, info.alignment);
+	ALIGN_ALLOC(dst, numOutputs * alignedSliceSize, info.alignment);
+	if(!src || !packed || !dst) {
+		if(src) ALIGN_FREE(src);
+		if(packed) ALIGN_FREE(packed);
+		if(dst) ALIGN_FREE(dst);
+		return 0;
+	}
+	for(size_t i=0; i<sliceSize; i++)
+		src[i] = (uint8_t)(i*7 + (i>>8));
+	memset(dst, 0, numOutputs * alignedSliceSize);
+	std::vector<uint16_t> coeffs(inputGrouping * numOutputs);
+	uint16_t coeff = 1;
+	for(auto& c : coeffs) {
+		coeff = coeff * 0x9E37 + 0x79B9;
+		c = coeff ? coeff : 1;
+	}
+	void* mutScratch = gf.mutScratch_alloc();
+	
+	uint64_t iterations = 0;
+	double elapsed = 0;
+	auto start = std::chrono::steady_clock::now();
+	do {
+		for(unsigned input=0; input<inputGrouping; input++)
+			gf.prepare_packed_cksum(packed, src, sliceSize, alignedSliceSize - info.stride, inputGrouping, input, chunkLen);
+		for(size_t chunk=0; chunk<numChunks; chunk++) {
+			size_t sliceOffset = chunk*chunkLen;
+			size_t procSize = MIN(alignedSliceSize-sliceOffset, chunkLen);
+			const char* srcPtr = static_cast<const char*>(packed) + sliceOffset*inputGrouping;
+			char* dstBase = static_cast<char*>(dst) + sliceOffset*numOutputs;
+			for(unsigned out=0; out<numOutputs; out++)
+				gf.mul_add_multi_packed(inputGrouping, inputGrouping, dstBase + out*procSize, srcPtr, procSize, coeffs.data() + out*inputGrouping, mutScratch);
+		}
+		iterations++;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while(elapsed < TUNE_MIN_TIME);
+	
+	gf.mutScratch_free(mutScratch);
+	ALIGN_FREE(src);
+	ALIGN_FREE(packed);
+	ALIGN_FREE(dst);
+	if(elapsed <= 0) return 0;
+	return (double)(iterations * sliceSize * inputGrouping * numOutputs) / elapsed;
+}
+
+static std::vector<std::string> split_tabs(const char* line) {
+	std::vector<std::string> fields(1);
+	for(; *line && *line != '\n' && *line != '\r'; line++) {
+		if(*line == '\t') fields.emplace_back();
+		else fields.back() += *line;
+	}
+	return fields;
+}
+
+// if the line is a cache entry, returns its key (CPU model and workload), otherwise an empty string
+static std::string tune_cache_key(const std::vector<std::string>& fields) {
+	if(fields.size() != 7) return std::string();
+	return fields[0] + '\t' + fields[1] + '\t' + fields[2] + '\t' + fields[3];
+}
+
+// the updated cache is written to a temporary file which then replaces it, so that a concurrent reader never sees a partial file
+// if two processes update it at the same time, one's entry is lost, which just means that workload gets tuned again
+static void tune_cache_store(const char* cacheFile, const std::string& key, const std::string& entry) {
+	std::string contents;
+	FILE* fp = fopen(cacheFile, "r");
+	if(fp) {
+		char line[1024];
+		while(fgets(line, sizeof(line), fp)) {
+			// drop stale entries for this workload, so that the file doesn't keep growing
+			if(tune_cache_key(split_tabs(line)) == key) continue;
+			contents += line;
+			if(contents.back() != '\n') contents += '\n';
+		}
+		fclose(fp);
+	}
+	contents += entry;
+	
+	size_t unique = std::hash<std::thread::id>()(std::this_thread::get_id()) ^ (size_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	std::string tmpFile = std::string(cacheFile) + ".tmp" + std::to_string(unique);
+	fp = fopen(tmpFile.c_str(), "w");
+	if(!fp) return;
+	bool written = fwrite(contents.data(), 1, contents.size(), fp) == contents.size();
+	if(fclose(fp) != 0) written = false;
+#if defined(_WINDOWS) || defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+	// rename won't replace an existing file on Windows
+	if(!written || !MoveFileExA(tmpFile.c_str(), cacheFile, MOVEFILE_REPLACE_EXISTING))
+#else
+	if(!written || rename(tmpFile.c_str(), cacheFile) != 0)
+#endif
+		remove(tmpFile.c_str());
+}
+
+PAR2ProcCPUTuning PAR2ProcCPU::autotune(size_t sliceSize, unsigned numInputs, unsigned numOutputs, const char* cacheFile) {
+	gfmat_init(); // checksumming in the trials needs the log tables, which may not be set up yet if no PAR2Proc has been created
+	sliceSize = MIN(sliceSize, TUNE_MAX_SLICE);
+	if(sliceSize < 2) sliceSize = 2;
+	sliceSize &= ~(size_t)1;
+	numInputs = MIN(numInputs, TUNE_MAX_INPUTS);
+	if(numInputs < 1) numInputs = 1;
+	numOutputs = MIN(numOutputs, TUNE_MAX_OUTPUTS);
+	if(numOutputs < 1) numOutputs = 1;
+	
+	auto methods = availableMethods();
+	PAR2ProcCPUTuning best{Galois16Mul::default_method(), 0, 0};
+	
+	// the cache is keyed on the CPU model and the bucketed workload
+	std::string key = cputopo_cpu_model();
+	if(key.empty()) key = "unknown";
+	key += '\t' + std::to_string(tune_bucket(sliceSize)) + '\t' + std::to_string(tune_bucket(numInputs)) + '\t' + std::to_string(tune_bucket(numOutputs));
+	if(cacheFile) {
+		FILE* fp = fopen(cacheFile, "r");
+		if(fp) {
+			bool found = false;
+			char line[1024];
+			while(fgets(line, sizeof(line), fp)) {
+				auto fields = split_tabs(line);
+				if(tune_cache_key(fields) != key) continue;
+				// later entries override earlier ones; ignore methods unavailable in this build
+				for(auto method : methods) {
+					if(fields[4] != Galois16Mul::methodToText(method)) continue;
+					unsigned grouping = (unsigned)strtoul(fields[5].c_str(), nullptr, 10);
+					size_t chunkLen = (size_t)strtoull(fields[6].c_str(), nullptr, 10);
+					if(grouping > 0 && grouping <= 32768 && chunkLen > 0) {
+						best = {method, MIN(grouping, numInputs), chunkLen};
+						found = true;
+					}
+					break;
+				}
+			}
+			fclose(fp);
+			if(found) return best;
+		}
+	}
+	
+	struct Candidate {
+		Galois16Methods method;
+		unsigned grouping;
+		size_t chunkLen;
+		double speed;
+	};
+	// `halves` scales the default grouping, in units of half the default (i.e. 1 = half, 2 = default, 4 = double)
+	auto makeGrouping = [numInputs](const Galois16MethodInfo& info, unsigned halves) -> unsigned {
+		// mirrors the default batch size selection (target 12, in multiples of the method's preference)
+		unsigned multiple = info.idealInputMultiple ? info.idealInputMultiple : 1;
+		unsigned grouping = ROUND_DIV(12, multiple);
+		if(grouping < 1) grouping = 1;
+		grouping = ROUND_DIV(grouping * halves, 2);
+		if(grouping < 1) grouping = 1;
+		grouping *= multiple;
+		return MIN(grouping, numInputs);
+	};
+	
+	// first pass: every method at its defaults
+	std::vector<Candidate> results;
+	for(auto method : methods) {
+		Galois16Mul gf(method);
+		const Galois16MethodInfo& info = gf.info();
+		Candidate c{method, makeGrouping(info, 2), defaultChunkLen(info), 0};
+		c.speed = tune_trial(gf, sliceSize, c.grouping, c.chunkLen, numOutputs);
+		results.push_back(c);
+	}
+	std::sort(results.begin(), results.end(), [](const Candidate& a, const Candidate& b) {
+		return a.speed > b.speed;
+	});
+	if(results.empty() || results[0].speed <= 0) return best;
+	
+	// second pass: vary grouping/chunk length on the leaders
+	Candidate winner = results[0];
+	for(unsigned i=0; i<TUNE_REFINE_METHODS && i<results.size(); i++) {
+		Galois16Mul gf(results[i].method);
+		const Galois16MethodInfo& info = gf.info();
+		size_t chunk = defaultChunkLen(info);
+		// half, default and double the grouping, each with half, default and double the chunk length
+		const std::pair<unsigned, size_t> variants[] = {
+			{1, chunk/2}, {1, chunk}, {1, chunk*2},
+			{2, chunk/2}, {2, chunk*2},
+			{4, chunk/2}, {4, chunk}, {4, chunk*2}
+		};
+		std::vector<std::pair<unsigned, size_t>> tried{{results[i].grouping, results[i].chunkLen}};
+		for(const auto& variant : variants) {
+			Candidate c{results[i].method, makeGrouping(info, variant.first), variant.second, 0};
+			if(c.chunkLen < info.stride) continue;
+			// halving/doubling may be limited by the method's preferred multiple or the number of inputs, so skip combinations already tried
+			std::pair<unsigned, size_t> combo{c.grouping, c.chunkLen};
+			if(std::find(tried.begin(), tried.end(), combo) != tried.end()) continue;
+			tried.push_back(combo);
+			c.speed = tune_trial(gf, sliceSize, c.grouping, c.chunkLen, numOutputs);
+			if(c.speed > winner.speed) winner = c;
+		}
+	}
+	best = {winner.method, winner.grouping, winner.chunkLen};
+	
+	if(cacheFile)
+		tune_cache_store(cacheFile, key, key + '\t' + Galois16Mul::methodToText(best.method) + '\t' + std::to_string(best.inputGrouping) + '\t' + std::to_string(best.chunkLen) + '\n');
+	return best;
+}
@@ -230,6 +230,7 @@ public:
 	
 	inline void _setAreaActive(int area, bool active) {
 		staging[area].setIsActive(active);
+		IF_NOT_LIBUV(if(!active) _areaReleased());
 	}
 	
 #ifndef USE_LIBUV
@@ -0,0 +1,53 @@
+#include "controller_repair.h"
+
+#ifdef PARPAR_INVERT_SUPPORT
+#include "gfmat_inv.h"
+
+bool PAR2Repair::init(const std::vector<bool>& inputValid, const std::vector<uint16_t>& availableRecovery, int numThreads, const std::function<void(uint16_t, uint16_t)>& progressCb) {
+	missing.clear();
+	recovery.clear();
+	coeffs.clear();
+	inputCol.resize(inputValid.size());
+	groupFirst = groupCount = 0;
+	
+	unsigned validCount = 0;
+	for(unsigned input=0; input<inputValid.size(); input++) {
+		if(inputValid[input])
+			inputCol[input] = validCount++;
+		else {
+			inputCol[input] = -1;
+			missing.push_back(input);
+		}
+	}
+	if(missing.empty()) return true; // nothing to rebuild
+	if(availableRecovery.size() < missing.size()) return false;
+	
+	// the matrix is only needed until the coefficients are extracted
+	recovery = availableRecovery;
+	Galois16RecMatrix mat;
+	if(numThreads > 0) mat.setNumThreads(numThreads);
+	if(!mat.Compute(inputValid, validCount, recovery, progressCb)) {
+		recovery.clear();
+		return false;
+	}
+	
+	// the matrix is laid out by missing input, with columns for the surviving inputs, followed by the recovery slices used; transpose it, so that an input's coefficients are contiguous
+	unsigned numMissing = missing.size();
+	unsigned numCols = inputValid.size();
+	coeffs.resize((size_t)numCols * numMissing);
+	for(unsigned out=0; out<numMissing; out++)
+		for(unsigned col=0; col<numCols; col++)
+			coeffs[(size_t)col * numMissing + out] = mat.GetFactor(col, out);
+	return true;
+}
+
+bool PAR2Repair::setOutputGroup(PAR2Proc& proc, unsigned first, unsigned count) {
+	if(count < 1 || first + count > missing.size()) return false;
+	// the backends only see custom coefficients, so exponents aren't needed
+	if(!proc.setRecoverySlices(count)) return false;
+	groupFirst = first;
+	groupCount = count;
+	return true;
+}
+
+#endif
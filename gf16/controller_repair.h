@@ -0,0 +1,66 @@
+#ifndef __GF16_CONTROLLER_REPAIR
+#define __GF16_CONTROLLER_REPAIR
+
+#include "controller.h"
+#include <vector>
+#include <functional>
+
+#ifdef PARPAR_INVERT_SUPPORT
+
+// rebuilds missing input slices via PAR2Proc: each missing input is computed as a "recovery slice" of the surviving inputs and the recovery slices used, with coefficients taken from the inverted recovery matrix
+// the inversion is done up front by init(); inputs are then streamed through PAR2Proc's custom coefficient interface, the same way as recovery is created:
+// - missing inputs are rebuilt in groups (setOutputGroup), so that recovery memory is bounded; all surviving inputs and used recovery slices need to be sent for each group
+// - each group can be computed in multiple passes over parts of the slice, via PAR2Proc::setCurrentSliceSize
+// inputs are identified by their index in the recovery set (i.e. the order of input slices across files); backends must accept custom coefficients (for OpenCL, this requires a non-log method)
+class PAR2Repair {
+	std::vector<uint16_t> missing; // index of each missing input, in rebuilt (output) order
+	std::vector<uint16_t> recovery; // exponents of the recovery slices used, in matrix column order (ascending, other than any replacing a slice which hit the PAR2 flaw)
+	std::vector<int> inputCol; // coefficient column of each input; -1 if missing
+	std::vector<uint16_t> coeffs; // for each column (surviving inputs, then recovery slices used), the coefficient for each missing input
+	unsigned groupFirst, groupCount;
+	
+	// disable copy constructor
+	PAR2Repair(const PAR2Repair&);
+	PAR2Repair& operator=(const PAR2Repair&);
+
+public:
+	PAR2Repair() : groupFirst(0), groupCount(0) {}
+	
+	// invert the recovery matrix, given which inputs survived and the exponents of the available recovery slices
+	// returns false if there's insufficient recovery to rebuild all missing inputs; unneeded recovery slices aren't used (see getRecoveryExponents)
+	// numThreads <= 0 uses all available threads
+	bool init(const std::vector<bool>& inputValid, const std::vector<uint16_t>& availableRecovery, int numThreads = 0, const std::function<void(uint16_t, uint16_t)>& progressCb = nullptr);
+	inline unsigned getNumInputs() const {
+		return inputCol.size();
+	}
+	inline const std::vector<uint16_t>& getMissingInputs() const {
+		return missing;
+	}
+	inline const std::vector<uint16_t>& getRecoveryExponents() const {
+		return recovery;
+	}
+	
+	// select the missing inputs (by position in getMissingInputs) to rebuild in the next pass(es), setting up the recovery slices for them
+	// PAR2Proc output `i` then corresponds to missing input `first+i`
+	bool setOutputGroup(PAR2Proc& proc, unsigned first, unsigned count);
+	inline unsigned getOutputGroupFirst() const {
+		return groupFirst;
+	}
+	inline unsigned getOutputGroupCount() const {
+		return groupCount;
+	}
+	
+	// coefficients to send a surviving input with, for the current group; nullptr if the input is missing
+	inline const uint16_t* inputCoeffs(uint16_t input) const {
+		if(input >= inputCol.size() || inputCol[input] < 0) return nullptr;
+		return coeffs.data() + inputCol[input] * missing.size() + groupFirst;
+	}
+	// coefficients to send a recovery slice with, for the current group; `rec` is the position in getRecoveryExponents
+	inline const uint16_t* recoveryCoeffs(unsigned rec) const {
+		return coeffs.data() + (inputCol.size() - missing.size() + rec) * missing.size() + groupFirst;
+	}
+};
+
+#endif
+
+#endif // defined(__GF16_CONTROLLER_REPAIR)
@@ -0,0 +1,399 @@
+#include "cpu_topology.h"
+#include "../src/cpuid.h"
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_WINDOWS) || defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# define WIN32_LEAN_AND_MEAN
+# include <Windows.h>
+#elif defined(__linux) || defined(__linux__)
+# include <sched.h>
+# include <unistd.h>
+# include <sys/syscall.h>
+# define CPUTOPO_LINUX 1
+#endif
+
+// CPUs that this process is permitted to run on
+static std::vector<int> available_cpus() {
+	std::vector<int> cpus;
+#if defined(_WINDOWS) || defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+	DWORD_PTR procMask, sysMask;
+	if(GetProcessAffinityMask(GetCurrentProcess(), &procMask, &sysMask)) {
+		for(int cpu=0; cpu<(int)sizeof(DWORD_PTR)*8; cpu++)
+			if(procMask & ((DWORD_PTR)1 << cpu)) cpus.push_back(cpu);
+	}
+#elif defined(CPUTOPO_LINUX) && defined(CPU_ISSET)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for(int cpu=0; cpu<CPU_SETSIZE; cpu++)
+			if(CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+	}
+#endif
+	if(cpus.empty()) {
+		int numCpus = (int)std::thread::hardware_concurrency();
+		if(numCpus < 1) numCpus = 1;
+		for(int cpu=0; cpu<numCpus; cpu++)
+			cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+#ifdef CPUTOPO_LINUX
+// parse a Linux CPU/node list, e.g. "0-3,8,10-11"
+static std::vector<int> read_id_list(const char* path) {
+	std::vector<int> ids;
+	FILE* fp = fopen(path, "r");
+	if(!fp) return ids;
+	int first, last;
+	while(fscanf(fp, "%d", &first) == 1) {
+		last = first;
+		int c = fgetc(fp);
+		if(c == '-') {
+			if(fscanf(fp, "%d", &last) != 1) break;
+			c = fgetc(fp);
+		}
+		for(int id=first; id<=last; id++)
+			ids.push_back(id);
+		if(c != ',') break;
+	}
+	fclose(fp);
+	return ids;
+}
+#endif
+
+#ifdef CPUTOPO_LINUX
+static bool read_cache_sysfs(CpuCacheInfo& info, int cpu) {
+	char path[96];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+	unsigned threadsPerCore = (unsigned)read_id_list(path).size();
+	if(threadsPerCore < 1) threadsPerCore = 1;
+	
+	bool found = false;
+	for(int index=0; ; index++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+		FILE* fp = fopen(path, "r");
+		if(!fp) break;
+		int level = 0;
+		if(fscanf(fp, "%d", &level) != 1) level = 0;
+		fclose(fp);
+		
+		char type[16] = {};
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/type", cpu, index);
+		fp = fopen(path, "r");
+		if(!fp) continue;
+		if(fscanf(fp, "%15s", type) != 1) type[0] = 0;
+		fclose(fp);
+		if(!strcmp(type, "Instruction")) continue;
+		
+		// size is given in KB, e.g. "2048K"
+		unsigned long size = 0;
+		char unit = 'K';
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/size", cpu, index);
+		fp = fopen(path, "r");
+		if(!fp) continue;
+		if(fscanf(fp, "%lu%c", &size, &unit) < 1) size = 0;
+		fclose(fp);
+		if(unit == 'K') size *= 1024;
+		else if(unit == 'M') size *= 1048576;
+		
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+		unsigned cores = (unsigned)read_id_list(path).size() / threadsPerCore;
+		if(cores < 1) cores = 1;
+		
+		if(level == 1) info.l1d = size;
+		else if(level == 2) {
+			info.l2 = size;
+			info.l2Cores = cores;
+		} else if(level == 3) {
+			info.l3 = size;
+			info.l3Cores = cores;
+		}
+		found = true;
+	}
+	return found;
+}
+#endif
+
+#ifdef PLATFORM_X86
+// read the deterministic cache parameters; Intel uses leaf 4, AMD provides the same format in leaf 0x8000001D
+static void read_cache_cpuid(CpuCacheInfo& info) {
+	int cpuInfo[4];
+	_cpuid(cpuInfo, 0);
+	int maxLeaf = cpuInfo[0];
+	bool isAMD = cpuInfo[1] == 0x68747541 || cpuInfo[1] == 0x6f677948; // "Auth"enticAMD or "Hygo"nGenuine
+	_cpuid(cpuInfo, 0x80000000);
+	unsigned maxExtLeaf = (unsigned)cpuInfo[0];
+	
+	unsigned cacheLeaf = 0;
+	unsigned threadsPerCore = 1;
+	if(isAMD) {
+		if(maxExtLeaf >= 0x8000001D) {
+			_cpuid(cpuInfo, 0x80000001);
+			if(cpuInfo[2] & (1<<22)) // topology extensions
+				cacheLeaf = 0x8000001D;
+		}
+		if(maxExtLeaf >= 0x8000001E) {
+			_cpuid(cpuInfo, 0x8000001E);
+			threadsPerCore = ((cpuInfo[1] >> 8) & 0xff) + 1;
+		}
+	} else {
+		if(maxLeaf >= 4) cacheLeaf = 4;
+		if(maxLeaf >= 0xB) {
+			_cpuidX(cpuInfo, 0xB, 0);
+			if(((cpuInfo[2] >> 8) & 0xff) == 1) // SMT level
+				threadsPerCore = cpuInfo[1] & 0xffff;
+		}
+	}
+	if(!cacheLeaf) return;
+	if(threadsPerCore < 1) threadsPerCore = 1;
+	
+	for(int index=0; index<16; index++) {
+		_cpuidX(cpuInfo, cacheLeaf, index);
+		int type = cpuInfo[0] & 0x1f;
+		if(type == 0) break; // no more caches
+		if(type == 2) continue; // instruction cache
+		int level = (cpuInfo[0] >> 5) & 7;
+		// this is the maximum number of logical CPUs which can share the cache, which may exceed the actual number
+		unsigned cores = ((((unsigned)cpuInfo[0] >> 14) & 0xfff) + 1) / threadsPerCore;
+		if(cores < 1) cores = 1;
+		size_t ways = (((unsigned)cpuInfo[1] >> 22) & 0x3ff) + 1;
+		size_t partitions = (((unsigned)cpuInfo[1] >> 12) & 0x3ff) + 1;
+		size_t lineSize = ((unsigned)cpuInfo[1] & 0xfff) + 1;
+		size_t sets = (size_t)(unsigned)cpuInfo[2] + 1;
+		size_t size = ways * partitions * lineSize * sets;
+		
+		if(level == 1) info.l1d = size;
+		else if(level == 2) {
+			info.l2 = size;
+			info.l2Cores = cores;
+		} else if(level == 3) {
+			info.l3 = size;
+			info.l3Cores = cores;
+		}
+	}
+}
+#endif
+
+static CpuCacheInfo detect_cache_info() {
+	CpuCacheInfo info{0, 0, 0, 0, 0};
+#ifdef CPUTOPO_LINUX
+	if(read_cache_sysfs(info, available_cpus()[0]))
+		return info;
+#endif
+#ifdef PLATFORM_X86
+	read_cache_cpuid(info);
+#endif
+	return info;
+}
+
+const CpuCacheInfo& cputopo_cache_info() {
+	static const CpuCacheInfo info = detect_cache_info();
+	return info;
+}
+
+std::string cputopo_cpu_model() {
+	std::string model;
+#ifdef PLATFORM_X86
+	int cpuInfo[4];
+	_cpuid(cpuInfo, 0x80000000);
+	if((unsigned)cpuInfo[0] >= 0x80000004) {
+		char brand[49] = {};
+		for(int i=0; i<3; i++) {
+			_cpuid(cpuInfo, 0x80000002+i);
+			memcpy(brand + i*16, cpuInfo, 16);
+		}
+		model = brand;
+	}
+#endif
+#ifdef CPUTOPO_LINUX
+	if(model.empty()) {
+		// other platforms don't have an equivalent of the brand string, so go by the identifying fields in /proc/cpuinfo (ARM has implementer + part, others typically have a model name)
+		FILE* fp = fopen("/proc/cpuinfo", "r");
+		if(fp) {
+			char line[256];
+			while(fgets(line, sizeof(line), fp)) {
+				if(strncmp(line, "model name", 10) && strncmp(line, "CPU implementer", 15) && strncmp(line, "CPU part", 8) && strncmp(line, "uarch", 5))
+					continue;
+				const char* value = strchr(line, ':');
+				if(!value) continue;
+				std::string v(value+1);
+				if(!model.empty() && model.find(v) != std::string::npos) break; // seen this field before = next CPU
+				model += v;
+			}
+			fclose(fp);
+		}
+	}
+#endif
+	// tidy up whitespace
+	std::string ret;
+	for(char c : model) {
+		if(c == '\n' || c == '\t') c = ' ';
+		if(c == ' ' && (ret.empty() || ret.back() == ' ')) continue;
+		ret += c;
+	}
+	while(!ret.empty() && ret.back() == ' ') ret.pop_back();
+	return ret;
+}
+
+std::vector<CpuNumaNode> cputopo_numa_nodes() {
+	std::vector<CpuNumaNode> nodes;
+#ifdef CPUTOPO_LINUX
+	std::vector<int> allowed = available_cpus();
+	std::vector<bool> isAllowed;
+	for(int cpu : allowed) {
+		if((int)isAllowed.size() <= cpu) isAllowed.resize(cpu+1, false);
+		isAllowed[cpu] = true;
+	}
+	
+	char path[64];
+	for(int nodeId : read_id_list("/sys/devices/system/node/online")) {
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodeId);
+		CpuNumaNode node{nodeId, {}};
+		for(int cpu : read_id_list(path))
+			if(cpu < (int)isAllowed.size() && isAllowed[cpu])
+				node.cpus.push_back(cpu);
+		// ignore memory-only nodes, or nodes we can't run on
+		if(!node.cpus.empty())
+			nodes.push_back(node);
+	}
+#endif
+	// TODO: support Windows (GetNumaNodeProcessorMaskEx)
+	return nodes;
+}
+
+#if defined(_WINDOWS) || defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64) || defined(CPUTOPO_LINUX)
+// group CPUs ranked by (negated) performance into classes, fastest first; returns an empty list if they're all the same
+static std::vector<CpuCoreClass> classes_from_ranks(std::vector<std::pair<int, int>>& ranks, const char* name) {
+	std::vector<CpuCoreClass> classes;
+	std::sort(ranks.begin(), ranks.end());
+	for(size_t i=0; i<ranks.size(); i++) {
+		if(i == 0 || ranks[i].first != ranks[i-1].first)
+			classes.push_back({std::string(name) + " " + std::to_string(-ranks[i].first), {}});
+		classes.back().cpus.push_back(ranks[i].second);
+	}
+	if(classes.size() < 2) classes.clear();
+	return classes;
+}
+#endif
+
+std::vector<CpuCoreClass> cputopo_core_classes() {
+	std::vector<CpuCoreClass> classes;
+#if defined(_WINDOWS) || defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+	std::vector<int> allowed = available_cpus();
+	std::vector<bool> isAllowed;
+	for(int cpu : allowed) {
+		if((int)isAllowed.size() <= cpu) isAllowed.resize(cpu+1, false);
+		isAllowed[cpu] = true;
+	}
+	
+	// each core reports an efficiency class, higher being faster; like available_cpus, only the first processor group is handled
+	DWORD len = 0;
+	GetLogicalProcessorInformationEx(RelationProcessorCore, NULL, &len);
+	if(GetLastError() != ERROR_INSUFFICIENT_BUFFER || !len) return classes;
+	std::vector<char> buf(len);
+	if(!GetLogicalProcessorInformationEx(RelationProcessorCore, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buf.data()), &len))
+		return classes;
+	std::vector<std::pair<int, int>> efficiencies; // (-class, cpu)
+	for(DWORD pos = 0; pos < len; ) {
+		auto core = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buf.data() + pos);
+		if(core->Relationship == RelationProcessorCore) {
+			for(WORD g=0; g<core->Processor.GroupCount; g++) {
+				if(core->Processor.GroupMask[g].Group != 0) continue;
+				KAFFINITY mask = core->Processor.GroupMask[g].Mask;
+				for(int cpu=0; cpu<(int)sizeof(KAFFINITY)*8 && cpu<(int)isAllowed.size(); cpu++)
+					if((mask & ((KAFFINITY)1 << cpu)) && isAllowed[cpu])
+						efficiencies.push_back({-(int)core->Processor.EfficiencyClass, cpu});
+			}
+		}
+		pos += core->Size;
+	}
+	classes = classes_from_ranks(efficiencies, "efficiency");
+#elif defined(CPUTOPO_LINUX)
+	std::vector<int> allowed = available_cpus();
+	std::vector<bool> isAllowed;
+	for(int cpu : allowed) {
+		if((int)isAllowed.size() <= cpu) isAllowed.resize(cpu+1, false);
+		isAllowed[cpu] = true;
+	}
+	
+	// Intel hybrid CPUs expose a PMU per core type
+	const char* const pmuTypes[] = {"cpu_core", "cpu_atom"};
+	char path[96];
+	for(const char* type : pmuTypes) {
+		snprintf(path, sizeof(path), "/sys/devices/%s/cpus", type);
+		CpuCoreClass cls{type, {}};
+		for(int cpu : read_id_list(path))
+			if(cpu < (int)isAllowed.size() && isAllowed[cpu])
+				cls.cpus.push_back(cpu);
+		if(!cls.cpus.empty())
+			classes.push_back(cls);
+	}
+	if(classes.size() >= 2) return classes;
+	classes.clear();
+	
+	// otherwise (e.g. ARM big.LITTLE), group by the kernel's relative capacity of each CPU
+	std::vector<std::pair<int, int>> capacities; // (capacity, cpu)
+	for(int cpu : allowed) {
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+		FILE* fp = fopen(path, "r");
+		if(!fp) return classes;
+		int capacity;
+		if(fscanf(fp, "%d", &capacity) != 1) capacity = 0;
+		fclose(fp);
+		capacities.push_back({-capacity, cpu});
+	}
+	classes = classes_from_ranks(capacities, "capacity");
+#endif
+	return classes;
+}
+
+std::vector<CpuCoreClass> cputopo_fake_core_classes(unsigned numClasses) {
+	std::vector<CpuCoreClass> classes;
+	for(auto& node : cputopo_fake_numa_nodes(numClasses))
+		classes.push_back({"fake " + std::to_string(classes.size()), std::move(node.cpus)});
+	return classes;
+}
+
+std::vector<CpuNumaNode> cputopo_fake_numa_nodes(unsigned numNodes) {
+	std::vector<CpuNumaNode> nodes;
+	std::vector<int> cpus = available_cpus();
+	for(unsigned n=0; n<numNodes; n++) {
+		CpuNumaNode node{-1, {}};
+		for(size_t i = (cpus.size()*n)/numNodes; i < (cpus.size()*(n+1))/numNodes; i++)
+			node.cpus.push_back(cpus[i]);
+		if(node.cpus.empty()) // more nodes than CPUs: share CPUs
+			node.cpus.push_back(cpus[n % cpus.size()]);
+		nodes.push_back(node);
+	}
+	return nodes;
+}
+
+bool cputopo_bind_memory(void* ptr, size_t len, int node) {
+#if defined(CPUTOPO_LINUX) && defined(SYS_mbind)
+	if(node < 0) return false;
+	// values from linux/mempolicy.h
+	const int MPOL_PREFERRED_ = 1;
+	const unsigned MPOL_MF_MOVE_ = 1<<1;
+	const unsigned long MASK_BITS = sizeof(unsigned long)*8;
+	unsigned long nodeMask[1024 / (sizeof(unsigned long)*8)] = {};
+	if((unsigned long)node >= sizeof(nodeMask)*8) return false;
+	nodeMask[node / MASK_BITS] = 1UL << (node % MASK_BITS);
+	
+	// mbind operates on whole pages; partially covered pages are left alone
+	uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t start = ((uintptr_t)ptr + pageSize-1) & ~(pageSize-1);
+	uintptr_t end = ((uintptr_t)ptr + len) & ~(pageSize-1);
+	if(end <= start) return false;
+	return syscall(SYS_mbind, start, end-start, MPOL_PREFERRED_, nodeMask, (unsigned long)sizeof(nodeMask)*8, MPOL_MF_MOVE_) == 0;
+#else
+	(void)ptr; (void)len; (void)node;
+	return false;
+#endif
+}
@@ -0,0 +1,51 @@
+#ifndef __GF16_CPU_TOPOLOGY
+#define __GF16_CPU_TOPOLOGY
+
+#include <vector>
+#include <cstddef>
+#include <string>
+
+struct CpuNumaNode {
+	int id; // OS node number; -1 if this isn't a real node (i.e. fake topology), in which case memory isn't bound to it
+	std::vector<int> cpus; // CPUs in this node that we're allowed to run on
+};
+
+// NUMA nodes which have CPUs available to this process; returns an empty list if the topology can't be determined
+std::vector<CpuNumaNode> cputopo_numa_nodes();
+// split the CPUs available to this process into the specified number of nodes; intended for testing NUMA handling on non-NUMA systems
+std::vector<CpuNumaNode> cputopo_fake_numa_nodes(unsigned numNodes);
+
+struct CpuCoreClass {
+	std::string name; // e.g. "cpu_core" or "cpu_atom" for Intel P/E-cores
+	std::vector<int> cpus; // CPUs of this type that we're allowed to run on
+};
+
+// on hybrid CPUs, the available CPUs grouped by core type, highest performance first; returns an empty list on homogeneous CPUs, or if the topology can't be determined
+// uses sysfs on Linux and core efficiency classes on Windows (first processor group only)
+std::vector<CpuCoreClass> cputopo_core_classes();
+// split the CPUs available to this process into the specified number of classes; intended for testing hybrid handling on homogeneous systems
+std::vector<CpuCoreClass> cputopo_fake_core_classes(unsigned numClasses);
+
+struct CpuCacheInfo {
+	// sizes in bytes, 0 if unknown
+	size_t l1d, l2, l3;
+	// number of cores (not hardware threads) sharing each cache, 0 if unknown
+	unsigned l2Cores, l3Cores;
+	
+	// share of L2 available to each core, 0 if unknown
+	inline size_t l2PerCore() const {
+		return l2Cores > 1 ? l2 / l2Cores : l2;
+	}
+};
+// cache sizes of the CPUs we're running on (as seen from the first available CPU); detected on first call
+// uses sysfs on Linux, otherwise CPUID on x86
+const CpuCacheInfo& cputopo_cache_info();
+
+// description of the CPU model we're running on (e.g. the x86 brand string), for identifying results specific to it; empty if unknown
+std::string cputopo_cpu_model();
+
+// set the preferred node for the pages fully contained in the specified memory range, migrating any already faulted in
+// returns false if unsupported or the node isn't real
+bool cputopo_bind_memory(void* ptr, size_t len, int node);
+
+#endif // defined(__GF16_CPU_TOPOLOGY)
@@ -81,8 +81,10 @@ GF_PREPARE_PACKED_FUNCS(gf16_affine2x, _FNSUFFIX, sizeof(_mword), _FNPREP(gf16_a
 # else
 GF_PREPARE_PACKED_FUNCS(gf16_affine2x, _FNSUFFIX, sizeof(_mword), _FNPREP(gf16_affine2x_prepare_block), _FNPREP(gf16_affine2x_prepare_blocku), 2, _MM_END, _mword checksum = _MMI(setzero)(), _FNPREP(gf16_checksum_block), _FNPREP(gf16_checksum_blocku), _FNPREP(gf16_checksum_exp), _FNPREP(gf16_checksum_prepare), sizeof(_mword))
 # endif
+GF_PREPARE_NATURAL_CKSUM_FUNCS(gf16_affine2x, _FNSUFFIX, sizeof(_mword), _MM_END, _mword checksum = _MMI(setzero)(), _FNPREP(gf16_checksum_block), _FNPREP(gf16_checksum_blocku), _FNPREP(gf16_checksum_exp))
 #else
 GF_PREPARE_PACKED_FUNCS_STUB(gf16_affine2x, _FNSUFFIX)
+GF_PREPARE_NATURAL_CKSUM_FUNCS_STUB(gf16_affine2x, _FNSUFFIX)
 #endif
 
 
@@ -200,10 +200,16 @@ GF16_MULADD_MULTI_FUNCS_STUB(gf16_affine, _FNSUFFIX)
 
 
 #if defined(_AVAILABLE) && !defined(PARPAR_SLIM_GF16)
-static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_2round)(const int srcCountOffs, const uint8_t* _src1, const uint8_t* _src2, intptr_t srcOffset, _mword* result, _mword* swapped, _mword matNorm1, _mword matSwap1, _mword matNorm2, _mword matSwap2) {
+// if `natural` is set, sources are untransformed (and possibly unaligned), and are transformed as they're loaded
+static HEDLEY_ALWAYS_INLINE _mword _FN(gf16_affine2x_load_src)(const uint8_t* src, const int natural) {
+	if(natural)
+		return separate_low_high(_MMI(loadu)((const _mword*)src));
+	return _MMI(load)((const _mword*)src);
+}
+static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_2round)(const int srcCountOffs, const uint8_t* _src1, const uint8_t* _src2, intptr_t srcOffset, _mword* result, _mword* swapped, _mword matNorm1, _mword matSwap1, _mword matNorm2, _mword matSwap2, const int natural) {
 	if(srcCountOffs < 0) return;
 	
-	_mword data1 = _MMI(load)((const _mword*)(_src1 + srcOffset));
+	_mword data1 = _FN(gf16_affine2x_load_src)(_src1 + srcOffset, natural);
 	if(srcCountOffs == 0) {
 		*result = _MMI(xor)(
 			*result,
@@ -215,7 +221,7 @@ static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_2round)(const int srcC
 		);
 	}
 	else { // if(srcCountOffs > 0)
-		_mword data2 = _MMI(load)((const _mword*)(_src2 + srcOffset));
+		_mword data2 = _FN(gf16_affine2x_load_src)(_src2 + srcOffset, natural);
 		*result = _MM(ternarylogic_epi32)(
 			*result,
 			_MM(gf2p8affine_epi64_epi8)(data1, matNorm1, 0),
@@ -230,10 +236,10 @@ static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_2round)(const int srcC
 		);
 	}
 }
-static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_x)(
+static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_x_impl)(
 	const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale,
 	GF16_MULADD_MULTI_SRCLIST,
-	size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf
+	size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf, const int natural
 ) {
 	GF16_MULADD_MULTI_SRC_UNUSED(13);
 	
@@ -362,13 +368,13 @@ static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_x)(
 # endif
 	
 	for(intptr_t ptr = -(intptr_t)len; ptr; ptr += sizeof(_mword)) {
-		_mword data = _MMI(load)((_mword*)(_src1 + ptr*srcScale));
+		_mword data = _FN(gf16_affine2x_load_src)(_src1 + ptr*srcScale, natural);
 		_mword result = _MM(gf2p8affine_epi64_epi8)(data, matNormA, 0);
 		_mword swapped = _MM(gf2p8affine_epi64_epi8)(data, matSwapA, 0);
 		if(srcCount > 1)
-			data = _MMI(load)((_mword*)(_src2 + ptr*srcScale));
+			data = _FN(gf16_affine2x_load_src)(_src2 + ptr*srcScale, natural);
 		if(srcCount >= 3) {
-			_mword data2 = _MMI(load)((_mword*)(_src3 + ptr*srcScale));
+			_mword data2 = _FN(gf16_affine2x_load_src)(_src3 + ptr*srcScale, natural);
 			result = _MM(ternarylogic_epi32)(
 				result,
 				_MM(gf2p8affine_epi64_epi8)(data, matNormB, 0),
@@ -392,11 +398,11 @@ static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_x)(
 			);
 		}
 		
-		_FN(gf16_affine2x_muladd_2round)(srcCount - 4, _src4, _src5, ptr*srcScale, &result, &swapped, matNormD, matSwapD, matNormE, matSwapE);
-		_FN(gf16_affine2x_muladd_2round)(srcCount - 6, _src6, _src7, ptr*srcScale, &result, &swapped, matNormF, matSwapF, matNormG, matSwapG);
-		_FN(gf16_affine2x_muladd_2round)(srcCount - 8, _src8, _src9, ptr*srcScale, &result, &swapped, matNormH, matSwapH, matNormI, matSwapI);
-		_FN(gf16_affine2x_muladd_2round)(srcCount - 10, _src10, _src11, ptr*srcScale, &result, &swapped, matNormJ, matSwapJ, matNormK, matSwapK);
-		_FN(gf16_affine2x_muladd_2round)(srcCount - 12, _src12, _src13, ptr*srcScale, &result, &swapped, matNormL, matSwapL, matNormM, matSwapM);
+		_FN(gf16_affine2x_muladd_2round)(srcCount - 4, _src4, _src5, ptr*srcScale, &result, &swapped, matNormD, matSwapD, matNormE, matSwapE, natural);
+		_FN(gf16_affine2x_muladd_2round)(srcCount - 6, _src6, _src7, ptr*srcScale, &result, &swapped, matNormF, matSwapF, matNormG, matSwapG, natural);
+		_FN(gf16_affine2x_muladd_2round)(srcCount - 8, _src8, _src9, ptr*srcScale, &result, &swapped, matNormH, matSwapH, matNormI, matSwapI, natural);
+		_FN(gf16_affine2x_muladd_2round)(srcCount - 10, _src10, _src11, ptr*srcScale, &result, &swapped, matNormJ, matSwapJ, matNormK, matSwapK, natural);
+		_FN(gf16_affine2x_muladd_2round)(srcCount - 12, _src12, _src13, ptr*srcScale, &result, &swapped, matNormL, matSwapL, matNormM, matSwapM, natural);
 		
 		result = _MM(ternarylogic_epi32)(
 			result,
@@ -412,6 +418,20 @@ static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_x)(
 			_mm_prefetch(_pf+ptr, _MM_HINT_T1);
 	}
 }
+static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_x)(
+	const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale,
+	GF16_MULADD_MULTI_SRCLIST,
+	size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf
+) {
+	_FN(gf16_affine2x_muladd_x_impl)(scratch, _dst, srcScale, GF16_MULADD_MULTI_SRCARGS, len, coefficients, doPrefetch, _pf, 0);
+}
+static HEDLEY_ALWAYS_INLINE void _FN(gf16_affine2x_muladd_x_natural)(
+	const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale,
+	GF16_MULADD_MULTI_SRCLIST,
+	size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf
+) {
+	_FN(gf16_affine2x_muladd_x_impl)(scratch, _dst, srcScale, GF16_MULADD_MULTI_SRCARGS, len, coefficients, doPrefetch, _pf, 1);
+}
 #endif /*defined(_AVAILABLE)*/
 
 
@@ -430,10 +450,13 @@ void _FN(gf16_affine2x_muladd)(const void *HEDLEY_RESTRICT scratch, void *HEDLEY
 # ifdef PLATFORM_AMD64
 // TODO: may not want 12 regions for non-packed variant
 GF16_MULADD_MULTI_FUNCS(gf16_affine2x, _FNSUFFIX, _FN(gf16_affine2x_muladd_x), 12, sizeof(_mword), 0, _mm256_zeroupper())
+GF16_MULADD_MULTI_NATURAL_FUNCS(gf16_affine2x, _FNSUFFIX, _FN(gf16_affine2x_muladd_x_natural), 12, _mm256_zeroupper())
 # else
 // if only 8 registers available, only allow 2 parallel regions
 GF16_MULADD_MULTI_FUNCS(gf16_affine2x, _FNSUFFIX, _FN(gf16_affine2x_muladd_x), 2, sizeof(_mword), 0, _mm256_zeroupper())
+GF16_MULADD_MULTI_NATURAL_FUNCS(gf16_affine2x, _FNSUFFIX, _FN(gf16_affine2x_muladd_x_natural), 2, _mm256_zeroupper())
 # endif
 #else
 GF16_MULADD_MULTI_FUNCS_STUB(gf16_affine2x, _FNSUFFIX)
+GF16_MULADD_MULTI_NATURAL_FUNCS_STUB(gf16_affine2x, _FNSUFFIX)
 #endif
@@ -201,11 +201,18 @@ void* gf16_affine_init_avx2(int polynomial) {
 
 
 #if defined(__GFNI__) && defined(__AVX2__) && !defined(PARPAR_SLIM_GF16)
-static HEDLEY_ALWAYS_INLINE void gf16_affine2x_muladd_x_avx2(
+// if `natural` is set, sources are untransformed (and possibly unaligned), and are transformed as they're loaded
+static HEDLEY_ALWAYS_INLINE __m256i gf16_affine2x_load_src_avx2(const uint8_t* src, const int natural) {
+	if(natural)
+		return separate_low_high(_mm256_loadu_si256((const __m256i*)src));
+	return _mm256_load_si256((const __m256i*)src);
+}
+
+static HEDLEY_ALWAYS_INLINE void gf16_affine2x_muladd_x_impl_avx2(
 	const void *HEDLEY_RESTRICT scratch,
 	uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale,
 	GF16_MULADD_MULTI_SRCLIST,
-	size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf
+	size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf, const int natural
 ) {
 	GF16_MULADD_MULTI_SRC_UNUSED(6);
 	
@@ -256,33 +263,33 @@ static HEDLEY_ALWAYS_INLINE void gf16_affine2x_muladd_x_avx2(
 		if(doPrefetch == 2)
 			_mm_prefetch(_pf+ptr, _MM_HINT_T2);
 		if(ptr & (sizeof(__m256i)*2-1)) { // align to a cacheline boundary
-			__m256i data = _mm256_load_si256((__m256i*)(_src1 + ptr*srcScale));
+			__m256i data = gf16_affine2x_load_src_avx2(_src1 + ptr*srcScale, natural);
 			__m256i result1 = _mm256_gf2p8affine_epi64_epi8(data, matNormA, 0);
 			__m256i result2 = _mm256_gf2p8affine_epi64_epi8(data, matSwapA, 0);
 			
 			if(srcCount >= 2) {
-				data = _mm256_load_si256((__m256i*)(_src2 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src2 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormB, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapB, 0));
 			}
 			
 			if(srcCount >= 3) {
-				data = _mm256_load_si256((__m256i*)(_src3 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src3 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormC, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapC, 0));
 			}
 			if(srcCount >= 4) {
-				data = _mm256_load_si256((__m256i*)(_src4 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src4 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormD, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapD, 0));
 			}
 			if(srcCount >= 5) {
-				data = _mm256_load_si256((__m256i*)(_src5 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src5 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormE, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapE, 0));
 			}
 			if(srcCount >= 6) {
-				data = _mm256_load_si256((__m256i*)(_src6 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src6 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormF, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapF, 0));
 			}
@@ -301,32 +308,32 @@ static HEDLEY_ALWAYS_INLINE void gf16_affine2x_muladd_x_avx2(
 			_mm_prefetch(_pf+ptr, _MM_HINT_T2);
 		
 		for(int iter=0; iter<(doPrefetch?2:1); iter++) { // if prefetching, iterate on cachelines
-			__m256i data = _mm256_load_si256((__m256i*)(_src1 + ptr*srcScale));
+			__m256i data = gf16_affine2x_load_src_avx2(_src1 + ptr*srcScale, natural);
 			__m256i result1 = _mm256_gf2p8affine_epi64_epi8(data, matNormA, 0);
 			__m256i result2 = _mm256_gf2p8affine_epi64_epi8(data, matSwapA, 0);
 			
 			if(srcCount >= 2) {
-				data = _mm256_load_si256((__m256i*)(_src2 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src2 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormB, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapB, 0));
 			}
 			if(srcCount >= 3) {
-				data = _mm256_load_si256((__m256i*)(_src3 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src3 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormC, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapC, 0));
 			}
 			if(srcCount >= 4) {
-				data = _mm256_load_si256((__m256i*)(_src4 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src4 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormD, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapD, 0));
 			}
 			if(srcCount >= 5) {
-				data = _mm256_load_si256((__m256i*)(_src5 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src5 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormE, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapE, 0));
 			}
 			if(srcCount >= 6) {
-				data = _mm256_load_si256((__m256i*)(_src6 + ptr*srcScale));
+				data = gf16_affine2x_load_src_avx2(_src6 + ptr*srcScale, natural);
 				result1 = _mm256_xor_si256(result1, _mm256_gf2p8affine_epi64_epi8(data, matNormF, 0));
 				result2 = _mm256_xor_si256(result2, _mm256_gf2p8affine_epi64_epi8(data, matSwapF, 0));
 			}
@@ -339,6 +346,22 @@ static HEDLEY_ALWAYS_INLINE void gf16_affine2x_muladd_x_avx2(
 		}
 	}
 }
+static HEDLEY_ALWAYS_INLINE void gf16_affine2x_muladd_x_avx2(
+	const void *HEDLEY_RESTRICT scratch,
+	uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale,
+	GF16_MULADD_MULTI_SRCLIST,
+	size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf
+) {
+	gf16_affine2x_muladd_x_impl_avx2(scratch, _dst, srcScale, GF16_MULADD_MULTI_SRCARGS, len, coefficients, doPrefetch, _pf, 0);
+}
+static HEDLEY_ALWAYS_INLINE void gf16_affine2x_muladd_x_natural_avx2(
+	const void *HEDLEY_RESTRICT scratch,
+	uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale,
+	GF16_MULADD_MULTI_SRCLIST,
+	size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf
+) {
+	gf16_affine2x_muladd_x_impl_avx2(scratch, _dst, srcScale, GF16_MULADD_MULTI_SRCARGS, len, coefficients, doPrefetch, _pf, 1);
+}
 #endif /*defined(__GFNI__) && defined(__AVX2__) && !defined(PARPAR_SLIM_GF16)*/
 
 #ifdef PARPAR_INVERT_SUPPORT
@@ -380,9 +403,12 @@ void gf16_affine2x_muladd_avx2(const void *HEDLEY_RESTRICT scratch, void *HEDLEY
 #if defined(__GFNI__) && defined(__AVX2__) && !defined(PARPAR_SLIM_GF16)
 # ifdef PLATFORM_AMD64
 GF16_MULADD_MULTI_FUNCS(gf16_affine2x, _avx2, gf16_affine2x_muladd_x_avx2, 6, sizeof(__m256i), 0, _mm256_zeroupper())
+GF16_MULADD_MULTI_NATURAL_FUNCS(gf16_affine2x, _avx2, gf16_affine2x_muladd_x_natural_avx2, 6, _mm256_zeroupper())
 # else
 GF16_MULADD_MULTI_FUNCS(gf16_affine2x, _avx2, gf16_affine2x_muladd_x_avx2, 2, sizeof(__m256i), 0, _mm256_zeroupper())
+GF16_MULADD_MULTI_NATURAL_FUNCS(gf16_affine2x, _avx2, gf16_affine2x_muladd_x_natural_avx2, 2, _mm256_zeroupper())
 # endif
 #else
 GF16_MULADD_MULTI_FUNCS_STUB(gf16_affine2x, _avx2)
+GF16_MULADD_MULTI_NATURAL_FUNCS_STUB(gf16_affine2x, _avx2)
 #endif
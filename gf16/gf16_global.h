@@ -218,12 +218,42 @@ static HEDLEY_ALWAYS_INLINE void gf16_prepare_packed(
 	}
 }
 
+// for kernels which transform on load: the source is left in place, with only its checksum computed
+// `dst` has the layout of an untransformed slice (sliceLen bytes + checksum block), of which only the part past the last full block of the source is written (i.e. the final partial block, zero padding and checksum)
+static HEDLEY_ALWAYS_INLINE void gf16_prepare_natural(
+	void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t srcLen, size_t sliceLen, const size_t blockLen,
+	void *HEDLEY_RESTRICT checksum, gf16_checksum_block checksumBlock, gf16_checksum_blocku checksumBlockU, gf16_checksum_exp checksumExp
+) {
+	ASSUME(srcLen <= sliceLen);
+	ASSUME(sliceLen % blockLen == 0);
+	
+	const uint8_t* _src = (const uint8_t*)src;
+	uint8_t* _dst = (uint8_t*)dst;
+	size_t len = srcLen - (srcLen % blockLen);
+	size_t pos;
+	for(pos=0; pos<len; pos+=blockLen)
+		checksumBlock(_src + pos, checksum, blockLen, 0);
+	if(srcLen > len) {
+		checksumBlockU(_src + len, srcLen-len, checksum);
+		memcpy(_dst + len, _src + len, srcLen-len);
+		memset(_dst + srcLen, 0, blockLen - (srcLen-len));
+		pos += blockLen;
+	}
+	
+	// zero fill rest of slice
+	if(pos < sliceLen) {
+		checksumExp(checksum, gf16_exp(((sliceLen-pos) / blockLen) % 65535));
+		memset(_dst + pos, 0, sliceLen-pos);
+	}
+	memcpy(_dst + sliceLen, checksum, blockLen);
+}
+
 
 
 static HEDLEY_ALWAYS_INLINE int gf16_finish_packed(
 	void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, const size_t blockLen, gf16_transform_block_rst finishBlock, gf16_transform_blocku_rst finishBlockU,
 	unsigned numOutputs, unsigned outputNum, size_t chunkLen, const unsigned interleaveSize,
-	size_t partOffset, size_t partLen,
+	size_t partOffset, size_t partLen, void *HEDLEY_RESTRICT partChecksum,
 	gf16_checksum_block checksumBlock, gf16_checksum_blocku checksumBlockU, gf16_checksum_exp checksumExp, gf16_finish_block inlineFinishBlock,
 	size_t accessAlign
 ) {
@@ -244,7 +274,8 @@ static HEDLEY_ALWAYS_INLINE int gf16_finish_packed(
 	void* checksum = NULL; // MSVC whines if you don't set an initial value
 	if(checksumBlock) {
 		// we only really need to update the source checksum if we're doing partial processing. If not partial processing, we can maintain const'ness of source memory
-		void* cksumPtr = gf16_checksum_ptr(src, alignedSliceLen, blockLen, numOutputs, outputNum, chunkLen, interleaveSize);
+		// for partial processing, the checksum can be located separately, which allows `src` to only be valid for the part being processed
+		void* cksumPtr = partChecksum ? partChecksum : gf16_checksum_ptr(src, alignedSliceLen, blockLen, numOutputs, outputNum, chunkLen, interleaveSize);
 		if(partLen != sliceLen)
 			checksum = cksumPtr;
 		else {
@@ -363,6 +394,17 @@ void TOKENPASTE3(fnpre , _prepare_partial_packsum , fnsuf)(void *HEDLEY_RESTRICT
 	finisher; \
 	if(partOffset + partLen == srcLen) ALIGN_FREE(checksum); \
 }
+#define GF_PREPARE_NATURAL_CKSUM_FUNCS(fnpre, fnsuf, blksize, finisher, cksumInit, cksumfn, cksumufn, cksumxfn) \
+void TOKENPASTE3(fnpre , _prepare_natural_cksum , fnsuf)(void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t srcLen, size_t sliceLen) { \
+	cksumInit; \
+	gf16_prepare_natural(dst, src, srcLen, sliceLen, blksize, &checksum, &cksumfn, &cksumufn, &cksumxfn); \
+	finisher; \
+}
+#define GF_PREPARE_NATURAL_CKSUM_FUNCS_STUB(fnpre, fnsuf) \
+void TOKENPASTE3(fnpre , _prepare_natural_cksum , fnsuf)(void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t srcLen, size_t sliceLen) { \
+	UNUSED(dst); UNUSED(src); UNUSED(srcLen); UNUSED(sliceLen); \
+}
+
 #define GF_PREPARE_PACKED_CKSUM_FUNCS_STUB(fnpre, fnsuf) \
 void TOKENPASTE3(fnpre , _prepare_packed_cksum , fnsuf)(void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t srcLen, size_t sliceLen, unsigned inputPackSize, unsigned inputNum, size_t chunkLen) { \
 	UNUSED(dst); UNUSED(src); UNUSED(srcLen); UNUSED(sliceLen); UNUSED(inputPackSize); UNUSED(inputNum); UNUSED(chunkLen); \
@@ -388,16 +430,16 @@ GF_PREPARE_PACKED_CKSUM_FUNCS_STUB(fnpre, fnsuf)
 
 # define GF_FINISH_PACKED_FUNCS(fnpre, fnsuf, blksize, finfn, finufn, interleave, finisher, cksumfn, cksumufn, cksumxfn, ilfinfn, align) \
 void TOKENPASTE3(fnpre , _finish_packed , fnsuf)(void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen) { \
-	gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, 0, sliceLen, NULL, NULL, NULL, NULL, align); \
+	gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, 0, sliceLen, NULL, NULL, NULL, NULL, NULL, align); \
 	finisher; \
 } \
 int TOKENPASTE3(fnpre , _finish_packed_cksum , fnsuf)(void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen) { \
-	int result = gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, 0, sliceLen, &cksumfn, &cksumufn, &cksumxfn, ilfinfn, align); \
+	int result = gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, 0, sliceLen, NULL, &cksumfn, &cksumufn, &cksumxfn, ilfinfn, align); \
 	finisher; \
 	return result; \
 } \
-int TOKENPASTE3(fnpre , _finish_partial_packsum , fnsuf)(void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen) { \
-	int result = gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, partOffset, partLen, &cksumfn, &cksumufn, &cksumxfn, ilfinfn, align); \
+int TOKENPASTE3(fnpre , _finish_partial_packsum , fnsuf)(void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen, void *HEDLEY_RESTRICT checksum) { \
+	int result = gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, partOffset, partLen, checksum, &cksumfn, &cksumufn, &cksumxfn, ilfinfn, align); \
 	finisher; \
 	return result; \
 }
@@ -410,8 +452,8 @@ int TOKENPASTE3(fnpre , _finish_packed_cksum , fnsuf)(void *HEDLEY_RESTRICT dst,
 	UNUSED(dst); UNUSED(src); UNUSED(sliceLen); UNUSED(numOutputs); UNUSED(outputNum); UNUSED(chunkLen); \
 	return 0; \
 } \
-int TOKENPASTE3(fnpre , _finish_partial_packsum , fnsuf)(void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen) { \
-	UNUSED(dst); UNUSED(src); UNUSED(sliceLen); UNUSED(numOutputs); UNUSED(outputNum); UNUSED(chunkLen); UNUSED(partOffset); UNUSED(partLen); \
+int TOKENPASTE3(fnpre , _finish_partial_packsum , fnsuf)(void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen, void *HEDLEY_RESTRICT checksum) { \
+	UNUSED(dst); UNUSED(src); UNUSED(sliceLen); UNUSED(numOutputs); UNUSED(outputNum); UNUSED(chunkLen); UNUSED(partOffset); UNUSED(partLen); UNUSED(checksum); \
 	return 0; \
 }
 
@@ -423,12 +465,12 @@ GF_PREPARE_PACKED_CKSUM_FUNCS(fnpre, fnsuf, blksize, prepfn, prepufn, interleave
 
 # define GF_FINISH_PACKED_FUNCS(fnpre, fnsuf, blksize, finfn, finufn, interleave, finisher, cksumfn, cksumufn, cksumxfn, ilfinfn, align) \
 int TOKENPASTE3(fnpre , _finish_packed_cksum , fnsuf)(void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen) { \
-	int result = gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, 0, sliceLen, &cksumfn, &cksumufn, &cksumxfn, ilfinfn, align); \
+	int result = gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, 0, sliceLen, NULL, &cksumfn, &cksumufn, &cksumxfn, ilfinfn, align); \
 	finisher; \
 	return result; \
 } \
-int TOKENPASTE3(fnpre , _finish_partial_packsum , fnsuf)(void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen) { \
-	int result = gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, partOffset, partLen, &cksumfn, &cksumufn, &cksumxfn, ilfinfn, align); \
+int TOKENPASTE3(fnpre , _finish_partial_packsum , fnsuf)(void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen, void *HEDLEY_RESTRICT checksum) { \
+	int result = gf16_finish_packed(dst, (void *HEDLEY_RESTRICT)src, sliceLen, blksize, &finfn, &finufn, numOutputs, outputNum, chunkLen, interleave, partOffset, partLen, checksum, &cksumfn, &cksumufn, &cksumxfn, ilfinfn, align); \
 	finisher; \
 	return result; \
 }
@@ -438,8 +480,8 @@ int TOKENPASTE3(fnpre , _finish_packed_cksum , fnsuf)(void *HEDLEY_RESTRICT dst,
 	UNUSED(dst); UNUSED(src); UNUSED(sliceLen); UNUSED(numOutputs); UNUSED(outputNum); UNUSED(chunkLen); \
 	return 0; \
 } \
-int TOKENPASTE3(fnpre , _finish_partial_packsum , fnsuf)(void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen) { \
-	UNUSED(dst); UNUSED(src); UNUSED(sliceLen); UNUSED(numOutputs); UNUSED(outputNum); UNUSED(chunkLen); UNUSED(partOffset); UNUSED(partLen); \
+int TOKENPASTE3(fnpre , _finish_partial_packsum , fnsuf)(void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen, void *HEDLEY_RESTRICT checksum) { \
+	UNUSED(dst); UNUSED(src); UNUSED(sliceLen); UNUSED(numOutputs); UNUSED(outputNum); UNUSED(chunkLen); UNUSED(partOffset); UNUSED(partLen); UNUSED(checksum); \
 	return 0; \
 }
 
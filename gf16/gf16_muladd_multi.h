@@ -3,6 +3,10 @@
 	const uint8_t* _src1, const uint8_t* _src2, const uint8_t* _src3, const uint8_t* _src4, const uint8_t* _src5, const uint8_t* _src6, \
 	const uint8_t* _src7, const uint8_t* _src8, const uint8_t* _src9, const uint8_t* _src10, const uint8_t* _src11, const uint8_t* _src12, \
 	const uint8_t* _src13, const uint8_t* _src14, const uint8_t* _src15, const uint8_t* _src16, const uint8_t* _src17, const uint8_t* _src18
+// for forwarding GF16_MULADD_MULTI_SRCLIST to another function
+#define GF16_MULADD_MULTI_SRCARGS srcCount, \
+	_src1, _src2, _src3, _src4, _src5, _src6, _src7, _src8, _src9, \
+	_src10, _src11, _src12, _src13, _src14, _src15, _src16, _src17, _src18
 #define GF16_MULADD_MULTI_SRC_UNUSED(max) \
 	HEDLEY_ASSUME(srcCount <= max); \
 	if(max < 2) UNUSED(_src2); \
@@ -85,6 +89,20 @@ void TOKENPASTE3(fnpre, _muladd_multi_packpf, fnsuf)(const void *HEDLEY_RESTRICT
 }
 #endif
 
+// variant for kernels which read untransformed sources, transforming them as they're loaded
+// unlike the packed functions, each source can be a separate (unaligned) buffer, so inputs can be used directly from the caller's memory
+#define GF16_MULADD_MULTI_NATURAL_FUNCS(fnpre, fnsuf, xfn, procRegions, finisher) \
+void TOKENPASTE3(fnpre, _muladd_multi_natural, fnsuf)(const void *HEDLEY_RESTRICT scratch, unsigned regions, size_t offset, void *HEDLEY_RESTRICT dst, const void* const*HEDLEY_RESTRICT src, size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, void *HEDLEY_RESTRICT mutScratch) { \
+	UNUSED(mutScratch); \
+	gf16_muladd_multi(scratch, &xfn, procRegions, regions, offset, dst, src, len, coefficients); \
+	finisher; \
+}
+#define GF16_MULADD_MULTI_NATURAL_FUNCS_STUB(fnpre, fnsuf) \
+void TOKENPASTE3(fnpre, _muladd_multi_natural, fnsuf)(const void *HEDLEY_RESTRICT scratch, unsigned regions, size_t offset, void *HEDLEY_RESTRICT dst, const void* const*HEDLEY_RESTRICT src, size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, void *HEDLEY_RESTRICT mutScratch) { \
+	UNUSED(mutScratch); \
+	UNUSED(scratch); UNUSED(regions); UNUSED(offset); UNUSED(dst); UNUSED(src); UNUSED(len); UNUSED(coefficients); \
+}
+
 
 
 
@@ -135,7 +153,6 @@ static HEDLEY_ALWAYS_INLINE void gf16_muladd_prefetch_single(const void *HEDLEY_
 
 #define REMAINING_CASES CASE(17); CASE(16); CASE(15); CASE(14); CASE(13); CASE(12); CASE(11); CASE(10); CASE( 9); CASE( 8); CASE( 7); CASE( 6); CASE( 5); CASE( 4); CASE( 3); CASE( 2); CASE( 1)
 
-#ifdef PARPAR_INVERT_SUPPORT
 static HEDLEY_ALWAYS_INLINE void gf16_muladd_multi(const void *HEDLEY_RESTRICT scratch, fMuladdPF muladd_pf, const unsigned interleave, unsigned regions, size_t offset, void *HEDLEY_RESTRICT dst, const void* const*HEDLEY_RESTRICT src, size_t len, const uint16_t *HEDLEY_RESTRICT coefficients) IGNORE_NULL_ADD {
 	uint8_t* _dst = (uint8_t*)dst + offset + len;
 	
@@ -177,6 +194,7 @@ static HEDLEY_ALWAYS_INLINE void gf16_muladd_multi(const void *HEDLEY_RESTRICT s
 	#undef _SRC
 }
 
+#ifdef PARPAR_INVERT_SUPPORT
 static HEDLEY_ALWAYS_INLINE void gf16_muladd_multi_stridepf(const void *HEDLEY_RESTRICT scratch, fMuladdPF muladd_pf, const unsigned interleave, unsigned regions, size_t srcStride, void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const unsigned pfFactor, const void* HEDLEY_RESTRICT prefetch) IGNORE_NULL_ADD {
 	uint8_t* _dst = (uint8_t*)dst + len;
 	uint8_t* srcEnd = (uint8_t*)src + len;
@@ -4,29 +4,22 @@
 
 #if defined(_AVAILABLE) && !defined(PARPAR_SLIM_GF16)
 # include "gf16_checksum_x86.h"
-static HEDLEY_ALWAYS_INLINE void _FN(gf16_shuffle2x_prepare_block)(void* dst, const void* src) {
-	_mword data = _MMI(loadu)((_mword*)src);
-	
+// also used by the multiply kernels to transform inputs as they're loaded
+static HEDLEY_ALWAYS_INLINE _mword _FN(gf16_shuffle2x_transform)(_mword data) {
 	data = separate_low_high(data);
 #if MWORD_SIZE >= 64
-	data = _mm512_permutexvar_epi64(_mm512_set_epi64(7,5,3,1, 6,4,2,0), data);
+	return _mm512_permutexvar_epi64(_mm512_set_epi64(7,5,3,1, 6,4,2,0), data);
 #else
-	data = _mm256_permute4x64_epi64(data, _MM_SHUFFLE(3,1,2,0));
+	return _mm256_permute4x64_epi64(data, _MM_SHUFFLE(3,1,2,0));
 #endif
-	
-	_MMI(store)((_mword*)dst, data);
+}
+static HEDLEY_ALWAYS_INLINE void _FN(gf16_shuffle2x_prepare_block)(void* dst, const void* src) {
+	_mword data = _MMI(loadu)((_mword*)src);
+	_MMI(store)((_mword*)dst, _FN(gf16_shuffle2x_transform)(data));
 }
 static HEDLEY_ALWAYS_INLINE void _FN(gf16_shuffle2x_prepare_blocku)(void* dst, const void* src, size_t remaining) {
 	_mword data = partial_load(src, remaining);
-	
-	data = separate_low_high(data);
-#if MWORD_SIZE >= 64
-	data = _mm512_permutexvar_epi64(_mm512_set_epi64(7,5,3,1, 6,4,2,0), data);
-#else
-	data = _mm256_permute4x64_epi64(data, _MM_SHUFFLE(3,1,2,0));
-#endif
-	
-	_MMI(store)((_mword*)dst, data);
+	_MMI(store)((_mword*)dst, _FN(gf16_shuffle2x_transform)(data));
 }
 
 static HEDLEY_ALWAYS_INLINE void _FN(gf16_shuffle2x_finish_block)(void *HEDLEY_RESTRICT dst) {
@@ -108,8 +101,10 @@ GF_PREPARE_PACKED_FUNCS(gf16_shuffle2x, _FNSUFFIX, sizeof(_mword), _FN(gf16_shuf
 # else
 GF_PREPARE_PACKED_FUNCS(gf16_shuffle2x, _FNSUFFIX, sizeof(_mword), _FN(gf16_shuffle2x_prepare_block), _FN(gf16_shuffle2x_prepare_blocku), 1, _MM_END, _mword checksum = _MMI(setzero)(), _FN(gf16_checksum_block), _FN(gf16_checksum_blocku), _FN(gf16_checksum_exp), _FN(gf16_checksum_prepare), sizeof(_mword))
 # endif
+GF_PREPARE_NATURAL_CKSUM_FUNCS(gf16_shuffle2x, _FNSUFFIX, sizeof(_mword), _MM_END, _mword checksum = _MMI(setzero)(), _FN(gf16_checksum_block), _FN(gf16_checksum_blocku), _FN(gf16_checksum_exp))
 #else
 GF_PREPARE_PACKED_FUNCS_STUB(gf16_shuffle2x, _FNSUFFIX)
+GF_PREPARE_NATURAL_CKSUM_FUNCS_STUB(gf16_shuffle2x, _FNSUFFIX)
 #endif
 
 #ifdef PARPAR_INVERT_SUPPORT
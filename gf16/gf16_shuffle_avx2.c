@@ -17,8 +17,15 @@
 #include "gf16_muladd_multi.h"
 
 #if defined(_AVAILABLE) && !defined(PARPAR_SLIM_GF16)
-static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_round_avx2(__m256i* _dst, const int srcCount, const uint8_t* _src1, const uint8_t* _src2, intptr_t srcOffset, __m256i shufNormLoA, __m256i shufNormLoB, __m256i shufNormHiA, __m256i shufNormHiB, __m256i shufSwapLoA, __m256i shufSwapLoB, __m256i shufSwapHiA, __m256i shufSwapHiB) {
-	__m256i data = _mm256_load_si256((const __m256i*)(_src1 + srcOffset));
+// if `natural` is set, sources are untransformed (and possibly unaligned), and are transformed as they're loaded
+static HEDLEY_ALWAYS_INLINE __m256i gf16_shuffle2x_load_src_avx2(const uint8_t* src, const int natural) {
+	if(natural)
+		return gf16_shuffle2x_transform_avx2(_mm256_loadu_si256((const __m256i*)src));
+	return _mm256_load_si256((const __m256i*)src);
+}
+
+static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_round_avx2(__m256i* _dst, const int srcCount, const uint8_t* _src1, const uint8_t* _src2, intptr_t srcOffset, __m256i shufNormLoA, __m256i shufNormLoB, __m256i shufNormHiA, __m256i shufNormHiB, __m256i shufSwapLoA, __m256i shufSwapLoB, __m256i shufSwapHiA, __m256i shufSwapHiB, const int natural) {
+	__m256i data = gf16_shuffle2x_load_src_avx2(_src1 + srcOffset, natural);
 	__m256i mask = _mm256_set1_epi8(0x0f);
 	
 	__m256i ti = _mm256_and_si256(mask, data);
@@ -32,7 +39,7 @@ static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_round_avx2(__m256i* _dst,
 	result = _mm256_xor_si256(result, _mm256_load_si256(_dst));
 	
 	if(srcCount > 1) {
-		data = _mm256_load_si256((const __m256i*)(_src2 + srcOffset));
+		data = gf16_shuffle2x_load_src_avx2(_src2 + srcOffset, natural);
 		
 		ti = _mm256_and_si256(mask, data);
 		result = _mm256_xor_si256(_mm256_shuffle_epi8(shufNormLoB, ti), result);
@@ -49,7 +56,7 @@ static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_round_avx2(__m256i* _dst,
 	_mm256_store_si256(_dst, result);
 }
 
-static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_avx2(const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale, GF16_MULADD_MULTI_SRCLIST, size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf) {
+static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_impl_avx2(const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale, GF16_MULADD_MULTI_SRCLIST, size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf, const int natural) {
 	GF16_MULADD_MULTI_SRC_UNUSED(2);
 	
 	__m256i shufNormLoA, shufSwapLoA, shufNormHiA, shufSwapHiA;
@@ -118,7 +125,7 @@ static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_avx2(const void *HEDLEY
 		if(len & (sizeof(__m256i)*2-1)) { // number of loop iterations isn't even, so do one iteration to make it even
 			gf16_shuffle2x_muladd_round_avx2(
 				(__m256i*)(_dst+ptr), srcCount, _src1, _src2, ptr*srcScale,
-				shufNormLoA, shufNormLoB, shufNormHiA, shufNormHiB, shufSwapLoA, shufSwapLoB, shufSwapHiA, shufSwapHiB
+				shufNormLoA, shufNormLoB, shufNormHiA, shufNormHiB, shufSwapLoA, shufSwapLoB, shufSwapHiA, shufSwapHiB, natural
 			);
 			if(doPrefetch == 1)
 				_mm_prefetch(_pf+ptr, MM_HINT_WT1);
@@ -129,12 +136,12 @@ static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_avx2(const void *HEDLEY
 		while(ptr) {
 			gf16_shuffle2x_muladd_round_avx2(
 				(__m256i*)(_dst+ptr), srcCount, _src1, _src2, ptr*srcScale,
-				shufNormLoA, shufNormLoB, shufNormHiA, shufNormHiB, shufSwapLoA, shufSwapLoB, shufSwapHiA, shufSwapHiB
+				shufNormLoA, shufNormLoB, shufNormHiA, shufNormHiB, shufSwapLoA, shufSwapLoB, shufSwapHiA, shufSwapHiB, natural
 			);
 			ptr += sizeof(__m256i);
 			gf16_shuffle2x_muladd_round_avx2(
 				(__m256i*)(_dst+ptr), srcCount, _src1, _src2, ptr*srcScale,
-				shufNormLoA, shufNormLoB, shufNormHiA, shufNormHiB, shufSwapLoA, shufSwapLoB, shufSwapHiA, shufSwapHiB
+				shufNormLoA, shufNormLoB, shufNormHiA, shufNormHiB, shufSwapLoA, shufSwapLoB, shufSwapHiA, shufSwapHiB, natural
 			);
 			
 			if(doPrefetch == 1)
@@ -147,18 +154,26 @@ static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_avx2(const void *HEDLEY
 		for(intptr_t ptr = -(intptr_t)len; ptr; ptr += sizeof(__m256i)) {
 			gf16_shuffle2x_muladd_round_avx2(
 				(__m256i*)(_dst+ptr), srcCount, _src1, _src2, ptr*srcScale,
-				shufNormLoA, shufNormLoB, shufNormHiA, shufNormHiB, shufSwapLoA, shufSwapLoB, shufSwapHiA, shufSwapHiB
+				shufNormLoA, shufNormLoB, shufNormHiA, shufNormHiB, shufSwapLoA, shufSwapLoB, shufSwapHiA, shufSwapHiB, natural
 			);
 		}
 	}
 }
+static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_avx2(const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale, GF16_MULADD_MULTI_SRCLIST, size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf) {
+	gf16_shuffle2x_muladd_x_impl_avx2(scratch, _dst, srcScale, GF16_MULADD_MULTI_SRCARGS, len, coefficients, doPrefetch, _pf, 0);
+}
+static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_natural_avx2(const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale, GF16_MULADD_MULTI_SRCLIST, size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, const int doPrefetch, const char* _pf) {
+	gf16_shuffle2x_muladd_x_impl_avx2(scratch, _dst, srcScale, GF16_MULADD_MULTI_SRCARGS, len, coefficients, doPrefetch, _pf, 1);
+}
 #endif
 
 
 #if defined(_AVAILABLE) && !defined(PARPAR_SLIM_GF16) && defined(PLATFORM_AMD64)
 GF16_MULADD_MULTI_FUNCS(gf16_shuffle2x, _avx2, gf16_shuffle2x_muladd_x_avx2, 2, sizeof(__m256i), 0, _mm256_zeroupper())
+GF16_MULADD_MULTI_NATURAL_FUNCS(gf16_shuffle2x, _avx2, gf16_shuffle2x_muladd_x_natural_avx2, 2, _mm256_zeroupper())
 #else
 GF16_MULADD_MULTI_FUNCS_STUB(gf16_shuffle2x, _avx2)
+GF16_MULADD_MULTI_NATURAL_FUNCS_STUB(gf16_shuffle2x, _avx2)
 #endif
 
 void gf16_shuffle2x_muladd_avx2(const void *HEDLEY_RESTRICT scratch, void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t len, uint16_t val, void *HEDLEY_RESTRICT mutScratch) {
@@ -173,11 +173,17 @@ GF16_MULADD_MULTI_FUNCS_STUB(gf16_shuffle, _avx512)
 
 
 #if defined(_AVAILABLE) && !defined(PARPAR_SLIM_GF16)
+// if `natural` is set, sources are untransformed (and possibly unaligned), and are transformed as they're loaded
+static HEDLEY_ALWAYS_INLINE __m512i gf16_shuffle2x_load_src_avx512(__m512i* src, const int natural) {
+	if(natural)
+		return gf16_shuffle2x_transform_avx512(_mm512_loadu_si512(src));
+	return _mm512_load_si512(src);
+}
 static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_avx512_round1(
 	__m512i* src, __m512i* result, __m512i* swapped,
-	__m512i shufNormLo, __m512i shufNormHi, __m512i shufSwapLo, __m512i shufSwapHi
+	__m512i shufNormLo, __m512i shufNormHi, __m512i shufSwapLo, __m512i shufSwapHi, const int natural
 ) {
-	__m512i data = _mm512_load_si512(src);
+	__m512i data = gf16_shuffle2x_load_src_avx512(src, natural);
 	
 	__m512i til = _mm512_and_si512(_mm512_set1_epi8(0x0f), data);
 	__m512i tih = _mm512_and_si512(_mm512_set1_epi8(0x0f), _mm512_srli_epi16(data, 4));
@@ -194,9 +200,9 @@ static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_avx512_round1(
 }
 static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_avx512_round(
 	__m512i* src, __m512i* result, __m512i* swapped,
-	__m512i shufNormLo, __m512i shufNormHi, __m512i shufSwapLo, __m512i shufSwapHi
+	__m512i shufNormLo, __m512i shufNormHi, __m512i shufSwapLo, __m512i shufSwapHi, const int natural
 ) {
-	__m512i data = _mm512_load_si512(src);
+	__m512i data = gf16_shuffle2x_load_src_avx512(src, natural);
 	
 	__m512i til = _mm512_and_si512(_mm512_set1_epi8(0x0f), data);
 	__m512i tih = _mm512_and_si512(_mm512_set1_epi8(0x0f), _mm512_srli_epi16(data, 4));
@@ -214,11 +220,11 @@ static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_avx512_round(
 	);
 }
 
-static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_avx512(
+static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_impl_avx512(
 	const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale,
 	GF16_MULADD_MULTI_SRCLIST, size_t len,
 	const uint16_t *HEDLEY_RESTRICT coefficients,
-	const int doPrefetch, const char* _pf
+	const int doPrefetch, const char* _pf, const int natural
 ) {
 	GF16_MULADD_MULTI_SRC_UNUSED(6);
 	__m512i polyl, polyh;
@@ -307,17 +313,17 @@ static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_avx512(
 	
 	for(intptr_t ptr = -(intptr_t)len; ptr; ptr += sizeof(__m512i)) {
 		__m512i swapped, result = _mm512_load_si512((__m512i*)(_dst+ptr));
-		gf16_shuffle2x_avx512_round1((__m512i*)(_src1+ptr*srcScale), &result, &swapped, shufNormLoA, shufNormHiA, shufSwapLoA, shufSwapHiA);
+		gf16_shuffle2x_avx512_round1((__m512i*)(_src1+ptr*srcScale), &result, &swapped, shufNormLoA, shufNormHiA, shufSwapLoA, shufSwapHiA, natural);
 		if(srcCount >= 2)
-			gf16_shuffle2x_avx512_round((__m512i*)(_src2+ptr*srcScale), &result, &swapped, shufNormLoB, shufNormHiB, shufSwapLoB, shufSwapHiB);
+			gf16_shuffle2x_avx512_round((__m512i*)(_src2+ptr*srcScale), &result, &swapped, shufNormLoB, shufNormHiB, shufSwapLoB, shufSwapHiB, natural);
 		if(srcCount >= 3)
-			gf16_shuffle2x_avx512_round((__m512i*)(_src3+ptr*srcScale), &result, &swapped, shufNormLoC, shufNormHiC, shufSwapLoC, shufSwapHiC);
+			gf16_shuffle2x_avx512_round((__m512i*)(_src3+ptr*srcScale), &result, &swapped, shufNormLoC, shufNormHiC, shufSwapLoC, shufSwapHiC, natural);
 		if(srcCount >= 4)
-			gf16_shuffle2x_avx512_round((__m512i*)(_src4+ptr*srcScale), &result, &swapped, shufNormLoD, shufNormHiD, shufSwapLoD, shufSwapHiD);
+			gf16_shuffle2x_avx512_round((__m512i*)(_src4+ptr*srcScale), &result, &swapped, shufNormLoD, shufNormHiD, shufSwapLoD, shufSwapHiD, natural);
 		if(srcCount >= 5)
-			gf16_shuffle2x_avx512_round((__m512i*)(_src5+ptr*srcScale), &result, &swapped, shufNormLoE, shufNormHiE, shufSwapLoE, shufSwapHiE);
+			gf16_shuffle2x_avx512_round((__m512i*)(_src5+ptr*srcScale), &result, &swapped, shufNormLoE, shufNormHiE, shufSwapLoE, shufSwapHiE, natural);
 		if(srcCount >= 6)
-			gf16_shuffle2x_avx512_round((__m512i*)(_src6+ptr*srcScale), &result, &swapped, shufNormLoF, shufNormHiF, shufSwapLoF, shufSwapHiF);
+			gf16_shuffle2x_avx512_round((__m512i*)(_src6+ptr*srcScale), &result, &swapped, shufNormLoF, shufNormHiF, shufSwapLoF, shufSwapHiF, natural);
 		
 		swapped = _mm512_shuffle_i32x4(swapped, swapped, _MM_SHUFFLE(1,0,3,2));
 		result = _mm512_xor_si512(result, swapped);
@@ -330,13 +336,31 @@ static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_avx512(
 			_mm_prefetch(_pf+ptr, _MM_HINT_T1);
 	}
 }
+static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_avx512(
+	const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale,
+	GF16_MULADD_MULTI_SRCLIST, size_t len,
+	const uint16_t *HEDLEY_RESTRICT coefficients,
+	const int doPrefetch, const char* _pf
+) {
+	gf16_shuffle2x_muladd_x_impl_avx512(scratch, _dst, srcScale, GF16_MULADD_MULTI_SRCARGS, len, coefficients, doPrefetch, _pf, 0);
+}
+static HEDLEY_ALWAYS_INLINE void gf16_shuffle2x_muladd_x_natural_avx512(
+	const void *HEDLEY_RESTRICT scratch, uint8_t *HEDLEY_RESTRICT _dst, const unsigned srcScale,
+	GF16_MULADD_MULTI_SRCLIST, size_t len,
+	const uint16_t *HEDLEY_RESTRICT coefficients,
+	const int doPrefetch, const char* _pf
+) {
+	gf16_shuffle2x_muladd_x_impl_avx512(scratch, _dst, srcScale, GF16_MULADD_MULTI_SRCARGS, len, coefficients, doPrefetch, _pf, 1);
+}
 #endif // defined(_AVAILABLE)
 
 
 #if defined(_AVAILABLE) && !defined(PARPAR_SLIM_GF16) && defined(PLATFORM_AMD64)
 GF16_MULADD_MULTI_FUNCS(gf16_shuffle2x, _avx512, gf16_shuffle2x_muladd_x_avx512, 6, sizeof(__m512i), 0, _mm256_zeroupper())
+GF16_MULADD_MULTI_NATURAL_FUNCS(gf16_shuffle2x, _avx512, gf16_shuffle2x_muladd_x_natural_avx512, 6, _mm256_zeroupper())
 #else
 GF16_MULADD_MULTI_FUNCS_STUB(gf16_shuffle2x, _avx512)
+GF16_MULADD_MULTI_NATURAL_FUNCS_STUB(gf16_shuffle2x, _avx512)
 #endif
 
 
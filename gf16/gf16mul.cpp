@@ -460,8 +460,7 @@ Galois16MethodInfo Galois16Mul::info(Galois16Methods _method) {
 	if(!_info.cksumSize) _info.cksumSize = _info.alignment;
 	
 	// TODO: improve these?
-	// TODO: this probably needs to be variable depending on the CPU cache size
-	// although these defaults are pretty good across most CPUs
+	// these defaults are pretty good across most CPUs; PAR2ProcCPU reduces them on CPUs with a small L2
 	switch(method) {
 		case GF16_XOR_JIT_SSE2: // JIT is a little slow, so larger blocks make things faster
 			_info.idealChunkSize = 64*1024;
@@ -700,6 +699,8 @@ void Galois16Mul::setupMethod(Galois16Methods _method) {
 			SET_FOR_INVERT(_mul_add_multi_stridepf, gf16_shuffle2x_muladd_multi_stridepf_avx512);
 			_mul_add_multi_packed = &gf16_shuffle2x_muladd_multi_packed_avx512;
 			_mul_add_multi_packpf = &gf16_shuffle2x_muladd_multi_packpf_avx512;
+			_mul_add_multi_natural = &gf16_shuffle2x_muladd_multi_natural_avx512;
+			prepare_natural_cksum = &gf16_shuffle2x_prepare_natural_cksum_avx512;
 			SET_BASIC_OP(add_multi_packed, gf_add_multi_packed_v1i6_avx512);
 			add_multi_packpf = &gf_add_multi_packpf_v1i6_avx512;
 			#else
@@ -730,6 +731,8 @@ void Galois16Mul::setupMethod(Galois16Methods _method) {
 			SET_FOR_INVERT(_mul_add_multi_stridepf, gf16_shuffle2x_muladd_multi_stridepf_avx2);
 			_mul_add_multi_packed = &gf16_shuffle2x_muladd_multi_packed_avx2;
 			_mul_add_multi_packpf = &gf16_shuffle2x_muladd_multi_packpf_avx2;
+			_mul_add_multi_natural = &gf16_shuffle2x_muladd_multi_natural_avx2;
+			prepare_natural_cksum = &gf16_shuffle2x_prepare_natural_cksum_avx2;
 			SET_BASIC_OP(add_multi_packed, gf_add_multi_packed_v1i2_avx2);
 			add_multi_packpf = &gf_add_multi_packpf_v1i2_avx2;
 			#else
@@ -1146,6 +1149,8 @@ void Galois16Mul::setupMethod(Galois16Methods _method) {
 			SET_FOR_INVERT(_mul_add_multi_stridepf, gf16_affine2x_muladd_multi_stridepf_avx512);
 			_mul_add_multi_packed = &gf16_affine2x_muladd_multi_packed_avx512;
 			_mul_add_multi_packpf = &gf16_affine2x_muladd_multi_packpf_avx512;
+			_mul_add_multi_natural = &gf16_affine2x_muladd_multi_natural_avx512;
+			prepare_natural_cksum = &gf16_affine2x_prepare_natural_cksum_avx512;
 			SET_BASIC_OP(add_multi, gf_add_multi_avx512);
 			#ifdef PLATFORM_AMD64
 			SET_BASIC_OP(add_multi_packed, gf_add_multi_packed_v1i12_avx512);
@@ -1177,6 +1182,8 @@ void Galois16Mul::setupMethod(Galois16Methods _method) {
 			SET_FOR_INVERT(_mul_add_multi_stridepf, gf16_affine2x_muladd_multi_stridepf_avx10);
 			_mul_add_multi_packed = &gf16_affine2x_muladd_multi_packed_avx10;
 			_mul_add_multi_packpf = &gf16_affine2x_muladd_multi_packpf_avx10;
+			_mul_add_multi_natural = &gf16_affine2x_muladd_multi_natural_avx10;
+			prepare_natural_cksum = &gf16_affine2x_prepare_natural_cksum_avx10;
 			SET_BASIC_OP(add_multi, gf_add_multi_avx2);
 			#ifdef PLATFORM_AMD64
 			SET_BASIC_OP(add_multi_packed, gf_add_multi_packed_v1i12_avx10);
@@ -1208,6 +1215,8 @@ void Galois16Mul::setupMethod(Galois16Methods _method) {
 			SET_FOR_INVERT(_mul_add_multi_stridepf, gf16_affine2x_muladd_multi_stridepf_avx2);
 			_mul_add_multi_packed = &gf16_affine2x_muladd_multi_packed_avx2;
 			_mul_add_multi_packpf = &gf16_affine2x_muladd_multi_packpf_avx2;
+			_mul_add_multi_natural = &gf16_affine2x_muladd_multi_natural_avx2;
+			prepare_natural_cksum = &gf16_affine2x_prepare_natural_cksum_avx2;
 			SET_BASIC_OP(add_multi, gf_add_multi_avx2);
 			#ifdef PLATFORM_AMD64
 			SET_BASIC_OP(add_multi_packed, gf_add_multi_packed_v1i6_avx2);
@@ -1454,6 +1463,8 @@ Galois16Mul::Galois16Mul(Galois16Methods method) {
 #endif
 	_mul_add_multi_packed = NULL;
 	_mul_add_multi_packpf = NULL;
+	_mul_add_multi_natural = NULL;
+	prepare_natural_cksum = NULL;
 #ifdef PARPAR_OPENCL_SUPPORT
 	copy_cksum = &gf16_cksum_copy_generic;
 	copy_cksum_check = &gf16_cksum_copy_check_generic;
@@ -1504,6 +1515,8 @@ void Galois16Mul::move(Galois16Mul& other) {
 #endif
 	_mul_add_multi_packed = other._mul_add_multi_packed;
 	_mul_add_multi_packpf = other._mul_add_multi_packpf;
+	_mul_add_multi_natural = other._mul_add_multi_natural;
+	prepare_natural_cksum = other.prepare_natural_cksum;
 #ifdef PARPAR_POW_SUPPORT
 	_pow = other._pow;
 	_pow_add = other._pow_add;
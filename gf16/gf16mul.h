@@ -9,11 +9,12 @@
 
 typedef void(*Galois16MulTransform) (void* dst, const void* src, size_t srcLen);
 typedef void(*Galois16MulTransformPacked) (void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t srcLen, size_t sliceLen, unsigned inputPackSize, unsigned inputNum, size_t chunkLen);
+typedef void(*Galois16MulTransformNatural) (void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t srcLen, size_t sliceLen);
 typedef void(*Galois16MulTransformPackedPartial) (void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t srcLen, size_t sliceLen, unsigned inputPackSize, unsigned inputNum, size_t chunkLen, size_t partOffset, size_t partLen);
 typedef void(*Galois16MulUntransform) (void *HEDLEY_RESTRICT dst, size_t len);
 typedef void(*Galois16MulUntransformPacked) (void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen);
 typedef int(*Galois16MulUntransformPackedCksum) (void *HEDLEY_RESTRICT dst, const void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen);
-typedef int(*Galois16MulUntransformPackedCksumPartial) (void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen);
+typedef int(*Galois16MulUntransformPackedCksumPartial) (void *HEDLEY_RESTRICT dst, void *HEDLEY_RESTRICT src, size_t sliceLen, unsigned numOutputs, unsigned outputNum, size_t chunkLen, size_t partOffset, size_t partLen, void *HEDLEY_RESTRICT checksum);
 
 typedef uint16_t(*Galois16ReplaceWord) (void* data, size_t index, uint16_t newValue);
 
@@ -72,7 +73,6 @@ enum Galois16Methods {
 	GF16_CLMUL_SHA3,
 	GF16_CLMUL_SVE2,
 	GF16_CLMUL_RVV
-	// TODO: consider non-transforming shuffle/affine
 };
 static const char* Galois16MethodsText[] = {
 	"Auto",
@@ -139,6 +139,7 @@ private:
 #endif
 	Galois16MulPackedFunc _mul_add_multi_packed;
 	Galois16MulPackPfFunc _mul_add_multi_packpf;
+	Galois16MulMultiFunc _mul_add_multi_natural;
 	
 	static void _prepare_none(void* dst, const void* src, size_t srcLen) {
 		if(dst != src)
@@ -194,6 +195,10 @@ public:
 	inline bool hasMultiMulAddPacked() const {
 		return _mul_add_multi_packed != NULL;
 	};
+	// can multiply directly from untransformed (caller supplied) buffers, using prepare_natural_cksum + mul_add_multi_natural
+	inline bool hasNaturalInput() const {
+		return _mul_add_multi_natural != NULL;
+	};
 #ifdef PARPAR_POW_SUPPORT
 	inline bool hasPowAdd() const {
 		return _pow_add != NULL;
@@ -234,6 +239,8 @@ public:
 	Galois16MulUntransformPackedCksum finish_packed_cksum;
 	Galois16MulUntransformPackedCksumPartial finish_partial_packsum;
 	Galois16AddPackPfFunc add_multi_packpf;
+	// computes the checksum of an untransformed source, and writes the tail (part past the last full stride of the source, zero padding + checksum) to a slice sized buffer
+	Galois16MulTransformNatural prepare_natural_cksum;
 #ifdef PARPAR_OPENCL_SUPPORT
 	Galois16CopyCksum copy_cksum;
 	Galois16CopyCksumCheck copy_cksum_check;
@@ -413,6 +420,16 @@ public:
 		}
 	}
 	
+	// as with mul_add_multi, but sources are untransformed, and need not be aligned; requires hasNaturalInput()
+	inline void mul_add_multi_natural(unsigned regions, size_t offset, void *HEDLEY_RESTRICT dst, const void* const*HEDLEY_RESTRICT src, size_t len, const uint16_t *HEDLEY_RESTRICT coefficients, void *HEDLEY_RESTRICT mutScratch) const {
+		assert(isMultipleOfStride(len));
+		assert(len > 0);
+		assert(regions > 0);
+		assert(_mul_add_multi_natural);
+		
+		_mul_add_multi_natural(scratch, regions, offset, dst, src, len, coefficients, mutScratch);
+	}
+
 };
 
 #endif
@@ -2,6 +2,7 @@
 #include "gfmat_inv.h"
 #include "gf16pmul.h"
 #include <algorithm>
+#include <string.h>
 
 #ifdef PARPAR_INVERT_SUPPORT
 extern "C" uint16_t* gf16_recip;
@@ -9,16 +10,29 @@ extern "C" uint16_t* gf16_recip;
 #include <cassert>
 #include "../src/platform.h" // for ALIGN_*
 #include "gf16mul.h"
+#include "gf16_global.h" // GF16_POLYNOMIAL
 #include "threadqueue.h"
+#include "cpu_topology.h"
 #include <future>
 
 static const unsigned MIN_THREAD_REC = 10; // minimum number of rows to process on a thread
 
+// size of the matrix region (stripe width * rows in group) to process at a time, which should fit in L2
+// targeting larger L2 (e.g. >1MB) seems to perform worse, so cap it; 512K is a reasonable guess if the size is unknown, and also serves as a minimum, as it's worked well on CPUs with smaller L2
+static size_t rowGroupTarget() {
+	size_t l2 = cputopo_cache_info().l2PerCore();
+	if(l2 < 512*1024) return 512*1024;
+	if(l2 > 1024*1024) return 1024*1024;
+	return l2;
+}
+
 struct Galois16RecMatrixComputeState {
 	uint16_t* coeff;
 	Galois16Mul gf;
 	void* gfScratch;
 	unsigned validCount;
+	const std::vector<bool>* inputValid;
+	std::vector<uint16_t>* recovery; // exponent of each row, followed by unused (spare) recovery
 	void* srcRowsBase[PP_INVERT_MAX_MULTI_ROWS];
 	std::vector<Galois16RecMatrixWorker> workers;
 	unsigned pfFactor;
@@ -136,6 +150,18 @@ void Galois16RecMatrix::invertLoop(unsigned stripeStart, unsigned stripeEnd, uns
 
 #define REPLACE_WORD(r, c, v) state.gf.replace_word(MAT_ROW((c)/(stripeWidth / sizeof(uint16_t)), r), (c)%(stripeWidth / sizeof(uint16_t)), v)
 
+// scalar multiply, only used for checking the small pivot block, so a simple shift-and-add suffices
+static inline uint16_t gf16_mul_scalar(uint16_t a, uint16_t b) {
+	uint32_t r = 0, x = a;
+	while(b) {
+		if(b & 1) r ^= x;
+		b >>= 1;
+		x <<= 1;
+		if(x & 0x10000) x ^= GF16_POLYNOMIAL;
+	}
+	return (uint16_t)r;
+}
+
 template<unsigned rows>
 int Galois16RecMatrix::scaleRows(Galois16RecMatrixComputeState& state, unsigned rec, unsigned recFirst, unsigned recLast) {
 	assert(recFirst <= recLast);
@@ -207,7 +233,28 @@ int Galois16RecMatrix::scaleRows(Galois16RecMatrixComputeState& state, unsigned
 	if(!state.workers.empty() && recFirst < recLast)
 		nextScaleRow = MAT_ROW(0, recFirst); // only prefetch if we're not sending data to threads
 	
-	// TODO: consider loop tiling this stuff; requires extracting a small matrix (rows*rows), and solving that, which means a scalar multiply is necessary
+	// loop tiling this (solving the rows*rows block below, then applying its inverse as a block) was tried, but measured no faster than the row-by-row elimination, as the block is only a few rows; likewise for widening or retiling the cross-group update in processRows
+	
+	if(rows > 1) {
+		// check the pivot block before touching any rows, as a bad row gets replaced (see replaceRow), which needs the rest of the block to be left as is
+		// elimination follows the same (unpivoted) order as below, so the same row is identified as bad
+		uint16_t block[rows][rows];
+		for(unsigned r=0; r<rows; r++)
+			for(unsigned c=0; c<rows; c++) {
+				block[r][c] = REPLACE_WORD(rec+r, missingCol+c, 0);
+				REPLACE_WORD(rec+r, missingCol+c, block[r][c]);
+			}
+		for(unsigned p=0; p<rows; p++) {
+			if(HEDLEY_UNLIKELY(block[p][p] == 0)) /* bad recovery coeff */
+				return p;
+			uint16_t factor = gf16_recip[block[p][p]];
+			for(unsigned r=p+1; r<rows; r++) {
+				uint16_t coeff = gf16_mul_scalar(block[r][p], factor);
+				for(unsigned c=p+1; c<rows; c++)
+					block[r][c] ^= gf16_mul_scalar(block[p][c], coeff);
+			}
+		}
+	}
 	
 	// rescale the row
 	SCALE_ROW(0);
@@ -290,6 +337,42 @@ void Galois16RecMatrix::fillCoeffs(Galois16RecMatrixComputeState& state, unsigne
 	}
 }
 
+// bring a freshly constructed row up to the elimination state of the pivot rows [srcFirst, srcFirst+srcCount), which must already be reduced against each other
+void Galois16RecMatrix::reduceRow(Galois16RecMatrixComputeState& state, unsigned row, unsigned srcFirst, unsigned srcCount) {
+	if(srcCount < 1) return;
+	// all coefficients need to be read before any are applied, as the pivot columns of the sources hold values of the inverse, which get added into those of the row
+	std::vector<uint16_t> coeffs(srcCount);
+	unsigned missingCol = state.validCount + srcFirst;
+	for(unsigned c=0; c<srcCount; c++)
+		coeffs[c] = REPLACE_WORD(row, missingCol+c, 0);
+	
+	for(unsigned stripe=0; stripe<numStripes; stripe++) {
+		for(unsigned c=0; c<srcCount; c+=PP_INVERT_MAX_MULTI_ROWS) {
+			unsigned numRows = (std::min)(srcCount-c, PP_INVERT_MAX_MULTI_ROWS);
+			unsigned offset = (srcFirst+c)*stripeWidth;
+			state.gf.mul_add_multi(numRows, stripeWidth*numRec*stripe + offset, MAT_ROW(0, row) - offset/sizeof(uint16_t), state.srcRowsBase, stripeWidth, coeffs.data() + c, state.gfScratch);
+		}
+	}
+}
+
+// replace a row which can't be inverted with a spare recovery row, bringing it up to the current elimination state
+// rows before recStart have been fully processed, whilst the pivots [recStart, rec) have only been applied to the current row group (which `row` is in)
+bool Galois16RecMatrix::replaceRow(Galois16RecMatrixComputeState& state, unsigned row, unsigned recStart, unsigned rec) {
+	std::vector<uint16_t>& recovery = *state.recovery;
+	if(recovery.size() <= numRec) return false; // no spare recovery
+	recovery[row] = recovery[numRec];
+	recovery.erase(recovery.begin() + numRec);
+	
+	ConstructRow(*state.inputValid, state.validCount, row, recovery[row]);
+	if(state.gf.needPrepare()) {
+		for(unsigned stripe=0; stripe<numStripes; stripe++)
+			state.gf.prepare(MAT_ROW(stripe, row), MAT_ROW(stripe, row), stripeWidth);
+	}
+	reduceRow(state, row, 0, recStart);
+	reduceRow(state, row, recStart, rec-recStart);
+	return true;
+}
+
 template<unsigned rows>
 void Galois16RecMatrix::applyRows(Galois16RecMatrixComputeState& state, unsigned rec, unsigned recCount, unsigned recFirst, unsigned recLast, unsigned coeffWidth, int nextRow) {
 	// TODO: consider optimisation for numStripes == 1 ?
@@ -389,7 +472,7 @@ void Galois16RecMatrix::applyRows(Galois16RecMatrixComputeState& state, unsigned
 
 
 template<unsigned rows>
-int Galois16RecMatrix::processRows(Galois16RecMatrixComputeState& state, unsigned& rec, unsigned rowGroupSize, std::function<void(uint16_t, uint16_t)> progressCb, uint16_t progressOffset, uint16_t totalProgress) {
+bool Galois16RecMatrix::processRows(Galois16RecMatrixComputeState& state, unsigned& rec, unsigned rowGroupSize, std::function<void(uint16_t, uint16_t)> progressCb, uint16_t progressOffset, uint16_t totalProgress) {
 	unsigned alignedRowGroupSize = (rowGroupSize / rows) * rows;
 	while(rec <= numRec-rows) {
 		
@@ -411,8 +494,12 @@ int Galois16RecMatrix::processRows(Galois16RecMatrixComputeState& state, unsigne
 			unsigned recFirst = recStart;
 			if(recFirst == rec) recFirst += rows;
 			
-			int badRowOffset = scaleRows<rows>(state, rec, recFirst, curRowGroupSize+recStart);
-			if(badRowOffset >= 0) return rec+badRowOffset;
+			int badRowOffset;
+			while((badRowOffset = scaleRows<rows>(state, rec, recFirst, curRowGroupSize+recStart)) >= 0) {
+				// hit the PAR2 un-invertability flaw: swap in another recovery row and retry
+				if(!replaceRow(state, rec+badRowOffset, recStart, rec))
+					return false;
+			}
 			if(recFirst == curRowGroupSize+recStart) continue;
 			fillCoeffs(state, rows, recFirst, curRowGroupSize+recStart, rec, rows);
 			
@@ -453,7 +540,7 @@ int Galois16RecMatrix::processRows(Galois16RecMatrixComputeState& state, unsigne
 			recGroup += curRowGroupSize2;
 		}
 	}
-	return -1;
+	return true;
 }
 
 
@@ -557,6 +644,20 @@ void Galois16RecMatrix::Construct(const std::vector<bool>& inputValid, unsigned
 	#undef CONSTRUCT_VIA_EXP
 }
 
+// construct a single row of the initial matrix, for the recovery slice with exponent `exp`
+void Galois16RecMatrix::ConstructRow(const std::vector<bool>& inputValid, unsigned validCount, unsigned row, uint16_t exp) {
+	unsigned sw16 = stripeWidth/sizeof(uint16_t);
+	for(unsigned stripe=0; stripe<numStripes; stripe++)
+		memset(mat + (stripe*numRec + row) * sw16, 0, stripeWidth);
+	
+	unsigned validCol = 0;
+	unsigned missingCol = validCount;
+	for(unsigned input = 0; input < inputValid.size(); input++) {
+		unsigned targetCol = inputValid[input] ? validCol++ : missingCol++;
+		mat[(targetCol/sw16)*sw16*numRec + row*sw16 + (targetCol%sw16)] = _LE16(gfmat_coeff(input, exp));
+	}
+}
+
 bool Galois16RecMatrix::Compute(const std::vector<bool>& inputValid, unsigned validCount, std::vector<uint16_t>& recovery, std::function<void(uint16_t, uint16_t)> progressCb) {
 	numRec = (unsigned)inputValid.size() - validCount;
 	assert(validCount < inputValid.size()); // i.e. numRec > 0
@@ -616,9 +717,7 @@ bool Galois16RecMatrix::Compute(const std::vector<bool>& inputValid, unsigned va
 	} else
 		state.gfScratch = state.gf.mutScratch_alloc();
 	
-	// target L2 size - 512K seems to be a reasonable guess for now; TODO: improve this
-	// - targeting larger L2 (e.g. >1MB) seems to perform worse, so a fixed size might end up being better
-	unsigned rowGroupSize = (512*1024 / stripeWidth);
+	unsigned rowGroupSize = (unsigned)(rowGroupTarget() / stripeWidth);
 	// if it's going to be split amongst cores, increase the number of rows in a group
 	if(numStripes < _numThreads) rowGroupSize *= _numThreads/numStripes;
 	unsigned rowMultiple = (std::min)(gfInfo.idealInputMultiple, PP_INVERT_MAX_MULTI_ROWS);
@@ -628,61 +727,55 @@ bool Galois16RecMatrix::Compute(const std::vector<bool>& inputValid, unsigned va
 	std::vector<uint16_t> stateCoeff(rowGroupSize*rowGroupSize);
 	state.coeff = stateCoeff.data();
 	
-	invert_loop: { // loop, in the unlikely case we hit the PAR2 un-invertability flaw; TODO: is there a faster way than just retrying?
-		if(numRec > recovery.size()) { // not enough recovery
-			if(_numThreads <= 1)
-				state.gf.mutScratch_free(state.gfScratch);
-			ALIGN_FREE(mat);
-			mat = nullptr;
-			return false;
-		}
-		
-		if(progressCb) progressCb(0, totalProgress);
-		Construct(inputValid, validCount, recovery);
+	state.inputValid = &inputValid;
+	state.recovery = &recovery;
+	
+	if(progressCb) progressCb(0, totalProgress);
+	Construct(inputValid, validCount, recovery);
+	
+	// pre-transform
+	uint16_t progressOffset = 1;
+	if(state.gf.needPrepare()) {
+		if(progressCb) progressCb(1, totalProgress);
+		progressOffset = 2;
 		
-		// pre-transform
-		uint16_t progressOffset = 1;
-		if(state.gf.needPrepare()) {
-			if(progressCb) progressCb(1, totalProgress);
-			progressOffset = 2;
-			
-			state.gf.prepare(mat, mat, matSize);
+		state.gf.prepare(mat, mat, matSize);
+	}
+	
+	// invert; if a row can't be inverted, it's replaced with spare recovery (see replaceRow), and processing continues from where it was
+	unsigned rec = 0;
+	bool success = true;
+	#define INVERT_GROUP(rows) \
+		if(success && gfInfo.idealInputMultiple >= rows && numRec >= rows) { \
+			success = processRows<rows>(state, rec, rowGroupSize, progressCb, progressOffset, totalProgress); \
 		}
+	// max out at 6 groups (registers + cache assoc?)
+	INVERT_GROUP(6)
+	INVERT_GROUP(5)
+	INVERT_GROUP(4)
+	INVERT_GROUP(3)
+	INVERT_GROUP(2)
+	INVERT_GROUP(1)
+	#undef INVERT_GROUP
+	
+	if(_numThreads <= 1)
+		state.gf.mutScratch_free(state.gfScratch);
+	if(!success) { // not enough recovery
+		ALIGN_FREE(mat);
+		mat = nullptr;
+		return false;
+	}
+	
+	// post transform
+	if(state.gf.needPrepare()) {
+		if(progressCb) progressCb(totalProgress-1, totalProgress);
 		
-		// invert
-		unsigned rec = 0;
-		#define INVERT_GROUP(rows) \
-			if(gfInfo.idealInputMultiple >= rows && numRec >= rows) { \
-				int badRow = processRows<rows>(state, rec, rowGroupSize, progressCb, progressOffset, totalProgress); \
-				if(badRow >= 0) { \
-					/* ignore this recovery row and try again */ \
-					recovery.erase(recovery.begin() + badRow); \
-					goto invert_loop; \
-				} \
-			}
-		// max out at 6 groups (registers + cache assoc?)
-		INVERT_GROUP(6)
-		INVERT_GROUP(5)
-		INVERT_GROUP(4)
-		INVERT_GROUP(3)
-		INVERT_GROUP(2)
-		INVERT_GROUP(1)
-		#undef INVERT_GROUP
-		
-		// post transform
-		if(state.gf.needPrepare()) {
-			if(progressCb) progressCb(totalProgress-1, totalProgress);
-			
-			state.gf.finish(mat, matSize);
-			// TODO: check for zeroes??
-		}
+		state.gf.finish(mat, matSize);
+		// TODO: check for zeroes??
 	}
 	
 	// remove excess recovery
 	recovery.resize(numRec);
-	
-	if(_numThreads <= 1)
-		state.gf.mutScratch_free(state.gfScratch);
 	return true;
 }
 
@@ -2,6 +2,7 @@
 #define __THREADQUEUE_H__
 
 #include <memory>
+#include <vector>
 #ifdef USE_LIBUV
 # include <uv.h>
 # define thread_t uv_thread_t
@@ -34,108 +35,223 @@
 # define condvar_signal(c) c->notify_one()
 #endif
 #include <queue>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 
+// multi-producer queue for passing messages to a thread
+// messages go through a fixed size lock-free ring; the mutex is only taken if the consumer needs to sleep (i.e. the ring is empty), or if the ring fills up, in which case messages spill into an unbounded overflow queue
+// messages from the same producer are always received in the order they were sent
 template<typename T>
 class ThreadMessageQueue {
-	std::queue<T> q;
-	mutable mutex_t mutex;
-	condvar_t cond;
-	bool skipDestructor;
+	static const size_t RING_SIZE = 256; // must be a power of 2
+	struct Cell {
+		std::atomic<size_t> seq; // == position when free for a push, == position+1 when holding a message
+		T item;
+	};
+	struct State {
+		Cell ring[RING_SIZE];
+		// keep positions on separate cache lines, as they're updated by different threads
+		char pad0[64];
+		std::atomic<size_t> pushPos;
+		char pad1[64];
+		std::atomic<size_t> popPos;
+		char pad2[64];
+		std::atomic<size_t> overflowCount;
+		std::atomic<unsigned> waiters; // number of threads sleeping (or about to) in pop()
+		std::queue<T> overflow; // protected by mutex
+		mutable mutex_t mutex;
+		condvar_t cond;
+		
+		State() : pushPos(0), popPos(0), overflowCount(0), waiters(0) {
+			for(size_t i=0; i<RING_SIZE; i++)
+				ring[i].seq.store(i, std::memory_order_relaxed);
+			mutex_init(mutex);
+			condvar_init(cond);
+		}
+		~State() {
+			mutex_destroy(mutex);
+			condvar_destroy(cond);
+		}
+	};
+	std::unique_ptr<State> s; // held indirectly, so that the queue can be moved
 	
 	// disable copy constructor
 	ThreadMessageQueue(const ThreadMessageQueue&);
 	ThreadMessageQueue& operator=(const ThreadMessageQueue&);
-	// ...but allow moves
-	void move(ThreadMessageQueue& other) {
-		q = std::move(other.q);
-#ifdef USE_LIBUV
-		mutex = other.mutex;
-		cond = other.cond;
-#else
-		mutex = std::move(other.mutex);
-		cond = std::move(other.cond);
-#endif
-		skipDestructor = false;
-		
-		other.skipDestructor = true;
-	}
 	
-	
-public:
-	ThreadMessageQueue() {
-		mutex_init(mutex);
-		condvar_init(cond);
-		skipDestructor = false;
+	bool ring_push(T item) {
+		size_t pos = s->pushPos.load(std::memory_order_relaxed);
+		Cell* cell;
+		while(1) {
+			cell = s->ring + (pos & (RING_SIZE-1));
+			intptr_t diff = (intptr_t)(cell->seq.load(std::memory_order_acquire) - pos);
+			if(diff == 0) {
+				if(s->pushPos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+					break;
+			} else if(diff < 0) // full: the cell hasn't been popped since the last time around
+				return false;
+			else // another producer took this position
+				pos = s->pushPos.load(std::memory_order_relaxed);
+		}
+		cell->item = item;
+		cell->seq.store(pos+1, std::memory_order_release);
+		return true;
 	}
-	~ThreadMessageQueue() {
-		if(skipDestructor) return;
-		mutex_destroy(mutex);
-		condvar_destroy(cond);
+	bool ring_pop(T* item) {
+		size_t pos = s->popPos.load(std::memory_order_relaxed);
+		Cell* cell;
+		while(1) {
+			cell = s->ring + (pos & (RING_SIZE-1));
+			intptr_t diff = (intptr_t)(cell->seq.load(std::memory_order_acquire) - (pos+1));
+			if(diff == 0) {
+				if(s->popPos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+					break;
+			} else if(diff < 0) // empty, or the push to this cell hasn't completed yet
+				return false;
+			else
+				pos = s->popPos.load(std::memory_order_relaxed);
+		}
+		*item = cell->item;
+		cell->seq.store(pos + RING_SIZE, std::memory_order_release);
+		return true;
 	}
-	
-	ThreadMessageQueue(ThreadMessageQueue&& other) noexcept {
-		move(other);
+	void push_overflow(T item) {
+		mutex_lock(s->mutex);
+		s->overflow.push(item);
+		s->overflowCount.fetch_add(1, std::memory_order_release);
+		mutex_unlock(s->mutex);
+	}
+	void _push(T item) {
+		// once the overflow is in use, keep using it until it's drained, so that messages stay in order
+		if(s->overflowCount.load(std::memory_order_acquire) || !ring_push(item))
+			push_overflow(item);
 	}
+	bool _trypop(T* item, bool locked) {
+		if(ring_pop(item)) return true;
+		if(!s->overflowCount.load(std::memory_order_acquire)) return false;
+		// messages in the overflow were sent after everything in the ring, so only take from it once the ring is drained, including pushes still in progress
+		if(s->pushPos.load(std::memory_order_acquire) != s->popPos.load(std::memory_order_relaxed)) return false;
+		if(!locked) mutex_lock(s->mutex);
+		bool notEmpty = !s->overflow.empty();
+		if(notEmpty) {
+			*item = s->overflow.front();
+			s->overflow.pop();
+			s->overflowCount.fetch_sub(1, std::memory_order_release);
+		}
+		if(!locked) mutex_unlock(s->mutex);
+		return notEmpty;
+	}
+	void wake() {
+		// pairs with the fence in pop(): either the consumer sees the message, or we see that it's waiting
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(s->waiters.load(std::memory_order_relaxed)) {
+			mutex_lock(s->mutex);
+			condvar_signal(s->cond);
+			mutex_unlock(s->mutex);
+		}
+	}
+
+public:
+	ThreadMessageQueue() : s(new State()) {}
+	
+	ThreadMessageQueue(ThreadMessageQueue&& other) noexcept : s(std::move(other.s)) {}
 	ThreadMessageQueue& operator=(ThreadMessageQueue&& other) noexcept {
-		move(other);
+		s = std::move(other.s);
 		return *this;
 	}
 	void push(T item) {
-		mutex_lock(mutex);
-		q.push(item);
-		condvar_signal(cond);
-		mutex_unlock(mutex);
+		_push(item);
+		wake();
 	}
 	template<class Iterable>
 	void push_multi(const Iterable& list) {
-		mutex_lock(mutex);
 		for(auto it = list.cbegin(); it != list.cend(); ++it) {
-			q.push(*it);
+			_push(*it);
 		}
-		condvar_signal(cond);
-		mutex_unlock(mutex);
+		wake();
+	}
+	// push without spilling into the overflow; returns false if the ring is full
+	bool trypush(T item) {
+		if(s->overflowCount.load(std::memory_order_acquire) || !ring_push(item))
+			return false;
+		wake();
+		return true;
 	}
 	T pop() {
+		T item;
+		if(_trypop(&item, false)) return item;
+		
+		// nothing available, so sleep until a message is pushed
 #ifdef USE_LIBUV
-		mutex_lock(mutex);
-		while(q.empty()) {
-			uv_cond_wait(&cond, &mutex);
+		mutex_lock(s->mutex);
+		s->waiters.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while(!_trypop(&item, true)) {
+			uv_cond_wait(&s->cond, &s->mutex);
 		}
-		T item = q.front();
-		q.pop();
-		mutex_unlock(mutex);
+		s->waiters.fetch_sub(1, std::memory_order_relaxed);
+		mutex_unlock(s->mutex);
 #else
-		std::unique_lock<std::mutex> lk(*mutex);
-		cond->wait(lk, [this]{ return !q.empty(); });
-		T item = q.front();
-		q.pop();
+		std::unique_lock<std::mutex> lk(*s->mutex);
+		s->waiters.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		s->cond->wait(lk, [&]{ return _trypop(&item, true); });
+		s->waiters.fetch_sub(1, std::memory_order_relaxed);
 #endif
 		return item;
 	}
 	
 	bool trypop(T* item) {
-		bool notEmpty;
-		mutex_lock(mutex);
-		notEmpty = !q.empty();
-		if(notEmpty) {
-			*item = q.front();
-			q.pop();
-		}
-		mutex_unlock(mutex);
-		return notEmpty;
+		return _trypop(item, false);
+	}
+	// look at the next message without removing it; only safe if this is the only thread which pops from the queue (otherwise the message may be taken, and reused, at any time)
+	// messages in the overflow aren't considered
+	bool trypeek(T* item) const {
+		size_t pos = s->popPos.load(std::memory_order_relaxed);
+		const Cell* cell = s->ring + (pos & (RING_SIZE-1));
+		if(cell->seq.load(std::memory_order_acquire) != pos+1) return false;
+		*item = cell->item;
+		return true;
 	}
 	
+	// note that these are only a snapshot, as other threads may be pushing/popping concurrently
 	size_t size() const {
-		mutex_lock(mutex);
-		size_t s = q.size();
-		mutex_unlock(mutex);
-		return s;
+		size_t popPos = s->popPos.load(std::memory_order_acquire);
+		size_t ringSize = s->pushPos.load(std::memory_order_acquire) - popPos;
+		if(ringSize > RING_SIZE) ringSize = RING_SIZE; // pops happened between the two loads
+		return ringSize + s->overflowCount.load(std::memory_order_acquire);
 	}
 	bool empty() const {
-		mutex_lock(mutex);
-		bool e = q.empty();
-		mutex_unlock(mutex);
-		return e;
+		return size() == 0;
+	}
+};
+
+// recycles objects between threads, to avoid going through the allocator for frequently created requests
+// objects aren't reset when recycled, so all members must be initialised after get()
+template<typename T>
+class ThreadObjectPool {
+	ThreadMessageQueue<T*> free;
+	
+	// disable copy constructor
+	ThreadObjectPool(const ThreadObjectPool&);
+	ThreadObjectPool& operator=(const ThreadObjectPool&);
+public:
+	ThreadObjectPool() {}
+	~ThreadObjectPool() {
+		T* obj;
+		while(free.trypop(&obj))
+			delete obj;
+	}
+	T* get() {
+		T* obj;
+		if(free.trypop(&obj)) return obj;
+		return new T;
+	}
+	void put(T* obj) {
+		// if the pool is full, just free it
+		if(!free.trypush(obj))
+			delete obj;
 	}
 };
 
@@ -219,13 +335,36 @@ typedef std::function<void(ThreadMessageQueue<void*>&)> thread_cb_t;
 #if defined(__linux) || defined(__linux__)
 # include <unistd.h>
 # include <sys/prctl.h>
+# include <sched.h>
 #endif
+
+// restrict the calling thread to the specified CPUs; returns false if unsupported
+static inline bool thread_set_affinity(const std::vector<int>& cpus) {
+#if defined(_WINDOWS) || defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+	// TODO: support processor groups
+	DWORD_PTR mask = 0;
+	for(int cpu : cpus)
+		if(cpu >= 0 && cpu < (int)sizeof(DWORD_PTR)*8) mask |= (DWORD_PTR)1 << cpu;
+	return mask && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif (defined(__linux) || defined(__linux__)) && defined(CPU_SET)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for(int cpu : cpus)
+		if(cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	(void)cpus;
+	return false;
+#endif
+}
+
 class MessageThread {
 	ThreadMessageQueue<void*> q;
 	thread_t thread;
 	bool threadActive;
 	bool threadCreated;
 	thread_cb_t cb;
+	std::vector<int> threadAffinity; // affinity used by the running thread
 	
 	static void thread_func(void* parent) {
 		MessageThread* self = static_cast<MessageThread*>(parent);
@@ -308,6 +447,9 @@ class MessageThread {
 			#endif
 		}
 		
+		if(!self->threadAffinity.empty())
+			thread_set_affinity(self->threadAffinity);
+		
 		self->cb(self->q);
 	}
 	
@@ -327,6 +469,8 @@ class MessageThread {
 		cb = other.cb;
 		name = other.name;
 		lowPrio = other.lowPrio;
+		cpuAffinity = std::move(other.cpuAffinity);
+		threadAffinity = std::move(other.threadAffinity);
 		
 		other.threadActive = false;
 		other.threadCreated = false;
@@ -335,6 +479,7 @@ class MessageThread {
 public:
 	bool lowPrio;
 	const char* name;
+	std::vector<int> cpuAffinity; // if non-empty, pin the thread to these CPUs; only applied when the thread is (re)started
 	MessageThread() {
 		cb = NULL;
 		threadActive = false;
@@ -372,6 +517,7 @@ public:
 		threadActive = true;
 		if(threadCreated) // previously created, but end fired, so need to wait for this thread to close before starting another
 			thread_join(thread);
+		threadAffinity = cpuAffinity;
 		threadCreated = true;
 		thread_create(thread, thread_func, this);
 	}
@@ -0,0 +1,150 @@
+#include "hasher_blockscan.h"
+
+#ifdef PARPAR_ENABLE_HASHER_MD5CRC
+#include "hasher_md5crc.h"
+#include "crc_zeropad.h"
+#include "../src/hedley.h"
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <string.h>
+
+extern const uint32_t Crc32Lookup[4][256];
+
+// number of windows rolled at once by each thread (this is fixed by the unrolled loop in scanRange)
+#define SCAN_LANES 4
+// minimum number of windows for a lane/thread, so that the setup (computing the CRC of the first window) stays a small part of its work
+static const size_t SCAN_MIN_LANE = 4096;
+static const size_t SCAN_MIN_THREAD = 256*1024;
+
+BlockScanner::BlockScanner(size_t _blockSize, const std::vector<BlockScanChecksum>& blocks) : blockSize(_blockSize), checksums(blocks) {
+	// the rolled CRC is computed with a zero initial value and no final inversion, so that it's linear in the window's contents
+	zeroCrc = crc_zeroPad(0, blockSize);
+	// when a byte enters the window, the byte leaving it is followed by blockSize bytes; its contribution to the CRC is removed by shifting it by that many zeroes
+	for(unsigned b=0; b<256; b++)
+		outTable[b] = ~crc_zeroPad(~Crc32Lookup[0][b], blockSize);
+	
+	crcs.reserve(blocks.size());
+	for(uint32_t i=0; i<blocks.size(); i++)
+		crcs.push_back(std::make_pair(blocks[i].crc ^ zeroCrc, i));
+	std::sort(crcs.begin(), crcs.end());
+	
+	// aim for a sparse filter (<= 1/256 occupancy), as each hit costs a search and likely a branch mispredict; capped at 2MB
+	size_t filterBits = 4096;
+	while(filterBits < crcs.size()*256 && filterBits < ((size_t)1 << 24))
+		filterBits <<= 1;
+	filterMask = (uint32_t)(filterBits - 1);
+	filter.assign(filterBits / 64, 0);
+	for(const auto& crc : crcs)
+		filter[(crc.first & filterMask) >> 6] |= (uint64_t)1 << (crc.first & 63);
+}
+
+void BlockScanner::confirm(const uint8_t* window, uint32_t crc, uint64_t offset, std::vector<BlockScanMatch>& matches) const {
+	auto it = std::lower_bound(crcs.begin(), crcs.end(), std::make_pair(crc, (uint32_t)0));
+	if(it == crcs.end() || it->first != crc) return;
+	uint8_t md5[16];
+	MD5CRC_Calc(window, blockSize, 0, md5);
+	for(; it != crcs.end() && it->first == crc; ++it) {
+		if(!memcmp(md5, checksums[it->second].md5, 16))
+			matches.push_back({offset, it->second});
+	}
+}
+
+// checks windows starting in [start, end); data must extend to end+blockSize-1
+void BlockScanner::scanRange(const uint8_t* data, size_t start, size_t end, uint64_t baseOffset, std::vector<BlockScanMatch>& matches) const {
+	// local copies, so that they stay in registers across the (rarely taken) confirm calls
+	const size_t len = blockSize;
+	const uint64_t* filterData = filter.data();
+	const uint32_t mask = filterMask;
+	const uint32_t* out = outTable;
+	
+	#define SCAN_INIT(crc, pos) \
+		uint32_t crc = CRC32_Calc(pos, len) ^ zeroCrc
+	#define SCAN_CHECK(crc, pos, found) \
+		if(HEDLEY_UNLIKELY(filterData[(crc & mask) >> 6] & ((uint64_t)1 << (crc & 63)))) \
+			confirm(pos, crc, baseOffset + (pos - data), found)
+	#define SCAN_ROLL(crc, pos) \
+		crc = (crc >> 8) ^ Crc32Lookup[0][(crc ^ pos[len]) & 0xff] ^ out[pos[0]]; \
+		pos++
+	
+	// each step depends on the previous, so split the range into lanes and roll them together
+	const uint8_t* pos = data + start;
+	std::vector<BlockScanMatch> laneMatches[SCAN_LANES-1]; // lane 0 adds to `matches` directly
+	if(end-start >= SCAN_LANES*SCAN_MIN_LANE) {
+		size_t laneLen = (end-start) / SCAN_LANES;
+		const uint8_t* pos1 = pos + laneLen;
+		const uint8_t* pos2 = pos1 + laneLen;
+		const uint8_t* pos3 = pos2 + laneLen;
+		SCAN_INIT(crc0, pos);
+		SCAN_INIT(crc1, pos1);
+		SCAN_INIT(crc2, pos2);
+		SCAN_INIT(crc3, pos3);
+		for(size_t i=1; i<laneLen; i++) {
+			SCAN_CHECK(crc0, pos, matches);
+			SCAN_ROLL(crc0, pos);
+			SCAN_CHECK(crc1, pos1, laneMatches[0]);
+			SCAN_ROLL(crc1, pos1);
+			SCAN_CHECK(crc2, pos2, laneMatches[1]);
+			SCAN_ROLL(crc2, pos2);
+			SCAN_CHECK(crc3, pos3, laneMatches[2]);
+			SCAN_ROLL(crc3, pos3);
+		}
+		// the last window of each lane, except the last lane, which continues below
+		SCAN_CHECK(crc0, pos, matches);
+		SCAN_CHECK(crc1, pos1, laneMatches[0]);
+		SCAN_CHECK(crc2, pos2, laneMatches[1]);
+		matches.insert(matches.end(), laneMatches[0].begin(), laneMatches[0].end());
+		matches.insert(matches.end(), laneMatches[1].begin(), laneMatches[1].end());
+		
+		// the last lane also covers any windows left over from the split
+		pos = pos3;
+		const uint8_t* lastPos = data + end-1;
+		while(1) {
+			SCAN_CHECK(crc3, pos, laneMatches[2]);
+			if(pos == lastPos) break;
+			SCAN_ROLL(crc3, pos);
+		}
+		matches.insert(matches.end(), laneMatches[2].begin(), laneMatches[2].end());
+	} else {
+		const uint8_t* lastPos = data + end-1;
+		SCAN_INIT(crc, pos);
+		while(1) {
+			SCAN_CHECK(crc, pos, matches);
+			if(pos == lastPos) break;
+			SCAN_ROLL(crc, pos);
+		}
+	}
+	#undef SCAN_INIT
+	#undef SCAN_CHECK
+	#undef SCAN_ROLL
+}
+
+void BlockScanner::scan(const void* data, size_t len, std::vector<BlockScanMatch>& matches, uint64_t baseOffset, int numThreads) const {
+	if(blockSize < 1 || len < blockSize || crcs.empty()) return;
+	const uint8_t* data_ = static_cast<const uint8_t*>(data);
+	size_t numWindows = len - blockSize + 1;
+	
+	if(numThreads <= 0) numThreads = (int)std::thread::hardware_concurrency();
+	if((size_t)numThreads > numWindows / SCAN_MIN_THREAD) numThreads = (int)(numWindows / SCAN_MIN_THREAD);
+	if(numThreads <= 1) {
+		scanRange(data_, 0, numWindows, baseOffset, matches);
+		return;
+	}
+	
+	// the first range is scanned on this thread
+	size_t threadLen = numWindows / numThreads;
+	std::vector<std::vector<BlockScanMatch>> threadMatches(numThreads);
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads-1);
+	for(int t=1; t<numThreads; t++) {
+		size_t end = t == numThreads-1 ? numWindows : (t+1)*threadLen;
+		threads.emplace_back(&BlockScanner::scanRange, this, data_, t*threadLen, end, baseOffset, std::ref(threadMatches[t]));
+	}
+	scanRange(data_, 0, threadLen, baseOffset, matches);
+	for(int t=1; t<numThreads; t++) {
+		threads[t-1].join();
+		matches.insert(matches.end(), threadMatches[t].begin(), threadMatches[t].end());
+	}
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef __HASHER_BLOCKSCAN_H
+#define __HASHER_BLOCKSCAN_H
+
+#ifdef PARPAR_ENABLE_HASHER_MD5CRC
+#include "../src/stdint.h"
+#include <vector>
+#include <cstddef>
+
+// checksums of a block to search for, as listed in the PAR2 IFSC packet
+struct BlockScanChecksum {
+	uint8_t md5[16];
+	uint32_t crc;
+};
+
+struct BlockScanMatch {
+	uint64_t offset; // position of the block in the scanned data
+	uint32_t block; // index into the list of checksums
+};
+
+// finds blocks at arbitrary byte offsets, by rolling a CRC32 over every block sized window, and confirming candidates via MD5
+// only full sized blocks are searched for, as the CRC of a partial (zero padded) block can't be rolled
+// requires the MD5/CRC hashers to be set up (see set_hasherMD5CRC)
+class BlockScanner {
+	size_t blockSize;
+	uint32_t outTable[256]; // CRC contribution of a byte leaving the window
+	uint32_t zeroCrc; // CRC of a block of zeroes; XORing this converts between the rolled (zero initial) CRC and the real one
+	std::vector<uint64_t> filter; // bitmap of the low bits of rolled CRCs to search for, to quickly reject most windows
+	uint32_t filterMask;
+	std::vector<std::pair<uint32_t, uint32_t>> crcs; // (rolled CRC, block index), sorted
+	std::vector<BlockScanChecksum> checksums;
+	
+	void scanRange(const uint8_t* data, size_t start, size_t end, uint64_t baseOffset, std::vector<BlockScanMatch>& matches) const;
+	void confirm(const uint8_t* window, uint32_t crc, uint64_t offset, std::vector<BlockScanMatch>& matches) const;
+public:
+	BlockScanner(size_t blockSize, const std::vector<BlockScanChecksum>& blocks);
+	inline size_t getBlockSize() const {
+		return blockSize;
+	}
+	
+	// find all blocks in `data`, appending matches, in order of offset, to `matches`; `baseOffset` is added to reported offsets
+	// to scan a file in pieces, consecutive pieces must overlap by blockSize-1 bytes
+	// the data is split across `numThreads` threads (<= 0 uses all available); each thread also rolls multiple windows at once, as a single window is limited by the latency of each step
+	// the roll stays scalar: CLMUL folding computes the CRC of one long stream, not of every window, so it's only used to seed each lane; rolling runs at ~1GB/s per thread (AVX512 machine, see bench-hasher), which is faster than the MD5 verification of the same data
+	void scan(const void* data, size_t len, std::vector<BlockScanMatch>& matches, uint64_t baseOffset = 0, int numThreads = 1) const;
+};
+
+#endif
+
+#endif /* __HASHER_BLOCKSCAN_H */
@@ -0,0 +1,163 @@
+#include "hasher_input_pool.h"
+
+HasherInputPool::HasherInputPool(int numThreads) : runningThreads(0), idleThreads(0), stopping(false) {
+	setNumThreads(numThreads);
+}
+
+HasherInputPool::~HasherInputPool() {
+	stop();
+}
+
+void HasherInputPool::setNumThreads(int numThreads) {
+	if(numThreads <= 0) numThreads = (int)std::thread::hardware_concurrency();
+	if(numThreads < 1) numThreads = 1;
+	std::lock_guard<std::mutex> lk(mutex);
+	maxThreads = numThreads;
+	// wake idle threads, so that any excess ones exit
+	workAvailable.notify_all();
+}
+
+void HasherInputPool::stop() {
+	{
+		std::lock_guard<std::mutex> lk(mutex);
+		stopping = true;
+		workAvailable.notify_all();
+	}
+	for(auto& thread : threads)
+		thread.join();
+	threads.clear();
+	exitedThreads.clear();
+	stopping = false;
+}
+
+// join threads which exited due to the thread limit being reduced; requires mutex to be held
+void HasherInputPool::reapThreads() {
+	for(const auto& id : exitedThreads) {
+		for(auto it = threads.begin(); it != threads.end(); ++it) {
+			if(it->get_id() == id) {
+				// the thread is past the point of needing the mutex, so this won't block for long
+				it->join();
+				threads.erase(it);
+				break;
+			}
+		}
+	}
+	exitedThreads.clear();
+}
+
+// requires mutex to be held
+void HasherInputPool::schedule(HasherInputStream* stream) {
+	if(!exitedThreads.empty()) reapThreads();
+	ready.push_back(stream);
+	// start another thread if the idle ones can't pick up all files waiting
+	if(ready.size() > idleThreads && runningThreads < maxThreads) {
+		runningThreads++;
+		threads.emplace_back(&HasherInputPool::thread_func, this);
+	} else
+		workAvailable.notify_one();
+}
+
+void HasherInputPool::thread_func() {
+	std::unique_lock<std::mutex> lk(mutex);
+	while(runningThreads <= maxThreads) {
+		if(ready.empty()) {
+			if(stopping) break;
+			idleThreads++;
+			workAvailable.wait(lk);
+			idleThreads--;
+			continue;
+		}
+		
+		HasherInputStream* stream = ready.front();
+		ready.pop_front();
+		HasherInputStream::Request req = stream->queue.front();
+		stream->queue.pop_front();
+		lk.unlock();
+		
+		stream->process(req);
+		// signal before releasing the file, so that, for a file, these are sent in order
+		if(stream->onHashed) stream->onHashed(req.cookie);
+		
+		lk.lock();
+		if(stream->queue.empty()) {
+			stream->active = false;
+			streamIdle.notify_all();
+		} else
+			ready.push_back(stream);
+	}
+	runningThreads--;
+	exitedThreads.push_back(std::this_thread::get_id());
+}
+
+
+HasherInputStream::HasherInputStream(HasherInputPool& _pool, uint64_t _blockSize, void* blockHashOut, unsigned numBlocks, const std::function<void(void*)>& _onHashed)
+: pool(_pool), onHashed(_onHashed), blockSize(_blockSize), blockPos(0), blockHashes(static_cast<char*>(blockHashOut)), blocksLeft(numBlocks), active(false) {
+	hasher = HasherInput_Create();
+}
+
+HasherInputStream::~HasherInputStream() {
+	wait();
+	if(hasher) hasher->destroy();
+}
+
+void HasherInputStream::process(const Request& req) {
+	const char* src = static_cast<const char*>(req.data);
+	size_t len = req.len;
+	// feed initial part
+	uint64_t blockLeft = blockSize - blockPos;
+	while(len >= blockLeft) {
+		hasher->update(src, blockLeft);
+		src += blockLeft;
+		len -= blockLeft;
+		blockLeft = blockSize;
+		blockPos = 0;
+		
+		if(blocksLeft) {
+			hasher->getBlock(blockHashes, 0);
+			blockHashes += 20;
+			blocksLeft--;
+		} // else there's an overflow
+	}
+	if(len) hasher->update(src, len);
+	blockPos += len;
+}
+
+void HasherInputStream::update(const void* data, size_t len, void* cookie) {
+	std::lock_guard<std::mutex> lk(pool.mutex);
+	queue.push_back({data, len, cookie});
+	if(!active) {
+		active = true;
+		pool.schedule(this);
+	}
+}
+
+IHasherInput* HasherInputStream::nextBlockHasher(void*& md5crc) {
+	std::lock_guard<std::mutex> lk(pool.mutex);
+	if(active || blockPos || !blocksLeft) return nullptr;
+	md5crc = blockHashes;
+	return hasher;
+}
+void HasherInputStream::advanceBlock() {
+	blockHashes += 20;
+	blocksLeft--;
+}
+
+void HasherInputStream::wait() {
+	std::unique_lock<std::mutex> lk(pool.mutex);
+	while(active)
+		pool.streamIdle.wait(lk);
+}
+
+void HasherInputStream::reset() {
+	wait();
+	hasher->reset();
+}
+
+void HasherInputStream::end(void* md5) {
+	wait();
+	// finish block hashes
+	if(blocksLeft)
+		// TODO: as zero padding can be slow, consider way of doing it in separate thread to not lock this one
+		hasher->getBlock(blockHashes, blockSize - blockPos);
+	hasher->end(md5);
+}
@@ -0,0 +1,98 @@
+#ifndef __HASHER_INPUT_POOL_H
+#define __HASHER_INPUT_POOL_H
+
+#include "hasher_input.h"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class HasherInputStream;
+
+// hashes input files on a bounded set of threads, so that many files can be hashed at once
+// data for a file is hashed in the order it was given, by at most one thread at a time, whilst different files are hashed concurrently
+// threads are started as needed, up to the limit
+class HasherInputPool {
+	friend class HasherInputStream;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable streamIdle;
+	std::deque<HasherInputStream*> ready; // files with queued data that no thread is working on; each thread takes one request from a file, then moves it to the back, to share threads fairly
+	std::vector<std::thread> threads;
+	std::vector<std::thread::id> exitedThreads; // threads which have ended, but are yet to be joined
+	unsigned maxThreads;
+	unsigned runningThreads;
+	unsigned idleThreads;
+	bool stopping;
+	
+	void thread_func();
+	void schedule(HasherInputStream* stream);
+	void reapThreads();
+	
+	// disable copy constructor
+	HasherInputPool(const HasherInputPool&);
+	HasherInputPool& operator=(const HasherInputPool&);
+public:
+	// numThreads <= 0 uses all available threads
+	explicit HasherInputPool(int numThreads = 0);
+	~HasherInputPool();
+	// reducing the number of threads takes effect once threads are idle
+	void setNumThreads(int numThreads);
+	inline unsigned getNumThreads() const {
+		return maxThreads;
+	}
+	// waits for queued data to be hashed, then ends all threads; the pool can still be used afterwards, which restarts threads
+	void stop();
+};
+
+// input hashing state for a file, computing the file's MD5, and the MD5+CRC32 of each block (as stored in the IFSC packet)
+class HasherInputStream {
+	friend class HasherInputPool;
+	struct Request {
+		const void* data;
+		size_t len;
+		void* cookie;
+	};
+	HasherInputPool& pool;
+	IHasherInput* hasher;
+	std::function<void(void*)> onHashed;
+	
+	uint64_t blockSize;
+	uint64_t blockPos; // amount of data in the current block
+	char* blockHashes; // where the next block's hashes are written
+	unsigned blocksLeft;
+	
+	std::deque<Request> queue; // guarded by pool.mutex
+	bool active; // in the pool's ready list, or being hashed
+	
+	void process(const Request& req);
+	
+	// disable copy constructor
+	HasherInputStream(const HasherInputStream&);
+	HasherInputStream& operator=(const HasherInputStream&);
+public:
+	// block hashes (20 bytes each) are written to `blockHashOut`, which must be large enough for `numBlocks`; any further blocks are not written
+	// `onHashed` is called, from a pool thread, with the `cookie` of each update once its data has been hashed; calls for a file are made in order
+	HasherInputStream(HasherInputPool& pool, uint64_t blockSize, void* blockHashOut, unsigned numBlocks, const std::function<void(void*)>& onHashed = nullptr);
+	~HasherInputStream();
+	
+	// queue data for hashing; it must remain valid until hashed
+	void update(const void* data, size_t len, void* cookie = nullptr);
+	// for hashing a whole block elsewhere (e.g. whilst it's prepared for GF processing, see PAR2Proc::addInput): returns the hasher to feed the next block through, with its block hash written to `md5crc`
+	// returns NULL if data is still queued, the current block has been partially hashed, or all blocks have been hashed; the hasher must not be used until the block is claimed via advanceBlock
+	IHasherInput* nextBlockHasher(void*& md5crc);
+	// claim the block returned by nextBlockHasher; no data can be queued, nor the stream ended, until it has been hashed
+	void advanceBlock();
+	uint64_t getBlockSize() const {
+		return blockSize;
+	}
+	// wait for all queued data to be hashed
+	void wait();
+	void reset();
+	// finish hashing (zero padding the last block), writing the file's MD5 to `md5`
+	void end(void* md5);
+};
+
+#endif /* __HASHER_INPUT_POOL_H */
@@ -37,6 +37,7 @@ function FileSeqReader(files, readSize, readBuffers) {
 
 FileSeqReader.prototype = {
 	maxQueuePerFile: 5, // number of queued hash requests per file; maybe scale this based on readSize? 3x4MB seems too small in tests (switches frequently on HDD), where 4x4MB is much better, and 5x4MB never switches on HDD
+	parallelFiles: 1, // number of files to keep open, and feed data to, at once; >1 allows multiple files to be hashed concurrently, at the expense of non-sequential reads
 	buf: null,
 	bufCount: 0,
 	maxBufs: 0,
@@ -155,6 +156,8 @@ FileSeqReader.prototype = {
 		}
 		
 		this._isReading = true;
+		if(this.parallelFiles > 1)
+			return this._readNextParallel(buffer);
 		
 		// try reading off currently active file
 		var file = this.openFiles[0];
@@ -180,35 +183,60 @@ FileSeqReader.prototype = {
 		}
 		
 		// can't fulfill request from existing open files, try a new file
-		if(this.fileQueue.length) {
-			var self = this;
-			var file = this.fileQueue.shift();
-			fs.open(file.name, 'r', function(err, fd) {
-				if(err) return self.cb(err);
-				
-				// create new file entry; we put this at the end of the queue because if a hash completes during the open, we want to prioritize existing files
-				self.openFiles.push({
-					fd: fd,
-					info: file,
-					pos: 0,
-					hashQueue: 0
-				});
-				
-				// put buffer back and retry
-				self.buf.push(buffer);
-				self.readNext();
-			});
-			return;
-		}
+		if(this.fileQueue.length)
+			return this._openNext(buffer);
 		else if(shortestIndex > 0) {
 			// if no unopened files available, prefer the best open file
 			this.openFiles.unshift(this.openFiles.splice(shortestIndex, 1)[0]);
 			return this._doRead(this.openFiles[0], buffer);
 		}
 		
-		
 		// otherwise, we've exhausted all files we can read from
+		this._readStalled(buffer);
+	},
+	
+	_readNextParallel: function(buffer) {
+		// feed the open file with the least data waiting to be hashed, so that all files are kept busy
+		var shortestQueue = this.maxQueuePerFile;
+		var shortestIndex = -1;
+		for(var fileI=0; fileI<this.openFiles.length; fileI++) {
+			var file = this.openFiles[fileI];
+			if(file.hashQueue < shortestQueue) {
+				shortestQueue = file.hashQueue;
+				shortestIndex = fileI;
+			}
+		}
+		
+		// if every open file has data waiting, start on another file, so that it can be hashed alongside the others
+		if(shortestQueue > 0 && this.openFiles.length < this.parallelFiles && this.fileQueue.length)
+			return this._openNext(buffer);
+		if(shortestIndex >= 0)
+			return this._doRead(this.openFiles[shortestIndex], buffer);
 		
+		this._readStalled(buffer);
+	},
+	
+	_openNext: function(buffer) {
+		var self = this;
+		var file = this.fileQueue.shift();
+		fs.open(file.name, 'r', function(err, fd) {
+			if(err) return self.cb(err);
+			
+			// create new file entry; we put this at the end of the queue because if a hash completes during the open, we want to prioritize existing files
+			self.openFiles.push({
+				fd: fd,
+				info: file,
+				pos: 0,
+				hashQueue: 0
+			});
+			
+			// put buffer back and retry
+			self.buf.push(buffer);
+			self.readNext();
+		});
+	},
+	
+	_readStalled: function(buffer) {
 		// can't proceed, return buffer to pool
 		this.buf.push(buffer);
 		this._isReading = false;
@@ -88,11 +88,20 @@ function PAR2OutputData(idx, buffer, gfWrapper) {
 	this.getMD5 = gfWrapper._getRecoveryPacketMD5.bind(gfWrapper, idx);
 	this.release = gfWrapper._markRecDataConsumed.bind(gfWrapper, idx);
 }
-function GFAddQueueItem(sliceNum, dataSlice, len, cb) {
+// presents a group hashed by the GF processor (see GfProc.setOutputHashing) like a HasherOutput
+function GFGroupHasher(gf, group) {
+	this.gf = gf;
+	this.group = group;
+}
+GFGroupHasher.prototype.get = function(md5) {
+	this.gf.getGroupMD5(this.group, md5);
+};
+function GFAddQueueItem(sliceNum, dataSlice, len, cb, hasher) {
 	this.num = sliceNum;
 	this.data = dataSlice;
 	this.len = len;
 	this.cb = cb;
+	this.hasher = hasher;
 }
 
 var GFWrapper = {
@@ -102,16 +111,31 @@ var GFWrapper = {
 	_allocSize: 0,
 	
 	gf_init: function(size) {
+		if(this.recDataHashers && this.recDataNativeHash)
+			throw new Error('Cannot reallocate whilst recovery packets are being hashed');
 		this.close();
 		this.gf = new binding.GfProc(size, this._gfOpts.proc_cpu, this._gfOpts.proc_ocl, this._gfOpts.stagingCount);
 		if(this._gfOpts.proc_cpu && this._gfOpts.threads)
 			this.gf.setNumThreads(this._gfOpts.threads);
+		if(this._gfOpts.autoBalance)
+			this.gf.setAutoBalance(true);
 		this._allocSize = size;
 	},
+	// redistribute the slice between backends in proportion to their throughput in the last pass; returns the measured rates if it was rebalanced
+	gf_rebalance: function(size) {
+		if(!this.gf || !this._gfOpts.autoBalance || !this.recoverySlices.length) return null;
+		var balance = this.gf.setCurrentSliceSize(size);
+		this.gf.setRecoverySlices(this.recoverySlices); // backends which grew need to reallocate recovery memory
+		return balance || null;
+	},
 	gf_info: function() {
 		if(!this.gf) return null;
 		return this.gf.info();
 	},
+	// whether input slices can be hashed by the GF processor whilst being added (see PAR2File.processData), which avoids reading them twice
+	canHashInput: function() {
+		return !!(this.gf && this.recoverySlices.length && this.gf.canHashInput());
+	},
 	close: function(cb) {
 		binding.hasher_clear();
 		if(this.gf) {
@@ -123,7 +147,8 @@ var GFWrapper = {
 	},
 	
 	// TODO: add way to partially submit blocks (helps with handling very large slice sizes)
-	bufferedProcess: function(dataSlice, sliceNum, len, cb) {
+	// if `hasher` (a HasherInput) is supplied, the slice is hashed as its next block whilst being added
+	bufferedProcess: function(dataSlice, sliceNum, len, cb, hasher) {
 		if(!len || !dataSlice.length) return process.nextTick(cb);
 		
 		var self = this;
@@ -146,21 +171,22 @@ var GFWrapper = {
 					else if(self.gf.add(item.num, bufferSlice.call(item.data, 0, item.len), function() {
 						//this.cb(this.num, this.data);
 						this.cb();
-					}.bind(item))) {
+					}.bind(item), item.hasher)) {
 						self.addQueue.shift();
 					} else break;
 				}
 			});
 		}
 		
-		if(this.gf.add(sliceNum, bufferSlice.call(dataSlice, 0, len), function() {
+		// hashed slices must be added in order, so can't skip ahead of queued ones
+		if(!(hasher && this.addQueue.length) && this.gf.add(sliceNum, bufferSlice.call(dataSlice, 0, len), function() {
 			//cb(sliceNum, dataSlice);
 			cb();
-		}))
+		}, hasher))
 			return true; // added successfully
 		
 		// not added, queue up buffer
-		this.addQueue.push(new GFAddQueueItem(sliceNum, dataSlice, len, cb));
+		this.addQueue.push(new GFAddQueueItem(sliceNum, dataSlice, len, cb, hasher));
 		return false;
 	},
 	
@@ -222,6 +248,7 @@ var GFWrapper = {
 	recDataHashCb: null, // indicator of whether data has been hashed
 	recDataRefcount: null, // number of references on a data buffer; when 0, buffer can be used for further fetching
 	recDataHashers: null, // hasher instances
+	recDataNativeHash: false, // whether recovery data is hashed by the GF processor whilst being fetched
 	recDataActiveHashers: 0, // number of hasher instances not yet complete
 	recDataHasherBufsNeeded: null, // count of number of buffers required to enable hashing
 	recDataMD5: null, // associated MD5 hashes
@@ -244,7 +271,13 @@ var GFWrapper = {
 		if(!this.recDataHashers) {
 			this.recDataHashers = Array(Math.ceil(this.recoverySlices.length / hashBatchSize));
 			this.recDataActiveHashers = this.recDataHashers.length;
+			// if possible, hash whilst the recovery data is being finished, which avoids reading it again
+			this.recDataNativeHash = !!this.gf.setOutputHashing && this.gf.setOutputHashing(hashBatchSize, this.setID);
 			for(var i=0, p=0; i<this.recoverySlices.length; i+=hashBatchSize, p++) {
+				if(this.recDataNativeHash) {
+					this.recDataHashers[p] = new GFGroupHasher(this.gf, p);
+					continue;
+				}
 				var numBufs = Math.min(hashBatchSize, this.recoverySlices.length-i);
 				this.recDataHashers[p] = new binding.HasherOutput(numBufs);
 				
@@ -288,6 +321,30 @@ var GFWrapper = {
 			}
 		}
 	},
+	_recDataGroupBufs: function(hasherIdx, len) {
+		var hashBaseIdx = hasherIdx*this._gfOpts.hashBatchSize;
+		var numBufs = Math.min(this._gfOpts.hashBatchSize, this.recoverySlices.length - hashBaseIdx);
+		var bufs = Array(numBufs);
+		var baseBufIdx = hashBaseIdx % this.recData.length;
+		for(var i=0; i<numBufs; i++) {
+			if(baseBufIdx + i >= this.recData.length)
+				baseBufIdx -= this.recData.length;
+			bufs[i] = bufferSlice.call(this.recData[baseBufIdx + i], 0, len);
+		}
+		return bufs;
+	},
+	_recDataHashed: function(hashBaseIdx, numBufs) {
+		// remove refs on buffers
+		for(var i=0; i<numBufs; i++) {
+			var _i = i+hashBaseIdx;
+			this._markRecDataConsumed(_i);
+			
+			// notify that hashing is complete
+			if(this.recDataHashCb[_i])
+				this.recDataHashCb[_i](_i);
+			this.recDataHashCb[_i] = true;
+		}
+	},
 	_fetchRecData: function(idx) {
 		var self = this;
 		var groupIdx = idx % this.recData.length;
@@ -295,6 +352,29 @@ var GFWrapper = {
 		if(!this.recData[groupIdx]) this.recData[groupIdx] = allocBuffer(this._allocSize);
 		// TODO: consider allowing recData to be allocated space for header
 		
+		if(this.recDataNativeHash) {
+			// the GF processor fetches and hashes a whole group at once, so wait until all its buffers are available
+			var hasherIdx = Math.floor(idx / this._gfOpts.hashBatchSize);
+			if(--this.recDataHasherBufsNeeded[hasherIdx] == 0) {
+				this.gf.getGroup(hasherIdx, this._recDataGroupBufs(hasherIdx, this._allocSize), function(hasherIdx, valid, buffers) {
+					var hashBaseIdx = hasherIdx*self._gfOpts.hashBatchSize;
+					if(!valid) {
+						console.error("Memory checksum error detected in one of recovery slices " + self.recoverySlices.slice(hashBaseIdx, hashBaseIdx+buffers.length).join(', ') + " -  recovery data is likely corrupt. This is likely due to hardware memory corruption or a bug in ParPar.");
+					}
+					self._recDataHashed(hashBaseIdx, buffers.length);
+					
+					// notify that buffers are available
+					for(var i=0; i<buffers.length; i++) {
+						var _i = i+hashBaseIdx;
+						if(self.recDataFetchCb[_i])
+							self.recDataFetchCb[_i](_i, buffers[i]);
+						self.recDataFetchCb[_i] = true;
+					}
+				});
+			}
+			return;
+		}
+		
 		this.gf.get(idx, this.recData[groupIdx], function(idx, valid, buffer) {
 			if(!valid) {
 				console.error("Memory checksum error detected in recovery slice " + self.recoverySlices[idx] + " -  recovery data is likely corrupt. This is likely due to hardware memory corruption or a bug in ParPar.");
@@ -306,27 +386,9 @@ var GFWrapper = {
 				// have enough buffers - send to hasher
 				
 				// first, collect relevant buffers
-				var hashBaseIdx = hasherIdx*self._gfOpts.hashBatchSize;
-				var numBufs = Math.min(self._gfOpts.hashBatchSize, self.recoverySlices.length - hashBaseIdx);
-				var bufs = Array(numBufs);
-				var baseBufIdx = hashBaseIdx % self.recData.length;
-				for(var i=0; i<numBufs; i++) {
-					if(baseBufIdx + i >= self.recData.length)
-						baseBufIdx -= self.recData.length;
-					bufs[i] = bufferSlice.call(self.recData[baseBufIdx + i], 0, self.chunkSize);
-				}
-				
+				var bufs = self._recDataGroupBufs(hasherIdx, self.chunkSize);
 				self.recDataHashers[hasherIdx].update(bufs, function() {
-					// remove refs on buffers
-					for(var i=0; i<numBufs; i++) {
-						var _i = i+hashBaseIdx;
-						self._markRecDataConsumed(_i);
-						
-						// notify that hashing is complete
-						if(self.recDataHashCb[_i])
-							self.recDataHashCb[_i](_i);
-						self.recDataHashCb[_i] = true;
-					}
+					self._recDataHashed(hasherIdx*self._gfOpts.hashBatchSize, bufs.length);
 				});
 			}
 			
@@ -631,9 +693,9 @@ PAR2.prototype = {
 		return pkt;
 	},
 	
-	processSlice: function(data, sliceNum, cb) {
+	processSlice: function(data, sliceNum, cb, hasher) {
 		if(this.recoverySlices.length)
-			this.bufferedProcess(data, sliceNum, this.chunkSize, cb);
+			this.bufferedProcess(data, sliceNum, this.chunkSize, cb, hasher);
 		else
 			process.nextTick(cb);
 	},
@@ -712,13 +774,16 @@ PAR2File.prototype = {
 	},
 	
 	process: function(data, cb) {
+		if(this._md5ctx && this.par2.canHashInput())
+			return this.processData(data, cb, true);
 		async.parallel([
 			this.processData.bind(this, data),
 			this.processHash.bind(this, data)
 		], cb);
 	},
 	
-	processData: function(data, cb) {
+	// if `hashInput` is set, the slice is also hashed whilst being processed, instead of requiring processHash; this requires PAR2.canHashInput()
+	processData: function(data, cb, hashInput) {
 		if(this.sliceDataPos >= this.numSlices) throw new Error('Too many slices given');
 		
 		if(this.sliceDataPos == this.numSlices-1) {
@@ -733,7 +798,19 @@ PAR2File.prototype = {
 		
 		var sliceNum = this.sliceOffset + this.sliceDataPos;
 		this.sliceDataPos++;
-		this.par2.processSlice(data, sliceNum, cb);
+		if(!hashInput)
+			return this.par2.processSlice(data, sliceNum, cb);
+		
+		if(this.hashPos != (sliceNum - this.sliceOffset) * this.par2.sliceSize)
+			throw new Error('Slices must be hashed in order');
+		this.hashPos += data.length;
+		var atEnd = (this.hashPos == this.size);
+		var self = this;
+		// slices using the same hasher are hashed in order, and before the add completes, so the file hash can be finished once the last slice is added
+		this.par2.processSlice(data, sliceNum, function() {
+			if(atEnd) self._endHash();
+			cb();
+		}, this._md5ctx);
 	},
 	
 	processHash: function(data, cb) {
@@ -745,14 +822,15 @@ PAR2File.prototype = {
 		var atEnd = (this.hashPos == this.size);
 		var self = this;
 		this._md5ctx.update(data, function() {
-			if(atEnd) {
-				self.md5 = allocBuffer(16);
-				self._md5ctx.end(self.md5);
-				self._md5ctx = null;
-			}
+			if(atEnd) self._endHash();
 			cb();
 		});
 	},
+	_endHash: function() {
+		this.md5 = allocBuffer(16);
+		this._md5ctx.end(this.md5);
+		this._md5ctx = null;
+	},
 	
 	packetChecksumsSize: function() {
 		if(!this.numSlices) return 0;
@@ -931,6 +1009,9 @@ module.exports = {
 	gf_info: function(method) {
 		return binding.gf_info(getMethodNum(GF_METHODS, method));
 	},
+	gf_autotune: function(sliceSize, numInputs, numOutputs, cacheFile) {
+		return binding.gf_autotune(sliceSize, numInputs, numOutputs, cacheFile || null);
+	},
 	opencl_devices: function() {
 		return binding.opencl_devices();
 	},
@@ -951,6 +1032,13 @@ module.exports = {
 	get_inhash_methodDesc: function() {
 		return binding.hasherInput_method();
 	},
+	// number of threads used to hash input files; files are hashed concurrently, up to this limit (0 = number of CPU threads)
+	set_inhash_threads: function(threads) {
+		return binding.set_hasherInput_threads(threads);
+	},
+	get_inhash_threads: function() {
+		return binding.hasherInput_threads();
+	},
 	get_outhash_methodDesc: function() {
 		return binding.hasherOutput_method();
 	},
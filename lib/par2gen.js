@@ -245,8 +245,11 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 		numThreads: null, // null => number of processors
 		gfMethod: null, // null => '' (auto)
 		loopTileSize: 0, // 0 = auto
+		gfAutotuneCache: null, // if set (and gfMethod is auto), benchmark GF methods on first use, caching results in this file
 		openclDevices: [], // each device (defaults listed): {platform: null, device: null, ratio: null, memoryLimit: null, method: null, input_batchsize: 0, target_iters: 0, target_grouping: 0, minChunkSize: 32768}
 		cpuMinChunkSize: 65536, // must be even
+		openclAutoBalance: true, // when splitting by slice, adjust each device's portion between passes according to its measured throughput
+		openclSplit: 'slice', // how work is divided between the CPU and OpenCL devices: 'slice' gives each a part of every slice, 'output' gives each all of the slice, but only some of the recovery slices
 	};
 	if(opts) Par2._extend(o, opts);
 	
@@ -483,7 +486,14 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 	if(o.maxCriticalRedundancy && o.maxCriticalRedundancy < o.minCriticalRedundancy)
 		throw new Error('Maximum critical packet redundancy cannot be below the minimum');
 	
-	var gfInfo = Par2.gf_info(o.gfMethod);
+	var gfMethod = o.gfMethod;
+	if(!gfMethod && o.gfAutotuneCache) {
+		var tuned = Par2.gf_autotune(o.sliceSize, this.inputSlices, o.recoverySlices, o.gfAutotuneCache);
+		gfMethod = tuned.method;
+		if(!o.processBatchSize && tuned.input_batchsize) o.processBatchSize = tuned.input_batchsize;
+		if(!o.loopTileSize && tuned.chunk_size) o.loopTileSize = tuned.chunk_size;
+	}
+	var gfInfo = Par2.gf_info(gfMethod);
 	
 	if(o.processBatchSize && (o.processBatchSize < 1 || o.processBatchSize > 32768))
 		throw new Error('Invalid processing batch size');
@@ -578,12 +588,15 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 	if(o.cpuMinChunkSize < 2 || o.cpuMinChunkSize % 2)
 		throw new Error('CPU min chunk size (' + o.cpuMinChunkSize + ') must be even and at least 2 bytes');
 	
-	// TODO: currently OpenCL/CPU distribution is done by dividing the slice; however it may be desirable to split by output as well (including slide+output dividing) if memory/chunk constraints are such
+	if(o.openclSplit != 'slice' && o.openclSplit != 'output')
+		throw new Error('Unknown OpenCL split mode (' + o.openclSplit + ')');
+	// when splitting by output, each device receives the whole chunk, so minimum chunk sizes don't need to be divided between them
+	var splitOutputs = o.openclSplit == 'output';
 	
 	// work out OpenCL device distribution
 	var cpuRatio = 1;
 	var minMemoryLimit = o.memoryLimit;
-	if(o.cpuMinChunkSize < o.sliceSize && o.openclDevices.length && o.recoverySlices > 0) {
+	if((splitOutputs || o.cpuMinChunkSize < o.sliceSize) && o.openclDevices.length && o.recoverySlices > 0) {
 		var totalMinChunk = o.cpuMinChunkSize;
 		var oclUsed = {};
 		var unspecifiedOclRatioMemory = null; // if a OpenCL device ratio isn't specified, use the memory limit as a guide
@@ -622,7 +635,7 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 			if(oclDev.ratio) {
 				if(oclDev.ratio > 1 || oclDev.ratio <= 0)
 					throw new Error('Invalid OpenCL device processing ratio (' + (oclDev.ratio*100) + '%)');
-				if(oclDev.minChunkSize / oclDev.ratio > o.sliceSize)
+				if(!splitOutputs && oclDev.minChunkSize / oclDev.ratio > o.sliceSize)
 					oclDev.ratio = oclDev.minChunkSize / o.sliceSize;
 				cpuRatio -= oclDev.ratio;
 			} else if(!oclDev.memoryLimit) // i.e. memoryLimit set to 0 (no limit)
@@ -637,7 +650,7 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 		if(cpuRatio < 0)
 			throw new Error('Total OpenCL device processing ratio(s) (' + ((1 - cpuRatio)*100) + '%) exceed 100%');
 		
-		if(totalMinChunk > o.sliceSize) {
+		if(!splitOutputs && totalMinChunk > o.sliceSize) {
 			// need to disable devices - we'll just disable from the end until the condition is satisfied
 			// TODO: investigate a smarter method
 			while(o.openclDevices.length) {
@@ -668,7 +681,7 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 				o.openclDevices.forEach(function(oclDev) {
 					if(!oclDev.ratio) {
 						var testRatio = (oclDev.memoryLimit / unspecifiedOclRatioMemory) * cpuRatio;
-						var minRatio = oclDev.minChunkSize / o.sliceSize;
+						var minRatio = splitOutputs ? 0 : oclDev.minChunkSize / o.sliceSize;
 						if(testRatio <= minRatio) {
 							oclDev.ratio = minRatio;
 							unspecifiedOclRatioMemory -= oclDev.memoryLimit;
@@ -701,13 +714,16 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 		if(minMemoryLimit == Number.MAX_VALUE) minMemoryLimit = 0;
 	}
 	
+	// portion of each chunk the CPU receives inputs for
+	var cpuSliceRatio = splitOutputs ? 1 : cpuRatio;
+	
 	// number of chunk sized buffers needed to pass data to/from backend
 	this.procInStagingBufferCount = o.processBatchSize*stagingCount;
 	var maxChunkSize = o.seqReadSize; // TODO: if moving away from seqReadSize, cannot exceed MAX_BUFFER_SIZE_MOD2
 	if(o.minChunkSize) {
 		o.minChunkSize = Math.min(o.minChunkSize, o.sliceSize);
 		o.openclDevices.forEach(function(oclDev) {
-			var ratioChunk = Math.ceil(oclDev.minChunkSize / oclDev.ratio);
+			var ratioChunk = splitOutputs ? oclDev.minChunkSize : Math.ceil(oclDev.minChunkSize / oclDev.ratio);
 			ratioChunk += ratioChunk % 2;
 			o.minChunkSize = Math.max(o.minChunkSize, ratioChunk);
 		});
@@ -716,7 +732,7 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 	}
 	
 	if(o.memoryLimit) {
-		var cpuMinChunk = Math.ceil(cpuRatio * o.minChunkSize /2) *2;
+		var cpuMinChunk = Math.ceil(cpuSliceRatio * o.minChunkSize /2) *2;
 		if(o.minChunkSize && (o.recDataSize+1) * o.minChunkSize > o.memoryLimit)
 			throw new Error('Cannot accommodate target memory limit (' + friendlySize(o.memoryLimit) + ') with target minimum chunk size (' + friendlySize(o.minChunkSize) + '). At least ' + (o.recDataSize+1) + ' buffers of the minimum chunk size need to be allocated.');
 		if(cpuMinChunk * (this.procInStagingBufferCount+1) > o.memoryLimit)
@@ -725,7 +741,7 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 	
 	// TODO: consider case where recovery > input size; we may wish to invert how processing is done in those cases
 	// consider memory limit
-	var reqMem = o.sliceSize * o.recoverySlices + Math.max(o.recDataSize * o.sliceSize, this.procInStagingBufferCount * Math.ceil(o.sliceSize*cpuRatio/2)*2);
+	var reqMem = o.sliceSize * o.recoverySlices + Math.max(o.recDataSize * o.sliceSize, this.procInStagingBufferCount * Math.ceil(o.sliceSize*cpuSliceRatio/2)*2);
 	this.passes = 1;
 	this.chunks = 1;
 	this.slicesPerPass = o.recoverySlices;
@@ -753,7 +769,7 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 			this.slicesPerPass = Math.floor(minMemoryLimit / chunkSize);
 			// check limits on the CPU side, after adding transfer memory
 			if(o.memoryLimit) {
-				var overhead = Math.max(this.procInStagingBufferCount*Math.ceil(chunkSize*cpuRatio/2)*2, o.recDataSize*chunkSize);
+				var overhead = Math.max(this.procInStagingBufferCount*Math.ceil(chunkSize*cpuSliceRatio/2)*2, o.recDataSize*chunkSize);
 				var cpuSlicesPerPass = Math.floor((o.memoryLimit-overhead) / chunkSize);
 				if(cpuSlicesPerPass < 1)
 					throw new Error('Cannot accommodate memory limit (' + friendlySize(o.memoryLimit) + '); a chunk size of ' + friendlySize(chunkSize) + ' was chosen, but a minimum of 1 recovery + ' + friendlySize(overhead) + ' processing buffer needs to be held in memory');
@@ -775,18 +791,49 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 	// break up chunks across devices
 	var procCpu = {method: gfInfo.id, chunk_size: o.loopTileSize, input_batchsize: o.processBatchSize};
 	var sliceOffset = 0;
-	o.openclDevices.forEach(function(oclDev) {
-		oclDev.slice_offset = sliceOffset;
-		oclDev.slice_size = Math.round(oclDev.ratio * this._chunkSize / 2) * 2;
-		sliceOffset += oclDev.slice_size;
-		oclDev.cksum_method = gfInfo.id;
-	}.bind(this));
-	o.openclDevices = o.openclDevices.filter(function(oclDev) {
-		return oclDev.slice_size > 0;
-	});
-	procCpu.slice_offset = sliceOffset;
-	procCpu.slice_size = this._chunkSize - sliceOffset;
-	if(procCpu.slice_size < 1) procCpu = null; // no CPU processing
+	if(splitOutputs) {
+		// passes are evened out, so the smallest has this many recovery slices; each device is given a fixed range of these, whilst the CPU computes the rest (always at least one) in every pass
+		var passSlices = Math.floor(o.recoverySlices / this.passes);
+		var outputFirst = 0;
+		o.openclDevices.forEach(function(oclDev) {
+			oclDev.slice_offset = 0;
+			oclDev.slice_size = this._chunkSize;
+			oclDev.output_first = outputFirst;
+			oclDev.output_count = Math.max(0, Math.min(Math.round(oclDev.ratio * passSlices), passSlices - 1 - outputFirst));
+			outputFirst += oclDev.output_count;
+			oclDev.cksum_method = gfInfo.id;
+		}.bind(this));
+		o.openclDevices = o.openclDevices.filter(function(oclDev) {
+			return oclDev.output_count > 0;
+		});
+		procCpu.output_first = outputFirst;
+	} else {
+		o.openclDevices.forEach(function(oclDev) {
+			oclDev.slice_offset = sliceOffset;
+			oclDev.slice_size = Math.round(oclDev.ratio * this._chunkSize / 2) * 2;
+			sliceOffset += oclDev.slice_size;
+			oclDev.cksum_method = gfInfo.id;
+		}.bind(this));
+		o.openclDevices = o.openclDevices.filter(function(oclDev) {
+			return oclDev.slice_size > 0;
+		});
+		procCpu.slice_offset = sliceOffset;
+		procCpu.slice_size = this._chunkSize - sliceOffset;
+		if(procCpu.slice_size < 1) procCpu = null; // no CPU processing
+		
+		if(o.openclAutoBalance && o.openclDevices.length && procCpu) {
+			// when balancing, each backend may be given more of the chunk, as far as its memory limit allows
+			var maxSliceSize = function(memoryLimit, buffers) {
+				if(!memoryLimit || !buffers) return this._chunkSize;
+				return Math.min(this._chunkSize, Math.floor(memoryLimit / buffers / 2) * 2);
+			}.bind(this);
+			o.openclDevices.forEach(function(oclDev) {
+				oclDev.slice_max = maxSliceSize(oclDev.memoryLimit, this.slicesPerPass);
+			}.bind(this));
+			procCpu.slice_max = maxSliceSize(o.memoryLimit, this.slicesPerPass + this.procInStagingBufferCount);
+			this._autoBalance = true;
+		}
+	}
 	
 	// generate display filenames
 	if(o.displayNameFormat == 'outrel') {
@@ -857,7 +904,8 @@ function PAR2Gen(fileInfo, sliceSize, opts) {
 		stagingCount: stagingCount,
 		hashBatchSize: o.hashBatchSize,
 		proc_cpu: procCpu,
-		proc_ocl: o.openclDevices
+		proc_ocl: o.openclDevices,
+		autoBalance: this._autoBalance
 	});
 	this.files = par.getFiles();
 	
@@ -1008,6 +1056,7 @@ PAR2Gen.prototype = {
 	totalSize: null,
 	inputSlices: null,
 	_chunker: null,
+	_autoBalance: false, // whether the split between the CPU and OpenCL devices is rebalanced between passes
 	passNum: 0,
 	passChunkNum: 0,
 	sliceOffset: 0, // not offset specified by user, rather offset from first pass
@@ -1317,6 +1366,11 @@ PAR2Gen.prototype = {
 			var reader = new FileSeqReader(this.files, this.readSize, this.opts.readBuffers);
 			reader.setBuffers(this._buf);
 			reader.maxQueuePerFile = this.opts.readHashQueue;
+			if(firstPass && !this._chunker && this.opts.recoverySlices < 1) {
+				// if only hashing, read from multiple files at once, so that they can be hashed in parallel
+				// each file needs around two buffers (one being read, one being hashed) to keep busy, so limit the number of files to what the read buffers allow
+				reader.parallelFiles = Math.max(1, Math.min(Par2.get_inhash_threads(), Math.floor(this.opts.readBuffers / 2)));
+			}
 			
 			var slicesPerRead;
 			if(this._chunker)
@@ -1327,9 +1381,11 @@ PAR2Gen.prototype = {
 					throw new Error('Expected read size (' + this.readSize + ') to be a multiple of slice size (' + this.opts.sliceSize + ')');
 			}
 			
+			// if the GF processor can hash slices whilst preparing them, avoid hashing the data separately
+			var hashInput = firstPass && !this._chunker && this.opts.recoverySlices > 0 && this.par2.canHashInput();
 			reader.run(function(err, data) {
 				if(err) return cb(err);
-				if(firstPass)
+				if(firstPass && !hashInput)
 					data.file.processHash(data.buffer, data.hashed.bind(data));
 				else
 					data.hashed(); // only hash on first pass
@@ -1374,7 +1430,7 @@ PAR2Gen.prototype = {
 					async.times(numSlices, function(sliceOffNum, cb) {
 						if(cbProgress) cbProgress('processing_slice', data.file, slicePos + sliceOffNum);
 						var bp = sliceOffNum * self.opts.sliceSize;
-						data.file.processData(bufferSlice.call(data.buffer, bp, Math.min(data.buffer.length, bp+self.opts.sliceSize)), cb);
+						data.file.processData(bufferSlice.call(data.buffer, bp, Math.min(data.buffer.length, bp+self.opts.sliceSize)), cb, hashInput);
 					}, data.release.bind(data));
 				}
 			}, cb);
@@ -1418,11 +1474,14 @@ PAR2Gen.prototype = {
 			if(chunkSize != this._chunker.chunkSize)
 				this._chunker.setChunkSize(chunkSize);
 		}
+		// rebalance the chunk between backends, using the throughput measured in the last pass
+		var balance = firstPass ? null : this[this._chunker ? '_chunker' : 'par2'].gf_rebalance(chunkSize);
 	
 		var readFn = this._readPass.bind(this, chunkSize, cbProgress);
 		var self = this;
 		
 		if(cbProgress) cbProgress('begin_chunk_pass', self.passNum, self.passChunkNum);
+		if(cbProgress && balance) cbProgress('rebalance', balance);
 		
 		async.series([
 			// read & process data
@@ -0,0 +1,813 @@
+"use strict";
+
+var emitter = require('events').EventEmitter;
+var Par2 = require('./par2');
+var binding = require('../build/Release/parpar_gf.node');
+var async = require('async');
+var fs = require('fs');
+var path = require('path');
+var crypto = require('crypto');
+var BufferPool = require('./bufferpool');
+var bufferSlice = Buffer.prototype.readBigInt64BE ? Buffer.prototype.subarray : Buffer.prototype.slice;
+var allocBuffer = (Buffer.allocUnsafe || Buffer);
+var toBuffer = (Buffer.alloc ? Buffer.from : Buffer);
+
+var MAGIC = toBuffer('PAR2\0PKT');
+var MAGIC_STR = MAGIC.toString('binary');
+var PKT_MAIN = 'PAR 2.0\0Main\0\0\0\0';
+var PKT_FILEDESC = 'PAR 2.0\0FileDesc';
+var PKT_IFSC = 'PAR 2.0\0IFSC\0\0\0\0';
+var PKT_RECVSLIC = 'PAR 2.0\0RecvSlic';
+var MAX_CRITICAL_PACKET = 64*1048576; // larger non-recovery packets are assumed to be corrupt
+var SCAN_BLOCK = 65536;
+var HASH_READ_SIZE = 1048576;
+var DISPLACED_READ_SIZE = 4194304; // amount of a damaged file to search for displaced slices at a time
+var MIN_CHUNK_SIZE = 65536;
+var STAGING_AREAS = 2;
+var SPARE_RECOVERY = 4; // extra recovery slices to verify, in case some can't be used
+
+var readUInt64LE = function(buf, offset) {
+	return buf.readUInt32LE(offset) + buf.readUInt32LE(offset+4) * 4294967296;
+};
+var md5 = function(data) {
+	return crypto.createHash('md5').update(data).digest();
+};
+
+// hash `len` bytes of `fd` from `position`, optionally prefixed by `head`
+var hashFileRange = function(fd, position, len, head, cb) {
+	var hash = crypto.createHash('md5');
+	if(head) hash.update(head);
+	var buf = allocBuffer(Math.min(HASH_READ_SIZE, len) || 1);
+	var readNext = function() {
+		if(len <= 0) return cb(null, hash.digest());
+		fs.read(fd, buf, 0, Math.min(buf.length, len), position, function(err, bytesRead) {
+			if(err) return cb(err);
+			if(!bytesRead) return cb(null, null); // truncated
+			hash.update(bufferSlice.call(buf, 0, bytesRead));
+			position += bytesRead;
+			len -= bytesRead;
+			readNext();
+		});
+	};
+	readNext();
+};
+
+function PAR2RepairFile(id) {
+	this.id = id;
+	this.slices = null; // MD5 of each slice, from the IFSC packet
+	this.checksums = null; // the IFSC packet's MD5 + CRC32 list
+	this.sliceValid = null;
+	this.displaced = null; // slices found at other offsets (see _findDisplaced), to be moved into place
+}
+PAR2RepairFile.prototype = {
+	name: null,
+	path: null,
+	size: 0,
+	md5: null,
+	numSlices: 0,
+	sliceOffset: 0,
+	goodSlices: 0,
+	exists: false,
+	needsRepair: false,
+	fd: null
+};
+
+function PAR2RecoveryPacket(fileName, position, length, exponent) {
+	this.fileName = fileName;
+	this.position = position;
+	this.length = length;
+	this.exponent = exponent;
+}
+PAR2RecoveryPacket.prototype = {
+	valid: null, // null = not yet verified
+	dataOffset: function() {
+		return this.position + 68;
+	}
+};
+
+// repairs the files protected by a PAR2 set, using the set's recovery slices
+// `par2File` is any file of the set; other volumes with the same base name, in the same directory, are also scanned
+// files are repaired in place; where damage has shifted data within a file (i.e. inserted or removed bytes), intact slices are searched for, and moved back into place, but any partial slice at the end of a file needs rebuilding
+function PAR2Repair(par2File, opts) {
+	var o = this.opts = {
+		memoryLimit: null, // 0 to specify no limit
+		numThreads: null,
+		readBuffers: 8
+	};
+	if(opts) Par2._extend(o, opts);
+	if(o.memoryLimit === null) o.memoryLimit = 256*1048576;
+	if(!(o.readBuffers >= 1)) throw new Error('Invalid number of read buffers');
+	
+	this.par2File = par2File;
+	this.baseDir = path.dirname(par2File);
+	this.par2Files = [];
+	this.files = [];
+	this.recovery = [];
+}
+
+PAR2Repair.prototype = {
+	setID: null,
+	sliceSize: 0,
+	totalSlices: 0,
+	missing: null, // input slices to be rebuilt
+	missingFile: null, // file each of the above belongs to
+	recoveryUsed: null, // recovery packets to rebuild them from, in the order given by GfProc.setRepair
+	chunkSize: 0,
+	groupSize: 0,
+	batchSize: 0, // inputs per CPU staging area
+	gf: null,
+	
+	// find all volumes belonging to the set
+	_findPar2Files: function(cb) {
+		var self = this;
+		var baseName = path.basename(this.par2File).replace(/(\.vol\d+[-+]\d+)?\.par2$/i, '');
+		var volRe = /^\.vol\d+[-+]\d+\.par2$/i;
+		fs.readdir(this.baseDir, function(err, dirFiles) {
+			if(err) return cb(err);
+			self.par2Files = [self.par2File];
+			dirFiles.forEach(function(fn) {
+				if(fn.substring(0, baseName.length) != baseName) return;
+				var suffix = fn.substring(baseName.length);
+				var fullName = path.join(self.baseDir, fn);
+				if((volRe.test(suffix) || suffix.toLowerCase() == '.par2') && path.resolve(fullName) != path.resolve(self.par2File))
+					self.par2Files.push(fullName);
+			});
+			cb();
+		});
+	},
+	
+	// locate packets in a PAR2 file; critical packets are read and verified, whilst only the position of recovery packets is noted (their MD5 is checked when they're needed)
+	_scanFile: function(fileName, packets, cb) {
+		var fd, fileSize, pos = 0;
+		var header = allocBuffer(68);
+		var searchBuf = allocBuffer(SCAN_BLOCK);
+		
+		// find the next packet magic after a corrupt packet header
+		var resync = function(from, cb) {
+			if(from + 64 > fileSize) return cb(null, fileSize);
+			fs.read(fd, searchBuf, 0, SCAN_BLOCK, from, function(err, bytesRead) {
+				if(err) return cb(err);
+				var idx = bufferSlice.call(searchBuf, 0, bytesRead).indexOf(MAGIC);
+				if(idx >= 0) return cb(null, from + idx);
+				if(bytesRead < SCAN_BLOCK) return cb(null, fileSize);
+				resync(from + bytesRead - MAGIC.length + 1, cb);
+			});
+		};
+		var done = function(err) {
+			fs.close(fd, function(err2) {
+				cb(err || err2);
+			});
+		};
+		var nextPacket = function(err) {
+			if(err) return done(err);
+			if(pos + 64 > fileSize) return done();
+			fs.read(fd, header, 0, 68, pos, function(err, bytesRead) {
+				if(err) return done(err);
+				var len = bytesRead >= 64 ? readUInt64LE(header, 8) : 0;
+				if(bytesRead < 64 || bufferSlice.call(header, 0, 8).toString('binary') != MAGIC_STR)
+					len = 0;
+				if(len < 64 || len % 4 || pos + len > fileSize)
+					return resync(pos + 1, function(err, newPos) {
+						pos = newPos;
+						nextPacket(err);
+					});
+				
+				var type = bufferSlice.call(header, 48, 64).toString('binary');
+				if(type == PKT_RECVSLIC) {
+					if(len < 68) return resync(pos + 1, function(err, newPos) {
+						pos = newPos;
+						nextPacket(err);
+					});
+					packets.push({
+						setID: toBuffer(bufferSlice.call(header, 32, 48)),
+						type: type,
+						recovery: new PAR2RecoveryPacket(fileName, pos, len, header.readUInt32LE(64))
+					});
+					pos += len;
+					return nextPacket();
+				}
+				if(len > MAX_CRITICAL_PACKET) {
+					pos += len;
+					return nextPacket();
+				}
+				var pkt = allocBuffer(len);
+				fs.read(fd, pkt, 0, len, pos, function(err, bytesRead) {
+					if(err) return done(err);
+					if(bytesRead != len || md5(bufferSlice.call(pkt, 32)).toString('hex') != bufferSlice.call(pkt, 16, 32).toString('hex')) {
+						// corrupt packet
+						return resync(pos + 1, function(err, newPos) {
+							pos = newPos;
+							nextPacket(err);
+						});
+					}
+					packets.push({
+						setID: toBuffer(bufferSlice.call(pkt, 32, 48)),
+						type: type,
+						data: pkt
+					});
+					pos += len;
+					nextPacket();
+				});
+			});
+		};
+		
+		fs.open(fileName, 'r', function(err, _fd) {
+			if(err) return cb(err);
+			fd = _fd;
+			fs.fstat(fd, function(err, stat) {
+				if(err) return done(err);
+				fileSize = stat.size;
+				nextPacket();
+			});
+		});
+	},
+	
+	scan: function(cb) {
+		var self = this;
+		var packets = [];
+		this._findPar2Files(function(err) {
+			if(err) return cb(err);
+			async.eachSeries(self.par2Files, function(fileName, cb) {
+				self._scanFile(fileName, packets, function(err) {
+					// unreadable volumes are skipped, unless it's the one specified
+					if(err && fileName == self.par2File) return cb(err);
+					cb();
+				});
+			}, function(err) {
+				if(err) return cb(err);
+				try {
+					self._loadPackets(packets);
+				} catch(x) {
+					return cb(x);
+				}
+				cb();
+			});
+		});
+	},
+	
+	_loadPackets: function(packets) {
+		var self = this;
+		var main = null;
+		packets.some(function(pkt) {
+			if(pkt.type == PKT_MAIN) {
+				main = pkt;
+				return true;
+			}
+		});
+		if(!main) throw new Error('Could not find a valid main packet');
+		this.setID = main.setID;
+		var setHex = this.setID.toString('hex');
+		packets = packets.filter(function(pkt) {
+			return pkt.setID.toString('hex') == setHex;
+		});
+		
+		var mainData = main.data;
+		this.sliceSize = readUInt64LE(mainData, 64);
+		if(!this.sliceSize || this.sliceSize % 4) throw new Error('Invalid slice size in main packet');
+		var numFiles = mainData.readUInt32LE(72);
+		if(76 + numFiles*16 > mainData.length) throw new Error('Invalid main packet');
+		var fileMap = {};
+		for(var i=0; i<numFiles; i++) {
+			var file = new PAR2RepairFile(toBuffer(bufferSlice.call(mainData, 76 + i*16, 92 + i*16)));
+			fileMap[file.id.toString('hex')] = file;
+			this.files.push(file);
+		}
+		
+		var recoveryMap = {};
+		packets.forEach(function(pkt) {
+			var file;
+			if(pkt.type == PKT_FILEDESC) {
+				file = fileMap[bufferSlice.call(pkt.data, 64, 80).toString('hex')];
+				if(!file || file.name !== null) return;
+				file.md5 = toBuffer(bufferSlice.call(pkt.data, 80, 96));
+				file.size = readUInt64LE(pkt.data, 112);
+				file.name = bufferSlice.call(pkt.data, 120).toString(Par2.asciiCharset).replace(/\0+$/, '');
+			}
+			else if(pkt.type == PKT_IFSC) {
+				file = fileMap[bufferSlice.call(pkt.data, 64, 80).toString('hex')];
+				if(!file || file.slices) return;
+				file.slices = [];
+				for(var p=80; p+20<=pkt.data.length; p+=20)
+					file.slices.push(bufferSlice.call(pkt.data, p, p+16).toString('hex'));
+				file.checksums = bufferSlice.call(pkt.data, 80);
+			}
+			else if(pkt.type == PKT_RECVSLIC) {
+				if(pkt.recovery.exponent > 65534 || pkt.recovery.length != 68 + self.sliceSize) return;
+				if(!(pkt.recovery.exponent in recoveryMap)) {
+					recoveryMap[pkt.recovery.exponent] = true;
+					self.recovery.push(pkt.recovery);
+				}
+			}
+		});
+		this.recovery.sort(function(a, b) {
+			return a.exponent - b.exponent;
+		});
+		
+		var sliceOffset = 0;
+		this.files.forEach(function(file) {
+			if(file.name === null)
+				throw new Error('Missing file description packet for a file in the recovery set');
+			if(path.isAbsolute ? path.isAbsolute(file.name) : /^([\/\\]|[a-z]:)/i.test(file.name))
+				throw new Error('File "' + file.name + '" has an absolute path');
+			if(file.name.split(/[\/\\]/).indexOf('..') >= 0)
+				throw new Error('File "' + file.name + '" refers to a parent directory');
+			file.path = path.join(self.baseDir, file.name);
+			file.numSlices = Math.ceil(file.size / self.sliceSize);
+			if(file.numSlices && (!file.slices || file.slices.length < file.numSlices))
+				throw new Error('Missing slice checksum packet for "' + file.name + '"');
+			file.sliceOffset = sliceOffset;
+			sliceOffset += file.numSlices;
+		});
+		if(sliceOffset > 32768) throw new Error('Invalid number of input slices');
+		this.totalSlices = sliceOffset;
+	},
+	
+	// check each input slice against its checksum, then search damaged files for slices which have moved
+	verify: function(cbProgress, cb) {
+		var self = this;
+		var buf = allocBuffer(this.sliceSize);
+		async.eachSeries(this.files, function(file, cb) {
+			file.sliceValid = [];
+			fs.open(file.path, 'r', function(err, fd) {
+				if(err) {
+					if(err.code != 'ENOENT') return cb(err);
+					// missing file: all slices need rebuilding
+					for(var i=0; i<file.numSlices; i++)
+						file.sliceValid.push(false);
+					file.needsRepair = true;
+					if(cbProgress) cbProgress('verified_file', file);
+					return cb();
+				}
+				file.exists = true;
+				async.waterfall([
+					fs.fstat.bind(fs, fd),
+					function(stat, cb) {
+						if(stat.size != file.size) file.needsRepair = true;
+						async.timesSeries(file.numSlices, function(i, cb) {
+							var len = Math.min(self.sliceSize, file.size - i*self.sliceSize);
+							fs.read(fd, buf, 0, len, i*self.sliceSize, function(err, bytesRead) {
+								if(err) return cb(err);
+								var valid = false;
+								if(bytesRead == len) {
+									// slices are hashed with zero padding
+									if(len < self.sliceSize) buf.fill(0, len);
+									valid = md5(buf).toString('hex') == file.slices[i];
+								}
+								file.sliceValid.push(valid);
+								if(valid) file.goodSlices++;
+								else file.needsRepair = true;
+								cb();
+							});
+						}, function(err) {
+							cb(err);
+						});
+					}
+				], function(err) {
+					fs.close(fd, function(err2) {
+						if(!err && cbProgress) cbProgress('verified_file', file);
+						cb(err || err2);
+					});
+				});
+			});
+		}, function(err) {
+			if(err) return cb(err);
+			self._findDisplaced(cbProgress, cb);
+		});
+	},
+	
+	// search damaged files for invalid slices at other offsets, so that they can be moved into place instead of being rebuilt
+	// only full sized slices can be found (see BlockScanner); found slices are held in memory until _openFiles writes them, so are limited by the memory limit
+	_findDisplaced: function(cbProgress, cb) {
+		var self = this;
+		var wanted = [], checksums = [];
+		this.files.forEach(function(file) {
+			file.sliceValid.forEach(function(valid, i) {
+				if(valid || (i == file.numSlices-1 && file.size % self.sliceSize)) return;
+				wanted.push({file: file, idx: i, data: null});
+				checksums.push(bufferSlice.call(file.checksums, i*20, i*20 + 20));
+			});
+		});
+		var scanFiles = this.files.filter(function(file) {
+			return file.exists && file.needsRepair;
+		});
+		var maxFound = this.opts.memoryLimit ? Math.floor(this.opts.memoryLimit / this.sliceSize) : wanted.length;
+		if(!wanted.length || !scanFiles.length || !maxFound) return this._setMissing(cb);
+		
+		var scanner = new binding.BlockScanner(this.sliceSize, Buffer.concat(checksums), this.opts.numThreads || 0);
+		// consecutive reads overlap by a slice (less a byte), so that slices spanning them can be found
+		var readSize = Math.max(DISPLACED_READ_SIZE, this.sliceSize);
+		var buf = allocBuffer(readSize + this.sliceSize - 1);
+		var found = 0;
+		async.eachSeries(scanFiles, function(file, cb) {
+			if(found >= maxFound) return cb();
+			fs.open(file.path, 'r', function(err, fd) {
+				if(err) return cb(err);
+				var scanFrom = function(pos) {
+					fs.read(fd, buf, 0, buf.length, pos, function(err, bytesRead) {
+						if(err || bytesRead < self.sliceSize) return fs.close(fd, cb.bind(null, err));
+						scanner.scan(bufferSlice.call(buf, 0, bytesRead), pos, function(matches) {
+							matches.forEach(function(match) {
+								var slice = wanted[match.block];
+								if(slice.data || found >= maxFound) return;
+								slice.data = allocBuffer(self.sliceSize);
+								buf.copy(slice.data, 0, match.offset - pos, match.offset - pos + self.sliceSize);
+								found++;
+							});
+							if(bytesRead < buf.length || found >= maxFound)
+								fs.close(fd, cb);
+							else
+								scanFrom(pos + readSize);
+						});
+					});
+				};
+				scanFrom(0);
+			});
+		}, function(err) {
+			if(err) return cb(err);
+			wanted.forEach(function(slice) {
+				if(!slice.data) return;
+				var file = slice.file;
+				file.sliceValid[slice.idx] = true;
+				file.goodSlices++;
+				file.needsRepair = true;
+				if(!file.displaced) file.displaced = [];
+				file.displaced.push(slice);
+			});
+			if(found && cbProgress) cbProgress('found_displaced', found);
+			self._setMissing(cb);
+		});
+	},
+	_setMissing: function(cb) {
+		var self = this;
+		this.missing = [];
+		this.missingFile = [];
+		this.files.forEach(function(file) {
+			file.sliceValid.forEach(function(valid, i) {
+				if(valid) return;
+				self.missing.push(file.sliceOffset + i);
+				self.missingFile.push(file);
+			});
+		});
+		cb();
+	},
+	
+	_verifyRecovery: function(rec, cb) {
+		var head = allocBuffer(36);
+		this.setID.copy(head, 0);
+		head.write(PKT_RECVSLIC, 16, 'binary');
+		head.writeUInt32LE(rec.exponent, 32);
+		fs.open(rec.fileName, 'r', function(err, fd) {
+			if(err) {
+				rec.valid = false;
+				return cb();
+			}
+			var pktHeader = allocBuffer(32);
+			fs.read(fd, pktHeader, 0, 32, rec.position, function(err) {
+				if(err) return fs.close(fd, cb.bind(null, err));
+				hashFileRange(fd, rec.dataOffset(), rec.length - 68, head, function(err, hash) {
+					rec.valid = !err && !!hash && hash.toString('hex') == bufferSlice.call(pktHeader, 16, 32).toString('hex');
+					fs.close(fd, cb);
+				});
+			});
+		});
+	},
+	
+	// invert the recovery matrix, verifying only as many recovery slices as needed, plus a few spares
+	// the spares are used to replace any recovery slices which can't be inverted (the PAR2 flaw), so the inversion doesn't need to be retried
+	_selectRecovery: function(cbProgress, cb) {
+		var self = this;
+		var inputValid = Array(this.totalSlices);
+		this.files.forEach(function(file) {
+			for(var i=0; i<file.numSlices; i++)
+				inputValid[file.sliceOffset + i] = file.sliceValid[i];
+		});
+		var wanted = this.missing.length + SPARE_RECOVERY;
+		var verified = [];
+		async.eachSeries(this.recovery, function(rec, cb) {
+			if(verified.length >= wanted) return cb();
+			self._verifyRecovery(rec, function(err) {
+				if(!err && rec.valid) verified.push(rec);
+				cb(err);
+			});
+		}, function(err) {
+			if(err) return cb(err);
+			if(verified.length < self.missing.length)
+				return cb(new Error('Need ' + self.missing.length + ' recovery slices to repair, but only ' + verified.length + ' are available'));
+			self.gf.setRepair(inputValid, verified.map(function(rec) {
+				return rec.exponent;
+			}), function(result) {
+				if(!result)
+					return cb(new Error('Unable to repair with the ' + verified.length + ' available recovery slices'));
+				var byExponent = {};
+				verified.forEach(function(rec) {
+					byExponent[rec.exponent] = rec;
+				});
+				self.recoveryUsed = result.recovery.map(function(exp) {
+					return byExponent[exp];
+				});
+				cb();
+			}, cbProgress ? function(done, total) {
+				cbProgress('invert_progress', done, total);
+			} : null);
+		});
+	},
+	
+	// decide how many missing slices to rebuild at a time, and how much of each slice to process per pass, to fit within the memory limit
+	_planPasses: function() {
+		var numMissing = this.missing.length;
+		var mem = this.opts.memoryLimit;
+		var chunkSize = this.sliceSize, groupSize = numMissing;
+		
+		// the CPU backend copies inputs into staging areas, each holding a batch of inputs; size batches the same way it does by default
+		var multiple = Par2.gf_info('').target_grouping;
+		var batchSize = Math.max(multiple, Math.round(12 / multiple) * multiple);
+		var numSources = this.totalSlices; // surviving inputs, plus a recovery slice for each missing input
+		if(numSources < batchSize * STAGING_AREAS)
+			batchSize = Math.ceil(numSources / STAGING_AREAS);
+		this.batchSize = batchSize;
+		
+		if(mem) {
+			var minChunk = Math.min(MIN_CHUNK_SIZE, this.sliceSize);
+			// recovery memory for each rebuilt slice, plus staging, read buffers and an output buffer
+			var overheadBufs = batchSize * STAGING_AREAS + this.opts.readBuffers + 1;
+			chunkSize = Math.min(this.sliceSize, Math.floor(mem / (numMissing + overheadBufs) / 4) * 4);
+			if(chunkSize < minChunk) {
+				chunkSize = minChunk;
+				groupSize = Math.max(1, Math.min(numMissing, Math.floor(mem / chunkSize) - overheadBufs));
+			}
+		}
+		this.chunkSize = chunkSize;
+		this.groupSize = groupSize;
+	},
+	
+	_openFiles: function(cb) {
+		var self = this;
+		async.eachSeries(this.files, function(file, cb) {
+			if(!file.numSlices && !file.needsRepair) return cb();
+			var mode = file.needsRepair ? (file.exists ? 'r+' : 'w+') : 'r';
+			if(!file.exists) {
+				// create parent directories of missing files
+				var dirs = [], dir = path.dirname(file.path);
+				while(dir != self.baseDir && dir != path.dirname(dir) && !fs.existsSync(dir)) {
+					dirs.unshift(dir);
+					dir = path.dirname(dir);
+				}
+				try {
+					dirs.forEach(function(dir) {
+						fs.mkdirSync(dir);
+					});
+				} catch(x) {
+					return cb(x);
+				}
+			}
+			fs.open(file.path, mode, function(err, fd) {
+				if(err) return cb(err);
+				file.fd = fd;
+				if(!file.needsRepair) return cb();
+				// move displaced slices into place first, as truncating may discard where they were found
+				async.eachSeries(file.displaced || [], function(slice, cb) {
+					fs.write(fd, slice.data, 0, self.sliceSize, slice.idx*self.sliceSize, function(err) {
+						cb(err);
+					});
+				}, function(err) {
+					file.displaced = null;
+					if(err) return cb(err);
+					// sizing the file up front allows rebuilt slices to be written in place, and strips any appended data
+					fs.ftruncate(fd, file.size, cb);
+				});
+			});
+		}, cb);
+	},
+	_closeFiles: function(cb) {
+		async.eachSeries(this.files, function(file, cb) {
+			if(file.fd === null) return cb();
+			var fd = file.fd;
+			file.fd = null;
+			fs.close(fd, cb);
+		}, cb);
+	},
+	
+	// send part of every surviving input and recovery slice to the GF processor, then write the rebuilt parts of the missing slices
+	_runPass: function(groupFirst, groupCount, chunkOffset, cbProgress, cb) {
+		var self = this;
+		var gf = this.gf;
+		var len = Math.min(this.chunkSize, this.sliceSize - chunkOffset);
+		gf.setCurrentSliceSize(len);
+		gf.setRepairGroup(groupFirst, groupCount);
+		
+		// sources in the order of GfProc.add's indicies: surviving inputs, then recovery slices
+		var sources = [];
+		this.files.forEach(function(file) {
+			for(var i=0; i<file.numSlices; i++) {
+				if(!file.sliceValid[i]) continue;
+				var pos = i*self.sliceSize + chunkOffset;
+				var readLen = Math.min(len, file.size - pos);
+				if(readLen > 0) // parts beyond the end of a file are zero, so don't contribute
+					sources.push({idx: file.sliceOffset + i, fd: file.fd, pos: pos, len: readLen});
+			}
+		});
+		var recFds = this._recFds;
+		this.recoveryUsed.forEach(function(rec, i) {
+			sources.push({idx: self.totalSlices + i, fd: recFds[rec.fileName], pos: rec.dataOffset() + chunkOffset, len: len});
+		});
+		
+		var pool = new BufferPool(this._readBufs, this.chunkSize, this.opts.readBuffers);
+		var addQueue = [];
+		var pending = 0, readDone = false, endCalled = false;
+		var err = null;
+		var finish = function() {
+			if(endCalled || !readDone || addQueue.length || err) return;
+			endCalled = true;
+			gf.end(function() {
+				pool.end(function() {
+					self._writeOutputs(groupFirst, groupCount, chunkOffset, len, cb);
+				});
+			});
+		};
+		var add = function(item) {
+			return gf.add(item.idx, item.data, function() {
+				pool.put(item.buf);
+			});
+		};
+		gf.setProgressCb(function() {
+			while(addQueue.length && add(addQueue[0]))
+				addQueue.shift();
+			finish();
+		});
+		
+		async.eachSeries(sources, function(src, cb) {
+			pool.get(function(buf) {
+				fs.read(src.fd, buf, 0, src.len, src.pos, function(err, bytesRead) {
+					if(err) return cb(err);
+					var item = {idx: src.idx, buf: buf, data: bufferSlice.call(buf, 0, src.len)};
+					if(bytesRead < src.len) buf.fill(0, bytesRead, src.len);
+					if(addQueue.length || !add(item))
+						addQueue.push(item);
+					cb();
+				});
+			});
+		}, function(_err) {
+			if(_err) {
+				err = _err;
+				// wait for the processor to finish with any buffers it has, before reporting the error
+				return gf.end(function() {
+					cb(err);
+				});
+			}
+			readDone = true;
+			if(cbProgress) cbProgress('pass_read', groupFirst, chunkOffset);
+			finish();
+		});
+	},
+	_writeOutputs: function(groupFirst, groupCount, chunkOffset, len, cb) {
+		var self = this;
+		var buf = this._outBuf;
+		async.timesSeries(groupCount, function(i, cb) {
+			self.gf.get(i, buf, function(idx, valid) {
+				if(!valid) return cb(new Error('Memory checksum error detected whilst rebuilding input slice ' + self.missing[groupFirst+idx] + ' - this is likely due to hardware memory corruption or a bug in ParPar'));
+				var sliceNum = self.missing[groupFirst+idx];
+				var file = self.missingFile[groupFirst+idx];
+				var pos = (sliceNum - file.sliceOffset)*self.sliceSize + chunkOffset;
+				var writeLen = Math.min(len, file.size - pos);
+				if(writeLen <= 0) return cb();
+				fs.write(file.fd, buf, 0, writeLen, pos, function(err) {
+					cb(err);
+				});
+			});
+		}, function(err) {
+			cb(err);
+		});
+	},
+	
+	repair: function(cbProgress, cb) {
+		var self = this;
+		if(!this.missing.length) {
+			// nothing to rebuild, but sizes may need fixing
+			return this._openFiles(function(err) {
+				self._closeFiles(function(err2) {
+					cb(err || err2);
+				});
+			});
+		}
+		
+		this._planPasses();
+		this.gf = new binding.GfProc(this.chunkSize, {input_batchsize: this.batchSize}, null, STAGING_AREAS);
+		if(this.opts.numThreads)
+			this.gf.setNumThreads(this.opts.numThreads);
+		var passes = [];
+		for(var g=0; g<this.missing.length; g+=this.groupSize)
+			for(var c=0; c<this.sliceSize; c+=this.chunkSize)
+				passes.push([g, Math.min(this.groupSize, this.missing.length - g), c]);
+		
+		this._recFds = {};
+		async.series([
+			this._selectRecovery.bind(this, cbProgress),
+			function(cb) {
+				if(cbProgress) cbProgress('repair_info', {
+					missing_slices: self.missing.length,
+					recovery_slices: self.recoveryUsed.length,
+					group_size: self.groupSize,
+					chunk_size: self.chunkSize,
+					passes: passes.length
+				});
+				self._outBuf = allocBuffer(self.chunkSize);
+				self._readBufs = [];
+				self._openFiles(cb);
+			},
+			function(cb) {
+				async.eachSeries(self.recoveryUsed, function(rec, cb) {
+					if(rec.fileName in self._recFds) return cb();
+					fs.open(rec.fileName, 'r', function(err, fd) {
+						if(!err) self._recFds[rec.fileName] = fd;
+						cb(err);
+					});
+				}, cb);
+			},
+			function(cb) {
+				async.eachSeries(passes, function(pass, cb) {
+					self._runPass(pass[0], pass[1], pass[2], cbProgress, function(err) {
+						if(!err && cbProgress) cbProgress('pass_complete', passes.indexOf(pass), passes.length);
+						cb(err);
+					});
+				}, cb);
+			}
+		], function(err) {
+			var recFds = self._recFds;
+			self._recFds = null;
+			self._outBuf = self._readBufs = null;
+			async.eachSeries(Object.keys(recFds), function(fn, cb) {
+				fs.close(recFds[fn], cb);
+			}, function() {
+				self._closeFiles(function(err2) {
+					self.gf.close();
+					self.gf = null;
+					cb(err || err2);
+				});
+			});
+		});
+	},
+	
+	// check the whole-file hash of repaired files
+	checkRepaired: function(cbProgress, cb) {
+		async.eachSeries(this.files, function(file, cb) {
+			if(!file.needsRepair) return cb();
+			fs.open(file.path, 'r', function(err, fd) {
+				if(err) return cb(err);
+				hashFileRange(fd, 0, file.size, null, function(err, hash) {
+					fs.close(fd, function() {
+						if(err) return cb(err);
+						if(!hash || hash.toString('hex') != file.md5.toString('hex'))
+							return cb(new Error('Repaired file "' + file.name + '" does not match its checksum'));
+						if(cbProgress) cbProgress('repaired_file', file);
+						cb();
+					});
+				});
+			});
+		}, cb);
+	},
+	
+	run: function(cbProgress, cb) {
+		var self = this;
+		async.series([
+			this.scan.bind(this),
+			function(cb) {
+				if(cbProgress) cbProgress('scanned', self.par2Files.length, self.recovery.length);
+				self.verify(cbProgress, cb);
+			},
+			function(cb) {
+				if(!self.needsRepair()) return cb();
+				self.repair(cbProgress, cb);
+			},
+			function(cb) {
+				self.checkRepaired(cbProgress, cb);
+			}
+		], function(err) {
+			cb(err);
+		});
+	},
+	needsRepair: function() {
+		return this.files.some(function(file) {
+			return file.needsRepair;
+		});
+	}
+};
+
+module.exports = {
+	PAR2Repair: PAR2Repair,
+	repair: function(par2File, opts, cb) {
+		if(typeof opts == 'function' && cb === undefined) {
+			cb = opts;
+			opts = {};
+		}
+		var ee = new emitter();
+		var rep = new PAR2Repair(par2File, opts);
+		process.nextTick(function() {
+			ee.emit('info', rep);
+			rep.run(function(event) {
+				var args = Array.prototype.slice.call(arguments, 1);
+				ee.emit.apply(ee, [event, rep].concat(args));
+			}, cb);
+		});
+		return ee;
+	}
+};
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <uv.h>
+#include <atomic>
 #include <node_object_wrap.h>
 
 #if defined(_MSC_VER)
@@ -24,8 +25,11 @@
 #include "../gf16/controller.h"
 #include "../gf16/controller_cpu.h"
 #include "../gf16/controller_ocl.h"
+#include "../gf16/controller_repair.h"
 #include "../gf16/threadqueue.h"
 #include "../hasher/hasher.h"
+#include "../hasher/hasher_input_pool.h"
+#include "../hasher/hasher_blockscan.h"
 
 
 using namespace v8;
@@ -106,6 +110,12 @@ using namespace v8;
 # define SET_OBJ_FUNC(obj, key, f) (obj)->Set(NEW_STRING(key), f->GetFunction())
 #endif
 
+#if NODE_VERSION_AT_LEAST(10, 0, 0)
+# define UTF8_VALUE(var, a) String::Utf8Value var(isolate, a)
+#else
+# define UTF8_VALUE(var, a) String::Utf8Value var(a)
+#endif
+
 
 
 #if NODE_VERSION_AT_LEAST(0, 11, 0)
@@ -219,7 +229,8 @@ struct CallbackWrapper {
 
 struct GfOclSpec {
 	int platformId, deviceId;
-	size_t sliceOffset, sliceSize;
+	size_t sliceOffset, sliceSize, sliceMax;
+	unsigned outputFirst, outputCount;
 	
 	Galois16OCLMethods method;
 	Galois16Methods cksumMethod;
@@ -236,6 +247,13 @@ static bool load_ocl() {
 	return true;
 }
 
+// HasherInput objects can be supplied to GfProc.add, to hash inputs whilst they're prepared; returns NULL if `obj` isn't a HasherInput
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+static HasherInputStream* unwrapHasherInput(Isolate* isolate, Local<Value> obj);
+#else
+static HasherInputStream* unwrapHasherInput(Local<Value> obj);
+#endif
+
 class GfProc : public node::ObjectWrap {
 public:
 	static inline void AttachMethods(Local<FunctionTemplate>& t) {
@@ -244,13 +262,24 @@ public:
 		NODE_SET_PROTOTYPE_METHOD(t, "close", Close);
 		NODE_SET_PROTOTYPE_METHOD(t, "freeMem", FreeMem);
 		NODE_SET_PROTOTYPE_METHOD(t, "setRecoverySlices", SetRecoverySlices);
+#ifdef PARPAR_INVERT_SUPPORT
+		NODE_SET_PROTOTYPE_METHOD(t, "setRepair", SetRepair);
+		NODE_SET_PROTOTYPE_METHOD(t, "setRepairGroup", SetRepairGroup);
+#endif
 		NODE_SET_PROTOTYPE_METHOD(t, "setCurrentSliceSize", SetCurrentSliceSize);
 		NODE_SET_PROTOTYPE_METHOD(t, "setNumThreads", SetNumThreads);
+		NODE_SET_PROTOTYPE_METHOD(t, "setAutoBalance", SetAutoBalance);
 		NODE_SET_PROTOTYPE_METHOD(t, "setProgressCb", SetProgressCb);
 		NODE_SET_PROTOTYPE_METHOD(t, "info", GetInfo);
 		NODE_SET_PROTOTYPE_METHOD(t, "add", AddSlice);
+		NODE_SET_PROTOTYPE_METHOD(t, "canHashInput", CanHashInput);
 		NODE_SET_PROTOTYPE_METHOD(t, "end", EndInput);
 		NODE_SET_PROTOTYPE_METHOD(t, "get", GetOutputSlice);
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+		NODE_SET_PROTOTYPE_METHOD(t, "setOutputHashing", SetOutputHashing);
+		NODE_SET_PROTOTYPE_METHOD(t, "getGroup", GetOutputGroup);
+		NODE_SET_PROTOTYPE_METHOD(t, "getGroupMD5", GetOutputGroupMD5);
+#endif
 	}
 	
 	FUNC(New) {
@@ -270,8 +299,16 @@ public:
 		int stagingAreas = 2;
 		int cpuMethod = GF16_AUTO;
 		unsigned cpuInputGrouping = 0, cpuInputMinGrouping = 0;
+		int cpuTransferThreads = 1;
+		int cpuNuma = 0, cpuNumaFakeNodes = 0;
+		int cpuHybrid = 0; // opt-in, as it pins workers to CPUs (within the process' affinity mask)
+		int cpuPageMode = PROC_PAGES_DEFAULT;
+		int cpuZeroedMem = 0;
+		int cpuInPlaceInput = 0;
+		size_t cpuStagingMemory = 0;
 		size_t cpuChunkLen = 0;
-		size_t cpuOffset = 0, cpuSliceSize = sliceSize;
+		size_t cpuOffset = 0, cpuSliceSize = sliceSize, cpuSliceMax = 0;
+		unsigned cpuOutputFirst = 0, cpuOutputCount = 0;
 #define ASSIGN_INT_VAL(prop, key, var, type) \
 	if(OBJ_HAS(prop, key)) { \
 		Local<Value> v = GET_OBJ(prop, key); \
@@ -291,6 +328,21 @@ public:
 					RETURN_ERROR("Input batchsize is invalid");
 				ASSIGN_INT_VAL(prop, "input_minbatchsize", cpuInputMinGrouping, Uint32)
 				ASSIGN_INT_VAL(prop, "chunk_size", cpuChunkLen, Uint32)
+				ASSIGN_INT_VAL(prop, "transfer_threads", cpuTransferThreads, Int32)
+				ASSIGN_INT_VAL(prop, "numa", cpuNuma, Int32)
+				ASSIGN_INT_VAL(prop, "numa_fake_nodes", cpuNumaFakeNodes, Int32)
+				if(cpuNumaFakeNodes < 0)
+					RETURN_ERROR("Invalid number of fake NUMA nodes");
+				ASSIGN_INT_VAL(prop, "hybrid", cpuHybrid, Int32)
+				ASSIGN_INT_VAL(prop, "huge_pages", cpuPageMode, Int32)
+				if(cpuPageMode < PROC_PAGES_DEFAULT || cpuPageMode > PROC_PAGES_HUGETLB)
+					RETURN_ERROR("Invalid huge page mode");
+				ASSIGN_INT_VAL(prop, "zeroed_memory", cpuZeroedMem, Int32)
+				// inputs are read from the caller's buffers, which are only released once their batch has been processed; the value is the number of buffers the caller has for adding inputs, which must be able to fill a batch
+				ASSIGN_INT_VAL(prop, "inplace_input", cpuInPlaceInput, Int32)
+				if(cpuInPlaceInput < 0)
+					RETURN_ERROR("Invalid number of in-place input buffers");
+				ASSIGN_INT_VAL(prop, "staging_memory", cpuStagingMemory, Integer)
 				ASSIGN_INT_VAL(prop, "slice_offset", cpuOffset, Integer)
 				if(cpuOffset & 1 || cpuOffset > sliceSize)
 					RETURN_ERROR("Invalid CPU slice offset");
@@ -299,6 +351,13 @@ public:
 					RETURN_ERROR("CPU slice size must be a multiple of 2");
 				if(cpuOffset+cpuSliceSize > sliceSize)
 					RETURN_ERROR("CPU slice offset+size cannot exceed the slice size");
+				// the most of the slice the CPU can be given when auto-balancing
+				ASSIGN_INT_VAL(prop, "slice_max", cpuSliceMax, Integer)
+				// only compute some of the recovery slices; output_count = 0 means all from output_first onwards
+				ASSIGN_INT_VAL(prop, "output_first", cpuOutputFirst, Uint32)
+				ASSIGN_INT_VAL(prop, "output_count", cpuOutputCount, Uint32)
+				if(cpuOutputFirst > 65535 || cpuOutputCount > 65535)
+					RETURN_ERROR("Invalid CPU recovery slice range");
 			}
 		}
 		std::vector<struct GfOclSpec> useOcl;
@@ -306,12 +365,17 @@ public:
 			Local<Array> props = Local<Array>::Cast(args[2]);
 			for(unsigned i=0; i<props->Length(); i++) {
 				Local<Object> prop = ARG_TO_OBJ(GET_ARR(props, i));
-				struct GfOclSpec spec{-1, -1, 0, 0, GF16OCL_AUTO, GF16_AUTO, 0, 0, 0, 0};
+				struct GfOclSpec spec{-1, -1, 0, 0, 0, 0, 0, GF16OCL_AUTO, GF16_AUTO, 0, 0, 0, 0};
 				// TODO: validate platform/device
 				ASSIGN_INT_VAL(prop, "platform", spec.platformId, Int32)
 				ASSIGN_INT_VAL(prop, "device", spec.deviceId, Int32)
 				ASSIGN_INT_VAL(prop, "slice_size", spec.sliceSize, Integer)
 				ASSIGN_INT_VAL(prop, "slice_offset", spec.sliceOffset, Integer)
+				ASSIGN_INT_VAL(prop, "slice_max", spec.sliceMax, Integer)
+				ASSIGN_INT_VAL(prop, "output_first", spec.outputFirst, Uint32)
+				ASSIGN_INT_VAL(prop, "output_count", spec.outputCount, Uint32)
+				if(spec.outputFirst > 65535 || spec.outputCount > 65535)
+					RETURN_ERROR("Invalid OpenCL recovery slice range");
 				int method = 0;
 				ASSIGN_INT_VAL(prop, "method", method, Int32)
 				if(method) spec.method = (Galois16OCLMethods)method;
@@ -349,16 +413,29 @@ public:
 			RETURN_ERROR("At least the CPU or one OpenCL device must be enabled");
 		}
 		
-		GfProc *self = new GfProc(sliceSize, stagingAreas, cpuOffset, cpuSliceSize, useOcl, getCurrentLoop(ISOLATE 0));
-		size_t usedSliceSize = 0;
+		GfProc *self = new GfProc(sliceSize, stagingAreas, cpuOffset, cpuSliceSize, cpuSliceMax, cpuOutputFirst, cpuOutputCount, useOcl, getCurrentLoop(ISOLATE 0));
 		if(useCpu && !self->init_cpu((Galois16Methods)cpuMethod, cpuInputGrouping, cpuChunkLen)) {
 			delete self;
 			RETURN_ERROR("Failed to allocate memory");
 		}
-		if(useCpu) self->par2cpu->setMinInputBatchSize(cpuInputMinGrouping);
+		if(useCpu) {
+			self->par2cpu->setMinInputBatchSize(cpuInputMinGrouping);
+			self->par2cpu->setTransferThreads(cpuTransferThreads);
+			if(cpuNuma || cpuNumaFakeNodes)
+				self->par2cpu->setNumaMode(true, cpuNumaFakeNodes);
+			else if(cpuHybrid)
+				self->par2cpu->setHybridMode(true);
+			self->par2cpu->setPageMode((PAR2ProcCPUPageMode)cpuPageMode);
+			self->par2cpu->setZeroedMemory(cpuZeroedMem != 0);
+			if(cpuInPlaceInput && (unsigned)cpuInPlaceInput < self->par2cpu->getInputBatchSize()) {
+				delete self;
+				RETURN_ERROR("In-place input requires at least as many input buffers as the input batch size");
+			}
+			self->par2cpu->setInPlaceInput(cpuInPlaceInput != 0);
+			self->par2cpu->setStagingMemoryLimit(cpuStagingMemory);
+		}
 		int oclI = 0;
 		for(const auto& oclSpec : useOcl) {
-			usedSliceSize += oclSpec.sliceSize;
 			if(oclSpec.sliceSize == 0 || (oclSpec.sliceSize & 1)) {
 				delete self;
 				RETURN_ERROR("Invalid slice size allocated to OpenCL device");
@@ -378,7 +455,8 @@ public:
 			self->par2ocl[oclI]->setMinInputBatchSize(oclSpec.inputMinGrouping);
 			oclI++;
 		}
-		if((useCpu && usedSliceSize >= sliceSize) || (!useCpu && usedSliceSize != sliceSize)) {
+		// devices may be given the same part of the slice, in which case they share its inputs between them, or compute different recovery slices from it
+		if(!self->allocValid) {
 			delete self;
 			RETURN_ERROR("Slice portions allocated to OpenCL devices is invalid");
 		}
@@ -392,10 +470,16 @@ private:
 	bool isClosed;
 	bool pendingDiscardOutput;
 	bool hasOutput;
+	bool cpuWholeSlice; // CPU is the only backend, so it computes all of every recovery slice
+	bool allocValid; // whether the parts of the slice (and recovery slices) allocated to each backend cover it, without partially overlapping
+	unsigned minOutputs, maxOutputs; // range of recovery slice counts which the ranges allocated to backends can cover; maxOutputs = 0 means no limit
 	CallbackWrapper progressCb;
 	PAR2Proc par2;
 	std::unique_ptr<PAR2ProcCPU> par2cpu;
 	std::vector<std::unique_ptr<PAR2ProcOCL>> par2ocl;
+#ifdef PARPAR_INVERT_SUPPORT
+	std::unique_ptr<PAR2Repair> repair; // if set, outputs are missing input slices, rather than recovery
+#endif
 	
 	// disable copy constructor
 	GfProc(const GfProc&);
@@ -459,7 +543,19 @@ protected:
 		self->hasOutput = false;
 		if(!self->par2.setCurrentSliceSize(sliceSize))
 			RETURN_ERROR("Failed to allocate memory");
-		RETURN_UNDEF;
+		
+		// if auto-balancing redistributed the slice, return the throughput measured for each backend (in the order of OpenCL devices, then CPU) and the part of the slice now allocated to it
+		const auto& balance = self->par2.getBalance();
+		if(balance.empty()) RETURN_UNDEF;
+		Local<Array> ret = Array::New(ISOLATE balance.size());
+		for(unsigned i=0; i<balance.size(); i++) {
+			Local<Object> backend = NEW_OBJ(Object);
+			SET_OBJ(backend, "rate", Number::New(ISOLATE balance[i].rate));
+			SET_OBJ(backend, "slice_offset", Number::New(ISOLATE (double)balance[i].offset));
+			SET_OBJ(backend, "slice_size", Number::New(ISOLATE (double)balance[i].size));
+			SET_ARR(ret, i, backend);
+		}
+		RETURN_VAL(ret);
 	}
 	FUNC(SetRecoverySlices) {
 		FUNC_START;
@@ -488,12 +584,192 @@ protected:
 				RETURN_ERROR("Invalid recovery index supplied");
 		}
 		
+		if((unsigned)numOutputs < self->minOutputs || (self->maxOutputs && (unsigned)numOutputs > self->maxOutputs))
+			RETURN_ERROR("Number of recovery indicies doesn't fit the recovery slices allocated to each device");
+		
 		self->hasOutput = false; // probably can be retained, but we'll pretend not for consistency's sake
 		if(!self->par2.setRecoverySlices(outputs))
 			RETURN_ERROR("Failed to allocate memory");
+#ifdef PARPAR_INVERT_SUPPORT
+		self->repair.reset();
+#endif
+		RETURN_UNDEF;
+	}
+	
+#ifdef PARPAR_INVERT_SUPPORT
+	struct repair_work_data {
+		uv_work_t req;
+		uv_async_t progressSignal;
+		std::atomic<uint32_t> progress; // last progress reported by the inversion, as (done << 16) | total
+		uint32_t lastProgress; // last progress passed to progressCb
+		GfProc* self;
+		std::unique_ptr<PAR2Repair> repair;
+		std::vector<bool> inputValid;
+		std::vector<uint16_t> recovery;
+		int numThreads;
+		bool success;
+		CallbackWrapper* cb;
+		CallbackWrapper* progressCb; // NULL if progress isn't wanted
+		
+		~repair_work_data() {
+			delete cb;
+			delete progressCb;
+		}
+	};
+	static void do_repair(uv_work_t *req) {
+		struct repair_work_data* data = static_cast<struct repair_work_data*>(req->data);
+		std::function<void(uint16_t, uint16_t)> progressCb = nullptr;
+		if(data->progressCb) progressCb = [data](uint16_t done, uint16_t total) {
+			// only the latest report is passed on, so reports may be skipped if the main thread is busy
+			data->progress = ((uint32_t)done << 16) | total;
+			uv_async_send(&data->progressSignal);
+		};
+		data->success = data->repair->init(data->inputValid, data->recovery, data->numThreads, progressCb);
+	}
+	static void after_repair(uv_work_t *req, int status) {
+		assert(status == 0);
+		
+		struct repair_work_data* data = static_cast<struct repair_work_data*>(req->data);
+		GfProc* self = data->self;
+		self->isRunning = false;
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+		Isolate* isolate = data->cb->isolate;
+		HandleScope scope(isolate);
+#else
+		HandleScope scope;
+#endif
+		if(data->success) {
+			const auto& missing = data->repair->getMissingInputs();
+			const auto& used = data->repair->getRecoveryExponents();
+			Local<Array> retMissing = Array::New(ISOLATE missing.size());
+			for(unsigned i=0; i<missing.size(); i++)
+				SET_ARR(retMissing, i, Integer::New(ISOLATE missing[i]));
+			Local<Array> retRecovery = Array::New(ISOLATE used.size());
+			for(unsigned i=0; i<used.size(); i++)
+				SET_ARR(retRecovery, i, Integer::New(ISOLATE used[i]));
+			
+			self->repair = std::move(data->repair);
+			self->hasOutput = false;
+			Local<Object> ret = NEW_OBJ(Object);
+			SET_OBJ(ret, "missing", retMissing);
+			SET_OBJ(ret, "recovery", retRecovery);
+			data->cb->call(scope, { ret });
+		} else
+			data->cb->call(scope);
+		
+		// any pending progress notification is dropped when the handle is closed
+		uv_close(reinterpret_cast<uv_handle_t*>(&data->progressSignal), [](uv_handle_t* handle) {
+			delete static_cast<struct repair_work_data*>(handle->data);
+		});
+	}
+	
+	// switch to rebuilding missing input slices, given which inputs are intact and the exponents of the available recovery slices
+	// available recovery beyond the number of missing inputs is only used to replace recovery slices which can't be inverted (the PAR2 flaw); supplying a few spares avoids having to retry the inversion
+	// the inversion runs on a work thread, using the threads configured for the CPU backend; once done, the callback receives the indicies of missing inputs, and the exponents of the recovery slices needed to rebuild them, or nothing if there's insufficient recovery
+	// the recovery exponents define the order that recovery slices are added with (see AddSlice); the optional progress callback receives the number of steps done and total
+	FUNC(SetRepair) {
+		FUNC_START;
+		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
+		if(self->isRunning)
+			RETURN_ERROR("Cannot change params whilst running");
+		if(self->isClosed)
+			RETURN_ERROR("Already closed");
+		if(!self->par2ocl.empty())
+			RETURN_ERROR("Repair is only supported on the CPU");
+		
+		if(args.Length() < 3 || !args[0]->IsArray() || !args[1]->IsArray() || !args[2]->IsFunction())
+			RETURN_ERROR("List of valid inputs, recovery exponents and callback required");
+		if(args.Length() >= 4 && !args[3]->IsUndefined() && !args[3]->IsNull() && !args[3]->IsFunction())
+			RETURN_ERROR("Progress callback must be a function");
+		
+		auto argValid = Local<Array>::Cast(args[0]);
+		auto argRecovery = Local<Array>::Cast(args[1]);
+		unsigned numInputs = argValid->Length();
+		unsigned numRecovery = argRecovery->Length();
+		if(numInputs < 1 || numInputs > 32768)
+			RETURN_ERROR("Invalid number of inputs specified");
+		if(numRecovery > 65535)
+			RETURN_ERROR("Too many recovery exponents specified");
+		
+		std::vector<bool> inputValid(numInputs);
+		for(unsigned i=0; i<numInputs; i++)
+			inputValid[i] = GET_ARR(argValid, i)->IsTrue();
+		std::vector<uint16_t> recovery(numRecovery);
+		for(unsigned i=0; i<numRecovery; i++) {
+			unsigned exp = ARG_TO_NUM(Uint32, GET_ARR(argRecovery, i));
+			if(exp > 65534)
+				RETURN_ERROR("Invalid recovery exponent supplied");
+			recovery[i] = exp;
+		}
+		
+		// the previous repair setup is invalid from here on
+		self->repair.reset();
+		self->hasOutput = false;
+		self->isRunning = true;
+		
+		struct repair_work_data* data = new struct repair_work_data;
+		data->self = self;
+		data->repair.reset(new PAR2Repair());
+		data->inputValid = std::move(inputValid);
+		data->recovery = std::move(recovery);
+		data->numThreads = self->par2cpu->getNumThreads();
+		data->success = false;
+		data->progress = 0;
+		data->lastProgress = 0;
+		data->cb = new CallbackWrapper(ISOLATE Local<Function>::Cast(args[2]));
+		data->progressCb = args.Length() >= 4 && args[3]->IsFunction() ? new CallbackWrapper(ISOLATE Local<Function>::Cast(args[3])) : NULL;
+		
+		uv_loop_t* loop = getCurrentLoop(ISOLATE 0);
+		uv_async_init(loop, &data->progressSignal, [](uv_async_t *handle
+#if UV_VERSION_MAJOR < 1
+			, int
+#endif
+		) {
+			struct repair_work_data* data = static_cast<struct repair_work_data*>(handle->data);
+			uint32_t progress = data->progress;
+			if(progress == data->lastProgress) return;
+			data->lastProgress = progress;
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+			Isolate* isolate = data->progressCb->isolate;
+			HandleScope scope(isolate);
+#else
+			HandleScope scope;
+#endif
+			data->progressCb->call(scope, { Integer::New(ISOLATE progress >> 16), Integer::New(ISOLATE progress & 0xffff) });
+		});
+		data->progressSignal.data = static_cast<void*>(data);
+		data->req.data = static_cast<void*>(data);
+		uv_queue_work(loop, &data->req, do_repair, after_repair);
 		RETURN_UNDEF;
 	}
 	
+	// select the missing inputs (by position in the list returned from setRepair) to rebuild; output `i` then refers to missing input `first+i`
+	FUNC(SetRepairGroup) {
+		FUNC_START;
+		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
+		if(self->isRunning)
+			RETURN_ERROR("Cannot change params whilst running");
+		if(self->isClosed)
+			RETURN_ERROR("Already closed");
+		if(!self->repair)
+			RETURN_ERROR("setRepair not yet called");
+		
+		if(args.Length() < 2)
+			RETURN_ERROR("Group offset and size required");
+		unsigned first = ARG_TO_NUM(Uint32, args[0]);
+		unsigned count = ARG_TO_NUM(Uint32, args[1]);
+		if(count < 1 || first + count > self->repair->getMissingInputs().size())
+			RETURN_ERROR("Invalid repair group specified");
+		if(count < self->minOutputs || (self->maxOutputs && count > self->maxOutputs))
+			RETURN_ERROR("Number of missing inputs doesn't fit the recovery slices allocated to each device");
+		
+		self->hasOutput = false;
+		if(!self->repair->setOutputGroup(self->par2, first, count))
+			RETURN_ERROR("Failed to allocate memory");
+		RETURN_UNDEF;
+	}
+#endif
+
 	FUNC(SetNumThreads) {
 		FUNC_START;
 		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
@@ -511,6 +787,20 @@ protected:
 		RETURN_VAL(Integer::New(ISOLATE self->par2cpu->getNumThreads()));
 	}
 	
+	FUNC(SetAutoBalance) {
+		FUNC_START;
+		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
+		if(self->isRunning)
+			RETURN_ERROR("Cannot change params whilst running");
+		if(self->isClosed)
+			RETURN_ERROR("Already closed");
+		
+		if(args.Length() < 1)
+			RETURN_ERROR("Argument required");
+		self->par2.setAutoBalance(args[0]->IsTrue());
+		RETURN_UNDEF;
+	}
+	
 	FUNC(SetProgressCb) {
 		FUNC_START;
 		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
@@ -539,14 +829,52 @@ protected:
 		Local<Object> ret = NEW_OBJ(Object);
 		if(self->par2cpu.get()) {
 			SET_OBJ(ret, "threads", Integer::New(ISOLATE self->par2cpu->getNumThreads()));
+			SET_OBJ(ret, "transfer_threads", Integer::New(ISOLATE self->par2cpu->getTransferThreads()));
 			SET_OBJ(ret, "method_desc", NEW_STRING(self->par2cpu->getMethodName()));
 			SET_OBJ(ret, "chunk_size", Number::New(ISOLATE self->par2cpu->getChunkLen()));
+			// detected cache sizes, which the default chunk size is derived from
+			const CpuCacheInfo& cache = cputopo_cache_info();
+			SET_OBJ(ret, "l1d_cache", Number::New(ISOLATE cache.l1d));
+			SET_OBJ(ret, "l2_cache", Number::New(ISOLATE cache.l2));
+			SET_OBJ(ret, "l2_cache_cores", Integer::New(ISOLATE cache.l2Cores));
+			SET_OBJ(ret, "l3_cache", Number::New(ISOLATE cache.l3));
 			SET_OBJ(ret, "staging_count", Integer::New(ISOLATE self->par2cpu->getStagingAreas()));
+			SET_OBJ(ret, "staging_max", Integer::New(ISOLATE self->par2cpu->getMaxStagingAreas()));
 			SET_OBJ(ret, "staging_size", Integer::New(ISOLATE self->par2cpu->getInputBatchSize()));
 			SET_OBJ(ret, "alignment", Integer::New(ISOLATE self->par2cpu->getAlignment()));
 			SET_OBJ(ret, "stride", Integer::New(ISOLATE self->par2cpu->getStride()));
 			SET_OBJ(ret, "slice_mem", Number::New(ISOLATE self->par2cpu->getAllocSliceSize()));
+			SET_OBJ(ret, "recovery_segments", Integer::New(ISOLATE self->par2cpu->getRecoverySegments()));
+			SET_OBJ(ret, "huge_pages", Boolean::New(ISOLATE self->par2cpu->getUsingHugePages()));
+			SET_OBJ(ret, "inplace_input", Boolean::New(ISOLATE self->par2cpu->getInPlaceInput()));
 			SET_OBJ(ret, "num_output_slices", Integer::New(ISOLATE self->par2cpu->getNumRecoverySlices()));
+			SET_OBJ(ret, "work_steals", Number::New(ISOLATE self->par2cpu->getStealCount()));
+			SET_OBJ(ret, "worker_idle_time", Number::New(ISOLATE self->par2cpu->getWorkerIdleTime()));
+			if(self->par2cpu->getNumaMode()) {
+				const auto numaStats = self->par2cpu->getNumaStats();
+				Local<Array> numaInfo = Array::New(ISOLATE numaStats.size());
+				for(unsigned i=0; i<numaStats.size(); i++) {
+					Local<Object> nodeInfo = NEW_OBJ(Object);
+					SET_OBJ(nodeInfo, "node", Integer::New(ISOLATE numaStats[i].node));
+					SET_OBJ(nodeInfo, "threads", Integer::New(ISOLATE numaStats[i].threads));
+					SET_OBJ(nodeInfo, "throughput", Number::New(ISOLATE numaStats[i].throughput));
+					SET_ARR(numaInfo, i, nodeInfo);
+				}
+				SET_OBJ(ret, "numa_nodes", numaInfo);
+			}
+			if(self->par2cpu->getHybridMode()) {
+				const auto classStats = self->par2cpu->getCoreClassStats();
+				Local<Array> classInfo = Array::New(ISOLATE classStats.size());
+				for(unsigned i=0; i<classStats.size(); i++) {
+					Local<Object> cls = NEW_OBJ(Object);
+					SET_OBJ(cls, "name", NEW_STRING(classStats[i].name.c_str()));
+					SET_OBJ(cls, "threads", Integer::New(ISOLATE classStats[i].threads));
+					SET_OBJ(cls, "throughput", Number::New(ISOLATE classStats[i].throughput));
+					SET_OBJ(cls, "weight", Number::New(ISOLATE classStats[i].weight));
+					SET_ARR(classInfo, i, cls);
+				}
+				SET_OBJ(ret, "core_classes", classInfo);
+			}
 		}
 		if(!self->par2ocl.empty()) {
 			Local<Array> oclDevInfo = Array::New(ISOLATE self->par2ocl.size());
@@ -587,12 +915,44 @@ protected:
 			RETURN_ERROR("Callback required");
 		
 		int idx = ARG_TO_NUM(Int32, args[0]);
+		const uint16_t* coeffs = nullptr;
+#ifdef PARPAR_INVERT_SUPPORT
+		// when repairing, indicies below the number of inputs refer to intact inputs; above that, to recovery slices, in the order returned from setRepair
+		if(self->repair) {
+			unsigned numInputs = self->repair->getNumInputs();
+			if(idx < 0 || (unsigned)idx >= numInputs + self->repair->getRecoveryExponents().size())
+				RETURN_ERROR("Input index not valid");
+			if((unsigned)idx < numInputs)
+				coeffs = self->repair->inputCoeffs(idx);
+			else
+				coeffs = self->repair->recoveryCoeffs(idx - numInputs);
+			if(!coeffs)
+				RETURN_ERROR("Input is missing");
+		} else
+#endif
 		if(idx < 0 || idx > 32767)
 			RETURN_ERROR("Input index not valid");
 		
 		if(node::Buffer::Length(args[1]) > self->par2.getCurrentSliceSize())
 			RETURN_ERROR("Input buffer too large");
 		
+		// if a HasherInput is supplied, the input is treated as its next block, and hashed alongside being added
+		HasherInputStream* hashStream = nullptr;
+		IHasherInput* hasher = nullptr;
+		void* md5crc = nullptr;
+		if(args.Length() >= 4 && !args[3]->IsUndefined() && !args[3]->IsNull()) {
+			if(!self->cpuWholeSlice)
+				RETURN_ERROR("Inputs can only be hashed when the CPU processes whole slices");
+			hashStream = unwrapHasherInput(ISOLATE args[3]);
+			if(!hashStream)
+				RETURN_ERROR("HasherInput required, which must not be ended or have pending updates");
+			if(hashStream->getBlockSize() != self->par2.getCurrentSliceSize())
+				RETURN_ERROR("Hasher block size doesn't match the current slice size");
+			hasher = hashStream->nextBlockHasher(md5crc);
+			if(!hasher)
+				RETURN_ERROR("HasherInput isn't at a block boundary");
+		}
+		
 		CallbackWrapper* cb = new CallbackWrapper(ISOLATE Local<Function>::Cast(args[2]));
 		cb->attachValue(args[1]);
 		
@@ -603,20 +963,31 @@ protected:
 			self->par2.discardOutput();
 		}
 		
-		bool added = self->par2.addInput(
-			node::Buffer::Data(args[1]), node::Buffer::Length(args[1]),
-			idx, false, [ISOLATE cb, idx]() {
-				HANDLE_SCOPE;
+		auto addCb = [ISOLATE cb, idx]() {
+			HANDLE_SCOPE;
 #if NODE_VERSION_AT_LEAST(0, 11, 0)
-				Local<Value> buffer = Local<Value>::New(cb->isolate, cb->value);
-				cb->call(scope, { Integer::New(cb->isolate, idx), buffer });
+			Local<Value> buffer = Local<Value>::New(cb->isolate, cb->value);
+			cb->call(scope, { Integer::New(cb->isolate, idx), buffer });
 #else
-				Local<Value> buffer = Local<Value>::New(cb->value);
-				cb->call(scope, { Integer::New(idx), buffer });
+			Local<Value> buffer = Local<Value>::New(cb->value);
+			cb->call(scope, { Integer::New(idx), buffer });
 #endif
-				delete cb;
-			}
-		);
+			delete cb;
+		};
+		bool added;
+		if(hasher) {
+			if(coeffs)
+				added = self->par2.addInput(node::Buffer::Data(args[1]), node::Buffer::Length(args[1]), coeffs, false, hasher, md5crc, addCb);
+			else
+				added = self->par2.addInput(node::Buffer::Data(args[1]), node::Buffer::Length(args[1]), idx, false, hasher, md5crc, addCb);
+			// a failed add is resent, and should hash into the same block
+			if(added) hashStream->advanceBlock();
+		} else {
+			if(coeffs)
+				added = self->par2.addInput(node::Buffer::Data(args[1]), node::Buffer::Length(args[1]), coeffs, false, addCb);
+			else
+				added = self->par2.addInput(node::Buffer::Data(args[1]), node::Buffer::Length(args[1]), idx, false, addCb);
+		}
 		
 		if(!added) {
 			delete cb;
@@ -624,6 +995,15 @@ protected:
 		RETURN_VAL(Boolean::New(ISOLATE added));
 	}
 	
+	// whether a HasherInput can be supplied to `add`, which is the case when the CPU processes whole slices (the CPU backend hashes inputs as part of its prepare)
+	FUNC(CanHashInput) {
+		FUNC_START;
+		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
+		if(self->isClosed)
+			RETURN_ERROR("Already closed");
+		RETURN_VAL(Boolean::New(ISOLATE self->cpuWholeSlice));
+	}
+	
 	FUNC(EndInput) {
 		FUNC_START;
 		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
@@ -697,20 +1077,146 @@ protected:
 		RETURN_UNDEF;
 	}
 	
-	explicit GfProc(size_t sliceSize, int stagingAreas, size_t cpuOffset, size_t cpuSliceSize, std::vector<struct GfOclSpec> useOcl, uv_loop_t* loop)
-	: ObjectWrap(), isRunning(false), isClosed(false), pendingDiscardOutput(true), hasOutput(false) {
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	// the CPU backend can compute recovery packet MD5s whilst finishing outputs, which avoids reading them again from JS (see HasherOutput)
+	// returns false if this isn't possible, in which case outputs need to be fetched with `get` and hashed separately
+	FUNC(SetOutputHashing) {
+		FUNC_START;
+		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
+		if(self->isRunning)
+			RETURN_ERROR("Cannot change params whilst running");
+		if(self->isClosed)
+			RETURN_ERROR("Already closed");
+		
+		if(args.Length() < 2)
+			RETURN_ERROR("Group size and set ID required");
+		unsigned groupSize = ARG_TO_NUM(Uint32, args[0]);
+		if(groupSize < 1 || groupSize > 65534)
+			RETURN_ERROR("Invalid group size specified");
+		if(!node::Buffer::HasInstance(args[1]) || node::Buffer::Length(args[1]) != 16)
+			RETURN_ERROR("Set ID must be a 16 byte Buffer");
+		
+		if(!self->cpuWholeSlice)
+			RETURN_VAL(Boolean::New(ISOLATE false));
+		self->par2cpu->setOutputHashing(groupSize, node::Buffer::Data(args[1]));
+		RETURN_VAL(Boolean::New(ISOLATE true));
+	}
+	
+	FUNC(GetOutputGroup) {
+		FUNC_START;
+		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
+		if(self->isRunning)
+			RETURN_ERROR("Cannot get output whilst running");
+		if(self->isClosed)
+			RETURN_ERROR("Already closed");
+		if(!self->hasOutput)
+			RETURN_ERROR("No finalized output to retrieve");
+		if(!self->cpuWholeSlice || !self->par2cpu->getOutputHashing())
+			RETURN_ERROR("Output hashing not enabled");
+		
+		if(args.Length() < 3)
+			RETURN_ERROR("Requires 3 arguments");
+		
+		if(!args[1]->IsArray())
+			RETURN_ERROR("Output buffers required");
+		if(!args[2]->IsFunction())
+			RETURN_ERROR("Callback required");
+		
+		unsigned group = ARG_TO_NUM(Uint32, args[0]);
+		if(group >= self->par2cpu->numOutputGroups())
+			RETURN_ERROR("Output group is not valid");
+		unsigned groupSize = self->par2cpu->getOutputHashing();
+		unsigned numOutputs = self->par2.getNumRecoverySlices() - group*groupSize;
+		if(numOutputs > groupSize) numOutputs = groupSize;
+		if(Local<Array>::Cast(args[1])->Length() != numOutputs)
+			RETURN_ERROR("Invalid number of output buffers given");
+		
+		// the pointers must outlive this call, as they're read on the transfer thread
+		auto outputs = new std::vector<void*>(numOutputs);
+		Local<Object> oBufs = ARG_TO_OBJ(args[1]);
+		for(unsigned i = 0; i < numOutputs; i++) {
+			Local<Value> buffer = GET_ARR(oBufs, i);
+			if(!node::Buffer::HasInstance(buffer) || node::Buffer::Length(buffer) < self->par2.getCurrentSliceSize()) {
+				delete outputs;
+				RETURN_ERROR("All outputs must be Buffers large enough to hold a slice");
+			}
+			(*outputs)[i] = node::Buffer::Data(buffer);
+		}
+		
+		CallbackWrapper* cb = new CallbackWrapper(ISOLATE Local<Function>::Cast(args[2]));
+		cb->attachValue(args[1]);
+		
+		self->par2cpu->getOutputGroup(
+			group,
+			outputs->data(),
+			[ISOLATE cb, group, outputs](bool cksumValid) {
+				delete outputs;
+				HANDLE_SCOPE;
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+				Local<Value> buffers = Local<Value>::New(cb->isolate, cb->value);
+				cb->call(scope, { Integer::New(cb->isolate, group), Boolean::New(cb->isolate, cksumValid), buffers });
+#else
+				Local<Value> buffers = Local<Value>::New(cb->value);
+				Local<Value> _group = Local<Value>::New(Integer::New(group));
+				Local<Value> _cksumValid = Local<Value>::New(Boolean::New(cksumValid));
+				cb->call(scope, { _group, _cksumValid, buffers });
+#endif
+				delete cb;
+			}
+		);
+		RETURN_UNDEF;
+	}
+	
+	FUNC(GetOutputGroupMD5) {
+		FUNC_START;
+		GfProc* self = node::ObjectWrap::Unwrap<GfProc>(args.This());
+		if(self->isClosed)
+			RETURN_ERROR("Already closed");
+		if(!self->cpuWholeSlice || !self->par2cpu->getOutputHashing())
+			RETURN_ERROR("Output hashing not enabled");
+		
+		if(args.Length() < 2 || !node::Buffer::HasInstance(args[1]))
+			RETURN_ERROR("Requires a group and a buffer");
+		
+		unsigned group = ARG_TO_NUM(Uint32, args[0]);
+		if(group >= self->par2cpu->numOutputGroups())
+			RETURN_ERROR("Output group is not valid");
+		unsigned groupSize = self->par2cpu->getOutputHashing();
+		unsigned numOutputs = self->par2.getNumRecoverySlices() - group*groupSize;
+		if(numOutputs > groupSize) numOutputs = groupSize;
+		if(node::Buffer::Length(args[1]) < numOutputs*16)
+			RETURN_ERROR("Buffer must be large enough to hold all hashes");
+		
+		self->par2cpu->getOutputGroupMD5(group, node::Buffer::Data(args[1]));
+		RETURN_UNDEF;
+	}
+#endif
+
+	explicit GfProc(size_t sliceSize, int stagingAreas, size_t cpuOffset, size_t cpuSliceSize, size_t cpuSliceMax, unsigned cpuOutputFirst, unsigned cpuOutputCount, std::vector<struct GfOclSpec> useOcl, uv_loop_t* loop)
+	: ObjectWrap(), isRunning(false), isClosed(false), pendingDiscardOutput(true), hasOutput(false), cpuWholeSlice(useOcl.empty() && cpuOffset == 0 && cpuSliceSize == sliceSize && cpuOutputFirst == 0 && cpuOutputCount == 0) {
 		std::vector<struct PAR2ProcBackendAlloc> procs;
+		minOutputs = 1;
+		maxOutputs = 0;
+		bool outputsOpen = false;
+		auto addOutputRange = [&](unsigned first, unsigned count) {
+			unsigned end = first + (count ? count : 1);
+			if(end > minOutputs) minOutputs = end;
+			if(end > maxOutputs) maxOutputs = end;
+			if(!count) outputsOpen = true;
+		};
+		if(cpuSliceSize) addOutputRange(cpuOutputFirst, cpuOutputCount);
 		for(const auto& spec : useOcl) {
+			addOutputRange(spec.outputFirst, spec.outputCount);
 			auto proc = new PAR2ProcOCL(loop, spec.platformId, spec.deviceId, stagingAreas);
 			par2ocl.push_back(std::unique_ptr<PAR2ProcOCL>(proc));
-			procs.push_back({static_cast<IPAR2ProcBackend*>(proc), spec.sliceOffset, spec.sliceSize});
+			procs.push_back({static_cast<IPAR2ProcBackend*>(proc), spec.sliceOffset, spec.sliceSize, spec.outputFirst, spec.outputCount, spec.sliceMax});
 		}
 		if(cpuSliceSize) {
 			par2cpu.reset(new PAR2ProcCPU(loop, stagingAreas));
-			procs.push_back({static_cast<IPAR2ProcBackend*>(par2cpu.get()), cpuOffset, cpuSliceSize});
+			procs.push_back({static_cast<IPAR2ProcBackend*>(par2cpu.get()), cpuOffset, cpuSliceSize, cpuOutputFirst, cpuOutputCount, cpuSliceMax});
 		}
-		// TODO: handle init returning false (currently, it can't)
-		par2.init(sliceSize, procs, [&](unsigned numInputs) {
+		if(outputsOpen) maxOutputs = 0;
+		allocValid = par2.init(sliceSize, procs, [&](unsigned numInputs) {
 			if(progressCb.hasCallback) {
 #if NODE_VERSION_AT_LEAST(0, 11, 0)
 				HandleScope scope(progressCb.isolate);
@@ -758,6 +1264,30 @@ FUNC(GfInfo) {
 	RETURN_VAL(ret);
 }
 
+FUNC(GfAutotune) {
+	FUNC_START;
+	
+	if(args.Length() < 3)
+		RETURN_ERROR("Slice size, number of inputs and recovery slices required");
+	size_t sliceSize = (size_t)ARG_TO_NUM(Integer, args[0]);
+	unsigned numInputs = ARG_TO_NUM(Uint32, args[1]);
+	unsigned numOutputs = ARG_TO_NUM(Uint32, args[2]);
+	
+	PAR2ProcCPUTuning tuning;
+	if(args.Length() >= 4 && args[3]->IsString()) {
+		UTF8_VALUE(cacheFile, args[3]);
+		tuning = PAR2ProcCPU::autotune(sliceSize, numInputs, numOutputs, *cacheFile);
+	} else
+		tuning = PAR2ProcCPU::autotune(sliceSize, numInputs, numOutputs);
+	
+	Local<Object> ret = NEW_OBJ(Object);
+	SET_OBJ(ret, "method", Integer::New(ISOLATE tuning.method));
+	SET_OBJ(ret, "input_batchsize", Integer::New(ISOLATE tuning.inputGrouping));
+	SET_OBJ(ret, "chunk_size", Number::New(ISOLATE (double)tuning.chunkLen));
+	
+	RETURN_VAL(ret);
+}
+
 static void OclDeviceToJS(
 #if NODE_VERSION_AT_LEAST(0, 11, 0)
 	  Isolate* isolate,
@@ -846,18 +1376,14 @@ FUNC(OclDeviceInfo) {
 
 
 class HasherInput;
-static std::vector<MessageThread*> HasherInputThreadPool;
-struct input_blockHash {
-	uint64_t size;
-	uint64_t pos;
-	int count;
-	char* ptr;
-};
+static HasherInputPool* hasherInputPool = nullptr;
+static int hasherInputThreads = 0;
+static HasherInputPool& getHasherInputPool() {
+	if(!hasherInputPool)
+		hasherInputPool = new HasherInputPool(hasherInputThreads);
+	return *hasherInputPool;
+}
 struct input_work_data {
-	IHasherInput* hasher;
-	const void* buffer;
-	size_t len;
-	struct input_blockHash* bh;
 	CallbackWrapper* cb;
 	HasherInput* self;
 };
@@ -888,27 +1414,34 @@ public:
 #endif
 		
 		HasherInput *self = new HasherInput(getCurrentLoop(ISOLATE 0));
-		
-		self->bh.size = (uint64_t)sliceSize;
-		self->bh.pos = 0;
-		self->bh.count = node::Buffer::Length(args[1]) / 20;
-		self->bh.ptr = node::Buffer::Data(args[1]);
+		self->stream.reset(new HasherInputStream(
+			getHasherInputPool(), (uint64_t)sliceSize,
+			node::Buffer::Data(args[1]), node::Buffer::Length(args[1]) / 20,
+			[self](void* data) {
+				// signal main thread that hashing has completed
+				self->hashesDone.push(static_cast<struct input_work_data*>(data));
+				uv_async_send(self->threadSignal.get());
+			}
+		));
 		PERSIST_VALUE(self->ifscData, args[1]);
 		
 		self->Wrap(args.This());
 		RETURN_UNDEF;
 	}
 	
+	// NULL once ended, or whilst updates are pending
+	HasherInputStream* getStream() const {
+		return queueCount ? nullptr : stream.get();
+	}
+
 private:
-	IHasherInput* hasher;
 	uv_loop_t* loop;
 	int queueCount;
 	
-	std::unique_ptr<MessageThread> thread;
+	std::unique_ptr<HasherInputStream> stream;
 	std::unique_ptr<uv_async_t> threadSignal;
 	ThreadMessageQueue<struct input_work_data*> hashesDone;
 	
-	struct input_blockHash bh;
 	Persistent<Value> ifscData;
 	
 	// disable copy constructor
@@ -922,39 +1455,10 @@ protected:
 		if(self->queueCount)
 			RETURN_ERROR("Cannot reset whilst running");
 		
-		self->hasher->reset();
+		self->stream->reset();
 		RETURN_UNDEF;
 	}
 	
-	static void thread_func(ThreadMessageQueue<void*>& q) {
-		struct input_work_data* data;
-		while((data = static_cast<struct input_work_data*>(q.pop())) != NULL) {
-			char* src_ = (char*)data->buffer;
-			size_t len = data->len;
-			// feed initial part
-			uint64_t blockLeft = data->bh->size - data->bh->pos;
-			while(len >= blockLeft) {
-				data->hasher->update(src_, blockLeft);
-				src_ += blockLeft;
-				len -= blockLeft;
-				blockLeft = data->bh->size;
-				data->bh->pos = 0;
-				
-				if(data->bh->count) {
-					data->hasher->getBlock(data->bh->ptr, 0);
-					data->bh->ptr += 20;
-					data->bh->count--;
-				} // else there's an overflow
-			}
-			if(len) data->hasher->update(src_, len);
-			data->bh->pos += len;
-			
-			
-			// signal main thread that hashing has completed
-			data->self->hashesDone.push(data);
-			uv_async_send(data->self->threadSignal.get());
-		}
-	}
 	void after_process() {
 		struct input_work_data* data;
 		while(hashesDone.trypop(&data)) {
@@ -965,24 +1469,11 @@ protected:
 		}
 	}
 	
-	inline void thread_send(struct input_work_data* data) {
-		if(thread == nullptr) {
-			if(HasherInputThreadPool.empty()) {
-				thread.reset(new MessageThread(thread_func));
-				thread->name = "par2_hash_input";
-			} else {
-				thread.reset(HasherInputThreadPool.back());
-				HasherInputThreadPool.pop_back();
-			}
-		}
-		thread->send(data);
-	}
-	
 	FUNC(Update) {
 		FUNC_START;
 		HasherInput* self = node::ObjectWrap::Unwrap<HasherInput>(args.This());
 		// TODO: consider queueing mechanism; for now, require JS to do the queueing
-		if(!self->hasher)
+		if(!self->stream)
 			RETURN_ERROR("Process already ended");
 		
 		if(args.Length() < 2 || !node::Buffer::HasInstance(args[0]) || !args[1]->IsFunction())
@@ -995,24 +1486,17 @@ protected:
 		
 		struct input_work_data* data = new struct input_work_data;
 		data->cb = cb;
-		data->hasher = self->hasher;
-		data->buffer = node::Buffer::Data(args[0]);
-		data->len = node::Buffer::Length(args[0]);
 		data->self = self;
-		data->bh = &self->bh;
-		self->thread_send(data);
+		self->stream->update(node::Buffer::Data(args[0]), node::Buffer::Length(args[0]), data);
 		RETURN_UNDEF;
 	}
 	
 	void deinit() {
-		if(!hasher) return;
-		hasher->destroy();
-		if(thread != nullptr)
-			HasherInputThreadPool.push_back(thread.release());
+		if(!stream) return;
+		stream.reset();
 		uv_close(reinterpret_cast<uv_handle_t*>(threadSignal.release()), [](uv_handle_t* handle) {
 			delete handle;
 		});
-		hasher = nullptr;
 		
 		PERSIST_CLEAR(ifscData);
 	}
@@ -1022,7 +1506,7 @@ protected:
 		HasherInput* self = node::ObjectWrap::Unwrap<HasherInput>(args.This());
 		if(self->queueCount)
 			RETURN_ERROR("Process currently active");
-		if(!self->hasher)
+		if(!self->stream)
 			RETURN_ERROR("Process already ended");
 		
 		if(args.Length() < 1 || !node::Buffer::HasInstance(args[0]))
@@ -1031,20 +1515,15 @@ protected:
 			RETURN_ERROR("Buffer must be at least 16 bytes long");
 		
 		// finish block hashes
-		if(self->bh.count)
-			// TODO: as zero padding can be slow, consider way of doing it in separate thread to not lock this one
-			self->hasher->getBlock(self->bh.ptr, self->bh.size - self->bh.pos);
-		
 		char* result = (char*)node::Buffer::Data(args[0]);
-		self->hasher->end(result);
+		self->stream->end(result);
 		
 		// clean up everything
 		self->deinit();
 		RETURN_UNDEF;
 	}
 	
-	explicit HasherInput(uv_loop_t* _loop) : ObjectWrap(), loop(_loop), queueCount(0), thread(nullptr) {
-		hasher = HasherInput_Create();
+	explicit HasherInput(uv_loop_t* _loop) : ObjectWrap(), loop(_loop), queueCount(0) {
 		threadSignal.reset(new uv_async_t());
 		uv_async_init(loop, threadSignal.get(), [](uv_async_t *handle
 #if UV_VERSION_MAJOR < 1
@@ -1062,11 +1541,25 @@ protected:
 	}
 };
 
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+static Persistent<FunctionTemplate> hasherInputTemplate;
+static HasherInputStream* unwrapHasherInput(Isolate* isolate, Local<Value> obj) {
+	if(!Local<FunctionTemplate>::New(isolate, hasherInputTemplate)->HasInstance(obj))
+		return nullptr;
+#else
+static Persistent<FunctionTemplate> hasherInputTemplate;
+static HasherInputStream* unwrapHasherInput(Local<Value> obj) {
+	if(!hasherInputTemplate->HasInstance(obj))
+		return nullptr;
+#endif
+	return node::ObjectWrap::Unwrap<HasherInput>(ARG_TO_OBJ(obj))->getStream();
+}
+
 FUNC(HasherInputClear) {
 	FUNC_START;
-	for(auto thread : HasherInputThreadPool)
-		delete thread;
-	HasherInputThreadPool.clear();
+	// end hashing threads; they're restarted if more hashing is requested
+	if(hasherInputPool)
+		hasherInputPool->stop();
 	RETURN_UNDEF;
 }
 
@@ -1224,6 +1717,139 @@ protected:
 	}
 };
 
+#ifdef PARPAR_ENABLE_HASHER_MD5CRC
+class BlockScan;
+struct scan_work_data {
+	const void* buffer;
+	size_t len;
+	uint64_t baseOffset;
+	std::vector<BlockScanMatch> matches;
+	CallbackWrapper* cb;
+	BlockScan* self;
+};
+// finds PAR2 blocks at any offset in data (see BlockScanner), for locating slices displaced by inserted or removed bytes
+class BlockScan : public node::ObjectWrap {
+public:
+	static inline void AttachMethods(Local<FunctionTemplate>& t) {
+		t->InstanceTemplate()->SetInternalFieldCount(1);
+		
+		NODE_SET_PROTOTYPE_METHOD(t, "scan", Scan);
+	}
+	
+	FUNC(New) {
+		FUNC_START;
+		if(!args.IsConstructCall())
+			RETURN_ERROR("Class must be constructed with 'new'");
+		
+		// block size, checksums (20 bytes per block, as listed in the IFSC packet), number of threads
+		if(args.Length() < 2 || !node::Buffer::HasInstance(args[1]))
+			RETURN_ERROR("Requires a size and buffer");
+		double blockSize = 0;
+#if NODE_VERSION_AT_LEAST(8, 0, 0)
+		blockSize = args[0].As<Number>()->Value();
+#else
+		blockSize = args[0]->NumberValue();
+#endif
+		if(blockSize < 1 || blockSize > (double)SIZE_MAX)
+			RETURN_ERROR("Invalid block size");
+		int numThreads = 0;
+		if(args.Length() >= 3 && !args[2]->IsUndefined())
+			numThreads = ARG_TO_NUM(Int32, args[2]);
+		
+		const uint8_t* src = (const uint8_t*)node::Buffer::Data(args[1]);
+		std::vector<BlockScanChecksum> checksums(node::Buffer::Length(args[1]) / 20);
+		for(auto& checksum : checksums) {
+			memcpy(checksum.md5, src, 16);
+			checksum.crc = src[16] | (src[17] << 8) | (src[18] << 16) | ((uint32_t)src[19] << 24);
+			src += 20;
+		}
+		
+		BlockScan *self = new BlockScan((size_t)blockSize, checksums, numThreads, getCurrentLoop(ISOLATE 0));
+		self->Wrap(args.This());
+		RETURN_UNDEF;
+	}
+
+private:
+	BlockScanner scanner;
+	int numThreads;
+	uv_loop_t* loop;
+	bool isRunning;
+	
+	// disable copy constructor
+	BlockScan(const BlockScan&);
+	BlockScan& operator=(const BlockScan&);
+
+protected:
+	static void do_scan(uv_work_t *req) {
+		struct scan_work_data* data = static_cast<struct scan_work_data*>(req->data);
+		data->self->scanner.scan(data->buffer, data->len, data->matches, data->baseOffset, data->self->numThreads);
+	}
+	static void after_scan(uv_work_t *req, int status) {
+		assert(status == 0);
+		
+		struct scan_work_data* data = static_cast<struct scan_work_data*>(req->data);
+		data->self->isRunning = false;
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+		Isolate* isolate = data->cb->isolate;
+		HandleScope scope(isolate);
+#else
+		HandleScope scope;
+#endif
+		Local<Array> ret = Array::New(ISOLATE data->matches.size());
+		for(unsigned i=0; i<data->matches.size(); i++) {
+			Local<Object> match = NEW_OBJ(Object);
+			SET_OBJ(match, "offset", Number::New(ISOLATE (double)data->matches[i].offset));
+			SET_OBJ(match, "block", Integer::New(ISOLATE data->matches[i].block));
+			SET_ARR(ret, i, match);
+		}
+		data->cb->call(scope, { ret });
+		delete data->cb;
+		delete data;
+		delete req;
+	}
+	
+	// find blocks in a buffer, on a work thread; the callback receives a list of {offset, block} matches, in order of offset, where `block` indexes the checksums given to the constructor
+	// to scan a file in pieces, consecutive buffers must overlap by blockSize-1 bytes, with `baseOffset` specifying the position of each in the file
+	FUNC(Scan) {
+		FUNC_START;
+		BlockScan* self = node::ObjectWrap::Unwrap<BlockScan>(args.This());
+		if(self->isRunning)
+			RETURN_ERROR("Process already active");
+		
+		if(args.Length() < 3 || !node::Buffer::HasInstance(args[0]) || !args[2]->IsFunction())
+			RETURN_ERROR("Requires a buffer, offset and callback");
+		double baseOffset = 0;
+#if NODE_VERSION_AT_LEAST(8, 0, 0)
+		baseOffset = args[1].As<Number>()->Value();
+#else
+		baseOffset = args[1]->NumberValue();
+#endif
+
+		CallbackWrapper* cb = new CallbackWrapper(ISOLATE Local<Function>::Cast(args[2]));
+		cb->attachValue(args[0]);
+		
+		self->isRunning = true;
+		
+		uv_work_t* req = new uv_work_t;
+		struct scan_work_data* data = new struct scan_work_data;
+		data->cb = cb;
+		data->buffer = node::Buffer::Data(args[0]);
+		data->len = node::Buffer::Length(args[0]);
+		data->baseOffset = (uint64_t)baseOffset;
+		data->self = self;
+		req->data = data;
+		uv_queue_work(self->loop, req, do_scan, after_scan);
+		RETURN_UNDEF;
+	}
+	
+	explicit BlockScan(size_t blockSize, const std::vector<BlockScanChecksum>& checksums, int _numThreads, uv_loop_t* _loop) : ObjectWrap(), scanner(blockSize, checksums), numThreads(_numThreads), loop(_loop), isRunning(false) {}
+	
+	~BlockScan() {
+		// TODO: if isRunning, cancel
+	}
+};
+#endif
+
 FUNC(SetHasherInput) {
 	FUNC_START;
 	
@@ -1244,6 +1870,22 @@ FUNC(SetHasherOutput) {
 	RETURN_UNDEF;
 }
 
+FUNC(SetHasherInputThreads) {
+	FUNC_START;
+	
+	if(args.Length() < 1)
+		RETURN_ERROR("Number of threads required");
+	
+	hasherInputThreads = ARG_TO_NUM(Int32, args[0]);
+	if(hasherInputPool)
+		hasherInputPool->setNumThreads(hasherInputThreads);
+	RETURN_UNDEF;
+}
+FUNC(HasherInputThreads) {
+	FUNC_START;
+	RETURN_VAL(Integer::New(ISOLATE getHasherInputPool().getNumThreads()));
+}
+
 FUNC(HasherInputMethod) {
 	FUNC_START;
 	RETURN_VAL(NEW_STRING(hasherInput_methodName()));
@@ -1272,12 +1914,18 @@ void parpar_gf_init(
 	SET_OBJ_FUNC(target, "GfProc", t);
 	
 	NODE_SET_METHOD(target, "gf_info", GfInfo);
+	NODE_SET_METHOD(target, "gf_autotune", GfAutotune);
 	NODE_SET_METHOD(target, "opencl_devices", OclDevices);
 	NODE_SET_METHOD(target, "opencl_device_info", OclDeviceInfo);
 	
 	t = FunctionTemplate::New(ISOLATE HasherInput::New);
 	HasherInput::AttachMethods(t);
 	SET_OBJ_FUNC(target, "HasherInput", t);
+#if NODE_VERSION_AT_LEAST(0, 11, 0)
+	hasherInputTemplate.Reset(isolate, t);
+#else
+	hasherInputTemplate = Persistent<FunctionTemplate>::New(t);
+#endif
 	
 	NODE_SET_METHOD(target, "hasher_clear", HasherInputClear);
 	
@@ -1285,9 +1933,17 @@ void parpar_gf_init(
 	HasherOutput::AttachMethods(t);
 	SET_OBJ_FUNC(target, "HasherOutput", t);
 	
+#ifdef PARPAR_ENABLE_HASHER_MD5CRC
+	t = FunctionTemplate::New(ISOLATE BlockScan::New);
+	BlockScan::AttachMethods(t);
+	SET_OBJ_FUNC(target, "BlockScanner", t);
+#endif
+
 	NODE_SET_METHOD(target, "set_HasherInput", SetHasherInput);
 	NODE_SET_METHOD(target, "set_HasherOutput", SetHasherOutput);
 	NODE_SET_METHOD(target, "hasherInput_method", HasherInputMethod);
+	NODE_SET_METHOD(target, "set_hasherInput_threads", SetHasherInputThreads);
+	NODE_SET_METHOD(target, "hasherInput_threads", HasherInputThreads);
 	NODE_SET_METHOD(target, "hasherOutput_method", HasherOutputMethod);
 	
 	setup_hasher();
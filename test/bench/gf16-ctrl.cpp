@@ -2,6 +2,7 @@
 #include "controller_cpu.h"
 #include "controller_ocl.h"
 #include "gfmat_coeff.h"
+#include "hasher.h"
 
 #include "bench.h"
 #include <memory>
@@ -56,6 +57,20 @@ struct benchProps {
 	bool _isEmpty;
 };
 static int cpuThreads = 0;
+static int cpuTransferThreads = 1;
+static bool cpuWorkStealing = true;
+static bool cpuLookahead = true;
+static PAR2ProcCPUTiling cpuTiling = PROC_TILING_AUTO;
+static bool showSchedStats = false;
+static int cpuNumaNodes = -1; // -1 = disabled, 0 = detect, >0 = fake topology
+static int cpuCoreClasses = -1; // as above, for hybrid mode
+static PAR2ProcCPUPageMode cpuPageMode = PROC_PAGES_DEFAULT;
+static bool cpuZeroedMem = false;
+static bool cpuInPlaceInput = false;
+static size_t cpuStagingMemory = 0;
+static bool hashInput = false;
+static unsigned hashOutputGroup = 0; // 0 = don't hash outputs
+static bool autoBalance = false; // rebalance the slice between CPU and OpenCL after each trial
 
 
 // globals
@@ -76,6 +91,12 @@ double bestTime;
 int trialsRemain;
 std::unique_ptr<Timer> timer;
 unsigned curInput;
+IHasherInput* inHasher = nullptr;
+uint8_t inBlockHash[20];
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+PAR2ProcCPU* outHasherCpu = nullptr; // if set, outputs are fetched in groups from this backend, computing packet MD5s
+std::vector<uint8_t> outGroupMD5;
+#endif
 
 static void run_bench(struct benchProps test);
 static void bench_add(unsigned);
@@ -90,7 +111,9 @@ static void bench_end_fetched(bool cksumFailure) {
 		benchDone(cksumFailure);
 	} else {
 		// simulate it being set in a usual scenario
-		if(transInput) par2.setRecoverySlices(numOutputs, outIdx);
+		if(autoBalance) par2.setCurrentSliceSize(TEST_SIZE);
+		if(transInput || autoBalance) par2.setRecoverySlices(numOutputs, outIdx); // a backend grown by rebalancing reallocates its recovery memory here
+		par2.discardOutput(); // start a new pass, rather than accumulating onto the last one
 		curInput = 0;
 		timer.reset(new Timer());
 		bench_add(0);
@@ -120,10 +143,44 @@ static void bench_end_dofetch(unsigned numOutputs) {
 		dofetch_fetchPos++;
 	}
 }
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+static void bench_end_dofetch_group(unsigned numOutputs) {
+	unsigned groupSize = outHasherCpu->getOutputHashing();
+	while(dofetch_fetchPos < numOutputs && dofetch_fetchCount < 12) {
+		unsigned group = dofetch_fetchPos / groupSize;
+		unsigned count = std::min(groupSize, numOutputs - dofetch_fetchPos);
+		auto gotGroup = [=](bool cksumSuccess) {
+			if(!cksumSuccess) dofetch_cksumFailure = true;
+			// the bench only does a single pass, so the packet MD5s are complete
+			outHasherCpu->getOutputGroupMD5(group, outGroupMD5.data());
+			
+			dofetch_fetchCount--;
+			dofetch_doneCount += count;
+			if(dofetch_doneCount == numOutputs) {
+				bench_end_fetched(dofetch_cksumFailure);
+			} else {
+				bench_end_dofetch_group(numOutputs);
+			}
+		};
+#ifdef USE_LIBUV
+		outHasherCpu->getOutputGroup(group, reinterpret_cast<void* const*>(dstM + dofetch_fetchPos), gotGroup);
+#else
+		gotGroup(outHasherCpu->getOutputGroup(group, reinterpret_cast<void* const*>(dstM + dofetch_fetchPos)).get());
+#endif
+		dofetch_fetchCount++;
+		dofetch_fetchPos += count;
+	}
+}
+#endif
 static void bench_end() {
 	if(transOutput) {
 		dofetch_fetchPos = dofetch_fetchCount = dofetch_doneCount = 0;
 		dofetch_cksumFailure = false;
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+		if(outHasherCpu)
+			bench_end_dofetch_group(numOutputs);
+		else
+#endif
 		bench_end_dofetch(numOutputs);
 	} else {
 		bench_end_fetched(false);
@@ -135,7 +192,9 @@ static void bench_add(unsigned) {
 	if(transInput) {
 		while(1) {
 			IF_NOT_LIBUV(par2.waitForAdd());
-			auto added = par2.addInput(srcM[curInput], TEST_SIZE, inIdx[curInput], false IF_LIBUV(, nullptr));
+			auto added = inHasher
+				? par2.addInput(srcM[curInput], TEST_SIZE, inIdx[curInput], false, inHasher, inBlockHash IF_LIBUV(, nullptr))
+				: par2.addInput(srcM[curInput], TEST_SIZE, inIdx[curInput], false IF_LIBUV(, nullptr));
 #ifdef USE_LIBUV
 			if(!added) break;
 #else
@@ -257,10 +316,21 @@ static void run_bench(struct benchProps test) {
 	std::vector<struct PAR2ProcBackendAlloc> procs;
 	
 	if(test.hasCPU) {
-		procs.push_back({par2cpu = new PAR2ProcCPU(IF_LIBUV(loop)), test.oclSize, TEST_SIZE-test.oclSize});
+		// when rebalancing, either side may grow to take the whole slice
+		procs.push_back({par2cpu = new PAR2ProcCPU(IF_LIBUV(loop)), test.oclSize, TEST_SIZE-test.oclSize, 0, 0, TEST_SIZE});
 		if(cpuThreads) par2cpu->setNumThreads(cpuThreads);
+		par2cpu->setWorkStealing(cpuWorkStealing);
+		par2cpu->setLookaheadPrefetch(cpuLookahead);
+		par2cpu->setTilingMode(cpuTiling);
+		par2cpu->setTransferThreads(cpuTransferThreads);
+		if(cpuNumaNodes >= 0) par2cpu->setNumaMode(true, cpuNumaNodes);
+		if(cpuCoreClasses >= 0) par2cpu->setHybridMode(true, cpuCoreClasses);
+		par2cpu->setPageMode(cpuPageMode);
+		par2cpu->setZeroedMemory(cpuZeroedMem);
+		par2cpu->setInPlaceInput(cpuInPlaceInput);
+		par2cpu->setStagingMemoryLimit(cpuStagingMemory);
 	}
-	if(test.hasOCL) procs.push_back({par2ocl = new PAR2ProcOCL(IF_LIBUV(loop,) test.oclPlatform, test.oclDevice), 0, test.oclSize});
+	if(test.hasOCL) procs.push_back({par2ocl = new PAR2ProcOCL(IF_LIBUV(loop,) test.oclPlatform, test.oclDevice), 0, test.oclSize, 0, 0, TEST_SIZE});
 	
 	
 	auto deinitCb = [=]() {
@@ -278,6 +348,19 @@ static void run_bench(struct benchProps test) {
 		}
 		
 		printf(osStatNum, (double)((TEST_SIZE*numRegions*numOutputs)/1048576) / bestTime);
+		if(par2cpu && showSchedStats) {
+			std::cerr << " " << par2cpu->getStealCount() << " steals, " << par2cpu->getLookaheadCount() << " lookaheads, " << (par2cpu->isOutputTiled() ? "2D" : "1D") << " tiling, " << par2cpu->getWorkerIdleTime()*1000 << "ms idle";
+			for(const auto& node : par2cpu->getNumaStats())
+				std::cerr << ", node " << node.node << " (" << node.threads << " threads): " << node.throughput/1048576 << "MB/s";
+			for(const auto& cls : par2cpu->getCoreClassStats())
+				std::cerr << ", " << cls.name << " (" << cls.threads << " threads): " << cls.throughput/1048576 << "MB/s, weight " << cls.weight;
+			std::cerr << std::endl;
+		}
+		if(autoBalance && showSchedStats && !par2.getBalance().empty()) {
+			for(const auto& backend : par2.getBalance())
+				std::cerr << " " << backend.rate/1048576 << "MB/s -> " << backend.size << " bytes @ " << backend.offset;
+			std::cerr << std::endl;
+		}
 #ifdef DEBUG_STAT_THREAD_EMPTY
 		if(par2cpu) {
 			// TODO: think of better way to print this
@@ -294,6 +377,7 @@ static void run_bench(struct benchProps test) {
 	};
 	
 	par2.init(TEST_SIZE, procs IF_LIBUV(, bench_add));
+	par2.setAutoBalance(autoBalance);
 	if(par2cpu) par2cpu->init(test.cpuMethod, test.inGrouping, test.cpuChunk);
 	if(par2ocl) par2ocl->init(test.oclMethod, test.inGrouping, test.oclIters, test.oclGrouping);
 	if(!par2.setRecoverySlices(numOutputs, outIdx)) {
@@ -306,6 +390,15 @@ static void run_bench(struct benchProps test) {
 #endif
 		return;
 	}
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	outHasherCpu = nullptr;
+	if(par2cpu && !par2ocl && hashOutputGroup) {
+		const uint8_t setId[16] = {};
+		par2cpu->setOutputHashing(hashOutputGroup, setId);
+		outGroupMD5.resize(hashOutputGroup * 16);
+		outHasherCpu = par2cpu;
+	}
+#endif
 	
 	if(!transInput) {
 		// fill inputs with random data, so we're not benchmarking all 0s
@@ -326,7 +419,7 @@ static void run_bench(struct benchProps test) {
 
 
 static void show_help() {
-	std::cout << "bench-ctrl [-c] [-g[a|g]] [-p] [-r<rounds("<<NUM_TRIALS<<")>] [-z<test_sizeKB("<<(TEST_SIZE/1024)<<")>] [-s<sizeKB1,sizeKB2...>] [-d<seed>] [-i<inBlocks>] [-o<outBlocks>] [-m<method1,method2...>] [-M<oclMethod1,oclMethod2...>] [-t<threads>] [-b<inBatchSize>]" << std::endl;
+	std::cout << "bench-ctrl [-c] [-g[a|g]] [-p] [-r<rounds("<<NUM_TRIALS<<")>] [-z<test_sizeKB("<<(TEST_SIZE/1024)<<")>] [-s<sizeKB1,sizeKB2...>] [-d<seed>] [-i<inBlocks>] [-o<outBlocks>] [-m<method1,method2...>] [-M<oclMethod1,oclMethod2...>] [-t<threads>] [-T<transferThreads>] [-b<inBatchSize>] [-w<0|1>] [-L<0|1>] [-D<0|1|2>] [-n[fakeNodes]] [-y[fakeClasses]] [-H<0|1|2>] [-Z] [-I] [-h] [-O<hashGroupSize>] [-S<stagingLimitKB>] [-B] [-W]" << std::endl;
 	// TODO: in grouping
 	// tile size (CPU), iters (GPU)
 	// out grouping (GPU)
@@ -385,9 +478,51 @@ int main(int argc, char** argv) {
 			case 't':
 				cpuThreads = std::stoul(argv[i] + 2);
 			break;
+			case 'T':
+				cpuTransferThreads = std::stoi(argv[i] + 2);
+			break;
 			case 'b':
 				inBatches = {(unsigned)std::stoul(argv[i] + 2)};
 			break;
+			case 'w': // work stealing on/off
+				cpuWorkStealing = argv[i][2] != '0';
+			break;
+			case 'L': // prefetch next batch on/off
+				cpuLookahead = argv[i][2] != '0';
+			break;
+			case 'D': // tiling: 0 = auto, 1 = 1D (chunks only), 2 = 2D (chunks and outputs)
+				cpuTiling = (PAR2ProcCPUTiling)std::stoi(argv[i] + 2);
+			break;
+			case 'n': // NUMA mode
+				cpuNumaNodes = argv[i][2] ? std::stoi(argv[i] + 2) : 0;
+			break;
+			case 'y': // hybrid mode
+				cpuCoreClasses = argv[i][2] ? std::stoi(argv[i] + 2) : 0;
+			break;
+			case 'H': // page mode for recovery memory: 0 = regular (4K), 1 = transparent huge pages, 2 = explicit huge pages
+				cpuPageMode = (PAR2ProcCPUPageMode)std::stoi(argv[i] + 2);
+			break;
+			case 'S': // staging memory limit
+				cpuStagingMemory = std::stoul(argv[i] + 2) * 1024;
+			break;
+			case 'Z': // zeroed recovery memory
+				cpuZeroedMem = true;
+			break;
+			case 'I': // read input directly from source buffers
+				cpuInPlaceInput = true;
+			break;
+			case 'h': // also compute input block hashes
+				hashInput = true;
+			break;
+			case 'O': // fetch outputs in groups of this size, computing packet MD5s
+				hashOutputGroup = std::stoul(argv[i] + 2);
+			break;
+			case 'B': // rebalance between CPU and OpenCL
+				autoBalance = true;
+			break;
+			case 'W': // show work stealing stats
+				showSchedStats = true;
+			break;
 			case 's':
 				// TODO: consider adding auto size
 				sizes = vector_from_comma_list<size_t>(argv[i] + 2, [=](const std::string& val) -> size_t {
@@ -468,6 +603,11 @@ int main(int argc, char** argv) {
 		dstM[i] = dst + i*MAX_SIZE/sizeof(uint16_t);
 	}
 	
+	if(hashInput || hashOutputGroup) setup_hasher();
+	if(hashInput) {
+		inHasher = HasherInput_Create();
+	}
+	
 	hideFuncLabels = inBatches.size() == 1;
 	showMethodLabel = showDefaultMethod || (testOCL ? oclMethods.size() : methods.size()) > 1;
 	
@@ -577,6 +717,7 @@ int main(int argc, char** argv) {
 	
 	std::cout << std::endl;
 	
+	if(inHasher) inHasher->destroy();
 	delete[] srcM;
 	delete[] dstM;
 	ALIGN_FREE(src);
@@ -364,7 +364,7 @@ void mat_mul_packed2(const Galois16Mul& g, void* mutScratch, const void* input,
 }
 
 static void show_help() {
-	std::cout << "bench-gf16 [-c] [-r<rounds("<<NUM_TRIALS<<")>] [-z<test_sizeKB("<<(TEST_SIZE/1024)<<")>] [-s<sizeKB1,sizeKB2...>] [-d<seed>] [-i<num_inputs1,num_inputs2...>] [-o<num_outputs1,num_outputs2...>] [-m<method1,method2...>] [-M<oclMethod1,oclMethod2...>] [-f<function1,function2...(prep|prepmis|fin|mul|muladd|muladdm|muladdmp|matmul|matmulp|matmulp2|matmulpf|matmulpf2|pow|powadd)>]" << std::endl;
+	std::cout << "bench-gf16 [-c] [-r<rounds("<<NUM_TRIALS<<")>] [-z<test_sizeKB("<<(TEST_SIZE/1024)<<")>] [-s<sizeKB1,sizeKB2...>] [-d<seed>] [-i<num_inputs1,num_inputs2...>] [-o<num_outputs1,num_outputs2...>] [-m<method1,method2...>] [-M<oclMethod1,oclMethod2...>] [-f<function1,function2...(prep|prepmis|fin|mul|muladd|muladdm|muladdmp|muladdmc|matmul|matmulp|matmulp2|matmulpf|matmulpf2|pow|powadd)>]" << std::endl;
 	exit(0);
 }
 
@@ -378,6 +378,7 @@ enum class TestFuncs {
 	MULTIPLY_ADD,
 	MULTIPLY_ADD_MULTI,
 	MULTIPLY_ADD_MULTI_PACKED,
+	MULTIPLY_ADD_MULTI_CLASSES,
 	POWMUL,
 	POWMUL_ADD,
 	MATRIX_MULTIPLY,
@@ -467,6 +468,7 @@ int main(int argc, char** argv) {
 					if(val == "muladd") return TestFuncs::MULTIPLY_ADD;
 					if(val == "muladdm") return TestFuncs::MULTIPLY_ADD_MULTI;
 					if(val == "muladdmp") return TestFuncs::MULTIPLY_ADD_MULTI_PACKED;
+					if(val == "muladdmc") return TestFuncs::MULTIPLY_ADD_MULTI_CLASSES;
 					if(val == "mul+") return TestFuncs::MULTIPLY_ALL;
 					if(val == "muladd+") return TestFuncs::MULTIPLY_ADD_ALL;
 					if(val == "pow") return TestFuncs::POWMUL;
@@ -540,6 +542,8 @@ int main(int argc, char** argv) {
 		for(const auto& f : funcs) {
 			if((f == TestFuncs::MULTIPLY_ADD_MULTI || f == TestFuncs::MULTIPLY_ADD_MULTI_PACKED) && multis.size() > 1)
 				hideFuncLabels = false;
+			if(f == TestFuncs::MULTIPLY_ADD_MULTI_CLASSES) // always has multiple outputs
+				hideFuncLabels = false;
 			if((f == TestFuncs::PREPARE_PACKED && multis.size() > 1) || (f == TestFuncs::FINISH_PACKED && powOuts.size() > 1))
 				hideFuncLabels = false;
 			if((f == TestFuncs::POWMUL || f == TestFuncs::POWMUL_ADD) && powOuts.size() > 1)
@@ -775,6 +779,25 @@ int main(int argc, char** argv) {
 				}
 			}
 			
+			// bench mul_add_multi_packed by coefficient class: all-one coefficients through the general kernel vs the add kernel PAR2ProcCPU switches to (all-zero coefficients are skipped entirely)
+			if((g.hasMultiMulAddPacked() || explicitlySpecifiedFuncs) && funcs.find(TestFuncs::MULTIPLY_ADD_MULTI_CLASSES) != funcs.end()) {
+				for(unsigned regions : multis) {
+					std::vector<uint16_t> ones(regions, 1);
+					print_func("MAOne%2d", regions);
+					run_bench([&](size_t size, const uint16_t*& coeff) {
+						g.mul_add_multi_packed(regions, regions, dst, src, size, ones.data(), gp.second);
+						coeff += regions;
+					}, coeffs, TEST_SIZE / regions, regions);
+					std::cout << std::endl;
+					print_func("AddPk%2d", regions);
+					run_bench([&](size_t size, const uint16_t*& coeff) {
+						g.add_multi_packpf(regions, regions, dst, src, size, NULL, dst);
+						coeff += regions;
+					}, coeffs, TEST_SIZE / regions, regions);
+					std::cout << std::endl;
+				}
+			}
+			
 			// bench pow
 			if(g.hasPowAdd()) {
 				for(unsigned outputs : powOuts) {
@@ -2,6 +2,7 @@
 #include <memory>
 #include "bench.h"
 #include "hasher.h"
+#include "hasher_blockscan.h"
 #include "../../src/platform.h"
 
 typedef char md5hash[16]; // add null byte for convenience
@@ -72,6 +73,33 @@ static inline void run_bench_crc(const char* label, CRC32_Calc_t crc32calc) {
 	}
 	printf("%8.1f MB/s\n", (double)(TEST_SIZE*NUM_ROUNDS/1048576) / result);
 }
+
+// scan all bench regions as one buffer, for blocks which aren't present (i.e. the rolling CRC cost, with occasional filter hits)
+static inline void run_bench_scan(const char* label, int threads) {
+	printf(" %-15s: ", label);
+	
+	const size_t scanLen = TEST_SIZE * MAX_REGIONS;
+	std::vector<uint8_t> data(scanLen);
+	for(int i=0; i<MAX_REGIONS; i++)
+		memcpy(data.data() + i*TEST_SIZE, benchData[i], TEST_SIZE);
+	std::vector<BlockScanChecksum> checksums(1024);
+	for(auto& ck : checksums) {
+		for(auto& b : ck.md5) b = rand();
+		ck.crc = rand() ^ (rand() << 16);
+	}
+	BlockScanner scanner(4096, checksums);
+	
+	double result = DBL_MAX;
+	int trial = NUM_TRIALS;
+	while(trial--) {
+		std::vector<BlockScanMatch> matches;
+		Timer t;
+		scanner.scan(data.data(), scanLen, matches, 0, threads);
+		double secs = t.elapsed();
+		if(secs < result) result = secs;
+	}
+	printf("%8.1f MB/s\n", (double)(scanLen/1048576) / result);
+}
 #endif
 
 static inline void run_bench_in(const char* label, IHasherInput* hasher) {
@@ -157,6 +185,9 @@ int main(void) {
 		set_hasherMD5CRC(hId);
 		run_bench_md5crc(md5crc_methodName(), MD5CRC_Calc);
 	}
+	std::cout << "Block Scan" << std::endl;
+	run_bench_scan("1 thread", 1);
+	run_bench_scan("All threads", 0);
 	#endif
 	
 	std::cout << "Input Hasher" << std::endl;
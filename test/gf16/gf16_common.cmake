@@ -78,8 +78,10 @@ endif()
 set(GF16_CPP_SOURCES
 	${GF16_DIR}/controller.cpp
 	${GF16_DIR}/controller_cpu.cpp
+	${GF16_DIR}/controller_cpu_tune.cpp
 	${GF16_DIR}/controller_ocl.cpp
 	${GF16_DIR}/controller_ocl_init.cpp
+	${GF16_DIR}/cpu_topology.cpp
 )
 
 include_directories(${GF16_DIR}/opencl-include ${GF16_DIR})
@@ -93,12 +95,14 @@ include_directories(${GF16_DIR}/opencl-include ${GF16_DIR})
 add_library(gf16_c STATIC ${GF16_C_SOURCES})
 add_library(gf16_base STATIC ${GF16_DIR}/gf16mul.cpp)
 add_library(gf16_pmul STATIC ${GF16_DIR}/gf16pmul.cpp)
-add_library(gf16_inv STATIC ${GF16_DIR}/gfmat_inv.cpp)
+add_library(gf16_inv STATIC ${GF16_DIR}/gfmat_inv.cpp ${GF16_DIR}/cpu_topology.cpp)
 add_library(gf16_ctl STATIC ${GF16_CPP_SOURCES})
+add_library(gf16_repair STATIC ${GF16_DIR}/controller_repair.cpp)
 target_link_libraries(gf16_base gf16_c)
 target_link_libraries(gf16_pmul gf16_c)
 target_link_libraries(gf16_inv gf16_base gf16_pmul)
 target_link_libraries(gf16_ctl gf16_base)
+target_link_libraries(gf16_repair gf16_ctl gf16_inv)
 
 if(NOT MSVC)
 	# posix_memalign may require _POSIX_C_SOURCE, but doing that on FreeBSD causes MAP_ANON* to disappear
@@ -121,6 +125,7 @@ if(NOT MSVC)
 		target_compile_options(gf16_pmul PRIVATE -fno-rtti -fno-exceptions)
 		target_compile_options(gf16_inv PRIVATE -fno-rtti -fno-exceptions)
 		target_compile_options(gf16_ctl PRIVATE -fno-rtti)
+		target_compile_options(gf16_repair PRIVATE -fno-rtti)
 	endif()
 endif()
 
@@ -9,7 +9,10 @@
 #include "controller.h"
 #include "controller_cpu.h"
 #include "controller_ocl.h"
+#include "controller_repair.h"
 #include "gfmat_coeff.h"
+#include "../../hasher/hasher_input_impl.h"
+#include "../../hasher/hasher.h"
 #include <iostream>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,6 +24,10 @@
 const int MAX_TEST_REGIONS = 20;
 const int MAX_TEST_OUTPUTS = 20;
 const unsigned REGION_SIZE = 20000;
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+const unsigned OUTPUT_HASH_GROUP = 3;
+const uint8_t outputHashSetId[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+#endif
 
 
 
@@ -29,12 +36,43 @@ uint16_t* src[MAX_TEST_REGIONS];
 uint16_t* dst[MAX_TEST_OUTPUTS];
 uint16_t* ref[MAX_TEST_OUTPUTS];
 uint16_t inputIndicies[MAX_TEST_REGIONS];
+uint8_t inputHashes[MAX_TEST_REGIONS][20];
 uint16_t outputIndicies[MAX_TEST_OUTPUTS*2];
 #ifdef USE_LIBUV
 uv_loop_t *loop;
 #endif
 
 
+// stand-in for an input hasher: computes a checksum which depends on the order data is fed in, but not how it's split up
+class TestHasherInput : public IHasherInput {
+	uint32_t blockSum, fileSum;
+public:
+	TestHasherInput() { reset(); }
+	void update(const void* data, size_t len) override {
+		for(size_t i=0; i<len; i++) {
+			uint8_t b = static_cast<const uint8_t*>(data)[i];
+			blockSum = blockSum*31 + b;
+			fileSum = fileSum*31 + b;
+		}
+	}
+	void getBlock(void* md5crc, uint64_t zeroPad) override {
+		memset(md5crc, 0, 20);
+		memcpy(md5crc, &blockSum, sizeof(blockSum));
+		memcpy(static_cast<char*>(md5crc) + 8, &zeroPad, sizeof(zeroPad));
+		blockSum = 0;
+	}
+	void end(void* md5) override {
+		memset(md5, 0, 16);
+		memcpy(md5, &fileSum, sizeof(fileSum));
+	}
+	void reset() override {
+		blockSum = fileSum = 0;
+	}
+#ifdef PARPAR_ENABLE_HASHER_MD5CRC
+	void extractFileMD5(MD5Single&) override {}
+#endif
+};
+
 struct testProps {
 	size_t sliceSize, lastSliceSize;
 	unsigned numInputs, numOutputs;
@@ -42,11 +80,13 @@ struct testProps {
 	int cpuThreads;
 	Galois16OCLMethods oclMethod;
 	bool useCpu, useOcl;
+	int cpuSplit; // add a second CPU backend: 1 = sharing the slice with the first, 2 = computing the second half of recovery slices
+	bool addOutputs; // compute the first half of recovery slices, then add the rest, sending inputs again for them
 	
 	void print(const char* label) const {
 		std::cout << label << "(" << numInputs << "x" << numOutputs << ", sliceSize " << sliceSize << ", lastSliceSize " << lastSliceSize;
 		if(useCpu && !useOcl)
-			std::cout << ", method " << PAR2ProcCPU::info(cpuMethod).name << ", threads " << cpuThreads;
+			std::cout << ", method " << PAR2ProcCPU::info(cpuMethod).name << ", threads " << cpuThreads << (cpuSplit == 1 ? ", shared" : (cpuSplit == 2 ? ", split outputs" : "")) << (addOutputs ? ", add outputs" : "");
 		if(!useCpu && useOcl)
 			std::cout << ", method " << PAR2ProcOCL::methodToText(oclMethod);
 		std::cout << ")";
@@ -56,111 +96,227 @@ struct testProps {
 static void run_test(struct testProps test IF_LIBUV(, std::function<void()> cb)) {
 	auto* par2 = new PAR2Proc();
 	PAR2ProcCPU* par2cpu = nullptr;
+	PAR2ProcCPU* par2cpu2 = nullptr;
 	PAR2ProcOCL* par2ocl = nullptr;
 	
 	if(test.useCpu && test.useOcl && test.sliceSize < 3)
 		test.useOcl = false;  // not enable space to split
 	if(test.useCpu) par2cpu = new PAR2ProcCPU(IF_LIBUV(loop));
+	if(test.cpuSplit) par2cpu2 = new PAR2ProcCPU(IF_LIBUV(loop));
 	if(test.useOcl) par2ocl = new PAR2ProcOCL(IF_LIBUV(loop));
 	// note the above needs to be allocated before this lambda, so that it captures the allocated values as opposed to nullptr
 	
+	// also check hashing whilst adding, except for the single thread case
+	std::shared_ptr<TestHasherInput> hasher(test.cpuThreads != 1 ? new TestHasherInput() : nullptr);
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	// for CPU only tests, also fetch outputs in groups, with packet hashing (which isn't possible if the backend only computes part of the sum)
+	bool hashOutputs = !par2ocl && !par2cpu2 && test.cpuThreads != 1;
+#endif
+	
 	auto endCb = [=]() {
+		if(hasher) {
+			TestHasherInput refHasher;
+			uint8_t refHash[20];
+			for(unsigned region=0; region<test.numInputs; region++) {
+				size_t regionSize = region == test.numInputs-1 ? test.lastSliceSize : test.sliceSize;
+				refHasher.update(src[region], regionSize);
+				refHasher.getBlock(refHash, test.sliceSize - regionSize);
+				if(memcmp(refHash, inputHashes[region], 20)) {
+					test.print("Hash ");
+					std::cout << ", input " << region << " block hash mismatch" << std::endl;
+					exit(1);
+				}
+			}
+			uint8_t fileHash[16];
+			hasher->end(fileHash);
+			refHasher.end(refHash);
+			if(memcmp(refHash, fileHash, 16)) {
+				test.print("Hash ");
+				std::cout << ", inputs hashed out of order" << std::endl;
+				exit(1);
+			}
+		}
+		
 		std::shared_ptr<unsigned> doneCount(new unsigned(0));
-		for(unsigned outputNum=0; outputNum<test.numOutputs; outputNum++) {
+		auto outputCb = [=](unsigned outputNum, bool cksumSuccess) {
 			void* buffer = dst[outputNum];
-			auto outputCb = [=](bool cksumSuccess) {
-				if(memcmp(buffer, ref[outputNum], test.sliceSize)) {
-					test.print("MatMul ");
-					std::cout << ", output " << outputNum << " failure" << std::endl;
-					unsigned loc = display_mem_diff(ref[outputNum], (const uint16_t*)buffer, test.sliceSize/2);
-					
-					std::cout << std::endl;
-					std::cout << "Input Idx:" << std::endl;
-					print_mem_region(inputIndicies, 0, test.numInputs);
-					for(unsigned region=0; region<test.numInputs; region++) {
-						size_t regionSize = region == test.numInputs-1 ? test.lastSliceSize : test.sliceSize;
-						if(regionSize & 1) {
-							// odd num of bytes - zero last byte
+			if(memcmp(buffer, ref[outputNum], test.sliceSize)) {
+				test.print("MatMul ");
+				std::cout << ", output " << outputNum << " failure" << std::endl;
+				unsigned loc = display_mem_diff(ref[outputNum], (const uint16_t*)buffer, test.sliceSize/2);
+				
+				std::cout << std::endl;
+				std::cout << "Input Idx:" << std::endl;
+				print_mem_region(inputIndicies, 0, test.numInputs);
+				for(unsigned region=0; region<test.numInputs; region++) {
+					size_t regionSize = region == test.numInputs-1 ? test.lastSliceSize : test.sliceSize;
+					if(regionSize & 1) {
+						// odd num of bytes - zero last byte
 #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
-							src[region][regionSize/2] >>= 8;
+						src[region][regionSize/2] >>= 8;
 #else
-							src[region][regionSize/2] &= 0xff;
+						src[region][regionSize/2] &= 0xff;
 #endif
-							regionSize++;
-						}
-						regionSize /= 2;
-						int printFrom = loc;
-						if(loc > regionSize) printFrom = 0;
-						size_t printTo = std::min((int)regionSize, printFrom+32);
-						std::cout << "Input " << region << ":" << std::endl;
-						print_mem_region(src[region], printFrom, printTo);
-						
-						
-						uint16_t coeff = gfmat_coeff(inputIndicies[region], outputIndicies[outputNum]);
-						std::cout << "Input " << region << " (*" << coeff << "):" << std::endl;
-						// since we're exiting, just edit in-place
-						for(unsigned iidx=printFrom; iidx<printTo; iidx++) {
-							src[region][iidx] = gf16_mul_le(src[region][iidx], coeff);
-						}
-						print_mem_region(src[region], printFrom, printTo);
+						regionSize++;
 					}
+					regionSize /= 2;
+					int printFrom = loc;
+					if(loc > regionSize) printFrom = 0;
+					size_t printTo = std::min((int)regionSize, printFrom+32);
+					std::cout << "Input " << region << ":" << std::endl;
+					print_mem_region(src[region], printFrom, printTo);
 					
-					exit(1);
-				}
-				if(!cksumSuccess) {
-					test.print("MatMul ");
-					std::cout << ", output " << outputNum << " checksum verification failed" << std::endl;
-					exit(1);
+					
+					uint16_t coeff = gfmat_coeff(inputIndicies[region], outputIndicies[outputNum]);
+					std::cout << "Input " << region << " (*" << coeff << "):" << std::endl;
+					// since we're exiting, just edit in-place
+					for(unsigned iidx=printFrom; iidx<printTo; iidx++) {
+						src[region][iidx] = gf16_mul_le(src[region][iidx], coeff);
+					}
+					print_mem_region(src[region], printFrom, printTo);
 				}
 				
-				if(++(*doneCount) == test.numOutputs) {
-					//delete par2; // for some reason, this can cause MSVC to free captured params, so defer deletion
-					auto deinitCb = [=]() {
-						delete par2;
-						// TODO: closing off async_t for unused asyncs causes libuv to go crazy?
-						delete par2cpu;
-						delete par2ocl;
-						IF_LIBUV(cb());
-					};
+				exit(1);
+			}
+			if(!cksumSuccess) {
+				test.print("MatMul ");
+				std::cout << ", output " << outputNum << " checksum verification failed" << std::endl;
+				exit(1);
+			}
+			
+			if(++(*doneCount) == test.numOutputs) {
+				//delete par2; // for some reason, this can cause MSVC to free captured params, so defer deletion
+				auto deinitCb = [=]() {
+					delete par2;
+					// TODO: closing off async_t for unused asyncs causes libuv to go crazy?
+					delete par2cpu;
+					delete par2cpu2;
+					delete par2ocl;
+					IF_LIBUV(cb());
+				};
 #ifdef USE_LIBUV
-					par2->deinit(deinitCb);
+				par2->deinit(deinitCb);
 #else
-					par2->deinit();
-					deinitCb();
+				par2->deinit();
+				deinitCb();
 #endif
-				}
-			};
+			}
+		};
+		
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+		if(hashOutputs) {
+			unsigned numGroups = par2cpu->numOutputGroups(); // the last callback deletes par2cpu
+			for(unsigned group=0; group<numGroups; group++) {
+				unsigned first = group * OUTPUT_HASH_GROUP;
+				auto groupCb = [=](bool cksumSuccess) {
+					// check packet MD5s against those computed from the reference
+					unsigned count = std::min(OUTPUT_HASH_GROUP, test.numOutputs - first);
+					MD5Multi refHasher(count);
+					std::vector<uint8_t> headers(count * 36);
+					std::vector<const void*> ptrs(count);
+					for(unsigned i=0; i<count; i++) {
+						uint8_t* header = headers.data() + i*36;
+						memcpy(header, outputHashSetId, 16);
+						memcpy(header + 16, "PAR 2.0\0RecvSlic", 16);
+						uint32_t exponent = outputIndicies[first+i];
+						for(int b=0; b<4; b++)
+							header[32+b] = (exponent >> (b*8)) & 0xff;
+						ptrs[i] = header;
+					}
+					refHasher.update(ptrs.data(), 36);
+					for(unsigned i=0; i<count; i++)
+						ptrs[i] = ref[first+i];
+					refHasher.update(ptrs.data(), test.sliceSize);
+					refHasher.end();
+					uint8_t refMD5[16*OUTPUT_HASH_GROUP], md5[16*OUTPUT_HASH_GROUP];
+					refHasher.get(refMD5);
+					par2cpu->getOutputGroupMD5(group, md5);
+					if(memcmp(refMD5, md5, 16*count)) {
+						test.print("Hash ");
+						std::cout << ", output group " << group << " packet MD5 mismatch" << std::endl;
+						exit(1);
+					}
+					
+					for(unsigned i=0; i<count; i++)
+						outputCb(first+i, cksumSuccess);
+				};
 #ifdef USE_LIBUV
-			par2->getOutput(outputNum, buffer, outputCb);
+				par2cpu->getOutputGroup(group, reinterpret_cast<void* const*>(dst + first), groupCb);
 #else
-			outputCb(par2->getOutput(outputNum, buffer).get());
+				groupCb(par2cpu->getOutputGroup(group, reinterpret_cast<void* const*>(dst + first)).get());
+#endif
+			}
+			return;
+		}
+#endif
+		for(unsigned outputNum=0; outputNum<test.numOutputs; outputNum++) {
+#ifdef USE_LIBUV
+			par2->getOutput(outputNum, dst[outputNum], [=](bool cksumSuccess) {
+				outputCb(outputNum, cksumSuccess);
+			});
+#else
+			outputCb(outputNum, par2->getOutput(outputNum, dst[outputNum]).get());
 #endif
 		}
 	};
 	
+	// if adding outputs, the inputs are sent again once the first pass completes, with only coefficients for the added outputs
+	unsigned initialOutputs = test.addOutputs ? test.numOutputs/2 : test.numOutputs;
+	std::shared_ptr<bool> reAdding(new bool(false));
+	auto addInputCbRef = std::make_shared<std::function<void(unsigned)>>();
+	
 	std::shared_ptr<unsigned> input(new unsigned(0));
 	auto addInputCb = [=](unsigned) {
 		if(*input >= test.numInputs) return;
 		// TODO: make last chunk smaller
 		while(1) {
 			IF_NOT_LIBUV(par2->waitForAdd());
-			auto added = par2->addInput(src[*input], *input == test.numInputs-1 ? test.lastSliceSize : test.sliceSize, inputIndicies[*input], false IF_LIBUV(, nullptr));
+			size_t size = *input == test.numInputs-1 ? test.lastSliceSize : test.sliceSize;
+			std::vector<uint16_t> coeffs;
+			if(*reAdding) {
+				coeffs.resize(test.numOutputs);
+				for(unsigned output=0; output<test.numOutputs; output++)
+					coeffs[output] = output < initialOutputs ? 0 : gfmat_coeff(inputIndicies[*input], outputIndicies[output]);
+			}
+			auto added = *reAdding
+				? par2->addInput(src[*input], size, coeffs.data(), false IF_LIBUV(, nullptr))
+				: hasher
+				? par2->addInput(src[*input], size, inputIndicies[*input], false, hasher.get(), inputHashes[*input] IF_LIBUV(, nullptr))
+				: par2->addInput(src[*input], size, inputIndicies[*input], false IF_LIBUV(, nullptr));
 #ifdef USE_LIBUV
 			if(!added) break;
 #else
 			(void)added;
 #endif
 			if(++(*input) == test.numInputs) {
+				auto passDone = [=]() {
+					if(!test.addOutputs || *reAdding) {
+						endCb();
+						return;
+					}
+					if(!par2->addRecoverySlices(test.numOutputs - initialOutputs, outputIndicies + initialOutputs)) {
+						test.print("AddOutputs ");
+						std::cout << ", failed to add recovery slices" << std::endl;
+						exit(1);
+					}
+					*reAdding = true;
+					*input = 0;
+					// this releases the reference to itself held by addInputCbRef
+					std::function<void(unsigned)> next;
+					next.swap(*addInputCbRef);
+					next(0);
+				};
 #ifdef USE_LIBUV
-				par2->endInput(endCb);
+				par2->endInput(passDone);
 #else
 				par2->endInput().get();
-				endCb();
+				passDone();
 #endif
 				break;
 			}
 		}
 	};
+	if(test.addOutputs) *addInputCbRef = addInputCb;
 	
 	std::vector<struct PAR2ProcBackendAlloc> par2backends;
 	if(test.useCpu && test.useOcl) {
@@ -170,6 +326,15 @@ static void run_test(struct testProps test IF_LIBUV(, std::function<void()> cb))
 		half += half&1;
 		par2backends.push_back({par2ocl, 0, half});
 		par2backends.push_back({par2cpu, half, test.sliceSize-half});
+	} else if(test.cpuSplit == 1) {
+		// both process the whole slice, taking turns to receive inputs
+		par2backends.push_back({par2cpu, 0, test.sliceSize});
+		par2backends.push_back({par2cpu2, 0, test.sliceSize});
+	} else if(test.cpuSplit == 2) {
+		// both receive all inputs, but compute different recovery slices
+		unsigned half = test.numOutputs >> 1;
+		par2backends.push_back({par2cpu, 0, test.sliceSize, 0, half});
+		par2backends.push_back({par2cpu2, 0, test.sliceSize, half});
 	} else if(test.useCpu) {
 		par2backends.push_back({par2cpu, 0, test.sliceSize});
 	} else {
@@ -177,13 +342,45 @@ static void run_test(struct testProps test IF_LIBUV(, std::function<void()> cb))
 	}
 	
 	par2->init(test.sliceSize, par2backends IF_LIBUV(, addInputCb));
-	if(par2cpu) par2cpu->init(test.cpuMethod);
-	if(test.cpuThreads) par2cpu->setNumThreads(test.cpuThreads);
+	// with more threads, use small input batches, so that more batches are in flight
+	if(par2cpu) par2cpu->init(test.cpuMethod, test.cpuThreads > 2 ? 3 : 0);
+	if(test.cpuThreads) {
+		par2cpu->setNumThreads(test.cpuThreads);
+		// also exercise prepare/finish across multiple transfer threads
+		par2cpu->setTransferThreads(test.cpuThreads > 1 ? 3 : 1);
+		// split the slice across a fake NUMA topology
+		if(test.cpuThreads > 2) par2cpu->setNumaMode(true, 2);
+		// and across fake core classes, with uneven weights
+		if(test.cpuThreads == 2) {
+			par2cpu->setHybridMode(true, 2);
+			par2cpu->setCoreClassWeights({1.0, 0.4});
+		}
+		// allow up to 4 staging areas to be used, instead of a fixed 2
+		if(test.cpuThreads > 2) par2cpu->setStagingMemoryLimit(par2cpu->getAllocSliceSize() * par2cpu->getInputBatchSize() * 4);
+		// start from zeroed recovery memory instead of clearing it
+		if(test.cpuThreads == 1) par2cpu->setZeroedMemory(true);
+		// split chunks by output as well (this is automatically enabled for small slices on many threads)
+		if(test.cpuThreads == 1) par2cpu->setTilingMode(PROC_TILING_2D);
+		// read inputs directly from the source buffers, where the method supports it
+		if(test.cpuThreads > 1) par2cpu->setInPlaceInput(true);
+		// split recovery memory into a segment per chunk, requesting huge pages
+		if(test.cpuThreads == 2) {
+			par2cpu->setSegmentSize(0);
+			par2cpu->setPageMode(PROC_PAGES_THP);
+		}
+	}
+	if(par2cpu2) {
+		par2cpu2->init(test.cpuMethod, 3);
+		par2cpu2->setNumThreads(1);
+	}
 	if(par2ocl) par2ocl->init(test.oclMethod);
-	if(!par2->setRecoverySlices(test.numOutputs, outputIndicies)) {
+	if(!par2->setRecoverySlices(initialOutputs, outputIndicies)) {
 		std::cout << "Init failed" << std::endl;
 		exit(1);
 	}
+#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
+	if(hashOutputs) par2cpu->setOutputHashing(OUTPUT_HASH_GROUP, outputHashSetId);
+#endif
 	
 	// generate reference
 	for(unsigned output=0; output<test.numOutputs; output++) {
@@ -207,6 +404,156 @@ static void run_test(struct testProps test IF_LIBUV(, std::function<void()> cb))
 	// TODO: test re-using PAR2 for multiple passes
 }
 
+// rebuild the inputs in `missing` (from the first `numInputs` source regions) using `numRecovery` recovery slices, computing `groupSize` missing inputs at a time, in parts of `chunkSize`
+static void run_repair_test(unsigned numInputs, std::vector<uint16_t> missing, unsigned numRecovery, unsigned groupSize, size_t chunkSize IF_LIBUV(, std::function<void()> cb)) {
+	const size_t sliceSize = REGION_SIZE;
+	std::vector<bool> inputValid(numInputs, true);
+	for(auto input : missing)
+		inputValid[input] = false;
+	std::sort(missing.begin(), missing.end());
+	
+	// generate recovery, into the reference buffers
+	std::vector<uint16_t> exponents(numRecovery);
+	for(unsigned rec=0; rec<numRecovery; rec++) {
+		exponents[rec] = rec*3 + 1;
+		memset(ref[rec], 0, REGION_SIZE);
+		for(unsigned input=0; input<numInputs; input++) {
+			uint16_t coeff = gfmat_coeff(input, exponents[rec]);
+			for(size_t i=0; i<sliceSize/sizeof(uint16_t); i++)
+				ref[rec][i] ^= gf16_mul_le(src[input][i], coeff);
+		}
+	}
+	
+	auto repair = std::make_shared<PAR2Repair>();
+	if(!repair->init(inputValid, exponents, 1) || repair->getMissingInputs() != missing || repair->getRecoveryExponents().size() != missing.size()) {
+		std::cout << "Repair (" << numInputs << " inputs, " << missing.size() << " missing) failed to init" << std::endl;
+		exit(1);
+	}
+	// insufficient recovery must be rejected
+	PAR2Repair insufficient;
+	if(insufficient.init(inputValid, std::vector<uint16_t>(exponents.begin(), exponents.begin() + missing.size()-1), 1)) {
+		std::cout << "Repair (" << numInputs << " inputs, " << missing.size() << " missing) accepted insufficient recovery" << std::endl;
+		exit(1);
+	}
+	
+	// each pass sends the surviving inputs, followed by the recovery slices used
+	std::vector<uint16_t> survivors;
+	for(unsigned input=0; input<numInputs; input++)
+		if(inputValid[input]) survivors.push_back(input);
+	unsigned numItems = survivors.size() + missing.size();
+	
+	auto* par2 = new PAR2Proc();
+	auto* par2cpu = new PAR2ProcCPU(IF_LIBUV(loop));
+	struct RepairPos {
+		unsigned item;
+		size_t offset;
+		bool ending;
+	};
+	auto pos = std::make_shared<RepairPos>(RepairPos{0, 0, false});
+	auto stepRef = std::make_shared<std::function<void()>>();
+	auto step = [=]() {
+		(*stepRef)();
+	};
+	// the step function only holds a weak reference to itself; the strong references are held by this function (for synchronous processing) and PAR2Proc's callback
+	std::weak_ptr<std::function<void()>> stepWeak = stepRef;
+	
+	*stepRef = [=]() {
+		size_t size = (std::min)(chunkSize, sliceSize - pos->offset);
+		while(pos->item < numItems) {
+			IF_NOT_LIBUV(par2->waitForAdd());
+			const uint16_t* buffer;
+			const uint16_t* coeffs;
+			if(pos->item < survivors.size()) {
+				buffer = src[survivors[pos->item]];
+				coeffs = repair->inputCoeffs(survivors[pos->item]);
+			} else {
+				unsigned rec = pos->item - (unsigned)survivors.size();
+				buffer = ref[(repair->getRecoveryExponents()[rec] - 1) / 3];
+				coeffs = repair->recoveryCoeffs(rec);
+			}
+			auto added = par2->addInput(reinterpret_cast<const char*>(buffer) + pos->offset, size, coeffs, false IF_LIBUV(, nullptr));
+#ifdef USE_LIBUV
+			if(!added) return;
+#else
+			(void)added;
+#endif
+			pos->item++;
+		}
+		if(pos->ending) return;
+		pos->ending = true;
+		
+		auto nextPass = [=]() {
+			unsigned first = repair->getOutputGroupFirst(), count = repair->getOutputGroupCount();
+			pos->item = 0;
+			pos->ending = false;
+			pos->offset += chunkSize;
+			if(pos->offset >= sliceSize) {
+				for(unsigned output=first; output<first+count; output++) {
+					if(memcmp(dst[output], src[missing[output]], sliceSize)) {
+						std::cout << "Repair (" << numInputs << " inputs, " << missing.size() << " missing) input " << missing[output] << " mismatch" << std::endl;
+						display_mem_diff(src[missing[output]], dst[output], sliceSize/2);
+						exit(1);
+					}
+				}
+				pos->offset = 0;
+				first += count;
+				if(first >= missing.size()) {
+					auto deinitCb = [=]() {
+						delete par2;
+						delete par2cpu;
+						IF_LIBUV(cb());
+					};
+#ifdef USE_LIBUV
+					par2->deinit(deinitCb);
+#else
+					par2->deinit();
+					deinitCb();
+#endif
+					return;
+				}
+				repair->setOutputGroup(*par2, first, (std::min)(groupSize, (unsigned)missing.size() - first));
+			}
+			par2->discardOutput(); // start the next pass afresh
+			par2->setCurrentSliceSize((std::min)(chunkSize, sliceSize - pos->offset));
+			if(auto next = stepWeak.lock()) (*next)();
+		};
+		auto passDone = [=]() {
+			unsigned first = repair->getOutputGroupFirst(), count = repair->getOutputGroupCount();
+			auto fetched = std::make_shared<unsigned>(0);
+			for(unsigned output=0; output<count; output++) {
+				auto outputCb = [=](bool cksumSuccess) {
+					if(!cksumSuccess) {
+						std::cout << "Repair (" << numInputs << " inputs, " << missing.size() << " missing) output " << output << " checksum verification failed" << std::endl;
+						exit(1);
+					}
+					if(++(*fetched) == count) nextPass();
+				};
+				void* buffer = reinterpret_cast<char*>(dst[first+output]) + pos->offset;
+#ifdef USE_LIBUV
+				par2->getOutput(output, buffer, outputCb);
+#else
+				outputCb(par2->getOutput(output, buffer).get());
+#endif
+			}
+		};
+#ifdef USE_LIBUV
+		par2->endInput(passDone);
+#else
+		par2->endInput().get();
+		passDone();
+#endif
+	};
+	
+	par2->init(chunkSize, {{par2cpu, 0, chunkSize}} IF_LIBUV(, [=](unsigned) { step(); }));
+	par2cpu->init(GF16_AUTO);
+	par2cpu->setNumThreads(2);
+	if(!repair->setOutputGroup(*par2, 0, (std::min)(groupSize, (unsigned)missing.size()))) {
+		std::cout << "Repair init failed" << std::endl;
+		exit(1);
+	}
+	step();
+}
+
 static void show_help() {
 	std::cout << "test-ctrl [-v] [-f] [-p[c][g]]" << std::endl;
 	exit(0);
@@ -245,6 +592,7 @@ int real_main(int argc, char** argv) {
 	const std::vector<size_t> outputSizeTests{1, 15, 16}; // must be less than MAX_TEST_OUTPUTS
 	gf16_generate_log_tables();
 	gfmat_init();
+	setup_hasher();
 	
 	if(useOcl) {
 		if(PAR2ProcOCL::load_runtime()) {
@@ -299,7 +647,7 @@ int real_main(int argc, char** argv) {
 					
 					if(useCpu && useOcl) {
 						tests.push({
-							sliceSize, lastSliceSize, numRegions, numOutputs, GF16_AUTO, 0, GF16OCL_AUTO, useCpu, useOcl
+							sliceSize, lastSliceSize, numRegions, numOutputs, GF16_AUTO, 0, GF16OCL_AUTO, useCpu, useOcl, 0, false
 						});
 					} else if(useCpu) {
 						const std::vector<Galois16Methods> methods = skipMethods ? std::vector<Galois16Methods>{GF16_AUTO} : PAR2ProcCPU::availableMethods();
@@ -307,15 +655,27 @@ int real_main(int argc, char** argv) {
 						for(auto threads : threadTests) {
 							for(const auto& method : methods) {
 								tests.push({
-									sliceSize, lastSliceSize, numRegions, numOutputs, method, threads, GF16OCL_AUTO, useCpu, useOcl
+									sliceSize, lastSliceSize, numRegions, numOutputs, method, threads, GF16OCL_AUTO, useCpu, useOcl, 0, false
 								});
+								if(threads == 2 && numRegions > 1)
+									tests.push({
+										sliceSize, lastSliceSize, numRegions, numOutputs, method, threads, GF16OCL_AUTO, useCpu, useOcl, 1, false
+									});
+								if(threads == 2 && numOutputs > 1)
+									tests.push({
+										sliceSize, lastSliceSize, numRegions, numOutputs, method, threads, GF16OCL_AUTO, useCpu, useOcl, 2, false
+									});
+								if(threads == 1 && numOutputs > 1 && numRegions > 15)
+									tests.push({
+										sliceSize, lastSliceSize, numRegions, numOutputs, method, threads, GF16OCL_AUTO, useCpu, useOcl, 0, true
+									});
 							}
 						}
 					} else {
 						const std::vector<Galois16OCLMethods> methods = skipMethods ? std::vector<Galois16OCLMethods>{GF16OCL_AUTO} : PAR2ProcOCL::availableMethods();
 						for(const auto& method : methods) {
 							tests.push({
-								sliceSize, lastSliceSize, numRegions, numOutputs, GF16_AUTO, 0, method, useCpu, useOcl
+								sliceSize, lastSliceSize, numRegions, numOutputs, GF16_AUTO, 0, method, useCpu, useOcl, 0, false
 							});
 						}
 					}
@@ -325,6 +685,37 @@ int real_main(int argc, char** argv) {
 		}
 	}
 	
+	// the autotuner should pick an available method, then return the same result from its cache
+	if(useCpu && !useOcl) {
+		const char* cacheFile = "test-ctrl-autotune.tmp";
+		remove(cacheFile);
+		auto tuned = PAR2ProcCPU::autotune(REGION_SIZE, 16, 16, cacheFile);
+		auto cached = PAR2ProcCPU::autotune(REGION_SIZE, 16, 16, cacheFile);
+		remove(cacheFile);
+		auto methods = PAR2ProcCPU::availableMethods();
+		if(std::find(methods.begin(), methods.end(), tuned.method) == methods.end() || tuned.inputGrouping < 1 || tuned.inputGrouping > 16 || tuned.chunkLen < 1) {
+			std::cout << "Autotune returned invalid parameters: " << Galois16Mul::methodToText(tuned.method) << ", " << tuned.inputGrouping << " inputs, " << tuned.chunkLen << " chunk" << std::endl;
+			return 1;
+		}
+		if(cached.method != tuned.method || cached.inputGrouping != tuned.inputGrouping || cached.chunkLen != tuned.chunkLen) {
+			std::cout << "Autotune cache returned different parameters: " << Galois16Mul::methodToText(cached.method) << ", " << cached.inputGrouping << " inputs, " << cached.chunkLen << " chunk" << std::endl;
+			return 1;
+		}
+	}
+	
+	// rebuild missing inputs: in groups with multiple passes over the slice, with spare recovery; and all inputs missing, in a single pass
+	if(useCpu && !useOcl) {
+#ifdef USE_LIBUV
+		run_repair_test(16, {0, 3, 7, 8, 15}, 7, 2, 6000, [=]() {
+			run_repair_test(12, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}, 12, 12, REGION_SIZE, []() {});
+		});
+		uv_run(loop, UV_RUN_DEFAULT);
+#else
+		run_repair_test(16, {0, 3, 7, 8, 15}, 7, 2, 6000);
+		run_repair_test(12, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}, 12, 12, REGION_SIZE);
+#endif
+	}
+	
 	std::function<bool()> testRunner;
 	testRunner = [=, &tests, &testRunner]() -> bool {
 		if(tests.empty()) return false;
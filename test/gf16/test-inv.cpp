@@ -136,6 +136,40 @@ int main(int argc, char** argv) {
 			delete[] leftmatrix;
 		}
 		
+		// PAR2 flaw hit on the last row, after other row groups have been processed, so that the replacement row needs to be brought up to the current elimination state
+		// as exponents are all multiples of 5, the columns for inputs 0 and 6554 are identical, so the matrix can't be inverted without a spare
+		{
+			std::vector<bool> inputValid(20000, true);
+			const unsigned numMissing = 72;
+			std::vector<uint16_t> recovery;
+			for(unsigned i=0; i<numMissing; i++) {
+				inputValid[i == numMissing-1 ? 6554 : i] = false;
+				recovery.push_back(i*5);
+			}
+			do_test(inputValid, recovery, method); // no spare recovery
+			
+			Galois16RecMatrix mat;
+			mat.regionMethod = (int)method;
+			recovery.push_back(numMissing*5 + 1);
+			recovery.push_back(numMissing*5 + 2);
+			if(!mat.Compute(inputValid, inputValid.size()-numMissing, recovery)) {
+				std::cout << "Failed to invert PAR2 flaw with spare recovery" << std::endl;
+				abort();
+			}
+			if(recovery.size() != numMissing || recovery.back() != numMissing*5 + 1) {
+				std::cout << "Spare recovery not used" << std::endl;
+				abort();
+			}
+			
+			Galois16* leftmatrix = nullptr;
+			if(!p2c_invert(inputValid, recovery, leftmatrix)) {
+				std::cout << "Unexpected invert failure" << std::endl;
+				abort();
+			}
+			compare_invert(mat, leftmatrix, inputValid, recovery);
+			delete[] leftmatrix;
+		}
+		
 		// a few more tests to check multi-region multiplies work
 		do_test(std::vector<bool>{false, false, false, false, false}, std::vector<uint16_t>{0,3,5,17,65534}, method);
 		do_test(std::vector<bool>{false, false, false, false, false, false}, std::vector<uint16_t>{0,1,2,3,32768,65534}, method);
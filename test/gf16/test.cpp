@@ -481,8 +481,8 @@ int main(int argc, char** argv) {
 											else {
 												memcpy(tmp2, tmp, regionSizeWithCksum*numOutputs);
 												if(firstLen)
-													g.finish_partial_packsum(outputDst, tmp2, srcLen, numOutputs, outputNum, chunkLen, 0, firstLen);
-												checksumResult = g.finish_partial_packsum(outputDst+firstLen, tmp2, srcLen, numOutputs, outputNum, chunkLen, firstLen, srcLen-firstLen);
+													g.finish_partial_packsum(outputDst, tmp2, srcLen, numOutputs, outputNum, chunkLen, 0, firstLen, NULL);
+												checksumResult = g.finish_partial_packsum(outputDst+firstLen, tmp2, srcLen, numOutputs, outputNum, chunkLen, firstLen, srcLen-firstLen, NULL);
 											}
 											if(memcmp(outputDst, ref, srcLen)) {
 												std::cout << "Packed finish-cksum failure: " << g.info().name << ", output " << outputNum << ": srcLen=" << srcLen << ", chunkLen=" << chunkLen << ", numOutputs=" << numOutputs << ", firstLen=" << firstLen << std::endl;
@@ -707,6 +707,35 @@ int main(int argc, char** argv) {
 							}
 						}
 						
+						// muladd_multi directly from untransformed sources
+						if(g.hasNaturalInput()) {
+							g.prepare(dst, src2, regionSize);
+							g.mul_add_multi_natural(maxRegions, 0, dst, (const void**)srcM, regionSize, coeffs, gfScratch[gi]);
+							g.finish(dst, regionSize);
+							if(memcmp(dst, ref, regionSize)) {
+								std::cout << "Mul_add_multi_natural (" << maxRegions << ") failure: " << g.info().name << std::endl;
+								display_mem_diff(ref, dst, regionSize/2);
+								return 1;
+							}
+							
+							// caller buffers needn't be aligned, and processing may start part way into the slice
+							const void* srcU[MAX_TEST_REGIONS];
+							for(unsigned region=0; region<maxRegions; region++) {
+								char* p = (char*)tmp2 + region*(regionSize+64) + (region%15)+1;
+								memcpy(p, srcM[region], regionSize);
+								srcU[region] = p;
+							}
+							const size_t offset = g.info().stride * (maxRegions % 3 + 1);
+							g.prepare(dst, src2, regionSize);
+							g.mul_add_multi_natural(maxRegions, offset, dst, srcU, regionSize-offset, coeffs, gfScratch[gi]);
+							g.finish(dst, regionSize);
+							if(memcmp(dst, src2, offset) || memcmp((char*)dst + offset, (char*)ref + offset, regionSize-offset)) {
+								std::cout << "Mul_add_multi_natural unaligned (" << maxRegions << ", offset " << offset << ") failure: " << g.info().name << std::endl;
+								display_mem_diff(ref, dst, regionSize/2);
+								return 1;
+							}
+						}
+						
 						for(unsigned blankRegions=0; blankRegions<3; blankRegions++) { // test packing with regions that are never written
 							if(blankRegions + maxRegions >= MAX_TEST_REGIONS) break;
 							
@@ -13,7 +13,9 @@
 #endif
 
 #include <stdlib.h>
-#if defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
+#ifdef ALIGN_ALLOC
+	// already defined by src/platform.h
+#elif defined(_MSC_VER) || defined(__MINGW32__) || defined(__MINGW64__)
 	// MSVC doesn't support C11 aligned_alloc: https://stackoverflow.com/a/62963007
 	#define ALIGN_ALLOC(buf, len, align) *(void**)&(buf) = _aligned_malloc((len), align)
 	#define ALIGN_FREE _aligned_free
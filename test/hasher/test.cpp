@@ -5,8 +5,11 @@
 #include <iomanip>
 #include <vector>
 #include <tuple>
+#include <algorithm>
 #include <memory>
 #include "hasher.h"
+#include "hasher_blockscan.h"
+#include "hasher_input_pool.h"
 
 typedef char md5hash[16]; // add null byte for convenience
 
@@ -217,8 +220,140 @@ bool do_tests(IHasherInput* hasher, MD5SingleUpdate_t md5sgl, MD5CRC_Calc_t md5c
 }
 
 
+// hash multiple files at once, with data given in varying sized pieces, and check that results match hashing each file on its own
+bool do_pool_tests() {
+	const uint64_t blockSize = 10000;
+	const unsigned numFiles = 7;
+	std::vector<std::vector<uint8_t>> files(numFiles);
+	std::vector<std::vector<char>> expectedBlocks(numFiles), blocks(numFiles);
+	std::vector<std::vector<char>> expectedMd5(numFiles, std::vector<char>(16)), md5(numFiles, std::vector<char>(16));
+	for(unsigned f=0; f<numFiles; f++) {
+		// include a file smaller than a block, and one that's an exact multiple of it
+		size_t len = f == 0 ? 123 : (f == 1 ? blockSize*5 : rand() % 100000 + 1);
+		files[f].resize(len);
+		for(auto& c : files[f]) c = rand();
+		unsigned numBlocks = (unsigned)((len + blockSize-1) / blockSize);
+		expectedBlocks[f].resize(numBlocks * 20);
+		blocks[f].resize(numBlocks * 20);
+		
+		auto hasher = HasherInput_Create();
+		for(unsigned b=0; b<numBlocks; b++) {
+			size_t blockLen = (std::min)((size_t)blockSize, len - b*blockSize);
+			hasher->update(files[f].data() + b*blockSize, blockLen);
+			hasher->getBlock(expectedBlocks[f].data() + b*20, blockSize - blockLen);
+		}
+		hasher->end(expectedMd5[f].data());
+		hasher->destroy();
+	}
+	
+	HasherInputPool pool(3);
+	std::vector<std::vector<size_t>> hashedPos(numFiles);
+	std::vector<std::unique_ptr<HasherInputStream>> streams;
+	for(unsigned f=0; f<numFiles; f++) {
+		auto* posList = &hashedPos[f];
+		streams.emplace_back(new HasherInputStream(pool, blockSize, blocks[f].data(), (unsigned)(blocks[f].size() / 20), [posList](void* cookie) {
+			posList->push_back((size_t)cookie);
+		}));
+	}
+	
+	// feed all files in interleaved pieces; the cookie is the piece's end position, so that the order of completion can be checked
+	std::vector<size_t> pos(numFiles, 0);
+	bool restarted = false;
+	while(1) {
+		bool fed = false;
+		for(unsigned f=0; f<numFiles; f++) {
+			if(pos[f] >= files[f].size()) continue;
+			size_t len = (std::min)((size_t)(rand() % 30000 + 1), files[f].size() - pos[f]);
+			streams[f]->update(files[f].data() + pos[f], len, (void*)(pos[f] + len));
+			pos[f] += len;
+			fed = true;
+		}
+		if(!fed) break;
+		if(!restarted) {
+			// threads should restart when more data is given after stopping, and continue after the thread count changes
+			pool.stop();
+			pool.setNumThreads(2);
+			restarted = true;
+		} else if(pool.getNumThreads() > 1) {
+			// reducing the thread count ends excess threads whilst data is still coming in
+			pool.setNumThreads(1);
+		}
+	}
+	
+	for(unsigned f=0; f<numFiles; f++) {
+		streams[f]->end(md5[f].data());
+		if(!std::is_sorted(hashedPos[f].begin(), hashedPos[f].end()) || hashedPos[f].empty() || hashedPos[f].back() != files[f].size()) {
+			std::cout << "File " << f << " hashed out of order" << std::endl;
+			return true;
+		}
+		if(blocks[f] != expectedBlocks[f] || md5[f] != expectedMd5[f]) {
+			std::cout << "File " << f << " hash mismatch" << std::endl;
+			return true;
+		}
+	}
+	return false;
+}
+
 #ifdef PARPAR_ENABLE_HASHER_MULTIMD5
 const int MAX_REGIONS = 128; // max SVE2 region count
+#ifdef PARPAR_ENABLE_HASHER_MD5CRC
+// place blocks at arbitrary offsets in random data, and check that the scanner finds exactly those
+bool do_scan_tests() {
+	const size_t blockSize = 1000;
+	const size_t dataLen = 600000; // enough for multiple threads, each with multiple lanes
+	const unsigned numBlocks = 8;
+	std::vector<uint8_t> data(dataLen);
+	std::vector<uint8_t> blocks(numBlocks * blockSize);
+	for(auto& c : data) c = rand();
+	for(auto& c : blocks) c = rand();
+	
+	std::vector<BlockScanChecksum> checksums(numBlocks+1);
+	for(unsigned i=0; i<numBlocks; i++)
+		checksums[i].crc = MD5CRC_Calc(blocks.data() + i*blockSize, blockSize, 0, checksums[i].md5);
+	// a block with a CRC matching block 0, but different content, must be rejected by the MD5 check
+	checksums[numBlocks] = checksums[0];
+	checksums[numBlocks].md5[0] ^= 1;
+	
+	// start, end, next to thread/lane split points, odd offsets; block 0 twice
+	const std::pair<size_t, unsigned> placements[] = {
+		{0, 0}, {12345, 1}, {74999, 2}, {150001, 3}, {299500, 4}, {299999+blockSize, 0}, {449997, 5}, {512345, 6}, {dataLen-blockSize, 7}
+	};
+	std::vector<BlockScanMatch> expected;
+	for(const auto& p : placements) {
+		memcpy(data.data() + p.first, blocks.data() + p.second*blockSize, blockSize);
+		expected.push_back({p.first, p.second});
+	}
+	auto sameMatches = [&](const std::vector<BlockScanMatch>& matches) -> bool {
+		if(matches.size() != expected.size()) return false;
+		for(unsigned i=0; i<matches.size(); i++)
+			if(matches[i].offset != expected[i].offset || matches[i].block != expected[i].block) return false;
+		return true;
+	};
+	
+	BlockScanner scanner(blockSize, checksums);
+	for(int threads : {1, 2, 3}) {
+		std::vector<BlockScanMatch> matches;
+		scanner.scan(data.data(), dataLen, matches, 0, threads);
+		if(!sameMatches(matches)) {
+			std::cout << "Block scan with " << threads << " thread(s) found " << matches.size() << " blocks" << std::endl;
+			return true;
+		}
+	}
+	// scan in overlapping pieces
+	std::vector<BlockScanMatch> matches;
+	const size_t pieceLen = 100000;
+	for(size_t pos=0; pos<dataLen; pos+=pieceLen) {
+		size_t len = (std::min)(pieceLen + blockSize-1, dataLen-pos);
+		scanner.scan(data.data() + pos, len, matches, pos);
+	}
+	if(!sameMatches(matches)) {
+		std::cout << "Block scan in pieces found " << matches.size() << " blocks" << std::endl;
+		return true;
+	}
+	return false;
+}
+#endif
+
 bool do_mb_tests(MD5Multi* hasher, const md5hash expected[MAX_REGIONS], const void* const* src, size_t len, int regions) {
 	hasher->reset();
 	hasher->update(src, len);
@@ -282,6 +417,10 @@ int main(void) {
 		if(do_tests(nullptr, MD5Single::_update, MD5CRC_Calc, CRC32_Calc)) ERROR(" - FAILED");
 		std::cout << std::endl;
 	}
+	
+	std::cout << "Testing block scanner..." << std::endl;
+	srand(0x87654321);
+	if(do_scan_tests()) ERROR("  - FAILED");
 	#endif
 	
 	std::cout << "Testing input hashers..." << std::endl;
@@ -295,6 +434,10 @@ int main(void) {
 		std::cout << std::endl;
 	}
 	
+	std::cout << "Testing input hashing pool..." << std::endl;
+	srand(0x12345678);
+	if(do_pool_tests()) ERROR("  - FAILED");
+	
 	#ifdef PARPAR_ENABLE_HASHER_MULTIMD5
 	set_hasherInput(inputHashers[0]);
 	IHasherInput* hiScalar = HasherInput_Create();
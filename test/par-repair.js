@@ -0,0 +1,262 @@
+"use strict";
+/*
+ * Crude end-to-end test of ParPar's repair mode
+ * A recovery set is created, then its files are damaged in various ways, repaired, and compared against the originals
+ */
+
+
+// Change these variables if necessary
+var tmpDir = (process.env.TMP || process.env.TEMP || '.') + require('path').sep;
+var exeNode = 'node';
+var exeParpar = '../bin/parpar';
+
+
+var procArgs = process.argv.slice(2);
+var verbose = procArgs.indexOf('-v') > -1;
+
+var fs = require('fs');
+var path = require('path');
+var crypto = require('crypto');
+var async = require('async');
+var proc = require('child_process');
+
+var allocBuffer = (Buffer.allocUnsafe || Buffer);
+var bufferSlice = Buffer.prototype.readBigInt64BE ? Buffer.prototype.subarray : Buffer.prototype.slice;
+
+var BufferCompare;
+if(Buffer.compare) BufferCompare = Buffer.compare;
+else BufferCompare = function(a, b) {
+	var l = Math.min(a.length, b.length);
+	for(var i=0; i<l; i++) {
+		if(a[i] > b[i])
+			return 1;
+		if(a[i] < b[i])
+			return -1;
+	}
+	if(a.length > b.length)
+		return 1;
+	if(a.length < b.length)
+		return -1;
+	return 0;
+};
+
+var workDir = tmpDir + 'parrepair' + path.sep;
+var sliceSize = 256*1024;
+var recoverySlices = 24;
+
+// generate consistent pseudo-random data, using xorshift32 seeded from the name (RC4 isn't available in newer OpenSSL builds)
+function rndData(name, size) {
+	var state = crypto.createHash('md5').update(name).digest().readUInt32LE(0) || 1;
+	var buf = allocBuffer(size);
+	for(var i=0; i<size; i++) {
+		state ^= state << 13;
+		state ^= state >>> 17;
+		state ^= state << 5;
+		buf[i] = state & 0xff;
+	}
+	return buf;
+}
+// prime number file sizes, so that the last slice of each file is partial
+var sourceFiles = {
+	'a.bin': 1048573,
+	'b.bin': 65521,
+	'd.bin': 7,
+	'e.bin': 499979
+};
+sourceFiles[path.join('sub', 'c.bin')] = 2999999;
+var sourceData = {};
+for(var name in sourceFiles)
+	sourceData[name] = rndData(name, sourceFiles[name]);
+
+var mkdirp = function(dir) {
+	if(fs.existsSync(dir)) return;
+	mkdirp(path.dirname(dir));
+	fs.mkdirSync(dir);
+};
+var writeSources = function() {
+	for(var name in sourceData) {
+		mkdirp(path.dirname(workDir + name));
+		fs.writeFileSync(workDir + name, sourceData[name]);
+	}
+};
+var delSet = function() {
+	if(!fs.existsSync(workDir)) return;
+	fs.readdirSync(workDir).forEach(function(f) {
+		if(/\.par2$/.test(f)) fs.unlinkSync(workDir + f);
+	});
+};
+
+
+// ways to damage a file
+var damage = {
+	'delete': function(file) {
+		fs.unlinkSync(file);
+	},
+	truncate: function(file) {
+		fs.truncateSync(file, Math.floor(fs.statSync(file).size / 3));
+	},
+	corrupt: function(file) {
+		// flip bytes in a few places, including the first and last
+		var size = fs.statSync(file).size;
+		var fd = fs.openSync(file, 'r+');
+		var b = allocBuffer(1);
+		[0, Math.floor(size/2), size-1].forEach(function(pos) {
+			fs.readSync(fd, b, 0, 1, pos);
+			b[0] ^= 0x5a;
+			fs.writeSync(fd, b, 0, 1, pos);
+		});
+		fs.closeSync(fd);
+	},
+	zero: function(file) {
+		// zero out a range spanning a slice boundary
+		var size = fs.statSync(file).size;
+		var len = Math.min(size, sliceSize);
+		var zeroes = allocBuffer(len);
+		zeroes.fill(0);
+		var fd = fs.openSync(file, 'r+');
+		fs.writeSync(fd, zeroes, 0, len, Math.max(0, Math.min(size - len, sliceSize/2)));
+		fs.closeSync(fd);
+	},
+	extend: function(file) {
+		fs.appendFileSync(file, rndData('junk', 1000));
+	},
+	// shift data within the file, displacing every following slice
+	insert: function(file) {
+		var data = fs.readFileSync(file);
+		var pos = Math.min(data.length, sliceSize/2);
+		fs.writeFileSync(file, Buffer.concat([bufferSlice.call(data, 0, pos), rndData('junk', 1000), bufferSlice.call(data, pos)]));
+	},
+	remove: function(file) {
+		var data = fs.readFileSync(file);
+		var pos = Math.min(data.length, sliceSize/2);
+		fs.writeFileSync(file, Buffer.concat([bufferSlice.call(data, 0, pos), bufferSlice.call(data, pos + 1000)]));
+	}
+};
+var cName = path.join('sub', 'c.bin');
+var damageAll = {'a.bin': 'corrupt', 'b.bin': 'delete', 'd.bin': 'truncate', 'e.bin': 'extend'};
+damageAll[cName] = 'delete';
+
+var allTests = [
+	{
+		name: 'intact',
+		damage: {},
+		repaired: false
+	},
+	{
+		name: 'missing file in subdirectory',
+		damage: (function() { var d = {}; d[cName] = 'delete'; return d; })()
+	},
+	{
+		name: 'truncated, corrupted and extended',
+		damage: {'a.bin': 'truncate', 'e.bin': 'corrupt', 'b.bin': 'extend', 'd.bin': 'corrupt'}
+	},
+	{
+		name: 'zeroed ranges, one read buffer',
+		damage: (function() { var d = {'a.bin': 'zero', 'e.bin': 'zero'}; d[cName] = 'zero'; return d; })(),
+		readBuffers: 1
+	},
+	{
+		name: 'all damage types, single pass',
+		damage: damageAll
+	},
+	{
+		// full slices after the change are found and moved back, but the first and last slice of each file need rebuilding
+		name: 'inserted and removed bytes',
+		damage: (function() { var d = {'a.bin': 'remove', 'e.bin': 'insert'}; d[cName] = 'insert'; return d; })(),
+		displaced: 2 + 0 + 10
+	},
+	{
+		// chunks of the minimum size, rebuilding a single slice at a time
+		name: 'all damage types, memory limited to multiple groups and chunks',
+		damage: damageAll,
+		memory: '1M',
+		multiGroup: true,
+		multiChunk: true
+	},
+	{
+		// typically rebuilds several slices per group
+		name: 'all damage types, memory limited to multiple groups and chunks (larger groups)',
+		damage: damageAll,
+		memory: '2560K',
+		multiGroup: true,
+		multiChunk: true
+	},
+	{
+		name: 'all damage types, memory limited to multiple chunks',
+		damage: damageAll,
+		memory: '8M',
+		multiChunk: true
+	}
+];
+
+
+var runParpar = function(args, cb) {
+	var execArgs = (Array.isArray(exeParpar) ? exeParpar : [exeParpar]).concat(args);
+	console.log('Executing: ' + exeNode, execArgs.map(function(arg) { return '"' + arg + '"'; }).join(' '));
+	proc.execFile(exeNode, execArgs, function(err, stdout, stderr) {
+		if(err) {
+			process.stdout.write(stdout);
+			process.stderr.write(stderr);
+			throw err;
+		}
+		cb(stdout);
+	});
+};
+
+mkdirp(workDir);
+delSet();
+writeSources();
+console.log('Creating recovery set...');
+runParpar(['-q', '--input-slices=' + sliceSize + 'b', '--recovery-slices=' + recoverySlices, '-o', workDir + 'set.par2'].concat(Object.keys(sourceFiles).map(function(name) {
+	return workDir + name;
+})), function() {
+	async.timesSeries(allTests.length, function(testNum, cb) {
+		var test = allTests[testNum];
+		console.log('Testing: ' + test.name);
+		
+		writeSources();
+		for(var name in test.damage)
+			damage[test.damage[name]](workDir + name);
+		
+		var args = ['--json', '--repair', workDir + 'set.par2'];
+		if(test.memory) args.push('--memory=' + test.memory);
+		if(test.readBuffers) args.push('--read-buffers=' + test.readBuffers);
+		runParpar(args, function(stdout) {
+			// output is a sequence of JSON objects
+			var events = JSON.parse('[' + stdout.trim().replace(/\}\s*\{/g, '},{') + ']');
+			if(verbose) console.log(events);
+			var info = null, complete = null, displaced = 0;
+			events.forEach(function(ev) {
+				if(ev.type == 'repair_info') info = ev;
+				if(ev.type == 'process_complete') complete = ev;
+				if(ev.type == 'found_displaced') displaced = ev.slices;
+			});
+			
+			if(!complete) throw new Error('Repair did not complete');
+			var expectRepaired = test.repaired !== false;
+			if(complete.repaired !== expectRepaired)
+				throw new Error('Expected files to ' + (expectRepaired ? '' : 'not ') + 'need repair');
+			if(test.multiGroup && !(info && info.group_size < info.missing_slices))
+				throw new Error('Expected missing slices to be rebuilt in multiple groups');
+			if(test.multiChunk && !(info && info.chunk_size < sliceSize))
+				throw new Error('Expected slices to be processed in multiple chunks');
+			if(displaced != (test.displaced || 0))
+				throw new Error('Expected ' + (test.displaced || 0) + ' displaced slices to be found, but found ' + displaced);
+			
+			for(var name in sourceData) {
+				if(!fs.existsSync(workDir + name))
+					throw new Error('File "' + name + '" was not restored');
+				if(BufferCompare(fs.readFileSync(workDir + name), sourceData[name]))
+					throw new Error('File "' + name + '" does not match the original');
+			}
+			cb();
+		});
+	}, function(err) {
+		delSet();
+		for(var name in sourceData)
+			fs.unlinkSync(workDir + name);
+		
+		if(!err)
+			console.log('All tests passed');
+	});
+});